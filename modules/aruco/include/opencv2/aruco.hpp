@@ -224,6 +224,78 @@ CV_EXPORTS_W void detectMarkers(InputArray image, const Ptr<Dictionary> &diction
 
 
 
+/**
+ * @brief Reusable marker detector
+ *
+ * Performs the same detection as detectMarkers(), but keeps the grey images, the thresholded
+ * images of every window size and the candidate containers between calls, so repeated detection
+ * on images of the same size does not reallocate them.
+ *
+ * detectBatch() processes several images at once. Thresholding and contour search of all
+ * images and all window sizes, candidate identification and corner refinement are each
+ * scheduled as a single flat parallel job over the whole batch, so all threads are kept busy
+ * even when every image contains only a few candidates.
+ *
+ * A MarkerDetector instance is not thread safe: use one instance per calling thread.
+ */
+class CV_EXPORTS_W MarkerDetector {
+
+    public:
+    virtual ~MarkerDetector();
+
+    /**
+     * @brief Create a new MarkerDetector
+     *
+     * @param dictionary indicates the type of markers that will be searched
+     * @param parameters marker detection parameters
+     */
+    CV_WRAP static Ptr<MarkerDetector> create(const Ptr<Dictionary> &dictionary,
+                                              const Ptr<DetectorParameters> &parameters = DetectorParameters::create());
+
+    /**
+     * @brief Detect markers in a single image
+     *
+     * Parameters and results are the same as in detectMarkers().
+     */
+    CV_WRAP virtual void detect(InputArray image, OutputArrayOfArrays corners, OutputArray ids,
+                                OutputArrayOfArrays rejectedImgPoints = noArray(),
+                                InputArray cameraMatrix = noArray(), InputArray distCoeff = noArray()) = 0;
+
+    /**
+     * @brief Detect markers in a batch of images
+     *
+     * @param images input images (CV_8UC1 or CV_8UC3), they do not need to have the same size
+     * @param corners for each image, the vector of detected marker corners (see detectMarkers())
+     * @param ids for each image, the vector of identifiers of the detected markers
+     * @param rejectedImgPoints for each image, the rejected candidates
+     * @param cameraMatrices optional camera matrices, only used by CORNER_REFINE_CONTOUR. Either
+     * empty, a single matrix shared by all images or one matrix per image.
+     * @param distCoeffs optional distortion coefficients, with the same layout as cameraMatrices
+     */
+    virtual void detectBatch(InputArrayOfArrays images,
+                             std::vector< std::vector< std::vector< Point2f > > > &corners,
+                             std::vector< std::vector< int > > &ids,
+                             std::vector< std::vector< std::vector< Point2f > > > &rejectedImgPoints,
+                             InputArrayOfArrays cameraMatrices = noArray(),
+                             InputArrayOfArrays distCoeffs = noArray()) = 0;
+
+    /** @overload */
+    void detectBatch(InputArrayOfArrays images,
+                     std::vector< std::vector< std::vector< Point2f > > > &corners,
+                     std::vector< std::vector< int > > &ids) {
+        std::vector< std::vector< std::vector< Point2f > > > rejectedImgPoints;
+        detectBatch(images, corners, ids, rejectedImgPoints);
+    }
+
+    CV_WRAP virtual void setDictionary(const Ptr<Dictionary> &dictionary) = 0;
+    CV_WRAP virtual Ptr<Dictionary> getDictionary() const = 0;
+
+    CV_WRAP virtual void setDetectorParameters(const Ptr<DetectorParameters> &parameters) = 0;
+    CV_WRAP virtual Ptr<DetectorParameters> getDetectorParameters() const = 0;
+};
+
+
+
 /**
  * @brief Pose estimation for single markers
  *
@@ -450,6 +522,69 @@ CV_EXPORTS_W void refineDetectedMarkers(
 
 
 
+/**
+ * @brief Stateful marker detector for video sequences
+ *
+ * Markers detected in the previous frame are tracked: their corners are predicted with a
+ * constant velocity model and the thresholding and contour search of detectMarkers() are only
+ * run in padded regions of interest around the predicted positions. A full frame detection is
+ * performed every fullScanInterval frames, when there is nothing to track, and whenever a tracked
+ * marker is not found again in its region of interest. New markers entering the view are thus
+ * found at the next full frame detection at the latest.
+ *
+ * If a board is set, refineDetectedMarkers() is applied after every detection to recover the
+ * board markers that were not detected (@sa refineDetectedMarkers). ChArUco corners can then be
+ * obtained from the returned markers with interpolateCornersCharuco().
+ */
+class CV_EXPORTS_W MarkerTracker {
+
+    public:
+    virtual ~MarkerTracker();
+
+    /**
+     * @brief Create a new MarkerTracker
+     *
+     * @param dictionary indicates the type of markers that will be searched
+     * @param parameters marker detection parameters
+     * @param fullScanInterval maximum number of frames between two full frame detections
+     * @param roiPaddingRate padding added around the predicted marker positions, as a rate
+     * respect to the size of the marker
+     */
+    CV_WRAP static Ptr<MarkerTracker> create(const Ptr<Dictionary> &dictionary,
+                                             const Ptr<DetectorParameters> &parameters = DetectorParameters::create(),
+                                             int fullScanInterval = 10, float roiPaddingRate = 0.5f);
+
+    /**
+     * @brief Detect markers in the next frame of the sequence
+     *
+     * Parameters and results are the same as in detectMarkers().
+     */
+    CV_WRAP virtual void detect(InputArray image, OutputArrayOfArrays corners, OutputArray ids,
+                                InputArray cameraMatrix = noArray(), InputArray distCoeff = noArray()) = 0;
+
+    /**
+     * @brief Forget the tracked markers, the next frame is processed with a full frame detection
+     */
+    CV_WRAP virtual void reset() = 0;
+
+    /**
+     * @brief Returns true if the last processed frame required a full frame detection
+     */
+    CV_WRAP virtual bool isLastFrameFullScan() const = 0;
+
+    /** @brief Set the board used to recover undetected markers, an empty pointer disables it */
+    CV_WRAP virtual void setBoard(const Ptr<Board> &board) = 0;
+    CV_WRAP virtual Ptr<Board> getBoard() const = 0;
+
+    CV_WRAP virtual void setFullScanInterval(int fullScanInterval) = 0;
+    CV_WRAP virtual int getFullScanInterval() const = 0;
+
+    CV_WRAP virtual void setRoiPaddingRate(float roiPaddingRate) = 0;
+    CV_WRAP virtual float getRoiPaddingRate() const = 0;
+};
+
+
+
 /**
  * @brief Draw detected markers in image
  *
@@ -47,6 +47,7 @@ namespace aruco {
 //! @addtogroup aruco
 //! @{
 
+class DictionaryIndex;
 
 /**
  * @brief Dictionary/Set of markers. It contains the inner codification
@@ -101,9 +102,24 @@ class CV_EXPORTS_W Dictionary {
     /**
      * @brief Given a matrix of bits. Returns whether if marker is identified or not.
      * It returns by reference the correct id (if any) and the correct rotation
+     *
+     * For dictionaries with many markers the search is done through a multi-index hash table over
+     * the bytes of all marker rotations instead of a linear scan (see buildIndex). Both searches
+     * return the same marker. The table is only checked against the identity of bytesList, not its
+     * content, so buildIndex has to be called after editing bytesList in place.
      */
     bool identify(const Mat &onlyBits, int &idx, int &rotation, double maxCorrectionRate) const;
 
+    /**
+     * @brief Build the hash table used by identify() to search large dictionaries.
+     *
+     * The table is built lazily on the first identification in a large dictionary and cached in
+     * the dictionary, this method only allows to build it in advance. Assigning a new bytesList
+     * invalidates the table, which is then rebuilt on next use. If the content of bytesList is
+     * modified in place, this method has to be called again.
+     */
+    CV_WRAP void buildIndex();
+
     /**
       * @brief Returns the distance of the input bits to the specific id. If allRotations is true,
       * the four posible bits rotation are considered
@@ -127,6 +143,10 @@ class CV_EXPORTS_W Dictionary {
       * @brief Transform list of bytes to matrix of bits
       */
     CV_WRAP static Mat getBitsFromByteList(const Mat &byteList, int markerSize);
+
+    private:
+    /// cached search table over bytesList, see buildIndex
+    mutable Ptr<DictionaryIndex> index;
 };
 
 
@@ -0,0 +1,53 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+#include "perf_precomp.hpp"
+
+namespace opencv_test { namespace {
+
+CV_ENUM(ArucoDictionary, aruco::DICT_4X4_50, aruco::DICT_4X4_250, aruco::DICT_4X4_1000,
+        aruco::DICT_6X6_50, aruco::DICT_6X6_250, aruco::DICT_6X6_1000, aruco::DICT_ARUCO_ORIGINAL,
+        aruco::DICT_APRILTAG_36h11, aruco::DICT_APRILTAG_36h10)
+
+typedef perf::TestBaseWithParam<ArucoDictionary> DictionarySize;
+
+// identify a mix of valid codes with flipped bits and random codes, so both successful and
+// unsuccessful searches are measured
+PERF_TEST_P(DictionarySize, identify, ArucoDictionary::all())
+{
+    Ptr<aruco::Dictionary> dictionary = aruco::getPredefinedDictionary((int)GetParam());
+    const int markerSize = dictionary->markerSize;
+    const int nCandidates = 1000;
+
+    RNG rng(0x2002);
+    vector<Mat> candidates(nCandidates);
+    for(int i = 0; i < nCandidates; i++)
+    {
+        if(i % 2 == 0)
+        {
+            int id = rng.uniform(0, dictionary->bytesList.rows);
+            candidates[i] = aruco::Dictionary::getBitsFromByteList(dictionary->bytesList.rowRange(id, id + 1), markerSize);
+            uchar &bit = candidates[i].at<uchar>(rng.uniform(0, markerSize), rng.uniform(0, markerSize));
+            bit = (uchar)(1 - bit);
+        }
+        else
+        {
+            candidates[i].create(markerSize, markerSize, CV_8UC1);
+            rng.fill(candidates[i], RNG::UNIFORM, 0, 2);
+        }
+    }
+
+    // exclude the lazy construction of the index from the measurements
+    int idx, rotation;
+    dictionary->identify(candidates[0], idx, rotation, 0.6);
+
+    TEST_CYCLE()
+    {
+        for(int i = 0; i < nCandidates; i++)
+            dictionary->identify(candidates[i], idx, rotation, 0.6);
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+
+}} // namespace
@@ -0,0 +1,51 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+#include "perf_precomp.hpp"
+
+namespace opencv_test { namespace {
+
+typedef perf::TestBaseWithParam<bool> ArucoSequence;
+
+// a board slowly moving over a 1280x720 frame, detected either with full frame detection on
+// every frame or with the ROI tracking of MarkerTracker
+PERF_TEST_P(ArucoSequence, detect, testing::Bool())
+{
+    const bool useTracker = GetParam();
+    const int nFrames = 30;
+
+    Ptr<aruco::Dictionary> dictionary = aruco::getPredefinedDictionary(aruco::DICT_6X6_250);
+    Ptr<aruco::DetectorParameters> params = aruco::DetectorParameters::create();
+    Ptr<aruco::GridBoard> board = aruco::GridBoard::create(4, 3, 0.04f, 0.01f, dictionary);
+    Mat boardImage;
+    board->draw(Size(380, 290), boardImage, 10, 1);
+
+    vector<Mat> frames(nFrames);
+    for(int i = 0; i < nFrames; i++)
+    {
+        frames[i].create(720, 1280, CV_8UC1);
+        frames[i].setTo(Scalar::all(255));
+        boardImage.copyTo(frames[i](Rect(200 + 5 * i, 150 + 2 * i, boardImage.cols, boardImage.rows)));
+    }
+
+    Ptr<aruco::MarkerTracker> tracker = aruco::MarkerTracker::create(dictionary, params, 10);
+    vector< vector< Point2f > > corners;
+    vector< int > ids;
+
+    TEST_CYCLE()
+    {
+        tracker->reset();
+        for(int i = 0; i < nFrames; i++)
+        {
+            if(useTracker)
+                tracker->detect(frames[i], corners, ids);
+            else
+                aruco::detectMarkers(frames[i], dictionary, corners, ids, params);
+        }
+    }
+
+    ASSERT_EQ(12u, ids.size());
+    SANITY_CHECK_NOTHING();
+}
+
+}} // namespace
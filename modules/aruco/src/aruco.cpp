@@ -142,8 +142,8 @@ static void _findMarkerContours(InputArray _in, vector< vector< Point2f > > &can
     unsigned int maxPerimeterPixels =
         (unsigned int)(maxPerimeterRate * max(_in.getMat().cols, _in.getMat().rows));
 
-    Mat contoursImg;
-    _in.getMat().copyTo(contoursImg);
+    // findContours() does not modify its input, so the thresholded image can be used directly
+    Mat contoursImg = _in.getMat();
     vector< vector< Point > > contours;
     findContours(contoursImg, contours, RETR_LIST, CHAIN_APPROX_NONE);
     // now filter list of contours
@@ -348,19 +348,65 @@ static void _filterTooCloseCandidates(const vector< vector< Point2f > > &candida
 }
 
 /**
- * @brief Initial steps on finding square candidates
+ * @brief Return the number of window sizes (scales) used for adaptive thresholding
  */
-static void _detectInitialCandidates(const Mat &grey, vector< vector< Point2f > > &candidates,
-                                     vector< vector< Point > > &contours,
-                                     const Ptr<DetectorParameters> &params) {
+static int _getNumThresholdScales(const Ptr<DetectorParameters> &params) {
 
     CV_Assert(params->adaptiveThreshWinSizeMin >= 3 && params->adaptiveThreshWinSizeMax >= 3);
     CV_Assert(params->adaptiveThreshWinSizeMax >= params->adaptiveThreshWinSizeMin);
     CV_Assert(params->adaptiveThreshWinSizeStep > 0);
 
+    return (params->adaptiveThreshWinSizeMax - params->adaptiveThreshWinSizeMin) /
+               params->adaptiveThreshWinSizeStep + 1;
+}
+
+
+/**
+ * @brief Threshold the image with the window size of the given scale and find square contours
+ */
+static void _detectScaleCandidates(const Mat &grey, int scale, Mat &thresh,
+                                   vector< vector< Point2f > > &candidates,
+                                   vector< vector< Point > > &contours,
+                                   const Ptr<DetectorParameters> &params) {
+
+    int currScale = params->adaptiveThreshWinSizeMin + scale * params->adaptiveThreshWinSizeStep;
+    // threshold
+    _threshold(grey, thresh, currScale, params->adaptiveThreshConstant);
+
+    // detect rectangles
+    _findMarkerContours(thresh, candidates, contours,
+                        params->minMarkerPerimeterRate, params->maxMarkerPerimeterRate,
+                        params->polygonalApproxAccuracyRate, params->minCornerDistanceRate,
+                        params->minDistanceToBorder);
+}
+
+
+/**
+ * @brief Join the candidates found at every thresholding scale
+ */
+static void _joinScaleCandidates(const vector< vector< vector< Point2f > > > &candidatesArrays,
+                                 const vector< vector< vector< Point > > > &contoursArrays,
+                                 vector< vector< Point2f > > &candidates,
+                                 vector< vector< Point > > &contours) {
+
+    for(size_t i = 0; i < candidatesArrays.size(); i++) {
+        for(unsigned int j = 0; j < candidatesArrays[i].size(); j++) {
+            candidates.push_back(candidatesArrays[i][j]);
+            contours.push_back(contoursArrays[i][j]);
+        }
+    }
+}
+
+
+/**
+ * @brief Initial steps on finding square candidates
+ */
+static void _detectInitialCandidates(const Mat &grey, vector< vector< Point2f > > &candidates,
+                                     vector< vector< Point > > &contours,
+                                     const Ptr<DetectorParameters> &params) {
+
     // number of window sizes (scales) to apply adaptive thresholding
-    int nScales =  (params->adaptiveThreshWinSizeMax - params->adaptiveThreshWinSizeMin) /
-                      params->adaptiveThreshWinSizeStep + 1;
+    int nScales = _getNumThresholdScales(params);
 
     vector< vector< vector< Point2f > > > candidatesArrays((size_t) nScales);
     vector< vector< vector< Point > > > contoursArrays((size_t) nScales);
@@ -371,26 +417,13 @@ static void _detectInitialCandidates(const Mat &grey, vector< vector< Point2f >
         const int end = range.end;
 
         for (int i = begin; i < end; i++) {
-            int currScale = params->adaptiveThreshWinSizeMin + i * params->adaptiveThreshWinSizeStep;
-            // threshold
             Mat thresh;
-            _threshold(grey, thresh, currScale, params->adaptiveThreshConstant);
-
-            // detect rectangles
-            _findMarkerContours(thresh, candidatesArrays[i], contoursArrays[i],
-                                params->minMarkerPerimeterRate, params->maxMarkerPerimeterRate,
-                                params->polygonalApproxAccuracyRate, params->minCornerDistanceRate,
-                                params->minDistanceToBorder);
+            _detectScaleCandidates(grey, i, thresh, candidatesArrays[i], contoursArrays[i], params);
         }
     });
 
     // join candidates
-    for(int i = 0; i < nScales; i++) {
-        for(unsigned int j = 0; j < candidatesArrays[i].size(); j++) {
-            candidates.push_back(candidatesArrays[i][j]);
-            contours.push_back(contoursArrays[i][j]);
-        }
-    }
+    _joinScaleCandidates(candidatesArrays, contoursArrays, candidates, contours);
 }
 
 
@@ -613,6 +646,40 @@ static void correctCornerPosition( vector< Point2f >& _candidate, int rotate){
     std::rotate(_candidate.begin(), _candidate.begin() + 4 - rotate, _candidate.end());
 }
 
+/**
+ * @brief Split identified candidates into accepted markers (with corrected corner order) and
+ * rejected candidates
+ */
+static void _sortIdentifiedCandidates(vector< vector< vector< Point2f > > >& _candidatesSet,
+                                      const vector< vector< vector< Point > > >& _contoursSet,
+                                      const vector< uint8_t >& validCandidates, const vector< int >& idsTmp,
+                                      const vector< int >& rotated, const Ptr<DetectorParameters> &params,
+                                      vector< vector< Point2f > >& accepted, vector< vector< Point > >& contours,
+                                      vector< int >& ids, vector< vector< Point2f > >& rejected) {
+
+    for(size_t i = 0; i < validCandidates.size(); i++) {
+        if(validCandidates[i] > 0) {
+            // to choose the right set of candidates :: 0 for default, 1 for white markers
+            uint8_t set = validCandidates[i]-1;
+
+            // shift corner positions to the correct rotation
+            correctCornerPosition(_candidatesSet[set][i], rotated[i]);
+
+            if( !params->detectInvertedMarker && validCandidates[i] == 2 )
+                continue;
+
+            // add valid candidate
+            accepted.push_back(_candidatesSet[set][i]);
+            ids.push_back(idsTmp[i]);
+
+            contours.push_back(_contoursSet[set][i]);
+
+        } else {
+            rejected.push_back(_candidatesSet[0][i]);
+        }
+    }
+}
+
 /**
  * @brief Identify square candidates according to a marker dictionary
  */
@@ -653,27 +720,8 @@ static void _identifyCandidates(InputArray _image, vector< vector< vector< Point
         }
     });
 
-    for(int i = 0; i < ncandidates; i++) {
-        if(validCandidates[i] > 0) {
-            // to choose the right set of candidates :: 0 for default, 1 for white markers
-            uint8_t set = validCandidates[i]-1;
-
-            // shift corner positions to the correct rotation
-            correctCornerPosition(_candidatesSet[set][i], rotated[i]);
-
-            if( !params->detectInvertedMarker && validCandidates[i] == 2 )
-                continue;
-
-            // add valid candidate
-            accepted.push_back(_candidatesSet[set][i]);
-            ids.push_back(idsTmp[i]);
-
-            contours.push_back(_contoursSet[set][i]);
-
-        } else {
-            rejected.push_back(_candidatesSet[0][i]);
-        }
-    }
+    _sortIdentifiedCandidates(_candidatesSet, _contoursSet, validCandidates, idsTmp, rotated, params,
+                              accepted, contours, ids, rejected);
 
     // parse output
     _accepted = accepted;
@@ -1058,6 +1106,297 @@ void detectMarkers(InputArray _image, const Ptr<Dictionary> &_dictionary, Output
     }
 }
 
+/**
+ * @brief Get one matrix per image from an optional array of matrices that can be empty, a single
+ * matrix or a vector with one matrix per image
+ */
+static void _getPerImageMatrices(InputArrayOfArrays _in, size_t nImages, vector< Mat > &out) {
+
+    out.assign(nImages, Mat());
+    if(_in.empty()) return;
+
+    if(_in.isMatVector() || _in.isUMatVector()) {
+        size_t n = _in.total();
+        CV_Assert(n == 1 || n == nImages);
+        for(size_t i = 0; i < nImages; i++)
+            out[i] = _in.getMat(n == 1 ? 0 : (int)i);
+    }
+    else {
+        Mat m = _in.getMat();
+        for(size_t i = 0; i < nImages; i++)
+            out[i] = m;
+    }
+}
+
+
+MarkerDetector::~MarkerDetector() {}
+
+
+/**
+ * @brief MarkerDetector implementation. Every stage of the detection is run as one parallel job
+ * over the whole batch and all intermediate results are kept in per image workspaces.
+ */
+class MarkerDetectorImpl CV_FINAL : public MarkerDetector {
+
+    public:
+    MarkerDetectorImpl(const Ptr<Dictionary> &_dictionary, const Ptr<DetectorParameters> &_params)
+        : dictionary(_dictionary), params(_params) {
+        CV_Assert(!_dictionary.empty() && !_params.empty());
+    }
+
+    void detect(InputArray image, OutputArrayOfArrays corners, OutputArray ids,
+                OutputArrayOfArrays rejectedImgPoints, InputArray cameraMatrix,
+                InputArray distCoeff) CV_OVERRIDE {
+
+        CV_Assert(!image.empty());
+
+        vector< Mat > images(1, image.getMat());
+        vector< Mat > cameraMatrices(1, cameraMatrix.getMat());
+        vector< Mat > distCoeffs(1, distCoeff.getMat());
+        run(images, cameraMatrices, distCoeffs);
+
+        FrameWorkspace &ws = frames[0];
+        _copyVector2Output(ws.accepted, corners);
+        Mat(ws.ids).copyTo(ids);
+        if(rejectedImgPoints.needed())
+            _copyVector2Output(ws.rejected, rejectedImgPoints);
+    }
+
+    void detectBatch(InputArrayOfArrays _images, vector< vector< vector< Point2f > > > &corners,
+                     vector< vector< int > > &ids, vector< vector< vector< Point2f > > > &rejectedImgPoints,
+                     InputArrayOfArrays _cameraMatrices, InputArrayOfArrays _distCoeffs) CV_OVERRIDE {
+
+        CV_Assert(_images.isMatVector() || _images.isUMatVector());
+
+        size_t nImages = _images.total();
+        vector< Mat > images(nImages);
+        for(size_t i = 0; i < nImages; i++) {
+            images[i] = _images.getMat((int)i);
+            CV_Assert(!images[i].empty());
+        }
+        vector< Mat > cameraMatrices, distCoeffs;
+        _getPerImageMatrices(_cameraMatrices, nImages, cameraMatrices);
+        _getPerImageMatrices(_distCoeffs, nImages, distCoeffs);
+
+        run(images, cameraMatrices, distCoeffs);
+
+        corners.resize(nImages);
+        ids.resize(nImages);
+        rejectedImgPoints.resize(nImages);
+        for(size_t i = 0; i < nImages; i++) {
+            corners[i] = frames[i].accepted;
+            ids[i] = frames[i].ids;
+            rejectedImgPoints[i] = frames[i].rejected;
+        }
+    }
+
+    void setDictionary(const Ptr<Dictionary> &_dictionary) CV_OVERRIDE {
+        CV_Assert(!_dictionary.empty());
+        dictionary = _dictionary;
+    }
+    Ptr<Dictionary> getDictionary() const CV_OVERRIDE { return dictionary; }
+
+    void setDetectorParameters(const Ptr<DetectorParameters> &parameters) CV_OVERRIDE {
+        CV_Assert(!parameters.empty());
+        params = parameters;
+    }
+    Ptr<DetectorParameters> getDetectorParameters() const CV_OVERRIDE { return params; }
+
+    private:
+    /// Buffers of a single image of the batch, reused between calls
+    struct FrameWorkspace {
+        Mat greyBuffer; // storage for the grey conversion of color images
+        Mat grey;       // either greyBuffer or the input image itself
+
+        vector< Mat > thresh; // one thresholded image per window size
+        vector< vector< vector< Point2f > > > candidatesArrays;
+        vector< vector< vector< Point > > > contoursArrays;
+
+        vector< vector< Point2f > > candidates;
+        vector< vector< Point > > contours;
+        vector< vector< vector< Point2f > > > candidatesSet;
+        vector< vector< vector< Point > > > contoursSet;
+
+        vector< uint8_t > validCandidates;
+        vector< int > idsTmp;
+        vector< int > rotated;
+
+        vector< vector< Point2f > > accepted;
+        vector< vector< Point > > acceptedContours;
+        vector< int > ids;
+        vector< vector< Point2f > > rejected;
+    };
+
+    /// find the image an element of a flattened batch belongs to, given the exclusive prefix sums
+    static int findImage(const vector< int > &offsets, int idx) {
+        return (int)(std::upper_bound(offsets.begin(), offsets.end(), idx) - offsets.begin()) - 1;
+    }
+
+    void run(const vector< Mat > &images, const vector< Mat > &cameraMatrices,
+             const vector< Mat > &distCoeffs) {
+
+        const int nImages = (int)images.size();
+        if((int)frames.size() < nImages)
+            frames.resize(nImages);
+
+        /// 1. CONVERT TO GRAY
+        parallel_for_(Range(0, nImages), [&](const Range& range) {
+            for(int i = range.start; i < range.end; i++) {
+                FrameWorkspace &ws = frames[i];
+                CV_Assert(images[i].type() == CV_8UC1 || images[i].type() == CV_8UC3);
+                if(images[i].type() == CV_8UC3) {
+                    cvtColor(images[i], ws.greyBuffer, COLOR_BGR2GRAY);
+                    ws.grey = ws.greyBuffer;
+                }
+                else
+                    ws.grey = images[i];
+            }
+        });
+
+        /// 2. DETECT MARKER CANDIDATES
+        if(params->cornerRefinementMethod == CORNER_REFINE_APRILTAG)
+            detectAprilTagCandidates(nImages);
+        else
+            detectCandidates(nImages);
+
+        /// 3. IDENTIFY CANDIDATES, all candidates of all images in one job
+        vector< int > candidateOffsets(nImages + 1, 0);
+        for(int i = 0; i < nImages; i++) {
+            FrameWorkspace &ws = frames[i];
+            int ncandidates = (int)ws.candidatesSet[0].size();
+            ws.validCandidates.assign(ncandidates, 0);
+            ws.idsTmp.assign(ncandidates, -1);
+            ws.rotated.assign(ncandidates, 0);
+            candidateOffsets[i + 1] = candidateOffsets[i] + ncandidates;
+        }
+
+        parallel_for_(Range(0, candidateOffsets[nImages]), [&](const Range& range) {
+            for(int k = range.start; k < range.end; k++) {
+                int i = findImage(candidateOffsets, k);
+                int j = k - candidateOffsets[i];
+                FrameWorkspace &ws = frames[i];
+                vector< vector< Point2f > >& candidates =
+                    params->detectInvertedMarker ? ws.candidatesSet[1] : ws.candidatesSet[0];
+
+                int currId;
+                ws.validCandidates[j] = _identifyOneCandidate(dictionary, ws.grey, candidates[j], currId,
+                                                              params, ws.rotated[j]);
+                if(ws.validCandidates[j] > 0)
+                    ws.idsTmp[j] = currId;
+            }
+        });
+
+        vector< int > markerOffsets(nImages + 1, 0);
+        for(int i = 0; i < nImages; i++) {
+            FrameWorkspace &ws = frames[i];
+            ws.accepted.clear();
+            ws.acceptedContours.clear();
+            ws.ids.clear();
+            ws.rejected.clear();
+            _sortIdentifiedCandidates(ws.candidatesSet, ws.contoursSet, ws.validCandidates, ws.idsTmp,
+                                      ws.rotated, params, ws.accepted, ws.acceptedContours, ws.ids,
+                                      ws.rejected);
+            markerOffsets[i + 1] = markerOffsets[i] + (int)ws.accepted.size();
+        }
+
+        /// 4. CORNER REFINEMENT, all markers of all images in one job
+        if(params->cornerRefinementMethod == CORNER_REFINE_SUBPIX) {
+            CV_Assert(params->cornerRefinementWinSize > 0 && params->cornerRefinementMaxIterations > 0 &&
+                      params->cornerRefinementMinAccuracy > 0);
+
+            parallel_for_(Range(0, markerOffsets[nImages]), [&](const Range& range) {
+                for(int k = range.start; k < range.end; k++) {
+                    int i = findImage(markerOffsets, k);
+                    FrameWorkspace &ws = frames[i];
+                    cornerSubPix(ws.grey, ws.accepted[k - markerOffsets[i]],
+                                 Size(params->cornerRefinementWinSize, params->cornerRefinementWinSize),
+                                 Size(-1, -1),
+                                 TermCriteria(TermCriteria::MAX_ITER | TermCriteria::EPS,
+                                              params->cornerRefinementMaxIterations,
+                                              params->cornerRefinementMinAccuracy));
+                }
+            });
+        }
+        else if(params->cornerRefinementMethod == CORNER_REFINE_CONTOUR) {
+            parallel_for_(Range(0, markerOffsets[nImages]), [&](const Range& range) {
+                for(int k = range.start; k < range.end; k++) {
+                    int i = findImage(markerOffsets, k);
+                    int j = k - markerOffsets[i];
+                    FrameWorkspace &ws = frames[i];
+                    _refineCandidateLines(ws.acceptedContours[j], ws.accepted[j], cameraMatrices[i],
+                                          distCoeffs[i]);
+                }
+            });
+        }
+    }
+
+    /// traditional candidate detection, all images and all thresholding scales in one job
+    void detectCandidates(int nImages) {
+
+        const int nScales = _getNumThresholdScales(params);
+        for(int i = 0; i < nImages; i++) {
+            FrameWorkspace &ws = frames[i];
+            ws.thresh.resize(nScales);
+            ws.candidatesArrays.resize(nScales);
+            ws.contoursArrays.resize(nScales);
+            for(int s = 0; s < nScales; s++) {
+                ws.candidatesArrays[s].clear();
+                ws.contoursArrays[s].clear();
+            }
+        }
+
+        parallel_for_(Range(0, nImages * nScales), [&](const Range& range) {
+            for(int k = range.start; k < range.end; k++) {
+                FrameWorkspace &ws = frames[k / nScales];
+                int s = k % nScales;
+                _detectScaleCandidates(ws.grey, s, ws.thresh[s], ws.candidatesArrays[s],
+                                       ws.contoursArrays[s], params);
+            }
+        });
+
+        parallel_for_(Range(0, nImages), [&](const Range& range) {
+            for(int i = range.start; i < range.end; i++) {
+                FrameWorkspace &ws = frames[i];
+                ws.candidates.clear();
+                ws.contours.clear();
+                _joinScaleCandidates(ws.candidatesArrays, ws.contoursArrays, ws.candidates, ws.contours);
+
+                _reorderCandidatesCorners(ws.candidates);
+
+                _filterTooCloseCandidates(ws.candidates, ws.candidatesSet, ws.contours, ws.contoursSet,
+                                          params->minMarkerDistanceRate, params->detectInvertedMarker);
+            }
+        });
+    }
+
+    /// AprilTag candidate detection, one job per image
+    void detectAprilTagCandidates(int nImages) {
+
+        parallel_for_(Range(0, nImages), [&](const Range& range) {
+            for(int i = range.start; i < range.end; i++) {
+                FrameWorkspace &ws = frames[i];
+                ws.candidates.clear();
+                ws.contours.clear();
+                _apriltag(ws.grey, params, ws.candidates, ws.contours);
+
+                ws.candidatesSet.assign(1, ws.candidates);
+                ws.contoursSet.assign(1, ws.contours);
+            }
+        });
+    }
+
+    Ptr<Dictionary> dictionary;
+    Ptr<DetectorParameters> params;
+    vector< FrameWorkspace > frames;
+};
+
+
+Ptr<MarkerDetector> MarkerDetector::create(const Ptr<Dictionary> &dictionary,
+                                           const Ptr<DetectorParameters> &parameters) {
+    return makePtr<MarkerDetectorImpl>(dictionary, parameters);
+}
+
+
 /**
   */
 void estimatePoseSingleMarkers(InputArrayOfArrays _corners, float markerLength,
@@ -1433,6 +1772,263 @@ void refineDetectedMarkers(InputArray _image, const Ptr<Board> &_board,
 
 
 
+MarkerTracker::~MarkerTracker() {}
+
+
+/**
+ * @brief MarkerTracker implementation
+ */
+class MarkerTrackerImpl CV_FINAL : public MarkerTracker {
+
+    public:
+    MarkerTrackerImpl(const Ptr<Dictionary> &_dictionary, const Ptr<DetectorParameters> &_params,
+                      int _fullScanInterval, float _roiPaddingRate)
+        : dictionary(_dictionary), params(_params), fullScanInterval(_fullScanInterval),
+          roiPaddingRate(_roiPaddingRate), framesSinceFullScan(0), lastFrameFullScan(false) {
+        CV_Assert(!_dictionary.empty() && !_params.empty());
+        CV_Assert(_fullScanInterval > 0 && _roiPaddingRate >= 0);
+    }
+
+    void detect(InputArray _image, OutputArrayOfArrays _corners, OutputArray _ids,
+                InputArray _cameraMatrix, InputArray _distCoeff) CV_OVERRIDE {
+
+        CV_Assert(!_image.empty());
+
+        Mat grey;
+        _convertToGrey(_image.getMat(), grey);
+        Mat cameraMatrix = _cameraMatrix.getMat(), distCoeff = _distCoeff.getMat();
+
+        vector< vector< Point2f > > corners, rejected;
+        vector< int > ids;
+
+        bool fullScan = tracks.empty() || framesSinceFullScan + 1 >= fullScanInterval ||
+                        !detectInRois(grey, cameraMatrix, distCoeff, corners, ids, rejected);
+        if(fullScan) {
+            corners.clear();
+            ids.clear();
+            rejected.clear();
+            detectMarkers(grey, dictionary, corners, ids, params, rejected, cameraMatrix, distCoeff);
+            framesSinceFullScan = 0;
+        }
+        else
+            framesSinceFullScan++;
+        lastFrameFullScan = fullScan;
+
+        if(!board.empty() && !ids.empty())
+            refineDetectedMarkers(grey, board, corners, ids, rejected, cameraMatrix, distCoeff, 10.f, 3.f,
+                                  true, noArray(), params);
+
+        // update tracks, keeping the previous corners of the markers that were already tracked
+        vector< Track > newTracks(ids.size());
+        for(size_t i = 0; i < ids.size(); i++) {
+            newTracks[i].id = ids[i];
+            newTracks[i].corners = corners[i];
+            for(size_t j = 0; j < tracks.size(); j++) {
+                if(tracks[j].id == ids[i]) {
+                    newTracks[i].prevCorners = tracks[j].corners;
+                    break;
+                }
+            }
+        }
+        tracks.swap(newTracks);
+
+        _copyVector2Output(corners, _corners);
+        Mat(ids).copyTo(_ids);
+    }
+
+    void reset() CV_OVERRIDE {
+        tracks.clear();
+        framesSinceFullScan = 0;
+        lastFrameFullScan = false;
+    }
+
+    bool isLastFrameFullScan() const CV_OVERRIDE { return lastFrameFullScan; }
+
+    void setBoard(const Ptr<Board> &_board) CV_OVERRIDE { board = _board; }
+    Ptr<Board> getBoard() const CV_OVERRIDE { return board; }
+
+    void setFullScanInterval(int _fullScanInterval) CV_OVERRIDE {
+        CV_Assert(_fullScanInterval > 0);
+        fullScanInterval = _fullScanInterval;
+    }
+    int getFullScanInterval() const CV_OVERRIDE { return fullScanInterval; }
+
+    void setRoiPaddingRate(float _roiPaddingRate) CV_OVERRIDE {
+        CV_Assert(_roiPaddingRate >= 0);
+        roiPaddingRate = _roiPaddingRate;
+    }
+    float getRoiPaddingRate() const CV_OVERRIDE { return roiPaddingRate; }
+
+    private:
+    struct Track {
+        int id;
+        vector< Point2f > corners;     // corners in the last frame
+        vector< Point2f > prevCorners; // corners in the frame before, empty if not detected
+    };
+
+    /**
+     * @brief Padded region of interest around some marker corners, clipped to the image
+     */
+    Rect getRoi(const vector< Point2f > &corners, const Size &imageSize) const {
+        Rect box = boundingRect(corners);
+        int pad = cvCeil(max(box.width, box.height) * roiPaddingRate) + params->minDistanceToBorder + 1;
+        box = Rect(box.x - pad, box.y - pad, box.width + 2 * pad, box.height + 2 * pad);
+        return box & Rect(Point(0, 0), imageSize);
+    }
+
+    /**
+     * @brief Detect markers only around the predicted positions of the tracked markers and, if a
+     * board is set, of the board markers missing in the previous frame.
+     * Returns false if a tracked marker is lost.
+     */
+    bool detectInRois(const Mat &grey, const Mat &cameraMatrix, const Mat &distCoeff,
+                      vector< vector< Point2f > > &corners, vector< int > &ids,
+                      vector< vector< Point2f > > &rejected) const {
+
+        // predict the tracked markers with a constant velocity model
+        vector< Rect > rois;
+        for(size_t i = 0; i < tracks.size(); i++) {
+            vector< Point2f > predicted = tracks[i].corners;
+            if(!tracks[i].prevCorners.empty()) {
+                for(int c = 0; c < 4; c++)
+                    predicted[c] += tracks[i].corners[c] - tracks[i].prevCorners[c];
+            }
+            Rect roi = getRoi(predicted, grey.size());
+            if(roi.area() == 0) return false; // moved out of the image
+            rois.push_back(roi);
+        }
+
+        // look for the missing board markers where the previous frame detections project them
+        if(!board.empty())
+            addUndetectedBoardRois(grey.size(), cameraMatrix, distCoeff, rois);
+
+        // merge overlapping regions so that every marker is searched only once
+        for(bool merged = true; merged;) {
+            merged = false;
+            for(size_t i = 0; i < rois.size() && !merged; i++) {
+                for(size_t j = i + 1; j < rois.size() && !merged; j++) {
+                    if((rois[i] & rois[j]).area() > 0) {
+                        rois[i] |= rois[j];
+                        rois.erase(rois.begin() + j);
+                        merged = true;
+                    }
+                }
+            }
+        }
+
+        // detect in every region
+        vector< vector< vector< Point2f > > > roiCorners(rois.size()), roiRejected(rois.size());
+        vector< vector< int > > roiIds(rois.size());
+        parallel_for_(Range(0, (int)rois.size()), [&](const Range& range) {
+            for(int i = range.start; i < range.end; i++) {
+                const Rect &roi = rois[i];
+
+                // perimeter limits are relative to the image size, keep them in pixels
+                Ptr<DetectorParameters> roiParams = makePtr<DetectorParameters>(*params);
+                double scale = double(max(grey.cols, grey.rows)) / max(roi.width, roi.height);
+                roiParams->minMarkerPerimeterRate *= scale;
+                roiParams->maxMarkerPerimeterRate *= scale;
+
+                // move the principal point to the region coordinates
+                Mat roiCameraMatrix;
+                if(!cameraMatrix.empty()) {
+                    cameraMatrix.convertTo(roiCameraMatrix, CV_64F);
+                    roiCameraMatrix.at< double >(0, 2) -= roi.x;
+                    roiCameraMatrix.at< double >(1, 2) -= roi.y;
+                }
+
+                detectMarkers(grey(roi), dictionary, roiCorners[i], roiIds[i], roiParams, roiRejected[i],
+                              roiCameraMatrix, distCoeff);
+
+                Point2f offset((float)roi.x, (float)roi.y);
+                for(size_t m = 0; m < roiCorners[i].size(); m++)
+                    for(int c = 0; c < 4; c++)
+                        roiCorners[i][m][c] += offset;
+                for(size_t m = 0; m < roiRejected[i].size(); m++)
+                    for(int c = 0; c < 4; c++)
+                        roiRejected[i][m][c] += offset;
+            }
+        });
+
+        for(size_t i = 0; i < rois.size(); i++) {
+            for(size_t m = 0; m < roiIds[i].size(); m++) {
+                if(std::find(ids.begin(), ids.end(), roiIds[i][m]) != ids.end()) continue;
+                ids.push_back(roiIds[i][m]);
+                corners.push_back(roiCorners[i][m]);
+            }
+            rejected.insert(rejected.end(), roiRejected[i].begin(), roiRejected[i].end());
+        }
+
+        // every tracked marker has to be found again
+        for(size_t i = 0; i < tracks.size(); i++) {
+            if(std::find(ids.begin(), ids.end(), tracks[i].id) == ids.end())
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Add the regions of the board markers not tracked, projected from the tracked ones
+     */
+    void addUndetectedBoardRois(const Size &imageSize, const Mat &cameraMatrix, const Mat &distCoeff,
+                                vector< Rect > &rois) const {
+
+        vector< vector< Point2f > > trackedCorners;
+        vector< int > trackedIds;
+        for(size_t i = 0; i < tracks.size(); i++) {
+            if(std::find(board->ids.begin(), board->ids.end(), tracks[i].id) == board->ids.end()) continue;
+            trackedCorners.push_back(tracks[i].corners);
+            trackedIds.push_back(tracks[i].id);
+        }
+        if(trackedIds.empty() || board->objPoints.empty()) return;
+
+        vector< vector< Point2f > > projectedCorners;
+        vector< int > projectedIds;
+        if(!cameraMatrix.empty()) {
+            _projectUndetectedMarkers(board, trackedCorners, trackedIds, cameraMatrix, distCoeff,
+                                      projectedCorners, projectedIds);
+        }
+        else {
+            // global homography only applies to planar boards
+            float boardZ = board->objPoints[0][0].z;
+            for(size_t i = 0; i < board->objPoints.size(); i++)
+                for(size_t j = 0; j < board->objPoints[i].size(); j++)
+                    if(board->objPoints[i][j].z != boardZ) return;
+            _projectUndetectedMarkers(board, trackedCorners, trackedIds, projectedCorners, projectedIds);
+        }
+
+        Rect imageRect(Point(0, 0), imageSize);
+        for(size_t i = 0; i < projectedCorners.size(); i++) {
+            bool inside = true;
+            for(size_t c = 0; c < projectedCorners[i].size(); c++)
+                inside = inside && imageRect.contains(Point(cvRound(projectedCorners[i][c].x),
+                                                            cvRound(projectedCorners[i][c].y)));
+            if(inside && projectedCorners[i].size() == 4)
+                rois.push_back(getRoi(projectedCorners[i], imageSize));
+        }
+    }
+
+    Ptr<Dictionary> dictionary;
+    Ptr<DetectorParameters> params;
+    Ptr<Board> board;
+    int fullScanInterval;
+    float roiPaddingRate;
+
+    vector< Track > tracks;
+    int framesSinceFullScan;
+    bool lastFrameFullScan;
+};
+
+
+Ptr<MarkerTracker> MarkerTracker::create(const Ptr<Dictionary> &dictionary,
+                                         const Ptr<DetectorParameters> &parameters,
+                                         int fullScanInterval, float roiPaddingRate) {
+    return makePtr<MarkerTrackerImpl>(dictionary, parameters, fullScanInterval, roiPaddingRate);
+}
+
+
+
+
 /**
   */
 int estimatePoseBoard(InputArrayOfArrays _corners, InputArray _ids, const Ptr<Board> &board,
@@ -43,6 +43,7 @@ the use of this software, even if advised of the possibility of such damage.
 #include "predefined_dictionaries.hpp"
 #include "predefined_dictionaries_apriltag.hpp"
 #include "opencv2/core/hal/hal.hpp"
+#include <memory>
 
 namespace cv {
 namespace aruco {
@@ -92,6 +93,150 @@ Ptr<Dictionary> Dictionary::get(int dict) {
 }
 
 
+/**
+ * @brief Multi-index hash table over the codes of a dictionary
+ *
+ * Every rotation of every marker code is split in byte chunks, and for each chunk the
+ * (marker, rotation) entries are bucketed by the value of the byte. If a candidate is within
+ * a hamming distance D of a code with nbytes chunks, at least one of its chunks is within
+ * D / nbytes bits of the corresponding chunk of the code, so only the buckets close to the
+ * candidate chunks have to be verified.
+ */
+class DictionaryIndex {
+
+    public:
+    DictionaryIndex(const Dictionary &dictionary) {
+
+        const Mat &bytesList = dictionary.bytesList;
+        codes = bytesList;
+        rows = bytesList.rows;
+        cols = bytesList.cols;
+        markerSize = dictionary.markerSize;
+        nbytes = (markerSize * markerSize + 8 - 1) / 8;
+        CV_Assert(bytesList.empty() || bytesList.total() * bytesList.channels() == (size_t)rows * 4 * nbytes);
+
+        // counting sort of the (marker, rotation) entries by chunk value, entries in a bucket are
+        // kept in increasing marker order
+        const int nEntries = rows * 4;
+        offsets.assign((size_t)nbytes * 257, 0);
+        entries.resize((size_t)nbytes * nEntries);
+        for(int c = 0; c < nbytes; c++) {
+            int *chunkOffsets = &offsets[c * 257];
+            for(int m = 0; m < rows; m++)
+                for(int r = 0; r < 4; r++)
+                    chunkOffsets[bytesList.ptr(m)[r * nbytes + c] + 1]++;
+            for(int v = 0; v < 256; v++)
+                chunkOffsets[v + 1] += chunkOffsets[v];
+
+            std::vector<int> fill(chunkOffsets, chunkOffsets + 256);
+            int *chunkEntries = &entries[(size_t)c * nEntries];
+            for(int m = 0; m < rows; m++)
+                for(int r = 0; r < 4; r++)
+                    chunkEntries[fill[bytesList.ptr(m)[r * nbytes + c]]++] = m * 4 + r;
+        }
+
+        // byte masks sorted by number of set bits, used to enumerate the buckets within a radius
+        nMasksUpTo[0] = 0;
+        for(int w = 0; w <= 8; w++) {
+            for(int v = 0; v < 256; v++)
+                if(_popCount((uchar)v) == w)
+                    masks.push_back((uchar)v);
+            nMasksUpTo[w + 1] = (int)masks.size();
+        }
+    }
+
+    // Only the identity of bytesList is compared, not its content: an in-place edit of the codes
+    // is not detected and requires Dictionary::buildIndex to be called again. Hashing the content
+    // would cost a pass over the whole dictionary on every identification. The index holds a
+    // reference to the indexed buffer, so its address cannot be reused by another bytesList.
+    bool isValidFor(const Dictionary &dictionary) const {
+        return dictionary.bytesList.data == codes.data && dictionary.bytesList.rows == rows &&
+               dictionary.bytesList.cols == cols && dictionary.markerSize == markerSize;
+    }
+
+    /**
+     * @brief Return the lowest marker index whose code, in any rotation, is within maxDistance
+     * bits of the candidate code, or -1 if there is none
+     */
+    int findFirst(const Mat &bytesList, const uchar *candidate, int maxDistance) const {
+
+        if(maxDistance < 0) return -1;
+
+        const int nEntries = rows * 4;
+        const int chunkRadius = std::min(maxDistance / nbytes, 8);
+        int best = rows;
+        for(int c = 0; c < nbytes; c++) {
+            const int *chunkOffsets = &offsets[c * 257];
+            const int *chunkEntries = &entries[(size_t)c * nEntries];
+            for(int k = 0; k < nMasksUpTo[chunkRadius + 1]; k++) {
+                int v = candidate[c] ^ masks[k];
+                for(int e = chunkOffsets[v]; e < chunkOffsets[v + 1]; e++) {
+                    int m = chunkEntries[e] >> 2;
+                    if(m >= best) break;
+                    int r = chunkEntries[e] & 3;
+                    if(cv::hal::normHamming(bytesList.ptr(m) + r * nbytes, candidate, nbytes) <= maxDistance)
+                        best = m;
+                }
+            }
+        }
+        return best < rows ? best : -1;
+    }
+
+    private:
+    static int _popCount(uchar v) {
+        int n = 0;
+        for(; v; v &= (uchar)(v - 1)) n++;
+        return n;
+    }
+
+    // the indexed bytesList, shared with the dictionary
+    Mat codes;
+    int rows, cols, markerSize;
+
+    int nbytes;
+    std::vector<int> offsets;  // nbytes x 257 bucket limits
+    std::vector<int> entries;  // nbytes x (rows*4) entries, encoded as marker*4 + rotation
+    std::vector<uchar> masks;  // the 256 byte values sorted by number of set bits
+    int nMasksUpTo[10];        // number of masks with less than w set bits
+};
+
+
+// dictionaries smaller than this are searched linearly, building the index is not worth it
+static const int IDENTIFY_INDEX_MIN_MARKERS = 256;
+
+
+/**
+ * @brief Serializes the construction of the indexes, lookups of a built index do not lock
+ */
+static Mutex& _getIndexMutex() {
+    static Mutex mutex;
+    return mutex;
+}
+
+
+/**
+ * @brief Read and publish the cached index atomically, it can be replaced while other threads
+ * identify markers with the previous one
+ */
+static Ptr<DictionaryIndex> _loadIndex(const Ptr<DictionaryIndex> &index) {
+    return std::atomic_load(static_cast<const std::shared_ptr<DictionaryIndex>*>(&index));
+}
+
+static void _storeIndex(Ptr<DictionaryIndex> &index, const Ptr<DictionaryIndex> &value) {
+    std::atomic_store(static_cast<std::shared_ptr<DictionaryIndex>*>(&index),
+                      static_cast<const std::shared_ptr<DictionaryIndex>&>(value));
+}
+
+
+/**
+ */
+void Dictionary::buildIndex() {
+    Ptr<DictionaryIndex> newIndex = makePtr<DictionaryIndex>(*this);
+    AutoLock lock(_getIndexMutex());
+    _storeIndex(index, newIndex);
+}
+
+
 /**
  */
 bool Dictionary::identify(const Mat &onlyBits, int &idx, int &rotation,
@@ -106,8 +251,31 @@ bool Dictionary::identify(const Mat &onlyBits, int &idx, int &rotation,
 
     idx = -1; // by default, not found
 
+    // small dictionaries are searched linearly, large ones through the index, built once by the
+    // first thread that needs it
+    Ptr<DictionaryIndex> currentIndex;
+    if(bytesList.rows >= IDENTIFY_INDEX_MIN_MARKERS) {
+        currentIndex = _loadIndex(index);
+        if(currentIndex.empty() || !currentIndex->isValidFor(*this)) {
+            AutoLock lock(_getIndexMutex());
+            currentIndex = _loadIndex(index);
+            if(currentIndex.empty() || !currentIndex->isValidFor(*this)) {
+                currentIndex = makePtr<DictionaryIndex>(*this);
+                _storeIndex(index, currentIndex);
+            }
+        }
+    }
+
+    int firstMarker = 0, lastMarker = bytesList.rows;
+    if(!currentIndex.empty()) {
+        // only the first matching marker has to be checked for its best rotation
+        firstMarker = currentIndex->findFirst(bytesList, candidateBytes.ptr(), maxCorrectionRecalculed);
+        if(firstMarker < 0) return false;
+        lastMarker = firstMarker + 1;
+    }
+
     // search closest marker in dict
-    for(int m = 0; m < bytesList.rows; m++) {
+    for(int m = firstMarker; m < lastMarker; m++) {
         int currentMinDistance = markerSize * markerSize + 1;
         int currentRotation = -1;
         for(unsigned int r = 0; r < 4; r++) {
@@ -554,4 +554,89 @@ TEST(CV_ArucoBitCorrection, algorithmic) {
     test.safe_run();
 }
 
+TEST(CV_ArucoMarkerDetector, batch_matches_detectMarkers) {
+    Ptr<aruco::Dictionary> dictionary = aruco::getPredefinedDictionary(aruco::DICT_6X6_250);
+    Ptr<aruco::DetectorParameters> params = aruco::DetectorParameters::create();
+    params->cornerRefinementMethod = aruco::CORNER_REFINE_SUBPIX;
+    Ptr<aruco::MarkerDetector> detector = aruco::MarkerDetector::create(dictionary, params);
+
+    const int markerSidePixels = 100;
+    const int imageSize = markerSidePixels * 2 + 3 * (markerSidePixels / 2);
+
+    // images with a different number of markers, alternating grey and color
+    vector< Mat > images;
+    for(int i = 0; i < 6; i++) {
+        Mat img(imageSize, imageSize, CV_8UC1, Scalar::all(255));
+        for(int m = 0; m <= i % 4; m++) {
+            Mat marker;
+            aruco::drawMarker(dictionary, i * 4 + m, markerSidePixels, marker);
+            int x = markerSidePixels / 2 + (m % 2) * (3 * markerSidePixels / 2);
+            int y = markerSidePixels / 2 + (m / 2) * (3 * markerSidePixels / 2);
+            marker.copyTo(img(Rect(x, y, markerSidePixels, markerSidePixels)));
+        }
+        if(i % 2 == 1) cvtColor(img, img, COLOR_GRAY2BGR);
+        images.push_back(img);
+    }
+
+    // run twice so the second batch reuses the buffers of the first one
+    for(int iter = 0; iter < 2; iter++) {
+        vector< vector< vector< Point2f > > > batchCorners;
+        vector< vector< int > > batchIds;
+        detector->detectBatch(images, batchCorners, batchIds);
+        ASSERT_EQ(images.size(), batchCorners.size());
+        ASSERT_EQ(images.size(), batchIds.size());
+
+        for(size_t i = 0; i < images.size(); i++) {
+            vector< vector< Point2f > > corners;
+            vector< int > ids;
+            aruco::detectMarkers(images[i], dictionary, corners, ids, params);
+
+            EXPECT_EQ((size_t)(i % 4 + 1), batchIds[i].size());
+            ASSERT_EQ(ids, batchIds[i]);
+            for(size_t m = 0; m < corners.size(); m++)
+                for(int c = 0; c < 4; c++)
+                    EXPECT_LE(cv::norm(corners[m][c] - batchCorners[i][m][c]), 1e-3);
+
+            vector< vector< Point2f > > singleCorners;
+            vector< int > singleIds;
+            detector->detect(images[i], singleCorners, singleIds);
+            EXPECT_EQ(ids, singleIds);
+        }
+    }
+}
+
+TEST(CV_ArucoMarkerTracker, sequence_matches_detectMarkers) {
+    Ptr<aruco::Dictionary> dictionary = aruco::getPredefinedDictionary(aruco::DICT_6X6_250);
+    Ptr<aruco::DetectorParameters> params = aruco::DetectorParameters::create();
+    Ptr<aruco::MarkerTracker> tracker = aruco::MarkerTracker::create(dictionary, params, 5);
+
+    // a board slowly moving over a bigger image
+    Ptr<aruco::GridBoard> board = aruco::GridBoard::create(3, 2, 0.04f, 0.01f, dictionary);
+    Mat boardImage;
+    board->draw(Size(300, 200), boardImage, 10, 1);
+
+    int nFullScans = 0;
+    for(int frame = 0; frame < 20; frame++) {
+        Mat img(480, 640, CV_8UC1, Scalar::all(255));
+        boardImage.copyTo(img(Rect(50 + 4 * frame, 60 + 3 * frame, boardImage.cols, boardImage.rows)));
+
+        vector< vector< Point2f > > corners, trackedCorners;
+        vector< int > ids, trackedIds;
+        aruco::detectMarkers(img, dictionary, corners, ids, params);
+        tracker->detect(img, trackedCorners, trackedIds);
+        if(tracker->isLastFrameFullScan()) nFullScans++;
+
+        ASSERT_EQ(6u, ids.size());
+        ASSERT_EQ(ids.size(), trackedIds.size());
+        for(size_t m = 0; m < ids.size(); m++) {
+            size_t t = std::find(trackedIds.begin(), trackedIds.end(), ids[m]) - trackedIds.begin();
+            ASSERT_LT(t, trackedIds.size());
+            for(int c = 0; c < 4; c++)
+                EXPECT_LE(cv::norm(corners[m][c] - trackedCorners[t][c]), 1.);
+        }
+    }
+    // one full scan every 5 frames
+    EXPECT_EQ(4, nFullScans);
+}
+
 }} // namespace
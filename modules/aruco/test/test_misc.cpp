@@ -24,4 +24,62 @@ TEST(CV_ArucoDrawMarker, regression_1226)
     });
 }
 
+TEST(CV_ArucoDictionary, identify_indexed_matches_linear_search)
+{
+    const int dictionaries[] = { aruco::DICT_ARUCO_ORIGINAL, aruco::DICT_4X4_1000, aruco::DICT_6X6_1000,
+                                 aruco::DICT_APRILTAG_36h11 };
+    RNG rng(0x2002);
+    for(size_t d = 0; d < sizeof(dictionaries) / sizeof(dictionaries[0]); d++)
+    {
+        Ptr<aruco::Dictionary> dictionary = aruco::getPredefinedDictionary(dictionaries[d]);
+        int markerSize = dictionary->markerSize;
+        // allow some correction even in dictionaries with maxCorrectionBits = 0
+        dictionary->maxCorrectionBits = std::max(dictionary->maxCorrectionBits, 3);
+
+        for(int i = 0; i < 200; i++)
+        {
+            // marker code with some flipped bits, or random bits
+            Mat bits;
+            if(i % 4 != 3)
+            {
+                int id = rng.uniform(0, dictionary->bytesList.rows);
+                bits = aruco::Dictionary::getBitsFromByteList(dictionary->bytesList.rowRange(id, id + 1), markerSize);
+                int nFlips = rng.uniform(0, 4);
+                for(int f = 0; f < nFlips; f++)
+                {
+                    uchar &bit = bits.at<uchar>(rng.uniform(0, markerSize), rng.uniform(0, markerSize));
+                    bit = (uchar)(1 - bit);
+                }
+            }
+            else
+            {
+                bits.create(markerSize, markerSize, CV_8UC1);
+                rng.fill(bits, RNG::UNIFORM, 0, 2);
+            }
+
+            // reference linear search
+            int maxCorrection = dictionary->maxCorrectionBits;
+            int expectedIdx = -1;
+            for(int m = 0; m < dictionary->bytesList.rows && expectedIdx < 0; m++)
+                if(dictionary->getDistanceToId(bits, m) <= maxCorrection)
+                    expectedIdx = m;
+
+            int idx = -1, rotation = -1;
+            bool found = dictionary->identify(bits, idx, rotation, 1.);
+            ASSERT_EQ(expectedIdx >= 0, found);
+            ASSERT_EQ(expectedIdx, idx);
+            if(found)
+            {
+                // the returned rotation is the closest one
+                Mat candidateBytes = aruco::Dictionary::getByteListFromBits(bits);
+                int nbytes = candidateBytes.cols;
+                Mat markerRotation(1, nbytes, CV_8UC1, dictionary->bytesList.ptr(idx) + rotation * nbytes);
+                Mat candidateRotation(1, nbytes, CV_8UC1, candidateBytes.ptr());
+                EXPECT_EQ(dictionary->getDistanceToId(bits, idx),
+                          (int)cv::norm(markerRotation, candidateRotation, NORM_HAMMING));
+            }
+        }
+    }
+}
+
 }} // namespace
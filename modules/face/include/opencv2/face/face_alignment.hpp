@@ -54,6 +54,16 @@ public:
     virtual bool setFaceDetector(bool(*f)(InputArray , OutputArray, void*), void* userData)=0;
     /// get faces using the custom detector
     virtual bool getFaces(InputArray image, OutputArray faces)=0;
+
+    /** @brief Saves the loaded model to a binary file.
+    *@param filename A variable of type cv::String which stores the name of the file to write.
+    *
+    *The file stores the pixel coordinates, the mean shape, the split nodes and the leaves of all the trees
+    *in flat, aligned arrays. loadModel recognizes it and maps it read-only where the platform allows it,
+    *so loading does not parse the trees and several processes share one copy of them.
+    *Loading a model saved by training and saving it with this function converts it.
+    */
+    virtual void saveBinaryModel(const String& filename) const = 0;
 };
 
 }} // namespace
@@ -110,6 +110,16 @@ public:
 
     static Ptr<FacemarkLBF> create(const FacemarkLBF::Params &parameters = FacemarkLBF::Params() );
     virtual ~FacemarkLBF(){};
+
+    /** @brief Saves the trained or loaded model to a binary file.
+    *@param filename Name of the file to write.
+    *
+    *The file stores the mean shape, the split nodes of the trees and the regression weights in flat,
+    *aligned arrays. loadModel recognizes it and maps it read-only where the platform allows it, so
+    *loading does not parse or copy the large arrays and several processes share one copy of the model.
+    *Loading a model in the FileStorage format and saving it with this function converts it.
+    */
+    virtual void saveBinaryModel(const String& filename) const = 0;
 }; /* LBF */
 
 //! @}
@@ -182,6 +182,14 @@ public:
     -   labels Labels corresponding to the calculated Local Binary Patterns Histograms.
      */
     CV_WRAP static Ptr<LBPHFaceRecognizer> create(int radius=1, int neighbors=8, int grid_x=8, int grid_y=8, double threshold = DBL_MAX);
+
+    /** Number of nearest training histograms reported by predict, or 0 (the default) to report all of
+    them. When it is smaller than the number of training samples, the query is first compared with
+    pooled versions of the histograms, whose distances are lower bounds of the exact ones, and exact
+    distances are only computed until the nearest histograms are known. */
+    CV_WRAP virtual int getCandidateCount() const = 0;
+    /** @copybrief getCandidateCount @see getCandidateCount */
+    CV_WRAP virtual void setCandidateCount(int val) = 0;
 };
 
 //! @}
@@ -0,0 +1,62 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+/*----------------------------------------------
+ * Converts a FacemarkLBF or FacemarkKazemi model to the binary format
+ * that loadModel maps read-only.
+ *
+ * example:
+ * facemark_convert_model -t=lbf -i=lbfmodel.yaml -o=lbfmodel.bin
+ * facemark_convert_model -t=kazemi -i=face_landmark_model.dat -o=face_landmark_model.bin
+ *--------------------------------------------------*/
+
+#include "opencv2/core.hpp"
+#include "opencv2/face.hpp"
+#include <iostream>
+#include <string>
+
+using namespace std;
+using namespace cv;
+using namespace cv::face;
+
+int main(int argc, char** argv){
+    CommandLineParser parser(argc, argv,
+        "{ help h usage ? |     | give the following arguments in following format }"
+        "{ type t         | lbf | type of the model: lbf or kazemi }"
+        "{ input i        |     | (required) path to the model file to convert [example - /data/lbfmodel.yaml] }"
+        "{ output o       |     | (required) path to the binary model file to write [example - /data/lbfmodel.bin] }"
+    );
+    if (parser.has("help")){
+        parser.printMessage();
+        return 0;
+    }
+    string type(parser.get<string>("type"));
+    string input(parser.get<string>("input"));
+    string output(parser.get<string>("output"));
+    if (input.empty() || output.empty()){
+        parser.printMessage();
+        cerr << "The names of the input and output model files are required" << endl;
+        return -1;
+    }
+
+    if (type == "lbf"){
+        FacemarkLBF::Params params;
+        params.verbose = false;
+        Ptr<FacemarkLBF> facemark = FacemarkLBF::create(params);
+        facemark->loadModel(input);
+        facemark->saveBinaryModel(output);
+    }
+    else if (type == "kazemi"){
+        Ptr<FacemarkKazemi> facemark = FacemarkKazemi::create();
+        facemark->loadModel(input);
+        facemark->saveBinaryModel(output);
+    }
+    else{
+        parser.printMessage();
+        cerr << "Unknown model type: " << type << endl;
+        return -1;
+    }
+    cout << "Model written to " << output << endl;
+    return 0;
+}
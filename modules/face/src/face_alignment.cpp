@@ -31,6 +31,11 @@ bool FacemarkKazemiImpl::getFaces(InputArray image, OutputArray faces)
     return faceDetector(image, faces, faceDetectorData);
 }
 FacemarkKazemiImpl::FacemarkKazemiImpl(const FacemarkKazemi::Params& parameters) :
+    trees_per_level(0),
+    num_leaves(0),
+    tree_offsets(NULL),
+    flat_nodes(NULL),
+    flat_leaves(NULL),
     faceDetector(NULL),
     faceDetectorData(NULL)
 {
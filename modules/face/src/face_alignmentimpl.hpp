@@ -5,6 +5,7 @@
 #ifndef __OPENCV_FACE_ALIGNMENTIMPL_HPP__
 #define __OPENCV_FACE_ALIGNMENTIMPL_HPP__
 #include "opencv2/face.hpp"
+#include "facemark_model_storage.hpp"
 #include <string>
 #include <sstream>
 #include <vector>
@@ -45,6 +46,42 @@ struct tree_node{
 struct regtree{
     std::vector<tree_node> nodes;
 };
+/** @brief node of a regression tree in the flat form used for fitting.
+* The children of the node k of a tree are the nodes 2k+1 and 2k+2 of the same tree.
+*/
+struct flat_node{
+    //! index1 and index2 indices of the test coordinates compared by a split node.
+    int32_t index1;
+    int32_t index2;
+    //! thresh threshold of a split node.
+    float thresh;
+    //! leaf index of the leaf among the leaves of the model, -1 for a split node.
+    int32_t leaf;
+};
+/** @brief header of the binary model file written by saveBinaryModel.
+* It is followed by the pixel coordinates of every cascade level, the mean shape, the node offsets
+* of the trees, the nodes and the leaves, each section aligned to FACEMARK_MODEL_ALIGNMENT.
+*/
+static const char KAZEMI_MODEL_MAGIC[8] = { 'K', 'Z', 'M', 'M', 'O', 'D', 'E', 'L' };
+static const int KAZEMI_MODEL_VERSION = 1;
+struct kazemi_model_header{
+    char magic[8];
+    int32_t version;
+    //! endianness 1 as written by the machine that saved the model
+    int32_t endianness;
+    uint64_t cascade_depth;
+    uint64_t num_pixels;
+    uint64_t num_landmarks;
+    uint64_t num_trees;
+    uint64_t num_nodes;
+    uint64_t num_leaves;
+    uint64_t pixels_offset;
+    uint64_t mean_shape_offset;
+    uint64_t tree_offsets_offset;
+    uint64_t nodes_offset;
+    uint64_t leaves_offset;
+    uint64_t file_size;
+};
 /** @brief Represents a training sample
 *It contains current shape, difference between actual shape
 *and current shape. It also stores the image whose shape is being
@@ -71,6 +108,7 @@ class FacemarkKazemiImpl : public FacemarkKazemi{
 public:
     FacemarkKazemiImpl(const FacemarkKazemi::Params& parameters);
     void loadModel(String fs) CV_OVERRIDE;
+    void saveBinaryModel(const String& filename) const CV_OVERRIDE;
     bool setFaceDetector(FN_FaceDetector f, void* userdata) CV_OVERRIDE;
     bool getFaces(InputArray image, OutputArray faces) CV_OVERRIDE;
     bool fit(InputArray image, InputArray faces, OutputArrayOfArrays landmarks ) CV_OVERRIDE;
@@ -93,6 +131,19 @@ protected:
     std::vector<Point2f> meanshape;
     std::vector< std::vector<regtree> > loaded_forests;
     std::vector< std::vector<Point2f> > loaded_pixel_coordinates;
+    /* The loaded trees used by fit: tree j of cascade level i spans the nodes
+    tree_offsets[i*trees_per_level+j] to tree_offsets[i*trees_per_level+j+1], each of the num_leaves
+    leaves holds meanshape.size() points. The arrays point either to the vectors below or to a mapped
+    binary model.*/
+    unsigned long trees_per_level;
+    unsigned long num_leaves;
+    const uint32_t* tree_offsets;
+    const flat_node* flat_nodes;
+    const Point2f* flat_leaves;
+    std::vector<uint32_t> tree_offsets_buf;
+    std::vector<flat_node> flat_nodes_buf;
+    std::vector<Point2f> flat_leaves_buf;
+    Ptr<const uchar> model_data;
     FN_FaceDetector faceDetector;
     void* faceDetectorData;
     bool findNearestLandmarks(std::vector< std::vector<int> >& nearest);
@@ -118,6 +169,10 @@ protected:
     void readSplit(std::ifstream& is, splitr &vec);
     //This function reads a leaf node of the tree.
     void readLeaf(std::ifstream& is, std::vector<Point2f> &leaf);
+    //This function converts the loaded forests to the flat arrays used by fit
+    void flattenForests();
+    //This function loads a model saved by saveBinaryModel
+    void loadBinaryModel(const String& filename);
     /* This function generates pixel intensities of the randomly generated test coordinates used to decide the split.
     */
     bool getPixelIntensities(Mat img,std::vector<Point2f> pixel_coordinates_,std::vector<int>& pixel_intensities_,Rect face);
@@ -36,11 +36,13 @@ Mentor: Delia Passalacqua
 
 #include "precomp.hpp"
 #include "opencv2/face.hpp"
+#include "facemark_model_storage.hpp"
 #include <fstream>
 #include <cmath>
 #include <ctime>
 #include <cstdio>
 #include <cstdarg>
+#include <climits>
 
 namespace cv {
 namespace face {
@@ -55,6 +57,23 @@ namespace face {
     x = x_tmp; y = y_tmp;                                     \
 } while(0)
 
+// binary model file layout: an LBFModelHeader followed by the mean shape, the split features and the
+// split thresholds of every tree, and the global regression weights of every stage, each section
+// aligned to FACEMARK_MODEL_ALIGNMENT. The trees are stored stage by stage, then landmark by landmark.
+static const char LBF_MODEL_MAGIC[8] = { 'L', 'B', 'F', 'M', 'O', 'D', 'E', 'L' };
+static const int LBF_MODEL_VERSION = 1;
+
+struct LBFModelHeader
+{
+    char magic[8];
+    int version;
+    int endianness;  // 1 as written by the machine that saved the model
+    int stages_n, tree_n, tree_depth, n_landmarks;
+    int weights_cols;
+    int reserved;
+    uint64 mean_shape_offset, feats_offset, thresholds_offset, weights_offset, file_size;
+};
+
 FacemarkLBF::Params::Params(){
 
     cascade_face = "";
@@ -106,6 +125,7 @@ public:
     void write( FileStorage& /*fs*/ ) const CV_OVERRIDE;
 
     void loadModel(String fs) CV_OVERRIDE;
+    void saveBinaryModel(const String& filename) const CV_OVERRIDE;
 
     bool setFaceDetector(bool(*f)(InputArray , OutputArray, void * extra_params ), void* userData) CV_OVERRIDE;
     bool getFaces(InputArray image, OutputArray faces) CV_OVERRIDE;
@@ -221,6 +241,8 @@ private:
 
         void write(FileStorage fs, Params config);
         void read(FileStorage fs, Params & config);
+        void writeBinary(const String& filename) const;
+        void readBinary(const Ptr<const uchar>& model, size_t size, Params & config);
 
         void globalRegressionTrain(
             std::vector<Mat> &lbfs, std::vector<Mat> &delta_shapes,
@@ -237,6 +259,9 @@ private:
         std::vector<RandomForest> random_forests;
         std::vector<cv::Mat> gl_regression_weights;
 
+        // memory of a model loaded with readBinary, referenced by the tree features and the weights
+        Ptr<const uchar> model_data;
+
     }; // LBF
 
     Regressor regressor;
@@ -481,6 +506,17 @@ void FacemarkLBFImpl::write( cv::FileStorage& fs ) const {
 
 void FacemarkLBFImpl::loadModel(String s){
     if(params.verbose) printf("loading data from : %s\n", s.c_str());
+    if (isFacemarkModelFile(s, LBF_MODEL_MAGIC)) {
+        size_t size;
+        Ptr<const uchar> model = mapFacemarkModelFile(s, size);
+        if (!model) {
+            CV_Error(Error::StsBadArg, "No valid input file was given, please check the given filename.");
+        }
+        regressor.readBinary(model, size, params);
+        isModelTrained = true;
+        return;
+    }
+
     std::ifstream infile;
     infile.open(s.c_str(), std::ios::in);
     if (!infile) {
@@ -493,6 +529,13 @@ void FacemarkLBFImpl::loadModel(String s){
     isModelTrained = true;
 }
 
+void FacemarkLBFImpl::saveBinaryModel(const String& filename) const {
+    if (!isModelTrained) {
+        CV_Error(Error::StsBadArg, "The LBF model is not trained yet. Please provide a trained model.");
+    }
+    regressor.writeBinary(filename);
+}
+
 Rect FacemarkLBFImpl::getBBox(Mat &img, const Mat_<double> shape) {
     std::vector<Rect> rects;
 
@@ -1065,6 +1108,12 @@ void FacemarkLBFImpl::Regressor::initRegressor(Params config) {
     stages_n = config.stages_n;
     landmark_n = config.n_landmarks;
 
+    // drop the references to a previously loaded binary model before releasing its memory
+    random_forests.clear();
+    gl_regression_weights.clear();
+    mean_shape.release();
+    model_data.release();
+
     random_forests.resize(stages_n);
     for (int i = 0; i < stages_n; i++)
         random_forests[i].initForest(
@@ -1452,6 +1501,157 @@ void FacemarkLBFImpl::Regressor::read(FileStorage fs, Params & config){
     }
 }
 
+void FacemarkLBFImpl::Regressor::writeBinary(const String& filename) const {
+    CV_Assert(stages_n > 0 && (int)random_forests.size() == stages_n && (int)gl_regression_weights.size() == stages_n);
+    const int tree_n = random_forests[0].trees_n;
+    const int tree_depth = random_forests[0].tree_depth;
+    const int nodes_n = 1 << tree_depth;
+    const int F = landmark_n * tree_n * (1 << (tree_depth - 1));
+
+    LBFModelHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, LBF_MODEL_MAGIC, sizeof(header.magic));
+    header.version = LBF_MODEL_VERSION;
+    header.endianness = 1;
+    header.stages_n = stages_n;
+    header.tree_n = tree_n;
+    header.tree_depth = tree_depth;
+    header.n_landmarks = landmark_n;
+    header.weights_cols = F;
+
+    const uint64 trees_total = (uint64)stages_n * landmark_n * tree_n;
+    const uint64 meanShapeSize = (uint64)landmark_n * 2 * sizeof(double);
+    const uint64 featsSize = trees_total * nodes_n * 4 * sizeof(double);
+    const uint64 thresholdsSize = trees_total * nodes_n * sizeof(int);
+    const uint64 weightsSize = (uint64)stages_n * 2 * landmark_n * F * sizeof(double);
+    header.mean_shape_offset = alignFacemarkModelOffset(sizeof(header));
+    header.feats_offset = alignFacemarkModelOffset(header.mean_shape_offset + meanShapeSize);
+    header.thresholds_offset = alignFacemarkModelOffset(header.feats_offset + featsSize);
+    header.weights_offset = alignFacemarkModelOffset(header.thresholds_offset + thresholdsSize);
+    header.file_size = header.weights_offset + weightsSize;
+
+    std::ofstream f(filename.c_str(), std::ios::binary);
+    if (!f.is_open()) {
+        CV_Error(Error::StsError, "Cannot open the model file for writing: " + filename);
+    }
+
+    f.write((const char*)&header, sizeof(header));
+    writeFacemarkModelPadding(f, sizeof(header), header.mean_shape_offset);
+    Mat mean_shape_ = mean_shape.reshape(1, 1);
+    CV_Assert(mean_shape.type() == CV_64FC1 && mean_shape_.isContinuous() && mean_shape_.total() == (size_t)landmark_n * 2);
+    f.write((const char*)mean_shape_.data, (std::streamsize)meanShapeSize);
+
+    writeFacemarkModelPadding(f, header.mean_shape_offset + meanShapeSize, header.feats_offset);
+    for (int k = 0; k < stages_n; k++) {
+        const RandomForest &forest = random_forests[k];
+        CV_Assert(forest.trees_n == tree_n && forest.tree_depth == tree_depth && forest.landmark_n == landmark_n);
+        for (int i = 0; i < landmark_n; i++) {
+            for (int j = 0; j < tree_n; j++) {
+                const RandomTree &tree = forest.random_trees[i][j];
+                CV_Assert(tree.feats.rows == nodes_n && tree.feats.cols == 4 && tree.feats.isContinuous());
+                f.write((const char*)tree.feats.data, (std::streamsize)nodes_n * 4 * sizeof(double));
+            }
+        }
+    }
+
+    writeFacemarkModelPadding(f, header.feats_offset + featsSize, header.thresholds_offset);
+    for (int k = 0; k < stages_n; k++) {
+        for (int i = 0; i < landmark_n; i++) {
+            for (int j = 0; j < tree_n; j++) {
+                const RandomTree &tree = random_forests[k].random_trees[i][j];
+                CV_Assert((int)tree.thresholds.size() == nodes_n);
+                f.write((const char*)&tree.thresholds[0], (std::streamsize)nodes_n * sizeof(int));
+            }
+        }
+    }
+
+    writeFacemarkModelPadding(f, header.thresholds_offset + thresholdsSize, header.weights_offset);
+    for (int k = 0; k < stages_n; k++) {
+        const Mat &weights = gl_regression_weights[k];
+        CV_Assert(weights.type() == CV_64FC1 && weights.rows == 2 * landmark_n && weights.cols == F);
+        for (int r = 0; r < weights.rows; r++)
+            f.write((const char*)weights.ptr<double>(r), (std::streamsize)F * sizeof(double));
+    }
+
+    if (f.fail()) {
+        CV_Error(Error::StsError, "Cannot write the model file: " + filename);
+    }
+}
+
+void FacemarkLBFImpl::Regressor::readBinary(const Ptr<const uchar>& model, size_t size, Params & config){
+    if (size < sizeof(LBFModelHeader)) {
+        CV_Error(Error::StsParseError, "Invalid LBF model file");
+    }
+    const LBFModelHeader& header = *(const LBFModelHeader*)model.get();
+    if (memcmp(header.magic, LBF_MODEL_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != LBF_MODEL_VERSION || header.endianness != 1 ||
+        header.file_size != size || header.stages_n <= 0 || header.tree_n <= 0 ||
+        header.n_landmarks <= 0 || header.tree_depth < 1 || header.tree_depth > 20 ||
+        (uint64)header.n_landmarks * header.tree_n > (uint64)INT_MAX ||
+        (uint64)header.weights_cols != (uint64)header.n_landmarks * header.tree_n * (1 << (header.tree_depth - 1)))
+    {
+        CV_Error(Error::StsParseError, "Invalid or incompatible LBF model file");
+    }
+
+    const int tree_n = header.tree_n;
+    const int nodes_n = 1 << header.tree_depth;
+    const int F = header.weights_cols;
+    const uint64 trees_total = (uint64)header.stages_n * header.n_landmarks * tree_n;
+    if (header.mean_shape_offset < sizeof(header) ||
+        !isFacemarkModelSection(header.mean_shape_offset, header.feats_offset, header.n_landmarks, 2, sizeof(double)) ||
+        !isFacemarkModelSection(header.feats_offset, header.thresholds_offset, trees_total, (uint64)nodes_n * 4, sizeof(double)) ||
+        !isFacemarkModelSection(header.thresholds_offset, header.weights_offset, trees_total, nodes_n, sizeof(int)) ||
+        !isFacemarkModelSection(header.weights_offset, header.file_size, (uint64)header.stages_n * 2 * header.n_landmarks, F, sizeof(double)))
+    {
+        CV_Error(Error::StsParseError, "Invalid LBF model file");
+    }
+
+    config.stages_n = header.stages_n;
+    config.tree_n = header.tree_n;
+    config.tree_depth = header.tree_depth;
+    config.n_landmarks = header.n_landmarks;
+    stages_n = config.stages_n;
+    landmark_n = config.n_landmarks;
+
+    // the split features, the mean shape and the weights reference the read-only storage, they are
+    // never written by predict; the thresholds are small and copied, the trees keep them in a vector
+    uchar* data = (uchar*)model.get();
+    const double* feats_ptr = (const double*)(data + header.feats_offset);
+    const int* thresholds_ptr = (const int*)(data + header.thresholds_offset);
+    mean_shape = Mat(landmark_n, 2, CV_64FC1, data + header.mean_shape_offset);
+
+    random_forests.clear();
+    random_forests.resize(stages_n);
+    gl_regression_weights.resize(stages_n);
+    for (int k = 0; k < stages_n; k++) {
+        RandomForest &forest = random_forests[k];
+        forest.landmark_n = landmark_n;
+        forest.trees_n = tree_n;
+        forest.tree_depth = config.tree_depth;
+        forest.overlap_ratio = config.bagging_overlap;
+        forest.feats_m = config.feats_m;
+        forest.radius_m = config.radius_m;
+        forest.verbose = config.verbose;
+        forest.random_trees.resize(landmark_n);
+        for (int i = 0; i < landmark_n; i++) {
+            forest.random_trees[i].resize(tree_n);
+            for (int j = 0; j < tree_n; j++) {
+                RandomTree &tree = forest.random_trees[i][j];
+                tree.landmark_id = i;
+                tree.depth = config.tree_depth;
+                tree.nodes_n = nodes_n;
+                tree.feats = Mat(nodes_n, 4, CV_64FC1, (void*)feats_ptr);
+                tree.thresholds.assign(thresholds_ptr, thresholds_ptr + nodes_n);
+                feats_ptr += nodes_n * 4;
+                thresholds_ptr += nodes_n;
+            }
+        }
+        gl_regression_weights[k] = Mat(2 * landmark_n, F, CV_64FC1,
+            data + header.weights_offset + (size_t)k * 2 * landmark_n * F * sizeof(double));
+    }
+    model_data = model;
+}
+
 #undef TIMER_BEGIN
 #undef TIMER_NOW
 #undef TIMER_END
@@ -0,0 +1,122 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "precomp.hpp"
+#include "facemark_model_storage.hpp"
+
+#if defined _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined __unix__ || defined __APPLE__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define FACEMARK_MODEL_USE_MMAP 1
+#endif
+
+namespace cv {
+namespace face {
+
+namespace {
+#if defined _WIN32
+struct UnmapView
+{
+    void operator()(const uchar* view) const { UnmapViewOfFile(view); }
+};
+#elif defined FACEMARK_MODEL_USE_MMAP
+struct Unmap
+{
+    explicit Unmap(size_t size_) : size(size_) {}
+    void operator()(const uchar* ptr) const { munmap((void*)ptr, size); }
+    size_t size;
+};
+#endif
+} // namespace
+
+Ptr<const uchar> mapFacemarkModelFile(const String& fileName, size_t& size)
+{
+    size = 0;
+#if defined _WIN32
+    HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return Ptr<const uchar>();
+    LARGE_INTEGER fileSize;
+    HANDLE mapping = NULL;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    // the view keeps the mapping open once the handles are closed
+    if (mapping)
+        CloseHandle(mapping);
+    CloseHandle(file);
+    if (!view)
+        return Ptr<const uchar>();
+    size = (size_t)fileSize.QuadPart;
+    return Ptr<const uchar>((const uchar*)view, UnmapView());
+#elif defined FACEMARK_MODEL_USE_MMAP
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+        return Ptr<const uchar>();
+    struct stat st;
+    void* ptr = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        ptr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED)
+        return Ptr<const uchar>();
+    size = (size_t)st.st_size;
+    return Ptr<const uchar>((const uchar*)ptr, Unmap(size));
+#else
+    std::ifstream f(fileName.c_str(), std::ios::binary | std::ios::ate);
+    if (!f.is_open() || f.tellg() <= 0)
+        return Ptr<const uchar>();
+    const size_t fileSize = (size_t)f.tellg();
+    f.seekg(0, std::ios::beg);
+    // 8-byte words, so that the doubles of the sections are aligned in memory too
+    Ptr<std::vector<uint64> > words = makePtr<std::vector<uint64> >((fileSize + sizeof(uint64) - 1) / sizeof(uint64));
+    if (!f.read((char*)&(*words)[0], (std::streamsize)fileSize))
+        return Ptr<const uchar>();
+    size = fileSize;
+    return Ptr<const uchar>(words, (const uchar*)&(*words)[0]);
+#endif
+}
+
+bool isFacemarkModelFile(const String& fileName, const char* magic)
+{
+    std::ifstream f(fileName.c_str(), std::ios::binary);
+    char header[8];
+    if (!f.read(header, sizeof(header)))
+        return false;
+    return memcmp(header, magic, sizeof(header)) == 0;
+}
+
+uint64 alignFacemarkModelOffset(uint64 offset)
+{
+    return (offset + FACEMARK_MODEL_ALIGNMENT - 1) & ~(uint64)(FACEMARK_MODEL_ALIGNMENT - 1);
+}
+
+bool isFacemarkModelSection(uint64 offset, uint64 end, uint64 count1, uint64 count2, size_t elemSize)
+{
+    if (offset % FACEMARK_MODEL_ALIGNMENT != 0 || offset > end)
+        return false;
+    const uint64 capacity = (end - offset) / elemSize;
+    return count1 == 0 || count2 <= capacity / count1;
+}
+
+void writeFacemarkModelPadding(std::ofstream& f, uint64 offset, uint64 nextOffset)
+{
+    const char padding[FACEMARK_MODEL_ALIGNMENT] = { 0 };
+    CV_Assert(nextOffset >= offset && nextOffset - offset <= FACEMARK_MODEL_ALIGNMENT);
+    f.write(padding, (std::streamsize)(nextOffset - offset));
+}
+
+} // namespace face
+} // namespace cv
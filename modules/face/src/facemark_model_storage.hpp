@@ -0,0 +1,43 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#ifndef __OPENCV_FACEMARK_MODEL_STORAGE_HPP__
+#define __OPENCV_FACEMARK_MODEL_STORAGE_HPP__
+
+#include "precomp.hpp"
+#include <fstream>
+
+namespace cv {
+namespace face {
+
+//! sections of the binary facemark model files are aligned to this many bytes
+static const size_t FACEMARK_MODEL_ALIGNMENT = 64;
+
+/** @brief Maps a binary facemark model file read-only.
+
+Several processes loading the same model share its pages. Where files cannot be mapped, the file is
+read into memory instead. The returned pointer keeps the bytes alive; it is empty when the file
+cannot be opened or is empty.
+@param fileName model file.
+@param size returns the size of the file in bytes.
+*/
+Ptr<const uchar> mapFacemarkModelFile(const String& fileName, size_t& size);
+
+//! returns true when the file starts with the 8 bytes of magic
+bool isFacemarkModelFile(const String& fileName, const char* magic);
+
+//! rounds offset up to FACEMARK_MODEL_ALIGNMENT
+uint64 alignFacemarkModelOffset(uint64 offset);
+
+//! returns true when offset is aligned and count1*count2 elements of elemSize bytes fit between
+//! offset and end, without computing the product
+bool isFacemarkModelSection(uint64 offset, uint64 end, uint64 count1, uint64 count2, size_t elemSize);
+
+//! writes zeros to the stream from offset up to the next section offset
+void writeFacemarkModelPadding(std::ofstream& f, uint64 offset, uint64 nextOffset);
+
+} // namespace face
+} // namespace cv
+
+#endif
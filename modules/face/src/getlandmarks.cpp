@@ -6,6 +6,7 @@
 #include "face_alignmentimpl.hpp"
 #include <fstream>
 #include <ctime>
+#include <climits>
 
 using namespace std;
 namespace cv{
@@ -44,12 +45,184 @@ void FacemarkKazemiImpl :: readPixels(ifstream& is,uint64_t index)
 {
     is.read((char*)&loaded_pixel_coordinates[(unsigned long)index][0], loaded_pixel_coordinates[(unsigned long)index].size() * sizeof(Point2f));
 }
+// checks that every split node reached from the root of its tree has its children inside the tree
+// and compares valid test coordinates, and that every leaf reached exists, so that fit can walk the
+// trees without checks
+static void checkFlatTrees(const uint32_t* offsets,const flat_node* nodes,uint64_t num_trees,
+                           uint64_t num_nodes,uint64_t num_leaves,uint64_t num_pixels){
+    if(offsets[0]!=0||offsets[num_trees]!=num_nodes){
+        String error_message = "Data not saved properly.Aborting.....";
+        CV_Error(Error::StsParseError, error_message);
+    }
+    vector<uchar> reached;
+    for(uint64_t t=0;t<num_trees;t++){
+        if(offsets[t+1]<=offsets[t]){
+            String error_message = "Data not saved properly.Aborting.....";
+            CV_Error(Error::StsParseError, error_message);
+        }
+        const flat_node* tree = nodes+offsets[t];
+        uint64_t tree_size = offsets[t+1]-offsets[t];
+        reached.assign((size_t)tree_size,0);
+        reached[0] = 1;
+        for(uint64_t k=0;k<tree_size;k++){
+            if(!reached[(size_t)k])
+                continue;
+            bool valid;
+            if(tree[k].leaf>=0)
+                valid = (uint64_t)tree[k].leaf<num_leaves;
+            else
+                valid = tree[k].index1>=0 && (uint64_t)tree[k].index1<num_pixels &&
+                        tree[k].index2>=0 && (uint64_t)tree[k].index2<num_pixels && 2*k+2<tree_size;
+            if(!valid){
+                String error_message = "Data not saved properly.Aborting.....";
+                CV_Error(Error::StsParseError, error_message);
+            }
+            if(tree[k].leaf<0){
+                reached[(size_t)(2*k+1)] = 1;
+                reached[(size_t)(2*k+2)] = 1;
+            }
+        }
+    }
+}
+void FacemarkKazemiImpl :: flattenForests(){
+    size_t leaf_size = meanshape.size();
+    trees_per_level = loaded_forests.empty() ? 0 : (unsigned long)loaded_forests[0].size();
+    if(loaded_forests.size()!=loaded_pixel_coordinates.size()){
+        String error_message = "Data not saved properly.Aborting.....";
+        CV_Error(Error::StsParseError, error_message);
+    }
+    tree_offsets_buf.assign(1,0);
+    flat_nodes_buf.clear();
+    flat_leaves_buf.clear();
+    for(size_t i=0;i<loaded_forests.size();i++){
+        if(loaded_forests[i].size()!=trees_per_level){
+            String error_message = "Data not saved properly.Aborting.....";
+            CV_Error(Error::StsParseError, error_message);
+        }
+        for(size_t j=0;j<loaded_forests[i].size();j++){
+            const vector<tree_node>& nodes = loaded_forests[i][j].nodes;
+            // keep the nodes up to the last one reachable from the root, so that the positions
+            // of the children stay 2k+1 and 2k+2; the nodes in between that are not reached are
+            // stored as empty splits and ignored by checkFlatTrees
+            vector<uchar> reached(nodes.size(),0);
+            size_t tree_size = 0;
+            if(!nodes.empty())
+                reached[0] = 1;
+            for(size_t k=0;k<nodes.size();k++){
+                if(!reached[k])
+                    continue;
+                tree_size = k+1;
+                if(nodes[k].leaf.empty()){
+                    if(right((unsigned long)k)>=nodes.size()){
+                        String error_message = "Data not saved properly.Aborting.....";
+                        CV_Error(Error::StsParseError, error_message);
+                    }
+                    reached[left((unsigned long)k)] = 1;
+                    reached[right((unsigned long)k)] = 1;
+                }
+            }
+            for(size_t k=0;k<tree_size;k++){
+                flat_node node;
+                node.index1 = 0;
+                node.index2 = 0;
+                node.thresh = 0;
+                node.leaf = -1;
+                if(reached[k]&&!nodes[k].leaf.empty()){
+                    if(nodes[k].leaf.size()!=leaf_size){
+                        String error_message = "Data not saved properly.Aborting.....";
+                        CV_Error(Error::StsParseError, error_message);
+                    }
+                    node.leaf = (int32_t)(flat_leaves_buf.size()/leaf_size);
+                    flat_leaves_buf.insert(flat_leaves_buf.end(),nodes[k].leaf.begin(),nodes[k].leaf.end());
+                }
+                else if(reached[k]){
+                    node.index1 = (int32_t)std::min(nodes[k].split.index1,(uint64_t)INT_MAX);
+                    node.index2 = (int32_t)std::min(nodes[k].split.index2,(uint64_t)INT_MAX);
+                    node.thresh = nodes[k].split.thresh;
+                }
+                flat_nodes_buf.push_back(node);
+            }
+            tree_offsets_buf.push_back((uint32_t)flat_nodes_buf.size());
+        }
+    }
+    num_leaves = leaf_size ? (unsigned long)(flat_leaves_buf.size()/leaf_size) : 0;
+    checkFlatTrees(&tree_offsets_buf[0],flat_nodes_buf.empty() ? NULL : &flat_nodes_buf[0],
+                   tree_offsets_buf.size()-1,flat_nodes_buf.size(),num_leaves,
+                   loaded_pixel_coordinates.empty() ? 0 : loaded_pixel_coordinates[0].size());
+    model_data.release();
+    tree_offsets = &tree_offsets_buf[0];
+    flat_nodes = flat_nodes_buf.empty() ? NULL : &flat_nodes_buf[0];
+    flat_leaves = flat_leaves_buf.empty() ? NULL : &flat_leaves_buf[0];
+}
+void FacemarkKazemiImpl :: loadBinaryModel(const String& filename){
+    CV_StaticAssert(sizeof(flat_node) == 16, "Invalid build configuration");
+    size_t size;
+    Ptr<const uchar> model = mapFacemarkModelFile(filename,size);
+    if(!model){
+        String error_message = "No file with given name found.Aborting....";
+        CV_Error(Error::StsBadArg, error_message);
+    }
+    if(size<sizeof(kazemi_model_header)){
+        String error_message = "Data not saved properly.Aborting.....";
+        CV_Error(Error::StsParseError, error_message);
+    }
+    const kazemi_model_header& header = *(const kazemi_model_header*)model.get();
+    if(memcmp(header.magic,KAZEMI_MODEL_MAGIC,sizeof(header.magic))!=0||header.version!=KAZEMI_MODEL_VERSION||
+       header.endianness!=1||header.file_size!=size||header.cascade_depth==0||header.num_trees==0||
+       header.num_pixels==0||header.num_landmarks==0||header.num_nodes>=(uint64_t)UINT_MAX||
+       header.num_leaves>=(uint64_t)INT_MAX||header.num_trees>=(uint64_t)UINT_MAX/header.cascade_depth){
+        String error_message = "Invalid or incompatible model file. Aborting.....";
+        CV_Error(Error::StsParseError, error_message);
+    }
+    // every count is bounded by the size of its section before it is used
+    const uint64_t num_trees_total = header.cascade_depth*header.num_trees;
+    if(header.pixels_offset<sizeof(header)||
+       !isFacemarkModelSection(header.pixels_offset,header.mean_shape_offset,header.cascade_depth,header.num_pixels,sizeof(Point2f))||
+       !isFacemarkModelSection(header.mean_shape_offset,header.tree_offsets_offset,header.num_landmarks,1,sizeof(Point2f))||
+       !isFacemarkModelSection(header.tree_offsets_offset,header.nodes_offset,num_trees_total+1,1,sizeof(uint32_t))||
+       !isFacemarkModelSection(header.nodes_offset,header.leaves_offset,header.num_nodes,1,sizeof(flat_node))||
+       !isFacemarkModelSection(header.leaves_offset,header.file_size,header.num_leaves,header.num_landmarks,sizeof(Point2f))){
+        String error_message = "Data not saved properly.Aborting.....";
+        CV_Error(Error::StsParseError, error_message);
+    }
+
+    const uchar* data = model.get();
+    const uint32_t* offsets = (const uint32_t*)(data+header.tree_offsets_offset);
+    const flat_node* nodes = (const flat_node*)(data+header.nodes_offset);
+    checkFlatTrees(offsets,nodes,num_trees_total,header.num_nodes,header.num_leaves,header.num_pixels);
+
+    // the pixel coordinates and the mean shape are small and copied, the trees stay in the storage
+    const Point2f* pixels = (const Point2f*)(data+header.pixels_offset);
+    loaded_pixel_coordinates.resize((size_t)header.cascade_depth);
+    for(size_t i=0;i<loaded_pixel_coordinates.size();i++){
+        loaded_pixel_coordinates[i].assign(pixels,pixels+header.num_pixels);
+        pixels += header.num_pixels;
+    }
+    const Point2f* mean_shape = (const Point2f*)(data+header.mean_shape_offset);
+    meanshape.assign(mean_shape,mean_shape+header.num_landmarks);
+    setMeanExtreme();
+    loaded_forests.clear();
+    tree_offsets_buf.clear();
+    flat_nodes_buf.clear();
+    flat_leaves_buf.clear();
+    trees_per_level = (unsigned long)header.num_trees;
+    num_leaves = (unsigned long)header.num_leaves;
+    tree_offsets = offsets;
+    flat_nodes = nodes;
+    flat_leaves = (const Point2f*)(data+header.leaves_offset);
+    model_data = model;
+    isModelLoaded = true;
+}
 void FacemarkKazemiImpl :: loadModel(String filename){
     if(filename.empty()){
         String error_message = "No filename found.Aborting....";
         CV_Error(Error::StsBadArg, error_message);
         return ;
     }
+    if(isFacemarkModelFile(filename,KAZEMI_MODEL_MAGIC)){
+        loadBinaryModel(filename);
+        return ;
+    }
     ifstream f(filename.c_str(),ios::binary);
     if(!f.is_open()){
         String error_message = "No file with given name found.Aborting....";
@@ -70,6 +243,7 @@ void FacemarkKazemiImpl :: loadModel(String filename){
     }
     uint64_t cascade_size;
     f.read((char*)&cascade_size,sizeof(cascade_size));
+    loaded_forests.clear();
     loaded_forests.resize((unsigned long)cascade_size);
     f.read((char*)&len, sizeof(len));
     temp = new char[(unsigned long)len+1];
@@ -166,6 +340,9 @@ void FacemarkKazemiImpl :: loadModel(String filename){
         }
     }
     f.close();
+    // fit uses the flat arrays, the trees are not needed any more
+    flattenForests();
+    loaded_forests.clear();
     isModelLoaded = true;
 }
 
@@ -227,50 +404,41 @@ bool FacemarkKazemiImpl::fit(InputArray img, InputArray roi, OutputArrayOfArrays
         CV_Error(Error::StsBadArg, error_message);
         return false;
     }
-    if(meanshape.empty()||loaded_forests.empty()||loaded_pixel_coordinates.empty()){
+    if(meanshape.empty()||trees_per_level==0||loaded_pixel_coordinates.empty()){
         String error_message = "Model not loaded properly.Aborting...";
         CV_Error(Error::StsBadArg, error_message);
         return false;
     }
-    if(loaded_forests.size()==0){
-        String error_message = "Model not loaded properly.Aboerting...";
-        CV_Error(Error::StsBadArg, error_message);
-        return false;
-    }
-    if(loaded_pixel_coordinates.size()==0){
-        String error_message = "Model not loaded properly.Aboerting...";
-        CV_Error(Error::StsBadArg, error_message);
-        return false;
-    }
     vector< vector<int> > nearest_landmarks;
     findNearestLandmarks(nearest_landmarks);
-    tree_node curr_node;
     vector<Point2f> pixel_relative;
     vector<int> pixel_intensity;
     Mat warp_mat;
+    const size_t leaf_size = meanshape.size();
     for(size_t e=0;e<faces.size();e++){
         shapes[e]=meanshape;
         convertToActual(faces[e],warp_mat);
-        for(size_t i=0;i<loaded_forests.size();i++){
+        for(size_t i=0;i<loaded_pixel_coordinates.size();i++){
             pixel_intensity.clear();
             pixel_relative = loaded_pixel_coordinates[i];
             getRelativePixels(shapes[e],pixel_relative,nearest_landmarks[i]);
             getPixelIntensities(image,pixel_relative,pixel_intensity,faces[e]);
-            for(size_t j=0;j<loaded_forests[i].size();j++){
-                regtree tree = loaded_forests[i][j];
-                curr_node = tree.nodes[0];
+            for(size_t j=0;j<trees_per_level;j++){
+                // the trees were checked when the model was loaded
+                const flat_node* tree = flat_nodes + tree_offsets[i*trees_per_level+j];
                 unsigned long curr_node_index = 0;
-                while(curr_node.leaf.size()==0)
+                while(tree[curr_node_index].leaf<0)
                 {
-                    if ((float)pixel_intensity[(unsigned long)curr_node.split.index1] - (float)pixel_intensity[(unsigned long)curr_node.split.index2] > curr_node.split.thresh)
+                    const flat_node& curr_node = tree[curr_node_index];
+                    if ((float)pixel_intensity[curr_node.index1] - (float)pixel_intensity[curr_node.index2] > curr_node.thresh)
                     {
                         curr_node_index=left(curr_node_index);
                     }                    else
                         curr_node_index=right(curr_node_index);
-                    curr_node = tree.nodes[curr_node_index];
                 }
-                for(size_t p=0;p<curr_node.leaf.size();p++){
-                    shapes[e][p]=shapes[e][p] + curr_node.leaf[p];
+                const Point2f* leaf = flat_leaves + (size_t)tree[curr_node_index].leaf*leaf_size;
+                for(size_t p=0;p<leaf_size;p++){
+                    shapes[e][p]=shapes[e][p] + leaf[p];
                 }
             }
         }
@@ -17,8 +17,11 @@
  */
 #include "precomp.hpp"
 #include "opencv2/face.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 #include "face_utils.hpp"
 
+#include <numeric>
+
 namespace cv { namespace face {
 
 // Face Recognition based on Local Binary Patterns.
@@ -36,7 +39,14 @@ private:
     int _neighbors;
     double _threshold;
 
-    std::vector<Mat> _histograms;
+    int _candidateCount;
+
+    // One spatial histogram per row, stored contiguously so that the
+    // gallery can be scanned in a single pass.
+    Mat _histograms;
+    // The same histograms with groups of adjacent bins pooled together,
+    // compared first when only the nearest candidates are requested.
+    Mat _pooledHistograms;
     Mat _labels;
 
     // Computes a LBPH model with images in src and
@@ -44,6 +54,9 @@ private:
     // old model data.
     void train(InputArrayOfArrays src, InputArray labels, bool preserveData);
 
+    // Pools the bins of every histogram in hists (one per row).
+    void poolHistograms(const Mat& hists, Mat& pooled) const;
+
 
 public:
     using FaceRecognizer::read;
@@ -61,7 +74,8 @@ public:
         _grid_y(gridy),
         _radius(radius_),
         _neighbors(neighbors_),
-        _threshold(threshold) {}
+        _threshold(threshold),
+        _candidateCount(0) {}
 
     // Initializes and computes this LBPH Model. The current implementation is
     // rather fixed as it uses the Extended Local Binary Patterns per default.
@@ -77,7 +91,8 @@ public:
                 _grid_y(gridy),
                 _radius(radius_),
                 _neighbors(neighbors_),
-                _threshold(threshold) {
+                _threshold(threshold),
+                _candidateCount(0) {
         train(src, labels);
     }
 
@@ -118,7 +133,9 @@ public:
     inline void setNeighbors(int val) CV_OVERRIDE { _neighbors = val; }
     inline double getThreshold() const CV_OVERRIDE { return _threshold; }
     inline void setThreshold(double val) CV_OVERRIDE { _threshold = val; }
-    inline std::vector<cv::Mat> getHistograms() const CV_OVERRIDE { return _histograms; }
+    inline int getCandidateCount() const CV_OVERRIDE { return _candidateCount; }
+    inline void setCandidateCount(int val) CV_OVERRIDE { _candidateCount = val; }
+    std::vector<cv::Mat> getHistograms() const CV_OVERRIDE;
     inline cv::Mat getLabels() const CV_OVERRIDE { return _labels; }
 };
 
@@ -132,8 +149,14 @@ void LBPH::read(const FileNode& fs) {
     fs["neighbors"] >> _neighbors;
     fs["grid_x"] >> _grid_x;
     fs["grid_y"] >> _grid_y;
+    cv::read(fs["candidate_count"], _candidateCount, 0); // older versions do not have "candidate_count"
     //read matrices
-    readFileNodeList(fs["histograms"], _histograms);
+    std::vector<Mat> histograms;
+    readFileNodeList(fs["histograms"], histograms);
+    _histograms.release();
+    for (size_t i = 0; i < histograms.size(); i++)
+        _histograms.push_back(histograms[i].reshape(1, 1));
+    poolHistograms(_histograms, _pooledHistograms);
     fs["labels"] >> _labels;
     const FileNode& fn = fs["labelsInfo"];
     if (fn.type() == FileNode::SEQ)
@@ -155,8 +178,9 @@ void LBPH::write(FileStorage& fs) const {
     fs << "neighbors" << _neighbors;
     fs << "grid_x" << _grid_x;
     fs << "grid_y" << _grid_y;
+    fs << "candidate_count" << _candidateCount;
     // write matrices
-    writeFileNodeList(fs, "histograms", _histograms);
+    writeFileNodeList(fs, "histograms", getHistograms());
     fs << "labels" << _labels;
     fs << "labelsInfo" << "[";
     for (std::map<int, String>::const_iterator it = _labelsInfo.begin(); it != _labelsInfo.end(); it++)
@@ -164,6 +188,13 @@ void LBPH::write(FileStorage& fs) const {
     fs << "]";
 }
 
+std::vector<Mat> LBPH::getHistograms() const {
+    std::vector<Mat> histograms(_histograms.rows);
+    for (int i = 0; i < _histograms.rows; i++)
+        histograms[i] = _histograms.row(i);
+    return histograms;
+}
+
 void LBPH::train(InputArrayOfArrays _in_src, InputArray _in_labels) {
     this->train(_in_src, _in_labels, false);
 }
@@ -342,6 +373,50 @@ static Mat spatial_histogram(InputArray _src, int numPatterns,
     return result.reshape(1,1);
 }
 
+//------------------------------------------------------------------------------
+// chi-square distance between histograms
+//------------------------------------------------------------------------------
+
+// Bins per grid cell of the pooled histograms.
+static const int LBPH_POOLED_BINS = 16;
+
+// Relative margin subtracted from the pooled lower bounds before pruning.
+static const double LBPH_BOUND_MARGIN = 1e-9;
+
+// Same measure as compareHist(h1, h2, HISTCMP_CHISQR_ALT), for float histograms.
+// The terms are accumulated in double, as compareHist does, so that the pooled
+// lower bounds stay below the exact distances up to a negligible rounding.
+static double chiSquareAlt(const float* h1, const float* h2, int len)
+{
+    double result = 0;
+    int j = 0;
+#if CV_SIMD128_64F
+    const v_float32x4 v_eps = v_setall_f32((float)DBL_EPSILON);
+    const v_float32x4 v_zero = v_setzero_f32();
+    const v_float32x4 v_one = v_setall_f32(1.f);
+    v_float64x2 v_sum0 = v_setzero_f64(), v_sum1 = v_setzero_f64();
+    for (; j <= len - 4; j += 4) {
+        v_float32x4 a = v_load(h1 + j);
+        v_float32x4 b = v_load(h2 + j);
+        v_float32x4 sum = a + b;
+        v_float32x4 mask = v_abs(sum) > v_eps;
+        v_float32x4 d = v_select(mask, a - b, v_zero);
+        sum = v_select(mask, sum, v_one);
+        v_float64x2 d0 = v_cvt_f64(d), d1 = v_cvt_f64_high(d);
+        v_sum0 += d0 * d0 / v_cvt_f64(sum);
+        v_sum1 += d1 * d1 / v_cvt_f64_high(sum);
+    }
+    result = v_reduce_sum(v_sum0 + v_sum1);
+#endif
+    for (; j < len; j++) {
+        double a = h1[j] - h2[j];
+        double b = h1[j] + h2[j];
+        if (fabs(b) > DBL_EPSILON)
+            result += a * a / b;
+    }
+    return 2 * result;
+}
+
 //------------------------------------------------------------------------------
 // wrapper to cv::elbp (extended local binary patterns)
 //------------------------------------------------------------------------------
@@ -377,25 +452,63 @@ void LBPH::train(InputArrayOfArrays _in_src, InputArray _in_labels, bool preserv
     // if this model should be trained without preserving old data, delete old model data
     if(!preserveData) {
         _labels.release();
-        _histograms.clear();
+        _histograms.release();
+        _pooledHistograms.release();
     }
     // append labels to _labels matrix
     for(size_t labelIdx = 0; labelIdx < labels.total(); labelIdx++) {
         _labels.push_back(labels.at<int>((int)labelIdx));
     }
-    // store the spatial histograms of the original data
-    for(size_t sampleIdx = 0; sampleIdx < src.size(); sampleIdx++) {
-        // calculate lbp image
-        Mat lbp_image = elbp(src[sampleIdx], _radius, _neighbors);
-        // get spatial histogram from this lbp image
-        Mat p = spatial_histogram(
-                lbp_image, /* lbp_image */
-                static_cast<int>(std::pow(2.0, static_cast<double>(_neighbors))), /* number of possible patterns */
-                _grid_x, /* grid size x */
-                _grid_y, /* grid size y */
-                true);
-        // add to templates
-        _histograms.push_back(p);
+    // calculate the spatial histograms of the original data
+    const int numPatterns = static_cast<int>(std::pow(2.0, static_cast<double>(_neighbors)));
+    Mat histograms((int)src.size(), _grid_x * _grid_y * numPatterns, CV_32FC1);
+    parallel_for_(Range(0, (int)src.size()), [&](const Range& range) {
+        for (int sampleIdx = range.start; sampleIdx < range.end; sampleIdx++) {
+            // calculate lbp image
+            Mat lbp_image = elbp(src[sampleIdx], _radius, _neighbors);
+            // get spatial histogram from this lbp image
+            Mat p = spatial_histogram(
+                    lbp_image, /* lbp_image */
+                    numPatterns, /* number of possible patterns */
+                    _grid_x, /* grid size x */
+                    _grid_y, /* grid size y */
+                    true);
+            p.copyTo(histograms.row(sampleIdx));
+        }
+    });
+    // add to templates, the existing ones are not copied unless the
+    // storage has to grow
+    Mat pooled;
+    poolHistograms(histograms, pooled);
+    _histograms.push_back(histograms);
+    _pooledHistograms.push_back(pooled);
+}
+
+// Every grid cell histogram is reduced to LBPH_POOLED_BINS bins by summing
+// groups of adjacent bins. Each term of the chi-square distance is jointly
+// convex and homogeneous in the two bins it compares, so the distance between
+// pooled histograms is a lower bound of the distance between the original ones.
+void LBPH::poolHistograms(const Mat& hists, Mat& pooled) const {
+    int numCells = _grid_x * _grid_y;
+    if (numCells <= 0 || hists.cols % numCells != 0)
+        numCells = 1;
+    const int cellBins = hists.cols / numCells;
+    const int group = std::max(1, cellBins / LBPH_POOLED_BINS);
+    const int pooledBins = (cellBins + group - 1) / group;
+    pooled.create(hists.rows, numCells * pooledBins, CV_32FC1);
+    for (int i = 0; i < hists.rows; i++) {
+        const float* h = hists.ptr<float>(i);
+        float* ph = pooled.ptr<float>(i);
+        for (int c = 0; c < numCells; c++) {
+            for (int k = 0; k < pooledBins; k++) {
+                const int first = c * cellBins + k * group;
+                const int last = std::min(first + group, (c + 1) * cellBins);
+                float sum = 0.f;
+                for (int j = first; j < last; j++)
+                    sum += h[j];
+                ph[c * pooledBins + k] = sum;
+            }
+        }
     }
 }
 
@@ -414,12 +527,73 @@ void LBPH::predict(InputArray _src, Ptr<PredictCollector> collector) const {
             _grid_x, /* grid size x */
             _grid_y, /* grid size y */
             true /* normed histograms */);
-    // find 1-nearest neighbor
-    collector->init((int)_histograms.size());
-    for (size_t sampleIdx = 0; sampleIdx < _histograms.size(); sampleIdx++) {
-        double dist = compareHist(_histograms[sampleIdx], query, HISTCMP_CHISQR_ALT);
-        int label = _labels.at<int>((int)sampleIdx);
-        if (!collector->collect(label, dist))return;
+    CV_CheckEQ(query.cols, _histograms.cols, "The histogram of the image does not match the model, was it trained with other parameters?");
+    const int numSamples = _histograms.rows;
+    const int dims = _histograms.cols;
+    const float* q = query.ptr<float>();
+    if (_candidateCount <= 0 || _candidateCount >= numSamples) {
+        // compare with every histogram of the gallery
+        std::vector<double> dists(numSamples);
+        parallel_for_(Range(0, numSamples), [&](const Range& range) {
+            for (int sampleIdx = range.start; sampleIdx < range.end; sampleIdx++)
+                dists[sampleIdx] = chiSquareAlt(_histograms.ptr<float>(sampleIdx), q, dims);
+        });
+        collector->init(numSamples);
+        for (int sampleIdx = 0; sampleIdx < numSamples; sampleIdx++) {
+            int label = _labels.at<int>(sampleIdx);
+            if (!collector->collect(label, dists[sampleIdx]))return;
+        }
+        return;
+    }
+    // rank the gallery by the lower bounds given by the pooled histograms
+    Mat pooledQuery;
+    poolHistograms(query, pooledQuery);
+    const int pooledDims = _pooledHistograms.cols;
+    std::vector<double> bounds(numSamples);
+    parallel_for_(Range(0, numSamples), [&](const Range& range) {
+        for (int sampleIdx = range.start; sampleIdx < range.end; sampleIdx++)
+            bounds[sampleIdx] = chiSquareAlt(_pooledHistograms.ptr<float>(sampleIdx), pooledQuery.ptr<float>(), pooledDims);
+    });
+    std::vector<int> order(numSamples);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        return bounds[a] < bounds[b] || (bounds[a] == bounds[b] && a < b);
+    });
+    // compute exact distances by increasing bound until no remaining
+    // histogram can be nearer than the k-th nearest one found so far
+    const size_t k = (size_t)_candidateCount;
+    const int batchSize = std::max(_candidateCount, 256);
+    std::vector<std::pair<double, int> > nearest; // max-heap on the distance
+    std::vector<double> dists(batchSize);
+    for (int pos = 0; pos < numSamples; pos += batchSize) {
+        // the bound is relaxed by a relative margin covering the rounding of both sums
+        if (nearest.size() == k && bounds[order[pos]] * (1 - LBPH_BOUND_MARGIN) > nearest.front().first)
+            break;
+        const int count = std::min(batchSize, numSamples - pos);
+        parallel_for_(Range(0, count), [&](const Range& range) {
+            for (int i = range.start; i < range.end; i++)
+                dists[i] = chiSquareAlt(_histograms.ptr<float>(order[pos + i]), q, dims);
+        });
+        for (int i = 0; i < count; i++) {
+            std::pair<double, int> candidate(dists[i], order[pos + i]);
+            if (nearest.size() < k) {
+                nearest.push_back(candidate);
+                std::push_heap(nearest.begin(), nearest.end());
+            } else if (candidate < nearest.front()) {
+                std::pop_heap(nearest.begin(), nearest.end());
+                nearest.back() = candidate;
+                std::push_heap(nearest.begin(), nearest.end());
+            }
+        }
+    }
+    // report the candidates in gallery order
+    std::sort(nearest.begin(), nearest.end(), [](const std::pair<double, int>& a, const std::pair<double, int>& b) {
+        return a.second < b.second;
+    });
+    collector->init((int)nearest.size());
+    for (size_t i = 0; i < nearest.size(); i++) {
+        int label = _labels.at<int>(nearest[i].second);
+        if (!collector->collect(label, nearest[i].first))return;
     }
 }
 
@@ -302,6 +302,59 @@ bool FacemarkKazemiImpl :: saveModel(String filename){
     }
     return true;
 }
+void FacemarkKazemiImpl :: saveBinaryModel(const String& filename) const{
+    if(!isModelLoaded){
+        String error_message = "No model loaded. Aborting....";
+        CV_Error(Error::StsBadArg, error_message);
+    }
+    kazemi_model_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, KAZEMI_MODEL_MAGIC, sizeof(header.magic));
+    header.version = KAZEMI_MODEL_VERSION;
+    header.endianness = 1;
+    header.cascade_depth = loaded_pixel_coordinates.size();
+    header.num_pixels = loaded_pixel_coordinates[0].size();
+    header.num_landmarks = meanshape.size();
+    header.num_trees = trees_per_level;
+    header.num_nodes = tree_offsets[header.cascade_depth*header.num_trees];
+    header.num_leaves = num_leaves;
+
+    const uint64_t pixelsSize = header.cascade_depth*header.num_pixels*sizeof(Point2f);
+    const uint64_t meanShapeSize = header.num_landmarks*sizeof(Point2f);
+    const uint64_t offsetsSize = (header.cascade_depth*header.num_trees+1)*sizeof(uint32_t);
+    const uint64_t nodesSize = header.num_nodes*sizeof(flat_node);
+    const uint64_t leavesSize = header.num_leaves*header.num_landmarks*sizeof(Point2f);
+    header.pixels_offset = alignFacemarkModelOffset(sizeof(header));
+    header.mean_shape_offset = alignFacemarkModelOffset(header.pixels_offset+pixelsSize);
+    header.tree_offsets_offset = alignFacemarkModelOffset(header.mean_shape_offset+meanShapeSize);
+    header.nodes_offset = alignFacemarkModelOffset(header.tree_offsets_offset+offsetsSize);
+    header.leaves_offset = alignFacemarkModelOffset(header.nodes_offset+nodesSize);
+    header.file_size = header.leaves_offset+leavesSize;
+
+    ofstream f(filename.c_str(),ios::binary);
+    if(!f.is_open()){
+        String error_message = "Error while opening file to write model. Aborting....";
+        CV_Error(Error::StsBadArg, error_message);
+    }
+    f.write((const char*)&header, sizeof(header));
+    writeFacemarkModelPadding(f, sizeof(header), header.pixels_offset);
+    for(size_t i=0;i<loaded_pixel_coordinates.size();i++){
+        CV_Assert(loaded_pixel_coordinates[i].size()==header.num_pixels);
+        f.write((const char*)&loaded_pixel_coordinates[i][0], (std::streamsize)(header.num_pixels*sizeof(Point2f)));
+    }
+    writeFacemarkModelPadding(f, header.pixels_offset+pixelsSize, header.mean_shape_offset);
+    f.write((const char*)&meanshape[0], (std::streamsize)meanShapeSize);
+    writeFacemarkModelPadding(f, header.mean_shape_offset+meanShapeSize, header.tree_offsets_offset);
+    f.write((const char*)tree_offsets, (std::streamsize)offsetsSize);
+    writeFacemarkModelPadding(f, header.tree_offsets_offset+offsetsSize, header.nodes_offset);
+    f.write((const char*)flat_nodes, (std::streamsize)nodesSize);
+    writeFacemarkModelPadding(f, header.nodes_offset+nodesSize, header.leaves_offset);
+    f.write((const char*)flat_leaves, (std::streamsize)leavesSize);
+    if(f.fail()){
+        String error_message = "Error while writing model. Aborting....";
+        CV_Error(Error::StsError, error_message);
+    }
+}
 void FacemarkKazemiImpl::training(String imageList, String groundTruth){
     imageList.clear();
     groundTruth.clear();
@@ -90,4 +90,25 @@ TEST(CV_Face_FacemarkKazemi, can_detect_landmarks) {
     shapes.clear();
 }
 
+TEST(CV_Face_FacemarkKazemi, binary_model) {
+    string imgname = cvtest::findDataFile("face/detect.jpg");
+    string modelfilename = cvtest::findDataFile("face/face_landmark_model.dat",true);
+    Mat img = imread(imgname);
+    EXPECT_TRUE(!img.empty());
+    Ptr<FacemarkKazemi> facemark = FacemarkKazemi::create();
+    EXPECT_NO_THROW(facemark->loadModel(modelfilename));
+    string binaryfilename = cv::tempfile(".bin");
+    EXPECT_NO_THROW(facemark->saveBinaryModel(binaryfilename));
+    Ptr<FacemarkKazemi> loaded = FacemarkKazemi::create();
+    EXPECT_NO_THROW(loaded->loadModel(binaryfilename));
+    vector<Rect> faces(1, Rect(img.cols/4, img.rows/4, img.cols/2, img.rows/2));
+    vector< vector<Point2f> > expected, actual;
+    EXPECT_TRUE(facemark->fit(img,faces,expected));
+    EXPECT_TRUE(loaded->fit(img,faces,actual));
+    ASSERT_EQ(expected.size(), actual.size());
+    EXPECT_EQ(0, cvtest::norm(Mat(expected[0]), Mat(actual[0]), NORM_INF));
+    loaded.release();
+    remove(binaryfilename.c_str());
+}
+
 }} // namespace
@@ -137,4 +137,44 @@ TEST(CV_Face_FacemarkLBF, test_workflow) {
     EXPECT_TRUE(facial_points[0].size()>0);
 }
 
+TEST(CV_Face_FacemarkLBF, binary_model) {
+    string i1 = cvtest::findDataFile("face/david1.jpg", true);
+    string p1 = cvtest::findDataFile("face/david1.pts", true);
+    string i2 = cvtest::findDataFile("face/david2.jpg", true);
+    string p2 = cvtest::findDataFile("face/david2.pts", true);
+    string cascade_filename =
+        cvtest::findDataFile("cascadeandhog/cascades/lbpcascade_frontalface.xml", true);
+
+    FacemarkLBF::Params params;
+    params.cascade_face = cascade_filename;
+    params.verbose = false;
+    params.save_model = false;
+    params.stages_n = 2;
+
+    Ptr<FacemarkLBF> facemark = FacemarkLBF::create(params);
+    std::vector<Point2f> landmarks;
+    EXPECT_TRUE(loadFacePoints(p1.c_str(), landmarks));
+    EXPECT_TRUE(facemark->addTrainingSample(imread(i1), landmarks));
+    EXPECT_TRUE(loadFacePoints(p2.c_str(), landmarks));
+    EXPECT_TRUE(facemark->addTrainingSample(imread(i2), landmarks));
+    EXPECT_NO_THROW(facemark->training());
+
+    string model_filename = cv::tempfile(".bin");
+    EXPECT_NO_THROW(facemark->saveBinaryModel(model_filename));
+
+    Ptr<FacemarkLBF> loaded = FacemarkLBF::create(params);
+    EXPECT_NO_THROW(loaded->loadModel(model_filename));
+
+    Mat image = imread(i1);
+    std::vector<Rect> rects(1, Rect(image.cols / 4, image.rows / 4, image.cols / 2, image.rows / 2));
+    std::vector<std::vector<Point2f> > expected, actual;
+    EXPECT_TRUE(facemark->fit(image, rects, expected));
+    EXPECT_TRUE(loaded->fit(image, rects, actual));
+    ASSERT_EQ(expected.size(), actual.size());
+    EXPECT_EQ(0, cvtest::norm(Mat(expected[0]), Mat(actual[0]), NORM_INF));
+
+    loaded.release();
+    remove(model_filename.c_str());
+}
+
 }} // namespace
@@ -0,0 +1,97 @@
+// This file is part of the OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "test_precomp.hpp"
+
+namespace opencv_test { namespace {
+
+// a few noisy variations of one random face per label
+static void makeLbphData(std::vector<Mat>& images, std::vector<int>& labels, int numLabels, int perLabel)
+{
+    RNG rng(12345);
+    for (int l = 0; l < numLabels; l++)
+    {
+        Mat base(64, 64, CV_8U);
+        rng.fill(base, RNG::UNIFORM, 0, 256);
+        for (int i = 0; i < perLabel; i++)
+        {
+            Mat noise(base.size(), CV_8S), img;
+            rng.fill(noise, RNG::UNIFORM, -20, 21);
+            add(base, noise, img, noArray(), CV_8U);
+            images.push_back(img);
+            labels.push_back(l);
+        }
+    }
+}
+
+TEST(CV_Face_LBPH, update_appends_histograms)
+{
+    std::vector<Mat> images;
+    std::vector<int> labels;
+    makeLbphData(images, labels, 6, 4);
+    const size_t half = images.size() / 2;
+
+    Ptr<face::LBPHFaceRecognizer> all = face::LBPHFaceRecognizer::create();
+    all->train(images, labels);
+
+    Ptr<face::LBPHFaceRecognizer> updated = face::LBPHFaceRecognizer::create();
+    updated->train(std::vector<Mat>(images.begin(), images.begin() + half), std::vector<int>(labels.begin(), labels.begin() + half));
+    updated->update(std::vector<Mat>(images.begin() + half, images.end()), std::vector<int>(labels.begin() + half, labels.end()));
+
+    std::vector<Mat> expected = all->getHistograms(), actual = updated->getHistograms();
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); i++)
+        EXPECT_EQ(0, cvtest::norm(expected[i], actual[i], NORM_INF)) << "sample " << i;
+    EXPECT_EQ(0, cvtest::norm(all->getLabels(), updated->getLabels(), NORM_INF));
+}
+
+TEST(CV_Face_LBPH, candidates_match_full_scan)
+{
+    std::vector<Mat> images;
+    std::vector<int> labels;
+    makeLbphData(images, labels, 20, 3);
+
+    Ptr<face::LBPHFaceRecognizer> model = face::LBPHFaceRecognizer::create();
+    model->train(images, labels);
+
+    for (size_t i = 0; i < images.size(); i += 7)
+    {
+        model->setCandidateCount(0);
+        Ptr<StandardCollector> full = StandardCollector::create();
+        model->predict(images[i], full);
+        std::vector<std::pair<int, double> > fullResults = full->getResults(true);
+        ASSERT_EQ(images.size(), fullResults.size());
+
+        const int k = 5;
+        model->setCandidateCount(k);
+        Ptr<StandardCollector> nearest = StandardCollector::create();
+        model->predict(images[i], nearest);
+        std::vector<std::pair<int, double> > nearestResults = nearest->getResults(true);
+        ASSERT_EQ((size_t)k, nearestResults.size());
+
+        EXPECT_EQ(full->getMinLabel(), nearest->getMinLabel());
+        for (int j = 0; j < k; j++)
+            EXPECT_NEAR(fullResults[j].second, nearestResults[j].second, 1e-6);
+    }
+}
+
+TEST(CV_Face_LBPH, candidate_count_is_saved)
+{
+    std::vector<Mat> images;
+    std::vector<int> labels;
+    makeLbphData(images, labels, 4, 2);
+
+    Ptr<face::LBPHFaceRecognizer> model = face::LBPHFaceRecognizer::create();
+    model->train(images, labels);
+    model->setCandidateCount(3);
+    const std::string fileName = cv::tempfile(".yml");
+    model->write(fileName);
+
+    Ptr<face::LBPHFaceRecognizer> loaded = face::LBPHFaceRecognizer::create();
+    loaded->read(fileName);
+    EXPECT_EQ(3, loaded->getCandidateCount());
+    remove(fileName.c_str());
+}
+
+}} // namespace
@@ -811,6 +811,9 @@ candidates \f$\mathcal{N}_i(\mathbf{q})\f$ is obtained. The union of sets
 \f$\mathcal{N}(\mathbf{q}) = \bigcup_i \mathcal{N}_i(\mathbf{q})\f$ is a superset of the *r*-neighbors
 of **q**. Then, last step of algorithm is computing the Hamming distance between **q** and each
 element in \f$\mathcal{N}(\mathbf{q})\f$, deleting the codes that are distant more that *r* from **q**.
+
+The queries of a batch are searched in parallel. A radius search with radius *r* only probes each
+substring up to \f$\lfloor r/m \rfloor\f$ bits away from the query's one.
 */
 class CV_EXPORTS_W BinaryDescriptorMatcher : public Algorithm
 {
@@ -901,11 +904,31 @@ void add( const std::vector<Mat>& descriptors );
 
 /** @brief Update dataset by inserting into it all descriptors that were stored locally by *add* function.
 
-@note Every time this function is invoked, current dataset is deleted and locally stored descriptors
-are inserted into dataset. The locally stored copy of just inserted descriptors is then removed.
+@note Locally stored descriptors are appended to the current dataset, whose hash tables are not
+rebuilt. The locally stored copy of just inserted descriptors is then removed.
  */
 void train();
 
+/** @brief Store the dataset into a binary file that can be memory-mapped by *loadIndex*.
+
+@param filename path of the file to write
+
+@note Descriptors stored locally by *add* function are inserted into dataset first. The file holds
+the descriptors, the multi-index hash tables in a flat layout and the image each descriptor belongs
+to. It must not be the file the dataset was loaded from, which stays mapped while in use.
+ */
+CV_WRAP void saveIndex( const String& filename );
+
+/** @brief Replace the dataset and internal data with the ones stored in a file written by *saveIndex*.
+
+@param filename path of the file to read
+
+@note The file is memory-mapped read-only, so its pages are shared by all the processes loading it
+and the hash tables are not rebuilt. Descriptors later inserted through *add* and *train* are kept in
+memory on top of it and are indexed as if they had been stored in the file.
+ */
+CV_WRAP void loadIndex( const String& filename );
+
 /** @brief Create a BinaryDescriptorMatcher object and return a smart pointer to it.
  */
 static Ptr<BinaryDescriptorMatcher> createBinaryDescriptorMatcher();
@@ -926,6 +949,9 @@ CV_WRAP BinaryDescriptorMatcher();
 }
 
 private:
+/** read-only memory holding a dataset loaded by loadIndex */
+class IndexStorage;
+
 class BucketGroup
 {
 
@@ -1083,20 +1109,32 @@ int K;
 /** Number of codes */
 UINT64 N;
 
-/** Table of original full-length codes */
-cv::Mat codes;
+/** Number of codes loaded from a file, they come before the ones in codes */
+UINT64 N_mapped;
 
-/** Counter for eliminating duplicate results (it is not thread safe) */
-Ptr<bitarray> counter;
+/** Codes loaded from a file, their hash tables in compressed row form (for every chunk, 2^b + 1
+offsets into its N_mapped entries) and the memory holding them */
+const UINT8 *mappedCodes;
+const UINT32 *mappedOffsets;
+const UINT32 *mappedEntries;
+Ptr<IndexStorage> storage;
 
-/** Array of m hashtables */
+/** Table of original full-length codes inserted in memory */
+cv::Mat codes;
+
+/** Array of m hashtables, indexing the codes inserted in memory */
 std::vector<SparseHashtable> H;
 
 /** Volume of a b-bit Hamming ball with radius s (for s = 0 to d) */
 std::vector<UINT32> xornum;
 
-/** Used within generation of binary codes at a certain Hamming distance */
-int power[100];
+/** For chunks of b and b-1 bits, all the bit-strings with up to d ones, sorted by number of ones
+(the ones with s ones start at bitstrOffsets[.][s]) */
+std::vector<UINT64> bitstrings[2];
+std::vector<UINT32> bitstrOffsets[2];
+
+/** per-thread state of a query */
+struct QueryWorkspace;
 
 /** constructor */
 Mihasher();
@@ -1110,16 +1148,37 @@ Mihasher( int B, int m );
 /** K setter */
 void setK( int K );
 
-/** populate tables */
-void populate( cv::Mat & codes, UINT32 N, int dim1codes );
+/** append codes to the dataset */
+void insert( const cv::Mat & codes );
+
+/** replace the dataset with one loaded from a file */
+void attach( const Ptr<IndexStorage>& storage, UINT64 N, const UINT8 * codes, const UINT32 * offsets, const UINT32 * entries );
+
+/** write codes and hash tables to a stream, in the layout expected by attach */
+void writeCodes( std::ostream & out ) const;
+void writeOffsets( std::ostream & out );
+void writeEntries( std::ostream & out );
 
 /** execute a batch query */
-void batchquery( UINT32 * results, UINT32 *numres/*, qstat *stats*/, const cv::Mat & q, UINT32 numq, int dim1queries );
+void batchquery( UINT32 * results, UINT32 *numres/*, qstat *stats*/, const cv::Mat & q, UINT32 numq );
+
+/** execute a batch radius query, retrieving (distance, index) pairs sorted by distance */
+void batchRadiusQuery( const cv::Mat & q, int radius, std::vector<std::vector<std::pair<int, UINT32> > > & found );
 
 private:
 
 /** execute a single query */
-void query( UINT32 * results, UINT32* numres/*, qstat *stats*/, UINT8 *q, UINT64 * chunks, UINT32 * res );
+void query( UINT32 * results, UINT32* numres/*, qstat *stats*/, const UINT8 *q, QueryWorkspace & ws );
+
+/** look up the codes whose chunk k equals key, and append the ones new to the query to the
+workspace together with their distance from it */
+int probe( int k, UINT64 key, const UINT8 *q, QueryWorkspace & ws );
+
+/** pointer to the full-length code of the given index */
+const UINT8* codeAt( UINT32 index ) const
+{
+  return index < N_mapped ? mappedCodes + (size_t) index * B_over_8 : codes.ptr( (int) ( index - N_mapped ) );
+}
 };
 
 /** retrieve Hamming distances */
@@ -180,5 +180,42 @@ PERF_TEST(radius_match, radius_match_distances_test)
 
 }
 
+PERF_TEST(knn_matching, knn_match_dataset)
+{
+  Mat query, train;
+  std::vector<std::vector<DMatch> > dm;
+  Ptr<BinaryDescriptorMatcher> bd = BinaryDescriptorMatcher::createBinaryDescriptorMatcher();
+
+  generateData( query, train );
+  bd->add( std::vector<Mat>( 1, train ) );
+  bd->train();
+
+  TEST_CYCLE()
+  {
+    dm.clear();
+    bd->knnMatch( query, dm, 2 );
+  }
+
+  SANITY_CHECK_NOTHING();
+}
+
+PERF_TEST(radius_match, radius_match_dataset)
+{
+  Mat query, train;
+  std::vector<std::vector<DMatch> > dm;
+  Ptr<BinaryDescriptorMatcher> bd = BinaryDescriptorMatcher::createBinaryDescriptorMatcher();
+
+  generateData( query, train );
+  bd->add( std::vector<Mat>( 1, train ) );
+  bd->train();
+
+  TEST_CYCLE()
+  {
+    dm.clear();
+    bd->radiusMatch( query, dm, RADIUS );
+  }
+
+  SANITY_CHECK_NOTHING();
+}
 
 }} // namespace
@@ -41,6 +41,24 @@
 
 #include "precomp.hpp"
 
+#include <fstream>
+
+#if defined _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined __unix__ || defined __APPLE__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define LINE_DESCRIPTOR_USE_MMAP 1
+#endif
+
 #define MAX_B 37
 double ARRAY_RESIZE_FACTOR = 1.1;    // minimum is 1.0
 double ARRAY_RESIZE_ADD_FACTOR = 4;  // minimum is 1
@@ -51,6 +69,212 @@ namespace cv
 namespace line_descriptor
 {
 
+/* index file layout: an IndexFileHeader followed by the image table, the codes, the offsets of
+ the hash tables' buckets and the buckets' entries, each section aligned to INDEX_ALIGNMENT */
+static const char INDEX_MAGIC[8] = { 'L', 'B', 'D', 'M', 'I', 'H', 'D', 'B' };
+static const int INDEX_VERSION = 1;
+static const size_t INDEX_ALIGNMENT = 64;
+
+struct IndexFileHeader
+{
+  char magic[8];
+  int version;
+  int endianness;  // 1 as written by the machine that saved the index
+  int B, m, b;  // bits per code, number of chunks and bits of the longest chunks
+  int numImages;
+  int numImageEntries;  // (first descriptor, image) pairs in the image table
+  int reserved;
+  uint64 N;
+  uint64 images_offset, codes_offset, offsets_offset, entries_offset, file_size;
+};
+
+static uint64 alignIndexOffset( uint64 offset )
+{
+  return ( offset + INDEX_ALIGNMENT - 1 ) & ~(uint64) ( INDEX_ALIGNMENT - 1 );
+}
+
+static void writeIndexPadding( std::ostream & out, uint64 offset )
+{
+  static const char zeros[INDEX_ALIGNMENT] = { 0 };
+  uint64 pos = (uint64) out.tellp();
+  CV_Assert( pos <= offset && offset - pos <= INDEX_ALIGNMENT );
+  out.write( zeros, (std::streamsize) ( offset - pos ) );
+}
+
+/* number of parallel stripes for a batch of queries: every stripe allocates its own workspace */
+static int getNumQueryStripes( int numq )
+{
+  return std::max( 1, std::min( numq, 4 * getNumThreads() ) );
+}
+
+/* Hamming radius of a search from the distance threshold given by the user */
+static int getHammingRadius( float maxDistance )
+{
+  if( maxDistance < 0 )
+    return -1;
+  return maxDistance >= 256.f ? 256 : cvFloor( maxDistance );
+}
+
+static bool pairDistanceLess( const std::pair<int, UINT32> & a, const std::pair<int, UINT32> & b )
+{
+  return a.first < b.first;
+}
+
+/* enumerates the bit-strings of nbits bits with s ones, in the order the original MIH search
+ generates them */
+static void appendBitstrings( int nbits, int s, std::vector<UINT64> & bitstrings )
+{
+  /* power[i] stores the location of the i'th 1 */
+  std::vector<int> power( s + 1 );
+  UINT64 bitstr = 0;
+  for ( int i = 0; i < s; i++ )
+    power[i] = i;
+  /* used for stopping criterion (location of (s+1)th 1) */
+  power[s] = nbits + 1;
+
+  /* bit determines the 1 that should be moving to the left */
+  int bit = s - 1;
+
+  /* start from the left-most 1, and move it to the left until
+   it touches another one */
+  for ( ;; )
+  {
+    if( bit != -1 )
+    {
+      bitstr ^= ( power[bit] == bit ) ? (UINT64) 1 << power[bit] : (UINT64) 3 << ( power[bit] - 1 );
+      power[bit]++;
+      bit--;
+    }
+
+    else
+    { /* bit == -1 */
+      bitstrings.push_back( bitstr );
+
+      while ( ++bit < s && power[bit] == power[bit + 1] - 1 )
+      {
+        bitstr ^= (UINT64) 1 << ( power[bit] - 1 );
+        power[bit] = bit;
+      }
+      if( bit == s )
+        break;
+    }
+  }
+}
+
+/* Read-only memory of an index file: a memory mapping of the file, or a copy of it in memory
+ on platforms without memory mapping */
+class BinaryDescriptorMatcher::IndexStorage
+{
+public:
+  IndexStorage() : data( 0 ), size( 0 )
+  {
+#if defined _WIN32
+    file = INVALID_HANDLE_VALUE;
+    mapping = NULL;
+#endif
+  }
+
+  ~IndexStorage()
+  {
+#if defined _WIN32
+    if( data )
+      UnmapViewOfFile( data );
+    if( mapping )
+      CloseHandle( mapping );
+    if( file != INVALID_HANDLE_VALUE )
+      CloseHandle( file );
+#elif defined LINE_DESCRIPTOR_USE_MMAP
+    if( data )
+      munmap( (void*) data, size );
+#endif
+  }
+
+  bool open( const String& fileName )
+  {
+#if defined _WIN32
+    file = CreateFileA( fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+    if( file == INVALID_HANDLE_VALUE )
+      return false;
+    LARGE_INTEGER fileSize;
+    if( !GetFileSizeEx( file, &fileSize ) || fileSize.QuadPart == 0 )
+      return false;
+    size = (size_t) fileSize.QuadPart;
+    mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+    if( !mapping )
+      return false;
+    data = (const uchar*) MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+    return data != NULL;
+#elif defined LINE_DESCRIPTOR_USE_MMAP
+    int fd = ::open( fileName.c_str(), O_RDONLY );
+    if( fd < 0 )
+      return false;
+    struct stat st;
+    if( fstat( fd, &st ) != 0 || st.st_size == 0 )
+    {
+      close( fd );
+      return false;
+    }
+    void* ptr = mmap( NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    close( fd );
+    if( ptr == MAP_FAILED )
+      return false;
+    data = (const uchar*) ptr;
+    size = (size_t) st.st_size;
+    return true;
+#else
+    /* read into 64-bit words, so that the 32-bit tables of the copy are aligned */
+    std::ifstream f( fileName.c_str(), std::ios::binary | std::ios::ate );
+    if( !f.is_open() || f.tellg() <= 0 )
+      return false;
+    size = (size_t) f.tellg();
+    buffer.assign( ( size + sizeof(uint64) - 1 ) / sizeof(uint64), 0 );
+    f.seekg( 0, std::ios::beg );
+    data = (const uchar*) &buffer[0];
+    return !f.read( (char*) &buffer[0], (std::streamsize) size ).fail();
+#endif
+  }
+
+  const uchar* data;
+  size_t size;
+
+private:
+#if defined _WIN32
+  HANDLE file, mapping;
+#elif !defined LINE_DESCRIPTOR_USE_MMAP
+  std::vector<uint64> buffer;
+#endif
+};
+
+/* state of the queries run by one thread */
+struct BinaryDescriptorMatcher::Mihasher::QueryWorkspace
+{
+  QueryWorkspace( const Mihasher & mh ) :
+      chunks( mh.m )
+  {
+    counter.init( mh.N );
+  }
+
+  /* forget the candidates of the last query */
+  void reset()
+  {
+    for ( size_t i = 0; i < found.size(); i++ )
+      counter.arr[found[i].second >> 5] = 0;
+    found.clear();
+  }
+
+  /* codes already retrieved by the current query */
+  bitarray counter;
+
+  /* chunks of the current query */
+  std::vector<UINT64> chunks;
+
+  /* results of a k-nearest neighbors query, K for every distance */
+  std::vector<UINT32> res;
+
+  /* codes retrieved by the current query, with their distance from it */
+  std::vector<std::pair<int, UINT32> > found;
+};
+
 /* constructor */
 BinaryDescriptorMatcher::BinaryDescriptorMatcher()
 {
@@ -85,13 +309,148 @@ void BinaryDescriptorMatcher::train()
   if( !dataset )
     dataset = Ptr<Mihasher>(new Mihasher( 256, 32 ));
 
+  /* new descriptors are appended, the ones already in dataset are not indexed again */
   if( descriptorsMat.rows > 0 )
-    dataset->populate( descriptorsMat, descriptorsMat.rows, descriptorsMat.cols );
+    dataset->insert( descriptorsMat );
 
-  descrInDS = descriptorsMat.rows;
+  descrInDS = (int) dataset->N;
   descriptorsMat.release();
 }
 
+/* store dataset into a file */
+void BinaryDescriptorMatcher::saveIndex( const String& filename )
+{
+  train();
+
+  const Mihasher& mh = *dataset;
+  const uint64 numKeys = (uint64) 1 << mh.b;
+
+  IndexFileHeader header;
+  memset( &header, 0, sizeof( header ) );
+  memcpy( header.magic, INDEX_MAGIC, sizeof( header.magic ) );
+  header.version = INDEX_VERSION;
+  header.endianness = 1;
+  header.B = mh.B;
+  header.m = mh.m;
+  header.b = mh.b;
+  header.numImages = numImages;
+  header.numImageEntries = (int) indexesMap.size();
+  header.N = mh.N;
+  header.images_offset = alignIndexOffset( sizeof( header ) );
+  header.codes_offset = alignIndexOffset( header.images_offset + indexesMap.size() * 2 * sizeof(int) );
+  header.offsets_offset = alignIndexOffset( header.codes_offset + mh.N * mh.B_over_8 );
+  header.entries_offset = alignIndexOffset( header.offsets_offset + (uint64) mh.m * ( numKeys + 1 ) * sizeof(UINT32) );
+  header.file_size = header.entries_offset + (uint64) mh.m * mh.N * sizeof(UINT32);
+
+  std::ofstream f( filename.c_str(), std::ios::binary );
+  if( !f.is_open() )
+    CV_Error( Error::StsError, "Cannot open the index file for writing: " + filename );
+
+  f.write( (const char*) &header, sizeof( header ) );
+
+  writeIndexPadding( f, header.images_offset );
+  for ( std::map<int, int>::const_iterator it = indexesMap.begin(); it != indexesMap.end(); ++it )
+  {
+    const int entry[2] = { it->first, it->second };
+    f.write( (const char*) entry, sizeof( entry ) );
+  }
+
+  writeIndexPadding( f, header.codes_offset );
+  dataset->writeCodes( f );
+  writeIndexPadding( f, header.offsets_offset );
+  dataset->writeOffsets( f );
+  writeIndexPadding( f, header.entries_offset );
+  dataset->writeEntries( f );
+
+  if( f.fail() )
+    CV_Error( Error::StsError, "Cannot write the index file: " + filename );
+}
+
+/* the search indexes the codes, its counters and the image table with the values stored in the
+ file without checks, so they are all validated once when the file is loaded: for every chunk,
+ the bucket offsets must be non-decreasing and end at N, and every entry must be a code; the
+ image table must start at the first code and be sorted, with valid image indices */
+static bool checkIndexTables( const IndexFileHeader & header, const int* images, const UINT32* offsets, const UINT32* entries, int m,
+                              uint64 numKeys )
+{
+  for ( int i = 0; i < header.numImageEntries; i++ )
+  {
+    const int first = images[2 * i], image = images[2 * i + 1];
+    if( first < 0 || (uint64) first > header.N || image < 0 || image >= header.numImages )
+      return false;
+    if( ( i == 0 && first != 0 ) || ( i > 0 && first <= images[2 * ( i - 1 )] ) )
+      return false;
+  }
+  if( header.N > 0 && header.numImageEntries == 0 )
+    return false;
+
+  for ( int k = 0; k < m; k++ )
+  {
+    const UINT32* chunkOffsets = offsets + (size_t) k * ( numKeys + 1 );
+    if( chunkOffsets[0] != 0 || chunkOffsets[numKeys] != header.N )
+      return false;
+    for ( uint64 key = 0; key < numKeys; key++ )
+      if( chunkOffsets[key] > chunkOffsets[key + 1] )
+        return false;
+  }
+
+  const uint64 numEntries = (uint64) m * header.N;
+  for ( uint64 e = 0; e < numEntries; e++ )
+    if( entries[e] >= header.N )
+      return false;
+
+  return true;
+}
+
+/* load dataset from a file */
+void BinaryDescriptorMatcher::loadIndex( const String& filename )
+{
+  Ptr<IndexStorage> storage = makePtr<IndexStorage>();
+  if( !storage->open( filename ) )
+    CV_Error( Error::StsError, "Cannot open the index file: " + filename );
+
+  IndexFileHeader header;
+  if( storage->size < sizeof( header ) )
+    CV_Error( Error::StsParseError, "Invalid index file: " + filename );
+  memcpy( &header, storage->data, sizeof( header ) );
+
+  Ptr<Mihasher> mh = Ptr<Mihasher>(new Mihasher( 256, 32 ));
+  const uint64 numKeys = (uint64) 1 << mh->b;
+
+  bool valid = memcmp( header.magic, INDEX_MAGIC, sizeof( header.magic ) ) == 0 && header.version == INDEX_VERSION && header.endianness == 1
+      && header.B == mh->B && header.m == mh->m && header.b == mh->b && header.numImages >= 0 && header.numImageEntries >= 0
+      && header.numImageEntries <= header.numImages && header.N <= (uint64) INT_MAX && header.file_size == (uint64) storage->size
+      && header.images_offset >= sizeof( header );
+
+  /* every section must be aligned, follow the previous one and hold its array; sizes are compared
+   with the distances between offsets, so that a corrupt header cannot make them wrap around */
+  const uint64 sections[] = { header.images_offset, header.codes_offset, header.offsets_offset, header.entries_offset, header.file_size };
+  const uint64 sectionSizes[] = { (uint64) header.numImageEntries * 2 * sizeof(int), header.N * mh->B_over_8,
+      (uint64) mh->m * ( numKeys + 1 ) * sizeof(UINT32), (uint64) mh->m * header.N * sizeof(UINT32) };
+  for ( int i = 0; valid && i < 4; i++ )
+    valid = sections[i] % INDEX_ALIGNMENT == 0 && sections[i] <= sections[i + 1] && sectionSizes[i] <= sections[i + 1] - sections[i];
+
+  valid = valid && checkIndexTables( header, (const int*) ( storage->data + header.images_offset ),
+                                     (const UINT32*) ( storage->data + header.offsets_offset ),
+                                     (const UINT32*) ( storage->data + header.entries_offset ), mh->m, numKeys );
+  if( !valid )
+    CV_Error( Error::StsParseError, "Invalid or incompatible index file: " + filename );
+
+  mh->attach( storage, header.N, storage->data + header.codes_offset, (const UINT32*) ( storage->data + header.offsets_offset ),
+              (const UINT32*) ( storage->data + header.entries_offset ) );
+
+  clear();
+
+  const int* entries = (const int*) ( storage->data + header.images_offset );
+  for ( int i = 0; i < header.numImageEntries; i++ )
+    indexesMap.insert( std::pair<int, int>( entries[2 * i], entries[2 * i + 1] ) );
+
+  dataset = mh;
+  numImages = header.numImages;
+  nextAddedIndex = (int) header.N;
+  descrInDS = (int) header.N;
+}
+
 /* clear dataset and internal data */
 void BinaryDescriptorMatcher::clear()
 {
@@ -152,7 +511,7 @@ void BinaryDescriptorMatcher::match( const Mat& queryDescriptors, std::vector<DM
   UINT32 * numres = new UINT32[ ( 256 + 1 ) * ( queryDescriptors.rows )];
 
   /* execute query */
-  dataset->batchquery( results, numres, queryDescriptors, queryDescriptors.rows, queryDescriptors.cols );
+  dataset->batchquery( results, numres, queryDescriptors, queryDescriptors.rows );
   /* compose matches */
   for ( int counter = 0; counter < queryDescriptors.rows; counter++ )
   {
@@ -215,8 +574,7 @@ void BinaryDescriptorMatcher::match( const Mat& queryDescriptors, const Mat& tra
   Mihasher *mh = new Mihasher( 256, 32 );
 
   /* populate mihasher */
-  cv::Mat copy = trainDescriptors.clone();
-  mh->populate( copy, copy.rows, copy.cols );
+  mh->insert( trainDescriptors );
   mh->setK( 1 );
 
   /* prepare structures for query */
@@ -224,7 +582,7 @@ void BinaryDescriptorMatcher::match( const Mat& queryDescriptors, const Mat& tra
   UINT32 * numres = new UINT32[ ( 256 + 1 ) * ( queryDescriptors.rows )];
 
   /* execute query */
-  mh->batchquery( results, numres, queryDescriptors, queryDescriptors.rows, queryDescriptors.cols );
+  mh->batchquery( results, numres, queryDescriptors, queryDescriptors.rows );
 
   /* compose matches */
   for ( int counter = 0; counter < queryDescriptors.rows; counter++ )
@@ -277,8 +635,7 @@ void BinaryDescriptorMatcher::knnMatch( const Mat& queryDescriptors, const Mat&
   Mihasher *mh = new Mihasher( 256, 32 );
 
   /* populate mihasher */
-  cv::Mat copy = trainDescriptors.clone();
-  mh->populate( copy, copy.rows, copy.cols );
+  mh->insert( trainDescriptors );
 
   /* set K */
   mh->setK( k );
@@ -288,7 +645,7 @@ void BinaryDescriptorMatcher::knnMatch( const Mat& queryDescriptors, const Mat&
   UINT32 * numres = new UINT32[ ( 256 + 1 ) * ( queryDescriptors.rows )];
 
   /* execute query */
-  mh->batchquery( results, numres, queryDescriptors, queryDescriptors.rows, queryDescriptors.cols );
+  mh->batchquery( results, numres, queryDescriptors, queryDescriptors.rows );
 
   /* compose matches */
   int index = 0;
@@ -366,7 +723,7 @@ void BinaryDescriptorMatcher::knnMatch( const Mat& queryDescriptors, std::vector
   UINT32 * numres = new UINT32[ ( 256 + 1 ) * ( queryDescriptors.rows )];
 
   /* execute query */
-  dataset->batchquery( results, numres, queryDescriptors, queryDescriptors.rows, queryDescriptors.cols );
+  dataset->batchquery( results, numres, queryDescriptors, queryDescriptors.rows );
 
   /* compose matches */
   int index = 0;
@@ -448,59 +805,37 @@ void BinaryDescriptorMatcher::radiusMatch( const Mat& queryDescriptors, const Ma
   Mihasher* mh = new Mihasher( 256, 32 );
 
   /* populate Mihasher */
-  //Mat copy = queryDescriptors.clone();
-  Mat copy = trainDescriptors.clone();
-  mh->populate( copy, copy.rows, copy.cols );
-
-  /* set K */
-  mh->setK( trainDescriptors.rows );
-
-  /* prepare structures for query */
-  UINT32 *results = new UINT32[trainDescriptors.rows * queryDescriptors.rows];
-  UINT32 * numres = new UINT32[ ( 256 + 1 ) * ( queryDescriptors.rows )];
+  mh->insert( trainDescriptors );
 
   /* execute query */
-  mh->batchquery( results, numres, queryDescriptors, queryDescriptors.rows, queryDescriptors.cols );
+  std::vector<std::vector<std::pair<int, UINT32> > > found;
+  mh->batchRadiusQuery( queryDescriptors, getHammingRadius( maxDistance ), found );
 
   /* compose matches */
-  int index = 0;
   for ( int i = 0; i < queryDescriptors.rows; i++ )
   {
-    std::vector<int> k_distances;
-    checkKDistances( numres, trainDescriptors.rows, k_distances, i, 256 );
-
     std::vector < DMatch > tempVector;
-    for ( int j = index; j < index + trainDescriptors.rows; j++ )
+    if( mask.empty() || mask.at < uchar > ( i ) != 0 )
     {
-//      if( numres[j] <= maxDistance )
-      if( k_distances[j - index] <= maxDistance )
+      for ( size_t j = 0; j < found[i].size(); j++ )
       {
-        if( mask.empty() || mask.at < uchar > ( i ) != 0 )
-        {
-          DMatch dm;
-          dm.queryIdx = i;
-          dm.trainIdx = (int) ( results[j] - 1 );
-          dm.imgIdx = 0;
-          dm.distance = (float) k_distances[j - index];
+        DMatch dm;
+        dm.queryIdx = i;
+        dm.trainIdx = (int) found[i][j].second;
+        dm.imgIdx = 0;
+        dm.distance = (float) found[i][j].first;
 
-          tempVector.push_back( dm );
-        }
+        tempVector.push_back( dm );
       }
     }
 
     /* decide whether temporary vector should be saved */
     if( ( tempVector.size() == 0 && !compactResult ) || tempVector.size() > 0 )
       matches.push_back( tempVector );
-
-    /* increment pointer */
-    index += trainDescriptors.rows;
-
   }
 
   /* delete data */
   delete mh;
-  delete[] results;
-  delete[] numres;
 }
 
 /* for every input descriptor, find all the ones falling in a
@@ -527,110 +862,150 @@ void BinaryDescriptorMatcher::radiusMatch( const Mat& queryDescriptors, std::vec
   /* populate dataset */
   train();
 
-  /* set K */
-  dataset->setK( descrInDS );
-
-  /* prepare structures for query */
-  UINT32 *results = new UINT32[descrInDS * queryDescriptors.rows];
-  UINT32 * numres = new UINT32[ ( 256 + 1 ) * ( queryDescriptors.rows )];
-
   /* execute query */
-  dataset->batchquery( results, numres, queryDescriptors, queryDescriptors.rows, queryDescriptors.cols );
+  std::vector<std::vector<std::pair<int, UINT32> > > found;
+  dataset->batchRadiusQuery( queryDescriptors, getHammingRadius( maxDistance ), found );
 
   /* compose matches */
-  int index = 0;
   for ( int counter = 0; counter < queryDescriptors.rows; counter++ )
   {
     std::vector < DMatch > tempVector;
-    for ( int j = index; j < index + descrInDS; j++ )
+    for ( size_t j = 0; j < found[counter].size(); j++ )
     {
-      std::vector<int> k_distances;
-      checkKDistances( numres, descrInDS, k_distances, counter, 256 );
+      int currentIndex = (int) found[counter][j].second;
+      std::map<int, int>::iterator itup;
+      itup = indexesMap.upper_bound( currentIndex );
+      itup--;
 
-      if( k_distances[j - index] <= maxDistance )
+      /* data validity check */
+      if( !masks.empty() && ( masks[itup->second].rows != queryDescriptors.rows || masks[itup->second].cols != 1 ) )
       {
-        int currentIndex = results[j] - 1;
-        std::map<int, int>::iterator itup;
-        itup = indexesMap.upper_bound( currentIndex );
-        itup--;
-
-        /* data validity check */
-        if( !masks.empty() && ( masks[itup->second].rows != queryDescriptors.rows || masks[itup->second].cols != 1 ) )
-        {
-          std::cout << "Error: mask " << itup->second << " in radiusMatch function " << "should have " << queryDescriptors.rows << " and "
-              << "1 column. Program will be terminated" << std::endl;
+        std::cout << "Error: mask " << itup->second << " in radiusMatch function " << "should have " << queryDescriptors.rows << " and "
+            << "1 column. Program will be terminated" << std::endl;
 
-          return;
-        }
+        return;
+      }
 
-        /* add match if necessary */
-        else if( masks.empty() || masks[itup->second].at < uchar > ( counter ) != 0 )
-        {
+      /* add match if necessary */
+      else if( masks.empty() || masks[itup->second].at < uchar > ( counter ) != 0 )
+      {
 
-          DMatch dm;
-          dm.queryIdx = counter;
-          dm.trainIdx = results[j] - 1;
-          dm.imgIdx = itup->second;
-          dm.distance = (float) k_distances[j - index];
+        DMatch dm;
+        dm.queryIdx = counter;
+        dm.trainIdx = currentIndex;
+        dm.imgIdx = itup->second;
+        dm.distance = (float) found[counter][j].first;
 
-          tempVector.push_back( dm );
-        }
+        tempVector.push_back( dm );
       }
     }
 
     /* decide whether temporary vector should be saved */
     if( ( tempVector.size() == 0 && !compactResult ) || tempVector.size() > 0 )
       matches.push_back( tempVector );
-
-    /* increment pointer */
-    index += descrInDS;
   }
-
-  /* delete data */
-  delete[] results;
-  delete[] numres;
-
 }
 
 /* execute a batch query */
-void BinaryDescriptorMatcher::Mihasher::batchquery( UINT32 * results, UINT32 *numres, const cv::Mat & queries, UINT32 numq, int dim1queries )
+void BinaryDescriptorMatcher::Mihasher::batchquery( UINT32 * results, UINT32 *numres, const cv::Mat & queries, UINT32 numq )
 {
-  /* create and initialize a bitarray */
-  counter = makePtr<bitarray>();
-  counter->init( N );
+  CV_Assert( queries.type() == CV_8UC1 && queries.cols == B_over_8 );
+
+  /* queries are independent, each thread uses its own workspace */
+  parallel_for_( Range( 0, (int) numq ), [&]( const Range& range )
+  {
+    QueryWorkspace ws( *this );
+    ws.res.resize( (size_t) K * ( D + 1 ) );
 
-  UINT32 *res = new UINT32[K * ( D + 1 )];
-  UINT64 *chunks = new UINT64[m];
-  UINT32 * presults = results;
-  UINT32 *pnumres = numres;
+    for ( int i = range.start; i < range.end; i++ )
+      query( results + (size_t) i * K, numres + (size_t) i * ( B + 1 ), queries.ptr( i ), ws );
+  }, getNumQueryStripes( (int) numq ) );
+}
+
+/* execute a batch radius query */
+void BinaryDescriptorMatcher::Mihasher::batchRadiusQuery( const cv::Mat & queries, int radius, std::vector<std::vector<std::pair<int, UINT32> > > & found )
+{
+  CV_Assert( queries.type() == CV_8UC1 && queries.cols == B_over_8 );
 
-  /* make a copy of input queries */
-  cv::Mat queries_clone = queries.clone();
+  found.assign( queries.rows, std::vector<std::pair<int, UINT32> >() );
+  if( radius < 0 || N == 0 )
+    return;
 
-  /* set a pointer to first query (row) */
-  UINT8 *pq = queries_clone.ptr();
+  /* a code within the radius differs from the query by at most radius / m bits in one of its
+   chunks at least, so larger substring radii cannot find anything new */
+  const int maxs = std::min( radius / m, d );
 
-  /* loop over number of descriptors */
-  for ( size_t i = 0; i < numq; i++ )
+  parallel_for_( Range( 0, queries.rows ), [&]( const Range& range )
   {
-    /* for every descriptor, query database */
-    query( presults, pnumres, pq, chunks, res );
+    QueryWorkspace ws( *this );
+
+    for ( int i = range.start; i < range.end; i++ )
+    {
+      const UINT8 *q = queries.ptr( i );
+      split( &ws.chunks[0], q, m, mplus, b );
+
+      for ( int s = 0; s <= maxs; s++ )
+      {
+        for ( int k = 0; k < m; k++ )
+        {
+          const int w = k < mplus ? 0 : 1;
+          for ( UINT32 j = bitstrOffsets[w][s]; j < bitstrOffsets[w][s + 1]; j++ )
+            probe( k, ws.chunks[k] ^ bitstrings[w][j], q, ws );
+        }
+      }
+
+      /* keep the codes within the radius, sorted by distance and then in retrieval order */
+      std::vector<std::pair<int, UINT32> > & out = found[i];
+      for ( size_t c = 0; c < ws.found.size(); c++ )
+      {
+        if( ws.found[c].first <= radius )
+          out.push_back( ws.found[c] );
+      }
+      std::stable_sort( out.begin(), out.end(), pairDistanceLess );
+
+      ws.reset();
+    }
+  }, getNumQueryStripes( queries.rows ) );
+}
 
-    /* move pointer to write next K indeces */
-    presults += K;
-    pnumres += B + 1;
+/* look up a key in a hashtable */
+int BinaryDescriptorMatcher::Mihasher::probe( int k, UINT64 key, const UINT8 * Query, QueryWorkspace & ws )
+{
+  const size_t first = ws.found.size();
 
-    /* move forward pointer to current row in descriptors matrix */
-    pq += dim1queries;
+  /* codes loaded from a file come first, then the ones inserted in memory */
+  for ( int part = 0; part < 2; part++ )
+  {
+    const UINT32 *arr;
+    int size = 0;
+    if( part == 0 )
+    {
+      if( N_mapped == 0 )
+        continue;
+      const UINT32 *offsets = mappedOffsets + (size_t) k * ( ( (size_t) 1 << b ) + 1 );
+      arr = mappedEntries + (size_t) k * N_mapped + offsets[key];
+      size = (int) ( offsets[key + 1] - offsets[key] );
+    }
+    else
+      arr = H[k].query( key, &size );
 
+    for ( int c = 0; c < size; c++ )
+    {
+      UINT32 index = arr[c];
+      if( !ws.counter.get( index ) )
+      { /* if it is not a duplicate */
+        ws.counter.set( index );
+        int hammd = cv::line_descriptor::match( codeAt( index ), Query, B_over_8 );
+        ws.found.push_back( std::make_pair( hammd, index ) );
+      }
+    }
   }
 
-  delete[] res;
-  delete[] chunks;
+  return (int) ( ws.found.size() - first );
 }
 
 /* execute a single query */
-void BinaryDescriptorMatcher::Mihasher::query( UINT32* results, UINT32* numres, UINT8 * Query, UINT64 *chunks, UINT32 *res )
+void BinaryDescriptorMatcher::Mihasher::query( UINT32* results, UINT32* numres, const UINT8 * Query, QueryWorkspace & ws )
 {
   /* if K == 0 that means we want everything to be processed.
    So maxres = N in that case. Otherwise K limits the results processed */
@@ -639,103 +1014,41 @@ void BinaryDescriptorMatcher::Mihasher::query( UINT32* results, UINT32* numres,
   /* number of results so far obtained (up to a distance of s per chunk) */
   UINT32 n = 0;
 
-  /* number of candidates tested with full codes (not counting duplicates) */
-  UINT32 nc = 0;
-
-  /* counting everything retrieved (duplicates are counted multiple times)
-   number of lookups (and xors) */
-  UINT32 nl = 0;
-
-  UINT32 nd = 0;
-  UINT32 *arr;
-  int size = 0;
-  UINT32 index;
-  int hammd;
+  UINT32 *res = &ws.res[0];
 
-  counter->erase();
   memset( numres, 0, ( B + 1 ) * sizeof ( *numres ) );
 
-  split( chunks, Query, m, mplus, b );
+  split( &ws.chunks[0], Query, m, mplus, b );
 
   /* the growing search radius per substring */
   int s;
 
-  /* current b: for the first mplus substrings it is b, for the rest it is (b-1) */
-  int curb = b;
-
   for ( s = 0; s <= d && n < maxres; s++ )
   {
     for ( int k = 0; k < m; k++ )
     {
-      if( k < mplus )
-        curb = b;
-      else
-        curb = b - 1;
-      UINT64 chunksk = chunks[k];
-      /* number of bit-strings with s number of 1s */
-      nl += xornum[s + 1] - xornum[s];
-
-      /* the bit-string with s number of 1s */
-      UINT64 bitstr = 0;
-      for ( int i = 0; i < s; i++ )
-        /* power[i] stores the location of the i'th 1 */
-        power[i] = i;
-      /* used for stopping criterion (location of (s+1)th 1) */
-      power[s] = curb + 1;
-
-      /* bit determines the 1 that should be moving to the left */
-      int bit = s - 1;
-
-      /* start from the left-most 1, and move it to the left until
-       it touches another one */
-
-      /* the loop for changing bitstr */
-      bool infiniteWhile = true;
-      while ( infiniteWhile )
+      /* bit-strings with s number of 1s, for the first mplus substrings of b bits
+       and for the rest of (b-1) bits */
+      const int w = k < mplus ? 0 : 1;
+      const UINT64 chunksk = ws.chunks[k];
+
+      for ( UINT32 j = bitstrOffsets[w][s]; j < bitstrOffsets[w][s + 1]; j++ )
       {
-        if( bit != -1 )
+        size_t first = ws.found.size();
+        probe( k, chunksk ^ bitstrings[w][j], Query, ws );
+
+        for ( size_t c = first; c < ws.found.size(); c++ )
         {
-          bitstr ^= ( power[bit] == bit ) ? (UINT64) 1 << power[bit] : (UINT64) 3 << ( power[bit] - 1 );
-          power[bit]++;
-          bit--;
-        }
+          int hammd = ws.found[c].first;
+          if( hammd <= D && numres[hammd] < maxres )
+            res[hammd * K + numres[hammd]] = ws.found[c].second + 1;
 
-        else
-        { /* bit == -1 */
-          /* the binary code bitstr is available for processing */
-          arr = H[k].query( chunksk ^ bitstr, &size );  // lookup
-          if( size )
-          { /* the corresponding bucket is not empty */
-            nd += size;
-            for ( int c = 0; c < size; c++ )
-            {
-              index = arr[c];
-              if( !counter->get( index ) )
-              { /* if it is not a duplicate */
-                counter->set( index );
-                hammd = cv::line_descriptor::match( codes.ptr() + (UINT64) index * ( B_over_8 ), Query, B_over_8 );
-
-                nc++;
-                if( hammd <= D && numres[hammd] < maxres )
-                  res[hammd * K + numres[hammd]] = index + 1;
-
-                numres[hammd]++;
-              }
-            }
-          }
-
-          /* end of processing */
-          while ( ++bit < s && power[bit] == power[bit + 1] - 1 )
-          {
-            bitstr ^= (UINT64) 1 << ( power[bit] - 1 );
-            power[bit] = bit;
-          }
-          if( bit == s )
-            break;
+          numres[hammd]++;
         }
       }
 
-      n = n + numres[s * m + k];
+      if( s * m + k <= B )
+        n = n + numres[s * m + k];
       if( n >= maxres )
         break;
     }
@@ -748,6 +1061,7 @@ void BinaryDescriptorMatcher::Mihasher::query( UINT32* results, UINT32* numres,
       results[n++] = res[s * K + c];
   }
 
+  ws.reset();
 }
 
 /* constructor 2 */
@@ -757,6 +1071,12 @@ BinaryDescriptorMatcher::Mihasher::Mihasher( int B_val, int _m )
   B_over_8 = B / 8;
   m = _m;
   b = (int) ceil( (double) B / m );
+  K = 0;
+  N = 0;
+  N_mapped = 0;
+  mappedCodes = NULL;
+  mappedOffsets = NULL;
+  mappedEntries = NULL;
 
   /* set radius to search for nearest neighbors to size of descriptor */
   D = (int) ceil( B );
@@ -771,6 +1091,19 @@ BinaryDescriptorMatcher::Mihasher::Mihasher( int B_val, int _m )
   for ( int i = 0; i <= d; i++ )
     xornum[i + 1] = xornum[i] + (UINT32) choose( b, i );
 
+  /* bit-strings probed around every chunk, generated once */
+  for ( int w = 0; w < 2; w++ )
+  {
+    bitstrOffsets[w].resize( d + 2 );
+    for ( int s = 0; s <= d; s++ )
+    {
+      bitstrOffsets[w][s] = (UINT32) bitstrings[w].size();
+      if( s <= b - w )
+        appendBitstrings( b - w, s, bitstrings[w] );
+    }
+    bitstrOffsets[w][d + 1] = (UINT32) bitstrings[w].size();
+  }
+
   H.resize(m);
 
   /* H[i].init might fail */
@@ -791,26 +1124,107 @@ BinaryDescriptorMatcher::Mihasher::~Mihasher()
 {
 }
 
-/* populate tables */
-void BinaryDescriptorMatcher::Mihasher::populate( cv::Mat & _codes, UINT32 N_val, int dim1codes )
+/* append codes to tables */
+void BinaryDescriptorMatcher::Mihasher::insert( const cv::Mat & _codes )
 {
-  N = N_val;
-  codes = _codes;
-  UINT64 * chunks = new UINT64[m];
+  if( _codes.empty() )
+    return;
+
+  CV_Assert( _codes.type() == CV_8UC1 && _codes.cols == B_over_8 );
+  CV_Assert( N + _codes.rows <= (UINT64) INT_MAX );
+
+  int first = codes.rows;
+  codes.push_back( _codes );
 
-  UINT8 * pcodes = codes.ptr();
-  for ( UINT64 i = 0; i < N; i++, pcodes += dim1codes )
+  std::vector<UINT64> chunks( m );
+  for ( int i = first; i < codes.rows; i++ )
   {
-    split( chunks, pcodes, m, mplus, b );
+    split( &chunks[0], codes.ptr( i ), m, mplus, b );
 
     for ( int k = 0; k < m; k++ )
-      H[k].insert( chunks[k], (UINT32) i );
+      H[k].insert( chunks[k], (UINT32) ( N_mapped + i ) );
+  }
+
+  N = N_mapped + codes.rows;
+}
+
+/* use codes and tables stored in a file */
+void BinaryDescriptorMatcher::Mihasher::attach( const Ptr<IndexStorage>& _storage, UINT64 N_val, const UINT8 * _codes, const UINT32 * offsets,
+                                                const UINT32 * entries )
+{
+  CV_Assert( N == 0 );
+
+  storage = _storage;
+  N = N_mapped = N_val;
+  mappedCodes = _codes;
+  mappedOffsets = offsets;
+  mappedEntries = entries;
+}
+
+/* write all the codes */
+void BinaryDescriptorMatcher::Mihasher::writeCodes( std::ostream & out ) const
+{
+  if( N_mapped > 0 )
+    out.write( (const char*) mappedCodes, (std::streamsize) ( N_mapped * B_over_8 ) );
+  for ( int i = 0; i < codes.rows; i++ )
+    out.write( (const char*) codes.ptr( i ), B_over_8 );
+}
+
+/* write, for every chunk, the offsets of its buckets in its entries */
+void BinaryDescriptorMatcher::Mihasher::writeOffsets( std::ostream & out )
+{
+  const size_t numKeys = (size_t) 1 << b;
+  std::vector<UINT32> offsets( numKeys + 1 );
 
-    if( i % (int) ceil( N / 1000.0 ) == 0 )
-      fflush (stdout);
+  for ( int k = 0; k < m; k++ )
+  {
+    const size_t curKeys = (size_t) 1 << ( k < mplus ? b : b - 1 );
+    const UINT32 *mapped = N_mapped > 0 ? mappedOffsets + k * ( numKeys + 1 ) : NULL;
+    UINT32 total = 0;
+    for ( size_t key = 0; key < numKeys; key++ )
+    {
+      offsets[key] = total;
+      if( key < curKeys )
+      {
+        int size = 0;
+        H[k].query( key, &size );
+        total += (UINT32) size;
+        if( N_mapped > 0 )
+          total += mapped[key + 1] - mapped[key];
+      }
+    }
+    offsets[numKeys] = total;
+    out.write( (const char*) &offsets[0], (std::streamsize) ( offsets.size() * sizeof(UINT32) ) );
   }
+}
 
-  delete[] chunks;
+/* write, for every chunk, the codes of its buckets */
+void BinaryDescriptorMatcher::Mihasher::writeEntries( std::ostream & out )
+{
+  const size_t numKeys = (size_t) 1 << b;
+  std::vector<UINT32> entries;
+  entries.reserve( (size_t) N );
+
+  for ( int k = 0; k < m; k++ )
+  {
+    const size_t curKeys = (size_t) 1 << ( k < mplus ? b : b - 1 );
+    const UINT32 *mapped = N_mapped > 0 ? mappedOffsets + k * ( numKeys + 1 ) : NULL;
+    entries.clear();
+    for ( size_t key = 0; key < curKeys; key++ )
+    {
+      /* same order as probe: codes loaded from a file first */
+      if( N_mapped > 0 )
+        entries.insert( entries.end(), mappedEntries + k * N_mapped + mapped[key], mappedEntries + k * N_mapped + mapped[key + 1] );
+
+      int size = 0;
+      UINT32 *arr = H[k].query( key, &size );
+      if( size > 0 )
+        entries.insert( entries.end(), arr, arr + size );
+    }
+    CV_Assert( entries.size() == N );
+    if( N > 0 )
+      out.write( (const char*) &entries[0], (std::streamsize) ( entries.size() * sizeof(UINT32) ) );
+  }
 }
 
 /* constructor */
@@ -40,6 +40,8 @@
  //M*/
 
 #include "test_precomp.hpp"
+#include <fstream>
+#include <iterator>
 
 namespace opencv_test { namespace {
 
@@ -577,4 +579,126 @@ TEST( BinaryDescriptor_Matcher, regression)
   test.safe_run();
 }
 
+static void expectEqualMatches( const std::vector<std::vector<DMatch> >& expected, const std::vector<std::vector<DMatch> >& actual )
+{
+  ASSERT_EQ( expected.size(), actual.size() );
+  for ( size_t i = 0; i < expected.size(); i++ )
+  {
+    ASSERT_EQ( expected[i].size(), actual[i].size() ) << "query " << i;
+    for ( size_t j = 0; j < expected[i].size(); j++ )
+    {
+      EXPECT_EQ( expected[i][j].queryIdx, actual[i][j].queryIdx );
+      EXPECT_EQ( expected[i][j].trainIdx, actual[i][j].trainIdx );
+      EXPECT_EQ( expected[i][j].imgIdx, actual[i][j].imgIdx );
+      EXPECT_EQ( expected[i][j].distance, actual[i][j].distance );
+    }
+  }
+}
+
+TEST( BinaryDescriptor_Matcher, saved_index_with_incremental_inserts )
+{
+  RNG rng( 42 );
+  Mat train( 2000, 32, CV_8UC1 ), query( 200, 32, CV_8UC1 );
+  rng.fill( train, RNG::UNIFORM, Scalar( 0 ), Scalar( 256 ) );
+
+  /* queries are train descriptors with a few flipped bits */
+  for ( int i = 0; i < query.rows; i++ )
+  {
+    train.row( i * 10 ).copyTo( query.row( i ) );
+    for ( int j = 0; j < i % 12; j++ )
+      query.at<uchar>( i, rng.uniform( 0, 32 ) ) ^= (uchar) ( 1 << rng.uniform( 0, 8 ) );
+  }
+
+  std::vector<Mat> firstImages, secondImages;
+  firstImages.push_back( train.rowRange( 0, 700 ) );
+  firstImages.push_back( train.rowRange( 700, 1200 ) );
+  secondImages.push_back( train.rowRange( 1200, 2000 ) );
+
+  Ptr<BinaryDescriptorMatcher> reference = BinaryDescriptorMatcher::createBinaryDescriptorMatcher();
+  reference->add( firstImages );
+  reference->add( secondImages );
+  std::vector<std::vector<DMatch> > knnExpected, radiusExpected;
+  reference->knnMatch( query, knnExpected, 5 );
+  reference->radiusMatch( query, radiusExpected, 40.f );
+
+  const std::string filename = cv::tempfile( ".bin" );
+  {
+    Ptr<BinaryDescriptorMatcher> saved = BinaryDescriptorMatcher::createBinaryDescriptorMatcher();
+    saved->add( firstImages );
+    saved->saveIndex( filename );
+  }
+
+  Ptr<BinaryDescriptorMatcher> loaded = BinaryDescriptorMatcher::createBinaryDescriptorMatcher();
+  loaded->loadIndex( filename );
+  loaded->add( secondImages );
+
+  std::vector<std::vector<DMatch> > knnMatches, radiusMatches;
+  loaded->knnMatch( query, knnMatches, 5 );
+  loaded->radiusMatch( query, radiusMatches, 40.f );
+  expectEqualMatches( knnExpected, knnMatches );
+  expectEqualMatches( radiusExpected, radiusMatches );
+
+  /* a file saved from a partly loaded dataset holds all of it */
+  const std::string mergedFilename = cv::tempfile( ".bin" );
+  loaded->saveIndex( mergedFilename );
+  loaded.release();
+  Ptr<BinaryDescriptorMatcher> reloaded = BinaryDescriptorMatcher::createBinaryDescriptorMatcher();
+  reloaded->loadIndex( mergedFilename );
+  knnMatches.clear();
+  reloaded->knnMatch( query, knnMatches, 5 );
+  expectEqualMatches( knnExpected, knnMatches );
+  reloaded.release();
+
+  remove( filename.c_str() );
+  remove( mergedFilename.c_str() );
+}
+
+TEST( BinaryDescriptor_Matcher, corrupt_index )
+{
+  RNG rng( 7 );
+  Mat train( 500, 32, CV_8UC1 );
+  rng.fill( train, RNG::UNIFORM, Scalar( 0 ), Scalar( 256 ) );
+  std::vector<Mat> images( 1, train );
+
+  const std::string filename = cv::tempfile( ".bin" );
+  {
+    Ptr<BinaryDescriptorMatcher> saved = BinaryDescriptorMatcher::createBinaryDescriptorMatcher();
+    saved->add( images );
+    saved->saveIndex( filename );
+  }
+
+  std::vector<char> content;
+  {
+    std::ifstream f( filename.c_str(), std::ios::binary );
+    ASSERT_TRUE( f.is_open() );
+    content.assign( std::istreambuf_iterator<char>( f ), std::istreambuf_iterator<char>() );
+  }
+  ASSERT_GT( content.size(), 64u );
+
+  /* the hash table entries are at the end of the file: point the last ones past the codes */
+  std::vector<char> corrupt( content );
+  memset( &corrupt[corrupt.size() - 64], 0xff, 64 );
+  {
+    std::ofstream f( filename.c_str(), std::ios::binary );
+    f.write( &corrupt[0], (std::streamsize) corrupt.size() );
+  }
+  Ptr<BinaryDescriptorMatcher> loaded = BinaryDescriptorMatcher::createBinaryDescriptorMatcher();
+  EXPECT_THROW( loaded->loadIndex( filename ), cv::Exception );
+
+  /* a truncated file */
+  {
+    std::ofstream f( filename.c_str(), std::ios::binary );
+    f.write( &content[0], (std::streamsize) ( content.size() / 2 ) );
+  }
+  EXPECT_THROW( loaded->loadIndex( filename ), cv::Exception );
+
+  {
+    std::ofstream f( filename.c_str(), std::ios::binary );
+    f.write( &content[0], (std::streamsize) content.size() );
+  }
+  EXPECT_NO_THROW( loaded->loadIndex( filename ) );
+
+  remove( filename.c_str() );
+}
+
 }} // namespace
@@ -199,7 +199,8 @@ namespace cv
             enum
             {
                 MODE_SGBM = 0,
-                MODE_HH   = 1
+                MODE_HH   = 1,
+                MODE_HH4  = 3  //!< four paths only, aggregated in parallel; same value as StereoSGBM::MODE_HH4
             };
 
             virtual int getPreFilterCap() const = 0;
@@ -258,6 +259,9 @@ namespace cv
             @param mode Set it to StereoSGBM::MODE_HH to run the full-scale two-pass dynamic programming
             algorithm. It will consume O(W\*H\*numDisparities) bytes, which is large for 640x480 stereo and
             huge for HD-size pictures. By default, it is set to false .
+            Set it to StereoBinarySGBM::MODE_HH4 to aggregate the costs along the left-right, right-left,
+            top-down and bottom-up paths only. The paths of this mode are independent of each other, so
+            they are processed in parallel. It needs the same O(W\*H\*numDisparities) memory as MODE_HH.
 
             The first constructor initializes StereoSGBM with all the default parameters. So, you only have to
             set StereoSGBM::numDisparities at minimum. The second constructor enables you to set each parameter
@@ -51,6 +51,7 @@ struct CV_EXPORTS_W_SIMPLE PropagationParameters
 
     CV_PROP_RW int	  neighborhoodSize;		// neighborhood size
     CV_PROP_RW int	  disparityGradient;	// disparity gradient threshold
+    CV_PROP_RW int	  tileSize;				// side of the tiles grown in parallel, 0 for a single tile
 
     // Parameters for LK flow algorithm
     CV_PROP_RW int lkTemplateSize;
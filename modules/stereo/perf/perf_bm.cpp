@@ -76,6 +76,36 @@ PERF_TEST_P( s_bm, sgm_perf,
     }
     SANITY_CHECK_NOTHING();
 }
+PERF_TEST_P( s_bm, sgm_hh4_perf,
+            testing::Combine(
+            testing::Values( cv::Size(1280, 720), cv::Size(640, 480) ),
+            testing::Values( CV_8U ),
+            testing::Values( CV_16S )
+            )
+            )
+{
+    Size sz = get<0>(GetParam());
+    int matType = get<1>(GetParam());
+    int sdepth = get<2>(GetParam());
+
+    Mat left(sz, matType);
+    Mat right(sz, matType);
+    Mat out1(sz, sdepth);
+    Ptr<StereoBinarySGBM> sgbm = StereoBinarySGBM::create(0, 64, 5);
+    sgbm->setBinaryKernelType(CV_DENSE_CENSUS);
+    sgbm->setMode(StereoBinarySGBM::MODE_HH4);
+    declare
+        .in(left, WARMUP_RNG)
+        .in(right, WARMUP_RNG)
+        .out(out1)
+        .time(0.1)
+        .iterations(20);
+    TEST_CYCLE()
+    {
+        sgbm->compute(left, right, out1);
+    }
+    SANITY_CHECK_NOTHING();
+}
 PERF_TEST_P( s_bm, bm_perf,
             testing::Combine(
             testing::Values( cv::Size(512, 383),  cv::Size(320, 240) ),
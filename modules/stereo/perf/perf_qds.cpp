@@ -0,0 +1,37 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "perf_precomp.hpp"
+
+namespace opencv_test { namespace {
+
+typedef perf::TestBaseWithParam<int> qds_threads;
+
+PERF_TEST_P(qds_threads, process, testing::Values(2, 4, 8, 16))
+{
+    const int nThreads = GetParam();
+    Mat left = imread(getDataPath("cv/stereomatching/datasets/cones/im2.png"), IMREAD_GRAYSCALE);
+    Mat right = imread(getDataPath("cv/stereomatching/datasets/cones/im6.png"), IMREAD_GRAYSCALE);
+    ASSERT_FALSE(left.empty() || right.empty());
+
+    Ptr<QuasiDenseStereo> qds = QuasiDenseStereo::create(left.size());
+    qds->Param.tileSize = 64;
+
+    const int savedThreads = getNumThreads();
+    setNumThreads(nThreads);
+    declare.time(30);
+    TEST_CYCLE()
+    {
+        qds->process(left, right);
+    }
+    setNumThreads(savedThreads);
+
+    // dense matches per frame; the throughput is this over the reported time
+    std::vector<MatchQuasiDense> matches;
+    qds->getDenseMatches(matches);
+    RecordProperty("dense_matches", (int)matches.size());
+    SANITY_CHECK_NOTHING();
+}
+
+}} // namespace
@@ -49,6 +49,7 @@
 
 #include <stdint.h>
 #include "opencv2/core.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 
 namespace cv
 {
@@ -156,29 +157,61 @@ namespace cv
             public :
                 hammingDistance(const Mat &leftImage, const Mat &rightImage, short *cost, int maxDisp, int kerSize, int *hammingLUT):
                     left((int *)leftImage.data), right((int *)rightImage.data), c(cost), v(maxDisp),kernelSize(kerSize),width(leftImage.cols), MASK(65535), hammLut(hammingLUT){}
+                void costs(int iw, int j, int dStart) const
+                {
+                    int iwj = iw + j;
+                    for (int d = dStart; d <= v; d++)
+                    {
+                        int j2 = std::max(0, j - d);
+                        int xorul = left[(iwj)] ^ right[(iw + j2)];
+#if CV_POPCNT
+                        if (checkHardwareSupport(CV_CPU_POPCNT))
+                        {
+                            c[(iwj)* (v + 1) + d] = (short)_mm_popcnt_u32(xorul);
+                        }
+                        else
+#endif
+                        {
+                            c[(iwj)* (v + 1) + d] = (short)(hammLut[xorul & MASK] + hammLut[(xorul >> 16) & MASK]);
+                        }
+                    }
+                }
                 void operator()(const cv::Range &r) const CV_OVERRIDE {
                     for (int i = r.start; i < r.end ; i++)
                     {
                         int iw = i * width;
-                        for (int j = kernelSize; j < width - kernelSize; j++)
+                        int j = kernelSize;
+#if CV_SIMD128
+                        // pixels whose matches never fall off the left border are processed four at a
+                        // time: 4x4 blocks of (disparity, pixel) costs are transposed to the pixel-major
+                        // layout of the cost volume
+                        const unsigned *l = (const unsigned *)left + iw, *rt = (const unsigned *)right + iw;
+                        for (; j < std::min(v, width - kernelSize); j++)
+                            costs(iw, j, 0);
+                        for (; j <= width - kernelSize - 4; j += 4)
                         {
-                            int iwj = iw + j;
-                            for (int d = 0; d <= v; d++)
+                            v_uint32x4 lv = v_load(l + j);
+                            int d = 0;
+                            for (; d <= v - 3; d += 4)
                             {
-                                int j2 = std::max(0, j - d);
-                                int xorul = left[(iwj)] ^ right[(iw + j2)];
-#if CV_POPCNT
-                                if (checkHardwareSupport(CV_CPU_POPCNT))
-                                {
-                                    c[(iwj)* (v + 1) + d] = (short)_mm_popcnt_u32(xorul);
-                                }
-                                else
-#endif
-                                {
-                                    c[(iwj)* (v + 1) + d] = (short)(hammLut[xorul & MASK] + hammLut[(xorul >> 16) & MASK]);
-                                }
+                                v_uint32x4 c0 = v_popcount(lv ^ v_load(rt + j - d));
+                                v_uint32x4 c1 = v_popcount(lv ^ v_load(rt + j - d - 1));
+                                v_uint32x4 c2 = v_popcount(lv ^ v_load(rt + j - d - 2));
+                                v_uint32x4 c3 = v_popcount(lv ^ v_load(rt + j - d - 3));
+                                v_uint32x4 p0, p1, p2, p3;
+                                v_transpose4x4(c0, c1, c2, c3, p0, p1, p2, p3);
+                                ushort *cj = (ushort *)c + (iw + j) * (v + 1) + d;
+                                v_pack_store(cj, p0);
+                                v_pack_store(cj + (v + 1), p1);
+                                v_pack_store(cj + (v + 1) * 2, p2);
+                                v_pack_store(cj + (v + 1) * 3, p3);
                             }
+                            for (int k = 0; k < 4; k++)
+                                costs(iw, j + k, d);
                         }
+#endif
+                        for (; j < width - kernelSize; j++)
+                            costs(iw, j, 0);
                     }
                 }
             };
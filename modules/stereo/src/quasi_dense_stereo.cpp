@@ -5,7 +5,9 @@
 #include "precomp.hpp"
 #include <opencv2/video/tracking.hpp>
 #include <opencv2/stereo/quasi_dense_stereo.hpp>
+#include "opencv2/core/hal/intrin.hpp"
 #include <queue>
+#include <unordered_set>
 
 
 namespace cv {
@@ -26,6 +28,7 @@ public:
         height = monoImgSize.height;
         refMap = cv::Mat_<cv::Point2i>(monoImgSize);
         mtcMap = cv::Mat_<cv::Point2i>(monoImgSize);
+        mtcCorr = cv::Mat_<float>(monoImgSize);
 
         cv::Size integralSize = cv::Size(monoImgSize.width+1, monoImgSize.height+1);
         sum0 = cv::Mat_<int32_t>(integralSize);
@@ -47,6 +50,7 @@ public:
 
         refMap.release();
         mtcMap.release();
+        mtcCorr.release();
 
         sum0.release();
         sum1.release();
@@ -140,8 +144,8 @@ public:
                             const std::vector< cv::Point2f > &featuresRight)
     {
         dMatchesLen = 0;
-        refMap = cv::Mat_<cv::Point2i>(cv::Size(width, height), cv::Point2i(0, 0));
-        mtcMap = cv::Point2i(0, 0);
+        refMap = NO_MATCH;
+        mtcMap = NO_MATCH;
 
         // build texture homogeneity reference maps.
         buildTextureDescriptor(grayLeft, textureDescLeft);
@@ -156,8 +160,127 @@ public:
         t_matchPriorityQueue seeds = extractSparseSeeds(featuresLeft, featuresRight,
         refMap, mtcMap);
 
+        const int tileSize = Param.tileSize > 0 ? Param.tileSize : std::max(width, height);
+        const int tilesX = (width + tileSize - 1) / tileSize;
+        const int tilesY = (height + tileSize - 1) / tileSize;
+        const int nTiles = tilesX * tilesY;
 
         // Do the propagation part
+        if(nTiles == 1)
+        {
+            dMatchesLen += propagateTile(seeds, cv::Rect(0, 0, width, height), NULL);
+            return;
+        }
+
+        std::vector<t_matchPriorityQueue> tileSeeds(nTiles);
+        std::vector< std::vector<MatchQuasiDense> > tileMatches(nTiles);
+
+        // a match seeds the tile of its left point, and the neighbouring tiles its neighbourhood reaches into
+        const int N = Param.neighborhoodSize;
+        auto distributeSeed = [&](const MatchQuasiDense &m)
+        {
+            const int tx0 = std::max(m.p0.x - N, 0) / tileSize, tx1 = std::min(m.p0.x + N, width - 1) / tileSize;
+            const int ty0 = std::max(m.p0.y - N, 0) / tileSize, ty1 = std::min(m.p0.y + N, height - 1) / tileSize;
+            for(int ty = ty0; ty <= ty1; ty++)
+                for(int tx = tx0; tx <= tx1; tx++)
+                    tileSeeds[ty*tilesX + tx].push(m);
+        };
+        for(; !seeds.empty(); seeds.pop())
+            distributeSeed(seeds.top());
+
+        for(;;)
+        {
+            bool done = true;
+            for(int t = 0; t < nTiles; t++)
+                done = done && tileSeeds[t].empty();
+            if(done)
+                break;
+
+            // grow every tile from its seeds, against the matches registered in the previous rounds
+            parallel_for_(cv::Range(0, nTiles), [&](const cv::Range &range)
+            {
+                for(int t = range.start; t < range.end; t++)
+                {
+                    const cv::Rect tile(cv::Point((t % tilesX)*tileSize, (t / tilesX)*tileSize),
+                                        cv::Point(std::min((t % tilesX + 1)*tileSize, width),
+                                                  std::min((t / tilesX + 1)*tileSize, height)));
+                    tileMatches[t].clear();
+                    propagateTile(tileSeeds[t], tile, &tileMatches[t]);
+                }
+            }, nTiles);
+
+            // resolve the right image locations claimed by several tiles: the best correlation wins,
+            // ties go to the first tile. The left image locations are owned by a single tile.
+            for(int t = 0; t < nTiles; t++)
+            {
+                for(size_t i = 0; i < tileMatches[t].size(); i++)
+                {
+                    const MatchQuasiDense &lm = tileMatches[t][i];
+                    cv::Point2i &owner = mtcMap(lm.p1);
+                    if(owner == NO_MATCH)
+                    {
+                        owner = lm.p0;
+                        mtcCorr(lm.p1) = lm.corr;
+                    }
+                    else if(lm.corr > mtcCorr(lm.p1))
+                    {
+                        refMap(owner) = NO_MATCH;
+                        owner = lm.p0;
+                        mtcCorr(lm.p1) = lm.corr;
+                    }
+                    else
+                        refMap(lm.p0) = NO_MATCH;
+                }
+            }
+            // the winners seed the next round in the neighbouring tiles
+            for(int t = 0; t < nTiles; t++)
+            {
+                const int tx = t % tilesX, ty = t / tilesX;
+                for(size_t i = 0; i < tileMatches[t].size(); i++)
+                {
+                    const MatchQuasiDense &lm = tileMatches[t][i];
+                    if(refMap(lm.p0) != lm.p1)
+                        continue;
+                    dMatchesLen++;
+                    if(lm.p0.x - N < tx*tileSize || lm.p0.x + N >= (tx + 1)*tileSize ||
+                       lm.p0.y - N < ty*tileSize || lm.p0.y + N >= (ty + 1)*tileSize)
+                    {
+                        const int tx0 = std::max(lm.p0.x - N, 0) / tileSize, tx1 = std::min(lm.p0.x + N, width - 1) / tileSize;
+                        const int ty0 = std::max(lm.p0.y - N, 0) / tileSize, ty1 = std::min(lm.p0.y + N, height - 1) / tileSize;
+                        for(int y = ty0; y <= ty1; y++)
+                            for(int x = tx0; x <= tx1; x++)
+                                if(y*tilesX + x != t)
+                                    tileSeeds[y*tilesX + x].push(lm);
+                    }
+                }
+            }
+        }
+    }
+
+
+    /**
+     * @brief Grow the matches of the left image pixels inside a tile from a queue of seeds.
+     *
+     * This is the propagation loop of quasiDenseMatching restricted to a tile. With newMatches
+     * NULL the matches are registered in refMap and mtcMap right away, which for a tile covering the
+     * whole image is the serial algorithm. Otherwise only refMap, whose pixels inside the tile are
+     * owned by the caller, is written: the right image locations claimed by the tile are tracked
+     * locally and the matches are appended to newMatches, to be resolved against the other tiles.
+     * @param[in,out] seeds The seeds of the tile, empty on return.
+     * @param[in] tile The region of the left image to match.
+     * @param[out] newMatches The matches found, or NULL.
+     * @return The number of matches found.
+     */
+    int propagateTile(t_matchPriorityQueue &seeds, const cv::Rect &tile,
+                      std::vector<MatchQuasiDense> *newMatches)
+    {
+        std::unordered_set<int> claimed;
+        int nMatches = 0;
+        auto isClaimed = [&](const cv::Point2i &p1)
+        {
+            return mtcMap(p1) != NO_MATCH || (newMatches && claimed.count(p1.y*width + p1.x) != 0);
+        };
+
         while(!seeds.empty())
         {
             t_matchPriorityQueue Local;
@@ -178,12 +301,16 @@ public:
                 {
                     cv::Point2i p0 = cv::Point2i(m.p0.x+x,m.p0.y+y);
 
+                    // Only the pixels of this tile
+                    if(!tile.contains(p0))
+                        continue;
+
                     // Check if its unique in ref
-                    if(refMap.at<cv::Point2i>(p0.y,p0.x) != NO_MATCH)
+                    if(refMap(p0) != NO_MATCH)
                         continue;
 
                     // Check the texture descriptor for a boundary
-                    if(textureDescLeft.at<int>(p0.y, p0.x) > Param.textrureThreshold)
+                    if(textureDescLeft(p0) > Param.textrureThreshold)
                         continue;
 
                     // For all candidate matches.
@@ -194,11 +321,11 @@ public:
                             cv::Point p1 = cv::Point(m.p1.x+x+wx,m.p1.y+y+wy);
 
                             // Check if its unique in ref
-                            if(mtcMap.at<cv::Point2i>(p1.y, p1.x) != NO_MATCH)
+                            if(isClaimed(p1))
                                 continue;
 
                             // Check the texture descriptor for a boundary
-                            if(textureDescRight.at<int>(p1.y, p1.x) > Param.textrureThreshold)
+                            if(textureDescRight(p1) > Param.textrureThreshold)
                                 continue;
 
                             // Calculate ZNCC and store local match.
@@ -224,20 +351,27 @@ public:
                 MatchQuasiDense lm = Local.top();
                 Local.pop();
                 // Check if its unique in both ref and dst.
-                if(refMap.at<cv::Point2i>(lm.p0.y, lm.p0.x) != NO_MATCH)
+                if(refMap(lm.p0) != NO_MATCH)
                     continue;
-                if(mtcMap.at<cv::Point2i>(lm.p1.y, lm.p1.x) != NO_MATCH)
+                if(isClaimed(lm.p1))
                     continue;
 
 
                 // Unique match
-                refMap.at<cv::Point2i>(lm.p0.y, lm.p0.x) = lm.p1;
-                mtcMap.at<cv::Point2i>(lm.p1.y, lm.p1.x) = lm.p0;
-                dMatchesLen++;
+                refMap(lm.p0) = lm.p1;
+                if(newMatches)
+                {
+                    claimed.insert(lm.p1.y*width + lm.p1.x);
+                    newMatches->push_back(lm);
+                }
+                else
+                    mtcMap(lm.p1) = lm.p0;
+                nMatches++;
                 // Add to the seed list
                 seeds.push(lm);
             }
         }
+        return nMatches;
     }
 
 
@@ -251,25 +385,28 @@ public:
     void computeDisparity(const cv::Mat_<cv::Point2i> &matchMap,
                             cv::Mat_<float> &dispMat)
     {
-        for(int row=0; row< height; row++)
+        parallel_for_(cv::Range(0, height), [&](const cv::Range &range)
         {
-            for(int col=0; col<width; col++)
+            for(int row=range.start; row< range.end; row++)
             {
-                cv::Point2d tmpPoint(col, row);
-
-                if (matchMap.at<cv::Point2i>(tmpPoint) == NO_MATCH)
+                for(int col=0; col<width; col++)
                 {
-                    dispMat.at<float>(tmpPoint) = NAN;
-                    continue;
+                    cv::Point2d tmpPoint(col, row);
+
+                    if (matchMap.at<cv::Point2i>(tmpPoint) == NO_MATCH)
+                    {
+                        dispMat.at<float>(tmpPoint) = NAN;
+                        continue;
+                    }
+                    //if a match is found, compute the difference in location of the match and current
+                    //pixel.
+                    int dx = col-matchMap.at<cv::Point2i>(tmpPoint).x;
+                    int dy = row-matchMap.at<cv::Point2i>(tmpPoint).y;
+                    //calculate disparity of current pixel.
+                    dispMat.at<float>(tmpPoint) = sqrt(float(dx*dx+dy*dy));
                 }
-                //if a match is found, compute the difference in location of the match and current
-                //pixel.
-                int dx = col-matchMap.at<cv::Point2i>(tmpPoint).x;
-                int dy = row-matchMap.at<cv::Point2i>(tmpPoint).y;
-                //calculate disparity of current pixel.
-                dispMat.at<float>(tmpPoint) = sqrt(float(dx*dx+dy*dy));
             }
-        }
+        });
     }
 
 
@@ -304,16 +441,53 @@ public:
         s1 = sqrt(s1-wa*m1*m1);
 
 
-        for (int col=-wy; col<=wy; col++)
+        zncc = (float)patchCrossSum(p0, p1, wx, wy);
+        zncc = (zncc-wa*m0*m1)/(s0*s1);
+        return zncc;
+    }
+
+
+    /**
+     * @brief Compute the sum of the products of the pixels of a patch in the left image, centered
+     * in point p0, with the pixels of a patch in the right image, centered in point p1.
+     *
+     * The patches are 2*wx+1 by 2*wy+1. The products are accumulated in integers, which is exact
+     * for any practical window size.
+     */
+    int patchCrossSum(const cv::Point2i p0, const cv::Point2i p1, const int wx, const int wy) const
+    {
+        const int patchWidth = 2*wx+1;
+        int sum = 0;
+#if CV_SIMD128
+        // rows are loaded in groups of 8 pixels, which may run past the patch (but not past the
+        // image row); the lanes outside the patch are masked out
+        if (std::max(p0.x, p1.x) - wx + ((patchWidth + 7) & -8) <= width)
         {
-            for (int row=-wx; row<=wx; row++)
+            const v_int16x8 lanes(0, 1, 2, 3, 4, 5, 6, 7);
+            v_int32x4 vsum = v_setzero_s32();
+            for (int dy=-wy; dy<=wy; dy++)
             {
-                zncc += (float)grayLeft.at<uchar>(p0.y+row, p0.x+col) *
-                (float)grayRight.at<uchar>(p1.y+row, p1.x+col);
+                const uchar* row0 = grayLeft.ptr<uchar>(p0.y+dy) + p0.x - wx;
+                const uchar* row1 = grayRight.ptr<uchar>(p1.y+dy) + p1.x - wx;
+                for (int dx=0; dx<patchWidth; dx+=8)
+                {
+                    v_int16x8 mask = lanes < v_setall_s16((short)(patchWidth - dx));
+                    v_int16x8 a = v_reinterpret_as_s16(v_load_expand(row0 + dx)) & mask;
+                    v_int16x8 b = v_reinterpret_as_s16(v_load_expand(row1 + dx));
+                    vsum += v_dotprod(a, b);
+                }
             }
+            return v_reduce_sum(vsum);
         }
-        zncc = (zncc-wa*m0*m1)/(s0*s1);
-        return zncc;
+#endif
+        for (int dy=-wy; dy<=wy; dy++)
+        {
+            const uchar* row0 = grayLeft.ptr<uchar>(p0.y+dy) + p0.x;
+            const uchar* row1 = grayRight.ptr<uchar>(p1.y+dy) + p1.x;
+            for (int dx=-wx; dx<=wx; dx++)
+                sum += row0[dx] * row1[dx];
+        }
+        return sum;
     }
 
 
@@ -427,32 +601,34 @@ public:
      */
     void buildTextureDescriptor(cv::Mat &img,cv::Mat &descriptor)
     {
-        float a, b, c, d;
+        // traverse every pixel, in parallel row bands.
+        parallel_for_(cv::Range(1, std::max(height-1, 1)), [&](const cv::Range &range)
+        {
+            float a, b, c, d;
 
-        uint8_t center, top, bottom, right, left;
-        //reset descriptors
+            uint8_t center, top, bottom, right, left;
 
-        // traverse every pixel.
-        for(int row=1; row<height-1; row++)
-        {
-            for(int col=1; col<width-1; col++)
+            for(int row=range.start; row<range.end; row++)
             {
-                // the values of the current pixel.
-                center = img.at<uchar>(row,col);
-                top = img.at<uchar>(row-1,col);
-                bottom = img.at<uchar>(row+1,col);
-                left = img.at<uchar>(row,col-1);
-                right = img.at<uchar>(row,col+1);
-
-                a = (float)abs(center - top);
-                b = (float)abs(center - bottom);
-                c = (float)abs(center - left);
-                d = (float)abs(center - right);
-                //choose the biggest of them.
-                int val = (int) std::max(a, std::max(b, std::max(c, d)));
-                descriptor.at<int>(row, col) = val;
+                for(int col=1; col<width-1; col++)
+                {
+                    // the values of the current pixel.
+                    center = img.at<uchar>(row,col);
+                    top = img.at<uchar>(row-1,col);
+                    bottom = img.at<uchar>(row+1,col);
+                    left = img.at<uchar>(row,col-1);
+                    right = img.at<uchar>(row,col+1);
+
+                    a = (float)abs(center - top);
+                    b = (float)abs(center - bottom);
+                    c = (float)abs(center - left);
+                    d = (float)abs(center - right);
+                    //choose the biggest of them.
+                    int val = (int) std::max(a, std::max(b, std::max(c, d)));
+                    descriptor.at<int>(row, col) = val;
+                }
             }
-        }
+        });
     }
 
     //-------------------------------------------------------------------------
@@ -491,6 +667,7 @@ public:
 
             fs["neighborhoodSize"] >> Param.neighborhoodSize;
             fs["disparityGradient"] >> Param.disparityGradient;
+            fs["tileSize"] >> Param.tileSize;
 
             fs["lkTemplateSize"] >> Param.lkTemplateSize;
             fs["lkPyrLvl"] >> Param.lkPyrLvl;
@@ -514,6 +691,7 @@ public:
 
         Param.neighborhoodSize = 5;
         Param.disparityGradient = 1;
+        Param.tileSize = 0;
 
         Param.lkTemplateSize = 3;
         Param.lkPyrLvl = 3;
@@ -546,6 +724,7 @@ public:
 
             fs << "neighborhoodSize" << Param.neighborhoodSize;
             fs << "disparityGradient" << Param.disparityGradient;
+            fs << "tileSize" << Param.tileSize;
 
             fs << "lkTemplateSize" << Param.lkTemplateSize;
             fs << "lkPyrLvl" << Param.lkPyrLvl;
@@ -589,8 +768,8 @@ public:
         }
         else
         {
-            grayLeft = imgLeft.clone();
-            grayRight = imgRight.clone();
+            imgLeft.copyTo(grayLeft);
+            imgRight.copyTo(grayRight);
         }
         sparseMatching(grayLeft, grayRight, leftFeatures, rightFeatures);
         quasiDenseMatching(leftFeatures, rightFeatures);
@@ -623,6 +802,8 @@ public:
     // Containers to store the locations of each points pair.
     cv::Mat_<cv::Point2i> refMap;
     cv::Mat_<cv::Point2i> mtcMap;
+    // Correlation of the matches registered in mtcMap, used to resolve conflicts between tiles.
+    cv::Mat_<float> mtcCorr;
     cv::Mat_<int32_t> sum0;
     cv::Mat_<int32_t> sum1;
     cv::Mat_<double> ssum0;
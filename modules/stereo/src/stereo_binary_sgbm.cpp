@@ -626,6 +626,326 @@ namespace cv
                 }
             }
         }
+        /*
+        HH4 variant of the dynamic programming: the costs are aggregated along four paths only
+        (left-right, right-left, top-down and bottom-up), so every path of a given direction is
+        independent of the others. The horizontal paths are processed in parallel row bands and
+        the vertical ones in parallel column bands, both adding their path costs to S; the
+        disparities are then selected in parallel row bands.
+        C and S are kept for the whole image, i.e. 2*W*H*numDisparities*sizeof(CostType) bytes
+        of buffer, which is reused between the calls.
+        */
+
+        // horizontal box sum of the per-pixel costs of one image row, clamped at the borders
+        static void calcRowHSum( const short* hamRow, int width1, int D, int SW2,
+                                 CostType* pixDiff, CostType* hsum )
+        {
+            for( int x = 0; x < width1; x++ )
+                for( int d = 0; d < D; d++ )
+                    pixDiff[x*D + d] = (CostType)hamRow[x*(D + 1) + d];
+
+            for( int d = 0; d < D; d++ )
+                hsum[d] = (CostType)(pixDiff[d]*(SW2 + 1));
+            for( int x = D; x <= SW2*D; x += D )
+            {
+                const CostType* pixAdd = pixDiff + std::min(x, (width1-1)*D);
+                for( int d = 0; d < D; d++ )
+                    hsum[d] = (CostType)(hsum[d] + pixAdd[d]);
+            }
+            for( int x = D; x < width1*D; x += D )
+            {
+                const CostType* pixAdd = pixDiff + std::min(x + SW2*D, (width1-1)*D);
+                const CostType* pixSub = pixDiff + std::max(x - (SW2+1)*D, 0);
+                for( int d = 0; d < D; d++ )
+                    hsum[x + d] = (CostType)(hsum[x - D + d] + pixAdd[d] - pixSub[d]);
+            }
+        }
+
+        /*
+        [formula 13 in the paper] for one pixel of one path:
+        Lr(p, d) = C(p, d) + min(Lr(p-r, d), Lr(p-r, d-1) + P1, Lr(p-r, d+1) + P1, min_k Lr(p-r, k) + P2) - min_k Lr(p-r, k)
+        C holds the extra P2 added when the costs are computed, which is why only minLprev is added to delta.
+        Lprev[-1] and Lprev[D] must be MAX_COST. Lr(p, d) is added to S, and min_k Lr(p, k) is returned.
+        */
+        static inline int updatePathCost( const CostType* Cp, const CostType* Lprev, int minLprev,
+                                          CostType* Lcur, CostType* Sp, int D, int P1, int P2 )
+        {
+            const CostType MAX_COST = SHRT_MAX;
+            const int delta = minLprev + P2;
+            int d = 0, minL = MAX_COST;
+#if CV_SIMD128
+            v_int16x8 _P1 = v_setall_s16((short)P1), _delta = v_setall_s16((short)delta);
+            v_int16x8 _minL = v_setall_s16(MAX_COST);
+            for( ; d < D; d += 8 )
+            {
+                v_int16x8 L = v_min(v_load(Lprev + d), v_min(v_load(Lprev + d - 1) + _P1, v_load(Lprev + d + 1) + _P1));
+                L = (v_min(L, _delta) - _delta) + v_load(Cp + d);
+                v_store(Lcur + d, L);
+                _minL = v_min(_minL, L);
+                v_store(Sp + d, v_load(Sp + d) + L);
+            }
+            minL = v_reduce_min(_minL);
+#endif
+            for( ; d < D; d++ )
+            {
+                const int L = Cp[d] + std::min((int)Lprev[d], std::min(Lprev[d-1] + P1, std::min(Lprev[d+1] + P1, delta))) - delta;
+                Lcur[d] = (CostType)L;
+                minL = std::min(minL, L);
+                Sp[d] = saturate_cast<CostType>(Sp[d] + L);
+            }
+            return minL;
+        }
+
+        static void computeDisparityBinarySGBM_HH4( const Mat& img1,
+            Mat& disp1, const StereoBinarySGBMParams& params,
+            Mat& buffer, const Mat& hamDist )
+        {
+            const int ALIGN = 16;
+            const int DISP_SHIFT = StereoMatcher::DISP_SHIFT;
+            const int DISP_SCALE = (1 << DISP_SHIFT);
+            const CostType MAX_COST = SHRT_MAX;
+            const int minD = params.minDisparity;
+            const int maxD = minD + params.numDisparities;
+            const int kernelSize = params.kernelSize > 0 ? params.kernelSize : 5;
+            const int uniquenessRatio = params.uniquenessRatio >= 0 ? params.uniquenessRatio : 10;
+            const int disp12MaxDiff = params.disp12MaxDiff > 0 ? params.disp12MaxDiff : 1;
+            const int P1 = params.P1 > 0 ? params.P1 : 2;
+            const int P2 = std::max(params.P2 > 0 ? params.P2 : 5, P1+1);
+            const int width = disp1.cols, height = disp1.rows;
+            const int minX1 = std::max(-maxD, 0);
+            const int maxX1 = width + std::min(minD, 0);
+            const int D = maxD - minD;
+            const int width1 = maxX1 - minX1;
+            const int INVALID_DISP = minD - 1, INVALID_DISP_SCALED = INVALID_DISP*DISP_SCALE;
+            const int SW2 = kernelSize/2, SH2 = kernelSize/2;
+            CV_UNUSED(img1);
+
+            if( minX1 >= maxX1 )
+            {
+                disp1 = Scalar::all(INVALID_DISP_SCALED);
+                return;
+            }
+            CV_Assert( D % 16 == 0 );
+            // Lr rows of one pixel, with room for d=-1 and d=D: Lr[x] = LrBuf + x*D2 + 8
+            const int D2 = D + 16;
+            const int hsumBufNRows = SH2*2 + 2;
+            const size_t costBufSize = (size_t)width1*D;
+            const short* ham = hamDist.ptr<short>();
+            const size_t hamStep = (size_t)width*(D + 1);
+
+            const size_t totalBufSize = costBufSize*height*2*sizeof(CostType) + ALIGN;
+            if( buffer.empty() || !buffer.isContinuous() ||
+                buffer.cols*buffer.rows*buffer.elemSize() < totalBufSize )
+                buffer.create(1, (int)totalBufSize, CV_8U);
+            CostType* Cbuf = (CostType*)alignPtr(buffer.ptr(), ALIGN);
+            CostType* Sbuf = Cbuf + costBufSize*height;
+
+            const int nRowStripes = std::max(1, std::min(height / 16, 4 * getNumThreads()));
+
+            // C(y) = P2 + sum of the horizontal box sums of rows y-SH2..y+SH2 (clamped),
+            // computed with a sliding window inside each band; S is cleared as well
+            parallel_for_(Range(0, height), [&](const Range& range)
+            {
+                AutoBuffer<CostType> _pixDiff(costBufSize), _hsum(costBufSize*hsumBufNRows);
+                CostType* pixDiff = _pixDiff.data();
+                const int y0 = range.start;
+                // hsum of row k lives in slot (k - y0 + SH2 + 1) % hsumBufNRows
+                auto hsumRow = [&](int k) -> CostType*
+                {
+                    return _hsum.data() + ((k - y0 + SH2 + 1) % hsumBufNRows)*costBufSize;
+                };
+                auto computeHSum = [&](int k)
+                {
+                    calcRowHSum(ham + std::min(std::max(k, 0), height-1)*hamStep, width1, D, SW2, pixDiff, hsumRow(k));
+                };
+
+                CostType* C = Cbuf + y0*costBufSize;
+                for( size_t i = 0; i < costBufSize; i++ )
+                    C[i] = (CostType)P2;
+                for( int k = y0 - SH2; k <= y0 + SH2; k++ )
+                {
+                    computeHSum(k);
+                    const CostType* hsumAdd = hsumRow(k);
+                    for( size_t i = 0; i < costBufSize; i++ )
+                        C[i] = saturate_cast<CostType>(C[i] + hsumAdd[i]);
+                }
+                for( int y = y0 + 1; y < range.end; y++ )
+                {
+                    computeHSum(y + SH2);
+                    const CostType* hsumAdd = hsumRow(y + SH2);
+                    const CostType* hsumSub = hsumRow(y - SH2 - 1);
+                    const CostType* Cprev = C;
+                    C += costBufSize;
+                    size_t i = 0;
+#if CV_SIMD128
+                    for( ; i < costBufSize; i += 8 )
+                        v_store(C + i, (v_load(Cprev + i) - v_load(hsumSub + i)) + v_load(hsumAdd + i));
+#endif
+                    for( ; i < costBufSize; i++ )
+                        C[i] = saturate_cast<CostType>(Cprev[i] - hsumSub[i] + hsumAdd[i]);
+                }
+                memset(Sbuf + range.start*costBufSize, 0, (range.end - range.start)*costBufSize*sizeof(CostType));
+            }, nRowStripes);
+
+            // left-right and right-left paths, row by row
+            parallel_for_(Range(0, height), [&](const Range& range)
+            {
+                AutoBuffer<CostType> _Lr(D2*2);
+                CostType* Lr[2] = { _Lr.data() + 8, _Lr.data() + D2 + 8 };
+                for( int y = range.start; y < range.end; y++ )
+                {
+                    const CostType* C = Cbuf + y*costBufSize;
+                    CostType* S = Sbuf + y*costBufSize;
+                    for( int dir = 0; dir < 2; dir++ )
+                    {
+                        const int x1 = dir == 0 ? 0 : width1 - 1, x2 = dir == 0 ? width1 : -1, dx = dir == 0 ? 1 : -1;
+                        memset(_Lr.data(), 0, D2*2*sizeof(CostType));
+                        Lr[0][-1] = Lr[0][D] = Lr[1][-1] = Lr[1][D] = MAX_COST;
+                        int minL = 0;
+                        for( int x = x1; x != x2; x += dx )
+                        {
+                            minL = updatePathCost(C + x*D, Lr[1], minL, Lr[0], S + x*D, D, P1, P2);
+                            std::swap(Lr[0], Lr[1]);
+                        }
+                    }
+                }
+            }, nRowStripes);
+
+            // top-down and bottom-up paths, in column bands
+            parallel_for_(Range(0, width1), [&](const Range& range)
+            {
+                const int bandWidth = range.end - range.start;
+                AutoBuffer<CostType> _Lr((size_t)D2*bandWidth*2);
+                AutoBuffer<int> _minL(bandWidth*2);
+                for( int dir = 0; dir < 2; dir++ )
+                {
+                    const int y1 = dir == 0 ? 0 : height - 1, y2 = dir == 0 ? height : -1, dy = dir == 0 ? 1 : -1;
+                    CostType* Lr[2] = { _Lr.data() + 8, _Lr.data() + (size_t)D2*bandWidth + 8 };
+                    int* minLr[2] = { _minL.data(), _minL.data() + bandWidth };
+                    memset(_Lr.data(), 0, (size_t)D2*bandWidth*2*sizeof(CostType));
+                    for( int k = 0; k < 2; k++ )
+                        for( int i = 0; i < bandWidth; i++ )
+                        {
+                            Lr[k][i*D2 - 1] = Lr[k][i*D2 + D] = MAX_COST;
+                            minLr[k][i] = 0;
+                        }
+                    for( int y = y1; y != y2; y += dy )
+                    {
+                        const CostType* C = Cbuf + y*costBufSize;
+                        CostType* S = Sbuf + y*costBufSize;
+                        for( int i = 0; i < bandWidth; i++ )
+                        {
+                            const int x = range.start + i;
+                            minLr[0][i] = updatePathCost(C + x*D, Lr[1] + i*D2, minLr[1][i], Lr[0] + i*D2, S + x*D, D, P1, P2);
+                        }
+                        std::swap(Lr[0], Lr[1]);
+                        std::swap(minLr[0], minLr[1]);
+                    }
+                }
+            }, std::max(1, std::min(width1 / 16, 4 * getNumThreads())));
+
+            // winner takes all, uniqueness check, sub-pixel interpolation and left-right check
+            parallel_for_(Range(0, height), [&](const Range& range)
+            {
+                AutoBuffer<CostType> _disp2cost(width);
+                AutoBuffer<DispType> _disp2(width);
+                CostType* disp2cost = _disp2cost.data();
+                DispType* disp2ptr = _disp2.data();
+                for( int y = range.start; y < range.end; y++ )
+                {
+                    DispType* disp1ptr = disp1.ptr<DispType>(y);
+                    const CostType* S = Sbuf + y*costBufSize;
+                    int x, d;
+                    for( x = 0; x < width; x++ )
+                    {
+                        disp1ptr[x] = disp2ptr[x] = (DispType)INVALID_DISP_SCALED;
+                        disp2cost[x] = MAX_COST;
+                    }
+
+                    for( x = width1 - 1; x >= 0; x-- )
+                    {
+                        const CostType* Sp = S + x*D;
+                        int minS = MAX_COST;
+                        int bestDisp = -1;
+                        for( d = 0; d < D; d++ )
+                        {
+                            const int Sval = Sp[d];
+                            if( Sval < minS )
+                            {
+                                minS = Sval;
+                                bestDisp = d;
+                            }
+                        }
+                        for( d = 0; d < D; d++ )
+                        {
+                            if( Sp[d]*(100 - uniquenessRatio) < minS*100 && std::abs(bestDisp - d) > 1 )
+                                break;
+                        }
+                        if( d < D )
+                            continue;
+                        d = bestDisp;
+                        // the match of the left border columns falls outside of the right image
+                        const int _x2 = x + minX1 - d - minD;
+                        if( _x2 >= 0 && disp2cost[_x2] > minS )
+                        {
+                            disp2cost[_x2] = (CostType)minS;
+                            disp2ptr[_x2] = (DispType)(d + minD);
+                        }
+                        if( 0 < d && d < D-1 )
+                        {
+                            if(params.subpixelInterpolationMethod == CV_SIMETRICV_INTERPOLATION)
+                            {
+                                const double m2 = Sp[d - 1];
+                                const double m3 = Sp[d + 1];
+                                const double m1 = Sp[d];
+                                const double m2m1 = m2 - m1;
+                                const double m3m1 = m3 - m1;
+                                if (!(m2m1 == 0 || m3m1 == 0))
+                                {
+                                    double p = 0;
+                                    if (m2 > m3)
+                                    {
+                                        p = (0.5 - 0.25 * ((m3m1 * m3m1) / (m2m1 * m2m1) + (m3m1 / m2m1)));
+                                    }
+                                    else
+                                    {
+                                        p = -1 * (0.5 - 0.25 * ((m2m1 * m2m1) / (m3m1 * m3m1) + (m2m1 / m3m1)));
+                                    }
+                                    if (p >= -0.5 && p <= 0.5)
+                                        d = (int)(d * DISP_SCALE + p * DISP_SCALE );
+                                }
+                                else
+                                {
+                                    d *= DISP_SCALE;
+                                }
+                            }
+                            else if(params.subpixelInterpolationMethod == CV_QUADRATIC_INTERPOLATION)
+                            {
+                                const int denom2 = std::max(Sp[d-1] + Sp[d+1] - 2*Sp[d], 1);
+                                d = d*DISP_SCALE + ((Sp[d-1] - Sp[d+1])*DISP_SCALE + denom2)/(denom2*2);
+                            }
+                        }
+                        else
+                            d *= DISP_SCALE;
+                        disp1ptr[x + minX1] = (DispType)(d + minD*DISP_SCALE);
+                    }
+                    for( x = minX1; x < maxX1; x++ )
+                    {
+                        const int d1 = disp1ptr[x];
+                        if( d1 == INVALID_DISP_SCALED )
+                            continue;
+                        const int _d = d1 >> DISP_SHIFT;
+                        const int d_ = (d1 + DISP_SCALE-1) >> DISP_SHIFT;
+                        const int _x = x - _d;
+                        const int x_ = x - d_;
+                        if( 0 <= _x && _x < width && disp2ptr[_x] >= minD && std::abs(disp2ptr[_x] - _d) > disp12MaxDiff &&
+                            0 <= x_ && x_ < width && disp2ptr[x_] >= minD && std::abs(disp2ptr[x_] - d_) > disp12MaxDiff )
+                            disp1ptr[x] = (DispType)INVALID_DISP_SCALED;
+                    }
+                }
+            }, nRowStripes);
+        }
+
         class StereoBinarySGBMImpl CV_FINAL : public StereoBinarySGBM, public Matching
         {
         public:
@@ -689,7 +1009,10 @@ namespace cv
 
                 hammingDistanceBlockMatching(censusImageLeft, censusImageRight, hamDist, params.kernelSize);
 
-                computeDisparityBinarySGBM( left, disp, params, buffer,hamDist);
+                if(params.mode == StereoBinarySGBM::MODE_HH4)
+                    computeDisparityBinarySGBM_HH4( left, disp, params, buffer, hamDist);
+                else
+                    computeDisparityBinarySGBM( left, disp, params, buffer,hamDist);
 
                 if(params.regionRemoval == CV_SPECKLE_REMOVAL_AVG_ALGORITHM)
                 {
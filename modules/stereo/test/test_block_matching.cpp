@@ -232,5 +232,80 @@ void CV_SGBlockMatchingTest::run(int )
 TEST(block_matching_simple_test, accuracy) { CV_BlockMatchingTest test; test.safe_run(); }
 TEST(SG_block_matching_simple_test, accuracy) { CV_SGBlockMatchingTest test; test.safe_run(); }
 
+TEST(SG_block_matching_HH4, accuracy_and_threads)
+{
+    string path = cvtest::TS::ptr()->get_data_path() + "stereomatching/datasets/tsukuba/";
+    Mat image1 = imread(path + "im2.png", IMREAD_GRAYSCALE);
+    Mat image2 = imread(path + "im6.png", IMREAD_GRAYSCALE);
+    Mat gt = imread(path + "disp2.png", IMREAD_GRAYSCALE);
+    ASSERT_FALSE(image1.empty() || image2.empty() || gt.empty());
+
+    Ptr<StereoBinarySGBM> sgbm = StereoBinarySGBM::create(0, 16, 9, 10, 100, 1, 0, 1, 400, 200,
+                                                          StereoBinarySGBM::MODE_HH4);
+    sgbm->setBinaryKernelType(CV_MODIFIED_CENSUS_TRANSFORM);
+    sgbm->setSpekleRemovalTechnique(CV_SPECKLE_REMOVAL_AVG_ALGORITHM);
+    sgbm->setSubPixelInterpolationMethod(CV_SIMETRICV_INTERPOLATION);
+
+    Mat disp, dispAgain, dispSingle;
+    sgbm->compute(image1, image2, disp);
+    // buffers reused from the previous call
+    sgbm->compute(image1, image2, dispAgain);
+    int threads = getNumThreads();
+    setNumThreads(1);
+    sgbm->compute(image1, image2, dispSingle);
+    setNumThreads(threads);
+
+    ASSERT_EQ(CV_16S, disp.type());
+    EXPECT_EQ(0, cvtest::norm(disp, dispAgain, NORM_INF));
+    EXPECT_EQ(0, cvtest::norm(disp, dispSingle, NORM_INF));
+
+    double minVal, maxVal;
+    minMaxLoc(disp, &minVal, &maxVal);
+    Mat test;
+    disp.convertTo(test, CV_8UC1, 255 / (maxVal - minVal));
+    EXPECT_LE(errorLevel(gt, test), 10);
+}
+
+TEST(SG_block_matching_HH4, left_border)
+{
+    string path = cvtest::TS::ptr()->get_data_path() + "stereomatching/datasets/tsukuba/";
+    Mat image1 = imread(path + "im2.png", IMREAD_GRAYSCALE);
+    Mat image2 = imread(path + "im6.png", IMREAD_GRAYSCALE);
+    ASSERT_FALSE(image1.empty() || image2.empty());
+
+    // narrow images: most columns are closer to the left border than the largest disparity
+    const int minDisparity = 0, numDisparities = 32;
+    Rect roi(0, 0, numDisparities + 8, image1.rows);
+    Mat left = image1(roi).clone(), right = image2(roi).clone();
+
+    Ptr<StereoBinarySGBM> sgbm = StereoBinarySGBM::create(minDisparity, numDisparities, 9, 10, 100, 1, 0, 1, 400, 200,
+                                                          StereoBinarySGBM::MODE_HH4);
+    sgbm->setBinaryKernelType(CV_MODIFIED_CENSUS_TRANSFORM);
+    // median filtering and speckle filtering keep the values among the computed ones
+    sgbm->setSpekleRemovalTechnique(CV_SPECKLE_REMOVAL_ALGORITHM);
+
+    Mat disp, dispSingle;
+    sgbm->compute(left, right, disp);
+    int threads = getNumThreads();
+    setNumThreads(1);
+    sgbm->compute(left, right, dispSingle);
+    setNumThreads(threads);
+
+    ASSERT_EQ(left.size(), disp.size());
+    EXPECT_EQ(0, cvtest::norm(disp, dispSingle, NORM_INF));
+
+    const int invalid = (minDisparity - 1) * StereoMatcher::DISP_SCALE;
+    for (int i = 0; i < disp.rows; i++)
+        for (int j = 0; j < disp.cols; j++)
+        {
+            int d = disp.at<short>(i, j);
+            if (d != invalid)
+            {
+                ASSERT_GE(d, minDisparity * StereoMatcher::DISP_SCALE);
+                ASSERT_LT(d, (minDisparity + numDisparities) * StereoMatcher::DISP_SCALE);
+            }
+        }
+}
+
 
 }} // namespace
\ No newline at end of file
@@ -64,6 +64,40 @@ TEST(qds_getDisparity, accuracy)
     ASSERT_LT(disparity_MAE(gt, outDisp),2) << "EPE should be 1.1053 for this sample/hyperparamters (Tested on version 4.5.1)";
 }
 
+TEST(qds_getDisparity, tiles_accuracy_and_threads)
+{
+    Mat image1, image2, gt;
+    image1 = imread(cvtest::TS::ptr()->get_data_path() + "stereomatching/datasets/cones/im2.png", IMREAD_GRAYSCALE);
+    image2 = imread(cvtest::TS::ptr()->get_data_path() + "stereomatching/datasets/cones/im6.png", IMREAD_GRAYSCALE);
+    gt = imread(cvtest::TS::ptr()->get_data_path() + "stereomatching/datasets/cones/disp2.png", IMREAD_GRAYSCALE);
+    ASSERT_FALSE(image1.empty() || image2.empty() || gt.empty()) << "Issue with input data";
+    gt.convertTo(gt, CV_32F);
+    gt =gt/4;
+
+    Ptr<stereo::QuasiDenseStereo> qds_matcher = stereo::QuasiDenseStereo::create(image1.size());
+    qds_matcher->Param.tileSize = 64;
+
+    qds_matcher->process(image1, image2);
+    Mat outDisp = qds_matcher->getDisparity();
+    ASSERT_LT(disparity_MAE(gt, outDisp),2);
+    std::vector<stereo::MatchQuasiDense> matches;
+    qds_matcher->getDenseMatches(matches);
+
+    // the matches do not depend on the number of threads, and the state is reused between frames
+    int nThreads = getNumThreads();
+    setNumThreads(1);
+    qds_matcher->process(image1, image2);
+    setNumThreads(nThreads);
+    std::vector<stereo::MatchQuasiDense> serialMatches;
+    qds_matcher->getDenseMatches(serialMatches);
+    ASSERT_EQ(matches.size(), serialMatches.size());
+    for (size_t i = 0; i < matches.size(); i++)
+    {
+        EXPECT_EQ(matches[i].p0, serialMatches[i].p0);
+        EXPECT_EQ(matches[i].p1, serialMatches[i].p1);
+    }
+}
+
 
 
 }} // namespace
\ No newline at end of file
@@ -59,6 +59,41 @@ namespace ppf_match_3d
 //! @addtogroup surface_matching
 //! @{
 
+/**
+* @brief A scene point cloud prepared for repeated ICP registration.
+*
+* The uniformly sampled pyramid levels of the scene and their KD-trees are built on first use and
+* then shared by every ICP::registerModelToScene call receiving this object, possibly from several
+* threads. Prefer it over passing the scene as a Mat when many models or pose hypotheses are
+* refined against the same scene.
+*/
+class CV_EXPORTS_W ICPScene
+{
+public:
+  /**
+     *  @param [in] dstPC The input point cloud for the scene. Expected to have the normals (Nx6).
+     *  Currently, CV_32F is the only supported data type. The data is referenced, not copied, and
+     *  should not be modified while this object is in use.
+     */
+  CV_WRAP ICPScene(const Mat& dstPC);
+
+  virtual ~ICPScene() { }
+
+  /**
+     *  \brief Returns the scene point cloud.
+     */
+  CV_WRAP Mat getPointCloud() const { return m_pc; }
+
+private:
+  friend class ICP;
+
+  class LevelCache;
+
+  Mat m_pc;
+  Vec3d m_mean;
+  Ptr<LevelCache> m_levels;
+};
+
 /**
 * @brief This class implements a very efficient and robust variant of the iterative closest point (ICP) algorithm.
 * The task is to register a 3D model (or point cloud) against a set of noisy target data. The variants are put together
@@ -151,6 +186,31 @@ public:
      */
   CV_WRAP int registerModelToScene(const Mat& srcPC, const Mat& dstPC, CV_IN_OUT std::vector<Pose3DPtr>& poses);
 
+  /**
+     *  \brief Perform registration against a prepared scene
+     *
+     *  @param [in] srcPC The input point cloud for the model. Expected to have the normals (Nx6). Currently,
+     *  CV_32F is the only supported data type.
+     *  @param [in] scene The prepared scene. Its search structures are reused across calls.
+     *  @param [out] residual The output registration error.
+     *  @param [out] pose Transformation between srcPC and the scene.
+     *  \return On successful termination, the function returns 0.
+     */
+  CV_WRAP int registerModelToScene(const Mat& srcPC, const Ptr<ICPScene>& scene, CV_OUT double& residual, CV_OUT Matx44d& pose);
+
+  /**
+     *  \brief Perform registration with multiple initial poses against a prepared scene
+     *
+     *  @param [in] srcPC The input point cloud for the model. Expected to have the normals (Nx6). Currently,
+     *  CV_32F is the only supported data type.
+     *  @param [in] scene The prepared scene. Its search structures are reused across calls.
+     *  @param [in,out] poses Input poses to start with but also list output of poses.
+     *  \return On successful termination, the function returns 0.
+     *
+     *  \details The poses are refined in parallel.
+     */
+  CV_WRAP int registerModelToScene(const Mat& srcPC, const Ptr<ICPScene>& scene, CV_IN_OUT std::vector<Pose3DPtr>& poses);
+
 private:
   float m_tolerance;
   int m_maxIterations;
@@ -130,6 +130,28 @@ public:
     */
   CV_WRAP void trainModel(const Mat& Model);
 
+  /**
+    *  \brief Saves the trained model to a binary file.
+    *
+    *  @param [in] fileName Name of the file to write
+    *
+    *  \details The file contains the sampled model, the point pair features and the hash table in flat,
+    *  aligned arrays, so that loadModel can use them directly from a read-only memory mapping of the file.
+    */
+  CV_WRAP void saveModel(const String& fileName) const;
+
+  /**
+    *  \brief Loads a model saved with saveModel.
+    *
+    *  @param [in] fileName Name of the file to read
+    *
+    *  \details The file is memory mapped read-only where the platform allows it: loading does not copy the
+    *  model and several processes loading the same file share the same physical memory. The training
+    *  parameters are restored from the file and the search parameters are reset to their defaults, so
+    *  setSearchParams should be called after loading.
+    */
+  CV_WRAP void loadModel(const String& fileName);
+
   /**
     *  \brief Matches a trained model across a provided scene.
     *
@@ -152,6 +174,10 @@ protected:
   hashtable_int* hash_table;
   THash* hash_nodes;
 
+  // flat copy of the hash table used by match: the entries of bucket b are the ppf indices
+  // bucket_entries[bucket_offsets[b]] to bucket_entries[bucket_offsets[b+1]-1]
+  Mat bucket_offsets, bucket_entries;
+
   double position_threshold, rotation_threshold;
   bool use_weighted_avg;
 
@@ -168,7 +194,13 @@ private:
 
   void clusterPoses(std::vector<Pose3DPtr>& poseList, int numPoses, std::vector<Pose3DPtr> &finalPoses);
 
+  void buildFlatHashTable();
+
   bool trained;
+
+  // memory of a model loaded with loadModel, referenced by the model matrices
+  class ModelStorage;
+  Ptr<ModelStorage> model_storage;
 };
 
 //! @}
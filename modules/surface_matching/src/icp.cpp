@@ -39,6 +39,10 @@
 // Author: Tolga Birdal <tbirdal AT gmail.com>
 
 #include "precomp.hpp"
+#include "opencv2/core/utility.hpp"
+#include "opencv2/core/hal/intrin.hpp"
+
+#include <map>
 
 namespace cv
 {
@@ -107,6 +111,23 @@ static double computeDistToOrigin(Mat srcPC)
   return dist;
 }
 
+// compute the average distance to the given point, equivalent to subtracting it and calling computeDistToOrigin
+static double computeDistToPoint(Mat srcPC, const Vec3d& point)
+{
+  const float px = (float)point[0], py = (float)point[1], pz = (float)point[2];
+  int height = srcPC.rows;
+  double dist = 0;
+
+  for (int i=0; i<height; i++)
+  {
+    const float *row = srcPC.ptr<float>(i);
+    const float x = row[0]-px, y = row[1]-py, z = row[2]-pz;
+    dist += sqrt(x*x+y*y+z*z);
+  }
+
+  return dist;
+}
+
 // From numerical receipes: Finds the median of an array
 static float medianF(float arr[], int n)
 {
@@ -191,32 +212,93 @@ static float getRejectionThreshold(float* r, int m, float outlierScale)
   return threshold;
 }
 
-// Kok Lim Low's linearization
-static void minimizePointToPlaneMetric(Mat Src, Mat Dst, Vec3d& rpy, Vec3d& t)
+// Rows of correspondences accumulated per parallel block. Fixed so that the summation order,
+// and therefore the result, does not depend on the number of threads.
+static const int ICP_NORMAL_EQ_BLOCK = 1024;
+
+// Accumulates the rows [src x n, n | (dst - src).n] of the point to plane system into a 6x8 block
+// holding A^T A in the first six columns and A^T b in the seventh
+static void accumulatePointToPlane(const Mat& Src, const Mat& Dst, int begin, int end, double* acc)
 {
-  //Mat sub = Dst - Src;
-  Mat A = Mat(Src.rows, 6, CV_64F);
-  Mat b = Mat(Src.rows, 1, CV_64F);
-  Mat rpy_t;
+#if CV_SIMD128_64F
+  v_float64x2 s[6][4];
+  for (int r=0; r<6; r++)
+    for (int c=0; c<4; c++)
+      s[r][c] = v_setzero_f64();
+#endif
 
-#if defined _OPENMP
-#pragma omp parallel for
+  for (int i=begin; i<end; i++)
+  {
+    const double* srcPt = Src.ptr<double>(i);
+    const double* dstPt = Dst.ptr<double>(i);
+    const double* normal = dstPt + 3;
+    double a[8];
+
+    a[0] = srcPt[1]*normal[2] - srcPt[2]*normal[1];
+    a[1] = srcPt[2]*normal[0] - srcPt[0]*normal[2];
+    a[2] = srcPt[0]*normal[1] - srcPt[1]*normal[0];
+    a[3] = normal[0];
+    a[4] = normal[1];
+    a[5] = normal[2];
+    a[6] = (dstPt[0]-srcPt[0])*normal[0] + (dstPt[1]-srcPt[1])*normal[1] + (dstPt[2]-srcPt[2])*normal[2];
+    a[7] = 0;
+
+#if CV_SIMD128_64F
+    const v_float64x2 a01 = v_load(a), a23 = v_load(a + 2), a45 = v_load(a + 4), a67 = v_load(a + 6);
+    for (int r=0; r<6; r++)
+    {
+      const v_float64x2 ar = v_setall_f64(a[r]);
+      s[r][0] = v_muladd(ar, a01, s[r][0]);
+      s[r][1] = v_muladd(ar, a23, s[r][1]);
+      s[r][2] = v_muladd(ar, a45, s[r][2]);
+      s[r][3] = v_muladd(ar, a67, s[r][3]);
+    }
+#else
+    for (int r=0; r<6; r++)
+      for (int c=0; c<8; c++)
+        acc[r*8+c] += a[r]*a[c];
+#endif
+  }
+
+#if CV_SIMD128_64F
+  for (int r=0; r<6; r++)
+    for (int c=0; c<4; c++)
+      v_store(acc + r*8 + c*2, s[r][c]);
 #endif
-  for (int i=0; i<Src.rows; i++)
+}
+
+// Kok Lim Low's linearization, solved through the 6x6 normal equations
+static void minimizePointToPlaneMetric(Mat Src, Mat Dst, Vec3d& rpy, Vec3d& t)
+{
+  const int numBlocks = divUp(Src.rows, ICP_NORMAL_EQ_BLOCK);
+  std::vector<double> blockAcc((size_t)numBlocks*6*8, 0.);
+
+  parallel_for_(Range(0, numBlocks), [&](const Range& range)
+  {
+    for (int blk=range.start; blk<range.end; blk++)
+    {
+      const int begin = blk*ICP_NORMAL_EQ_BLOCK;
+      const int end = std::min(begin + ICP_NORMAL_EQ_BLOCK, Src.rows);
+      accumulatePointToPlane(Src, Dst, begin, end, &blockAcc[(size_t)blk*6*8]);
+    }
+  });
+
+  Matx66d AtA;
+  Vec6d Atb;
+  for (int blk=0; blk<numBlocks; blk++)
   {
-    const Vec3d srcPt(Src.ptr<double>(i));
-    const Vec3d dstPt(Dst.ptr<double>(i));
-    const Vec3d normals(Dst.ptr<double>(i) + 3);
-    const Vec3d sub = dstPt - srcPt;
-    const Vec3d axis = srcPt.cross(normals);
-
-    *b.ptr<double>(i) = sub.dot(normals);
-    hconcat(axis.reshape<1, 3>(), normals.reshape<1, 3>(), A.row(i));
+    const double* acc = &blockAcc[(size_t)blk*6*8];
+    for (int r=0; r<6; r++)
+    {
+      for (int c=0; c<6; c++)
+        AtA(r, c) += acc[r*8+c];
+      Atb[r] += acc[r*8+6];
+    }
   }
 
-  cv::solve(A, b, rpy_t, DECOMP_SVD);
-  rpy_t.rowRange(0, 3).copyTo(rpy);
-  rpy_t.rowRange(3, 6).copyTo(t);
+  const Vec6d rpy_t = AtA.solve(Atb, DECOMP_SVD);
+  rpy = Vec3d(rpy_t[0], rpy_t[1], rpy_t[2]);
+  t = Vec3d(rpy_t[3], rpy_t[4], rpy_t[5]);
 }
 
 static void getTransformMat(Vec3d& euler, Vec3d& t, Matx44d& Pose)
@@ -242,33 +324,94 @@ static hashtable_int* getHashtable(int* data, size_t length, int numMaxElement)
   return hashtable;
 }
 
+// Sampled pyramid levels of the scene with their KD-trees, keyed by the sampling step. Levels are
+// built in the scene's own coordinate frame: nearest neighbours are invariant to the translation and
+// isotropic scaling ICP applies to each model/scene pair, so they can be shared by all registrations.
+class ICPScene::LevelCache
+{
+public:
+  struct Level
+  {
+    Mat points;
+    void* flann;
+  };
+
+  ~LevelCache()
+  {
+    for (std::map<int, Level>::iterator it = levels.begin(); it != levels.end(); ++it)
+      destroyFlann(it->second.flann);
+  }
+
+  const Level& get(const Mat& pc, int sampleStep)
+  {
+    AutoLock lock(mutex);
+    std::map<int, Level>::iterator it = levels.find(sampleStep);
+    if (it == levels.end())
+    {
+      Level level;
+      level.points = samplePCUniform(pc, sampleStep);
+      level.flann = indexPCFlann(level.points);
+      it = levels.insert(std::make_pair(sampleStep, level)).first;
+    }
+    return it->second;
+  }
+
+private:
+  Mutex mutex;
+  std::map<int, Level> levels;
+};
+
+ICPScene::ICPScene(const Mat& dstPC)
+{
+  CV_CheckGT(dstPC.rows, 0, "");
+  CV_CheckTypeEQ(dstPC.type(), CV_32FC1, "");
+  CV_CheckGE(dstPC.cols, 6, "Scene normals are required");
+
+  m_pc = dstPC;
+  computeMeanCols(m_pc, m_mean);
+  m_levels = makePtr<LevelCache>();
+}
+
 // source point clouds are assumed to contain their normals
 int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, double& residual, Matx44d& pose)
+{
+  return registerModelToScene(srcPC, makePtr<ICPScene>(dstPC), residual, pose);
+}
+
+// source point clouds are assumed to contain their normals
+int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, std::vector<Pose3DPtr>& poses)
+{
+  return registerModelToScene(srcPC, makePtr<ICPScene>(dstPC), poses);
+}
+
+// source point clouds are assumed to contain their normals
+int ICP::registerModelToScene(const Mat& srcPC, const Ptr<ICPScene>& scene, double& residual, Matx44d& pose)
 {
   int n = srcPC.rows;
   CV_CheckGT(n, 0, "");
+  CV_Assert(scene);
 
   const bool useRobustReject = m_rejectionScale>0;
 
+  // the scene is left in its own frame, only the model is normalized here
+  const Mat& dstPC = scene->m_pc;
   Mat srcTemp = srcPC.clone();
-  Mat dstTemp = dstPC.clone();
-  Vec3d meanSrc, meanDst;
+  Vec3d meanSrc;
   computeMeanCols(srcTemp, meanSrc);
-  computeMeanCols(dstTemp, meanDst);
-  Vec3d meanAvg = 0.5 * (meanSrc + meanDst);
+  Vec3d meanAvg = 0.5 * (meanSrc + scene->m_mean);
   subtractColumns(srcTemp, meanAvg);
-  subtractColumns(dstTemp, meanAvg);
 
   double distSrc = computeDistToOrigin(srcTemp);
-  double distDst = computeDistToOrigin(dstTemp);
+  double distDst = computeDistToPoint(dstPC, meanAvg);
 
   double scale = (double)n / ((distSrc + distDst)*0.5);
+  const double invScale = 1.0 / scale;
+  const double sqrScale = scale * scale;
+  const float meanAvgF[3] = {(float)meanAvg[0], (float)meanAvg[1], (float)meanAvg[2]};
 
   srcTemp(cv::Range(0, srcTemp.rows), cv::Range(0,3)) *= scale;
-  dstTemp(cv::Range(0, dstTemp.rows), cv::Range(0,3)) *= scale;
 
   Mat srcPC0 = srcTemp;
-  Mat dstPC0 = dstTemp;
 
   // initialize pose
   pose = Matx44d::eye();
@@ -295,8 +438,9 @@ int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, double& residu
     Tolga Birdal thinks that downsampling the scene points might decrease the accuracy.
     Hamdi Sahloul, however, noticed that accuracy increased (pose residual decreased slightly).
     */
-    Mat dstPCS = samplePCUniform(dstPC0, sampleStep);
-    void* flann = indexPCFlann(dstPCS);
+    const ICPScene::LevelCache::Level& sceneLevel = scene->m_levels->get(dstPC, sampleStep);
+    const Mat& dstPCS = sceneLevel.points;
+    void* flann = sceneLevel.flann;
 
     double fval_old=9999999999;
     double fval_perc=0;
@@ -312,6 +456,8 @@ int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, double& residu
 
     Mat Indices(2, sizesResult, CV_32S, indices, 0);
     Mat Distances(2, sizesResult, CV_32F, distances, 0);
+    const int numQuery = Src_Moved.rows;
+    Mat Query(numQuery, 3, CV_32F);
 
     // use robust weighting for outlier treatment
     int* indicesModel = new int[numElSrc];
@@ -326,7 +472,18 @@ int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, double& residu
     {
       uint di=0, selInd = 0;
 
-      queryPCFlann(flann, Src_Moved, Indices, Distances);
+      // search in the scene frame and bring the squared distances back to the normalized one
+      for (int qi=0; qi<numQuery; qi++)
+      {
+        const float *movedPt = Src_Moved.ptr<float>(qi);
+        float *queryPt = Query.ptr<float>(qi);
+        queryPt[0] = (float)(movedPt[0]*invScale + meanAvg[0]);
+        queryPt[1] = (float)(movedPt[1]*invScale + meanAvg[1]);
+        queryPt[2] = (float)(movedPt[2]*invScale + meanAvg[2]);
+      }
+      queryPCFlann(flann, Query, Indices, Distances);
+      for (int qi=0; qi<numQuery; qi++)
+        distances[qi] = (float)(distances[qi]*sqrScale);
 
       for (di=0; di<numElSrc; di++)
       {
@@ -413,7 +570,7 @@ int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, double& residu
           for (ci=0; ci<srcPCT.cols; ci++)
           {
             srcMatchPt[ci] = (double)srcPt[ci];
-            dstMatchPt[ci] = (double)dstPt[ci];
+            dstMatchPt[ci] = ci<3 ? (double)saturate_cast<float>((dstPt[ci]-meanAvgF[ci])*scale) : (double)dstPt[ci];
           }
         }
 
@@ -453,7 +610,6 @@ int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, double& residu
     delete[] indices;
 
     tempResidual = fval_min;
-    destroyFlann(flann);
   }
 
   Matx33d Rpose;
@@ -468,18 +624,20 @@ int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, double& residu
 }
 
 // source point clouds are assumed to contain their normals
-int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, std::vector<Pose3DPtr>& poses)
+int ICP::registerModelToScene(const Mat& srcPC, const Ptr<ICPScene>& scene, std::vector<Pose3DPtr>& poses)
 {
-  #if defined _OPENMP
-  #pragma omp parallel for
-  #endif
-  for (int i=0; i<(int)poses.size(); i++)
+  CV_Assert(scene);
+
+  parallel_for_(Range(0, (int)poses.size()), [&](const Range& range)
   {
-    Matx44d poseICP = Matx44d::eye();
-    Mat srcTemp = transformPCPose(srcPC, poses[i]->pose);
-    registerModelToScene(srcTemp, dstPC, poses[i]->residual, poseICP);
-    poses[i]->appendPose(poseICP);
-  }
+    for (int i=range.start; i<range.end; i++)
+    {
+      Matx44d poseICP = Matx44d::eye();
+      Mat srcTemp = transformPCPose(srcPC, poses[i]->pose);
+      registerModelToScene(srcTemp, scene, poses[i]->residual, poseICP);
+      poses[i]->appendPose(poseICP);
+    }
+  });
   return 0;
 }
 
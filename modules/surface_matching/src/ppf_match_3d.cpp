@@ -41,6 +41,22 @@
 #include "precomp.hpp"
 #include "hash_murmur.hpp"
 
+#if defined _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined __unix__ || defined __APPLE__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define PPF_MODEL_USE_MMAP 1
+#endif
+
 namespace cv
 {
 namespace ppf_match_3d
@@ -48,6 +64,122 @@ namespace ppf_match_3d
 
 static const size_t PPF_LENGTH = 5;
 
+// binary model file layout: a ModelFileHeader followed by the sampled model, the point pair
+// features, the bucket offsets and the bucket entries, each section aligned to MODEL_ALIGNMENT
+static const char MODEL_MAGIC[8] = { 'P', 'P', 'F', '3', 'D', 'M', 'D', 'L' };
+static const int MODEL_VERSION = 1;
+static const size_t MODEL_ALIGNMENT = 64;
+
+struct ModelFileHeader
+{
+  char magic[8];
+  int version;
+  int endianness;  // 1 as written by the machine that saved the model
+  double angle_step, angle_step_radians, distance_step;
+  double sampling_step_relative, angle_step_relative, distance_step_relative;
+  int num_ref_points;
+  int sampled_rows, sampled_cols;
+  int num_buckets, num_entries;
+  int reserved;
+  uint64 sampled_offset, ppf_offset, buckets_offset, entries_offset, file_size;
+};
+
+static uint64 alignModelOffset(uint64 offset)
+{
+  return (offset + MODEL_ALIGNMENT - 1) & ~(uint64)(MODEL_ALIGNMENT - 1);
+}
+
+/**
+  * @brief Read-only memory of a model file: a memory mapping of the file, or a copy of it in
+  * memory on platforms without memory mapping
+  */
+class PPF3DDetector::ModelStorage
+{
+public:
+  ModelStorage() : data(0), size(0)
+  {
+#if defined _WIN32
+    file = INVALID_HANDLE_VALUE;
+    mapping = NULL;
+#endif
+  }
+
+  ~ModelStorage()
+  {
+#if defined _WIN32
+    if (data)
+      UnmapViewOfFile(data);
+    if (mapping)
+      CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE)
+      CloseHandle(file);
+#elif defined PPF_MODEL_USE_MMAP
+    if (data)
+      munmap((void*)data, size);
+#endif
+  }
+
+  bool open(const String& fileName)
+  {
+#if defined _WIN32
+    file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+      return false;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+      return false;
+    size = (size_t)fileSize.QuadPart;
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping)
+      return false;
+    data = (const uchar*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    return data != NULL;
+#elif defined PPF_MODEL_USE_MMAP
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+      close(fd);
+      return false;
+    }
+    void* ptr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED)
+      return false;
+    data = (const uchar*)ptr;
+    size = (size_t)st.st_size;
+    return true;
+#else
+    // the data of a Mat is CV_MALLOC_ALIGN aligned, enough for the sections of the model
+    std::ifstream f(fileName.c_str(), std::ios::binary | std::ios::ate);
+    if (!f.is_open())
+      return false;
+    const std::streamoff fileSize = f.tellg();
+    if (fileSize <= 0 || fileSize > INT_MAX)
+      return false;
+    buffer.create(1, (int)fileSize, CV_8UC1);
+    f.seekg(0, std::ios::beg);
+    f.read((char*)buffer.data, fileSize);
+    data = buffer.data;
+    size = (size_t)fileSize;
+    return !f.fail();
+#endif
+  }
+
+  const uchar* data;
+  size_t size;
+
+private:
+#if defined _WIN32
+  HANDLE file, mapping;
+#elif !defined PPF_MODEL_USE_MMAP
+  Mat buffer;
+#endif
+};
+
 // routines for assisting sort
 static bool pose3DPtrCompare(const Pose3DPtr& a, const Pose3DPtr& b)
 {
@@ -192,6 +324,13 @@ void PPF3DDetector::clearTrainingModels()
     hashtableDestroy(this->hash_table);
     this->hash_table=0;
   }
+
+  sampled_pc.release();
+  ppf.release();
+  bucket_offsets.release();
+  bucket_entries.release();
+  model_storage.release();
+  trained = false;
 }
 
 PPF3DDetector::~PPF3DDetector()
@@ -204,6 +343,8 @@ void PPF3DDetector::trainModel(const Mat &PC)
 {
   CV_Assert(PC.type() == CV_32F || PC.type() == CV_32FC1);
 
+  clearTrainingModels();
+
   // compute bbox
   Vec2f xRange, yRange, zRange;
   computeBboxStd(PC, xRange, yRange, zRange);
@@ -223,7 +364,9 @@ void PPF3DDetector::trainModel(const Mat &PC)
   hashtable_int* hashTable = hashtableCreate(size, NULL);
 
   int numPPF = sampled.rows*sampled.rows;
-  ppf = Mat(numPPF, PPF_LENGTH, CV_32FC1);
+  // the rows of the pairs of a point with itself are never computed, they are zeroed so that
+  // saveModel writes defined values
+  ppf = Mat::zeros(numPPF, PPF_LENGTH, CV_32FC1);
 
   // TODO: Maybe I could sample 1/5th of them here. Check the performance later.
   int numRefPoints = sampled.rows;
@@ -231,40 +374,53 @@ void PPF3DDetector::trainModel(const Mat &PC)
   // pre-allocate the hash nodes
   hash_nodes = (THash*)calloc(numRefPoints*numRefPoints, sizeof(THash));
 
-  // TODO : This can easily be parallelized. But we have to lock hashtable_insert.
-  // I realized that performance drops when this loop is parallelized (unordered
-  // inserts into the hashtable
-  // But it is still there to be investigated. For now, I leave this unparallelized
-  // since this is just a training part.
-  for (int i=0; i<numRefPoints; i++)
+  // The features, their hashes and angles are computed in parallel, each reference point
+  // filling its own rows of hash_nodes and ppf.
+  parallel_for_(Range(0, numRefPoints), [&](const Range& range)
   {
-    const Vec3f p1(sampled.ptr<float>(i));
-    const Vec3f n1(sampled.ptr<float>(i) + 3);
+    for (int i = range.start; i < range.end; i++)
+    {
+      const Vec3f p1(sampled.ptr<float>(i));
+      const Vec3f n1(sampled.ptr<float>(i) + 3);
+
+      for (int j=0; j<numRefPoints; j++)
+      {
+        // cannot compute the ppf with myself
+        if (i!=j)
+        {
+          const Vec3f p2(sampled.ptr<float>(j));
+          const Vec3f n2(sampled.ptr<float>(j) + 3);
+
+          Vec4d f = Vec4d::all(0);
+          computePPFFeatures(p1, n1, p2, n2, f);
+          KeyType hashValue = hashPPF(f, angle_step_radians, distanceStep);
+          double alpha = computeAlpha(p1, n1, p2);
+          uint ppfInd = i*numRefPoints+j;
+
+          THash* hashNode = &hash_nodes[i*numRefPoints+j];
+          hashNode->id = hashValue;
+          hashNode->i = i;
+          hashNode->ppfInd = ppfInd;
+
+          float* ppfRow = ppf.ptr<float>(ppfInd);
+          for (int k = 0; k < 4; k++)
+            ppfRow[k] = (float)f[k];
+          ppfRow[4] = (float)alpha;
+        }
+      }
+    }
+  });
 
-    //printf("///////////////////// NEW REFERENCE ////////////////////////\n");
+  // The insertion into the hashtable is kept serial and in the original order, so that the
+  // table is the same as the one built by a sequential training
+  for (int i=0; i<numRefPoints; i++)
+  {
     for (int j=0; j<numRefPoints; j++)
     {
-      // cannot compute the ppf with myself
       if (i!=j)
       {
-        const Vec3f p2(sampled.ptr<float>(j));
-        const Vec3f n2(sampled.ptr<float>(j) + 3);
-
-        Vec4d f = Vec4d::all(0);
-        computePPFFeatures(p1, n1, p2, n2, f);
-        KeyType hashValue = hashPPF(f, angle_step_radians, distanceStep);
-        double alpha = computeAlpha(p1, n1, p2);
-        uint ppfInd = i*numRefPoints+j;
-
         THash* hashNode = &hash_nodes[i*numRefPoints+j];
-        hashNode->id = hashValue;
-        hashNode->i = i;
-        hashNode->ppfInd = ppfInd;
-
-        hashtableInsertHashed(hashTable, hashValue, (void*)hashNode);
-
-        Mat(f).reshape(1, 1).convertTo(ppf.row(ppfInd).colRange(0, 4), CV_32F);
-        ppf.ptr<float>(ppfInd)[4] = (float)alpha;
+        hashtableInsertHashed(hashTable, hashNode->id, (void*)hashNode);
       }
     }
   }
@@ -274,7 +430,202 @@ void PPF3DDetector::trainModel(const Mat &PC)
   hash_table = hashTable;
   num_ref_points = numRefPoints;
   sampled_pc = sampled;
+
+  buildFlatHashTable();
+
+  trained = true;
+}
+
+void PPF3DDetector::buildFlatHashTable()
+{
+  const int numBuckets = (int)hash_table->size;
+  bucket_offsets.create(1, numBuckets + 1, CV_32S);
+  int* offsets = bucket_offsets.ptr<int>();
+
+  offsets[0] = 0;
+  for (int b = 0; b < numBuckets; b++)
+  {
+    int count = 0;
+    for (hashnode_i* node = hash_table->nodes[b]; node; node = node->next)
+      count++;
+    offsets[b + 1] = offsets[b] + count;
+  }
+
+  bucket_entries.create(1, std::max(offsets[numBuckets], 1), CV_32S);
+  int* entries = bucket_entries.ptr<int>();
+  parallel_for_(Range(0, numBuckets), [&](const Range& range)
+  {
+    for (int b = range.start; b < range.end; b++)
+    {
+      int e = offsets[b];
+      for (hashnode_i* node = hash_table->nodes[b]; node; node = node->next)
+        entries[e++] = ((THash*)node->data)->ppfInd;
+    }
+  });
+}
+
+void PPF3DDetector::saveModel(const String& fileName) const
+{
+  if (!trained)
+  {
+    throw cv::Exception(cv::Error::StsError, "The model is not trained. Cannot save without training", __FUNCTION__, __FILE__, __LINE__);
+  }
+  CV_Assert(sampled_pc.isContinuous() && ppf.isContinuous() &&
+            bucket_offsets.isContinuous() && bucket_entries.isContinuous());
+
+  ModelFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MODEL_MAGIC, sizeof(header.magic));
+  header.version = MODEL_VERSION;
+  header.endianness = 1;
+  header.angle_step = angle_step;
+  header.angle_step_radians = angle_step_radians;
+  header.distance_step = distance_step;
+  header.sampling_step_relative = sampling_step_relative;
+  header.angle_step_relative = angle_step_relative;
+  header.distance_step_relative = distance_step_relative;
+  header.num_ref_points = num_ref_points;
+  header.sampled_rows = sampled_pc.rows;
+  header.sampled_cols = sampled_pc.cols;
+  header.num_buckets = (int)bucket_offsets.total() - 1;
+  header.num_entries = (int)bucket_entries.total();
+
+  const size_t sampledSize = sampled_pc.total() * sizeof(float);
+  const size_t ppfSize = ppf.total() * sizeof(float);
+  const size_t bucketsSize = bucket_offsets.total() * sizeof(int);
+  const size_t entriesSize = bucket_entries.total() * sizeof(int);
+  header.sampled_offset = alignModelOffset(sizeof(header));
+  header.ppf_offset = alignModelOffset(header.sampled_offset + sampledSize);
+  header.buckets_offset = alignModelOffset(header.ppf_offset + ppfSize);
+  header.entries_offset = alignModelOffset(header.buckets_offset + bucketsSize);
+  header.file_size = header.entries_offset + entriesSize;
+
+  std::ofstream f(fileName.c_str(), std::ios::binary);
+  if (!f.is_open())
+  {
+    CV_Error(Error::StsError, "Cannot open the model file for writing: " + fileName);
+  }
+
+  const char padding[MODEL_ALIGNMENT] = { 0 };
+  f.write((const char*)&header, sizeof(header));
+  f.write(padding, (std::streamsize)(header.sampled_offset - sizeof(header)));
+  f.write((const char*)sampled_pc.data, sampledSize);
+  f.write(padding, (std::streamsize)(header.ppf_offset - header.sampled_offset - sampledSize));
+  f.write((const char*)ppf.data, ppfSize);
+  f.write(padding, (std::streamsize)(header.buckets_offset - header.ppf_offset - ppfSize));
+  f.write((const char*)bucket_offsets.data, bucketsSize);
+  f.write(padding, (std::streamsize)(header.entries_offset - header.buckets_offset - bucketsSize));
+  f.write((const char*)bucket_entries.data, entriesSize);
+
+  if (f.fail())
+  {
+    CV_Error(Error::StsError, "Cannot write the model file: " + fileName);
+  }
+}
+
+// match() indexes the features and the reference points with the table without checks, so a
+// truncated or corrupt file is rejected here: the bucket offsets must be non-decreasing and
+// inside the entries, every entry must be a point pair feature with a valid angle. Only the
+// features referenced by the table are read by match, the other ones are not checked.
+static void checkFlatHashTable(const String& fileName, const Mat& bucketOffsets, const Mat& bucketEntries,
+                               const Mat& ppf, int numPPF)
+{
+  const int numBuckets = (int)bucketOffsets.total() - 1;
+  const int numEntries = (int)bucketEntries.total();
+  const int* offsets = bucketOffsets.ptr<int>();
+  const int* entries = bucketEntries.ptr<int>();
+
+  bool valid = offsets[0] == 0 && offsets[numBuckets] <= numEntries;
+  for (int b = 0; valid && b < numBuckets; b++)
+    valid = offsets[b] <= offsets[b + 1];
+  for (int e = 0; valid && e < offsets[numBuckets]; e++)
+  {
+    valid = 0 <= entries[e] && entries[e] < numPPF;
+    if (valid)
+    {
+      const float alpha = ppf.ptr<float>(entries[e])[PPF_LENGTH - 1];
+      valid = -(float)CV_PI <= alpha && alpha <= (float)CV_PI;
+    }
+  }
+
+  if (!valid)
+  {
+    CV_Error(Error::StsParseError, "Invalid model file: " + fileName);
+  }
+}
+
+void PPF3DDetector::loadModel(const String& fileName)
+{
+  clearTrainingModels();
+
+  Ptr<ModelStorage> storage = makePtr<ModelStorage>();
+  if (!storage->open(fileName))
+  {
+    CV_Error(Error::StsError, "Cannot open the model file: " + fileName);
+  }
+
+  if (storage->size < sizeof(ModelFileHeader))
+  {
+    CV_Error(Error::StsParseError, "Invalid model file: " + fileName);
+  }
+  const ModelFileHeader& header = *(const ModelFileHeader*)storage->data;
+  // the number of point pairs, num_ref_points squared, must fit in an int; match reads the point
+  // and its normal from the first 6 columns of the sampled model and derives the number of angles
+  // and the distance quantization from the steps
+  if (memcmp(header.magic, MODEL_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != MODEL_VERSION || header.endianness != 1 ||
+      header.file_size != storage->size || header.num_ref_points != header.sampled_rows ||
+      header.num_ref_points <= 0 || header.num_ref_points > 46340 || header.sampled_cols < 6 ||
+      header.num_buckets <= 0 || header.num_buckets == INT_MAX || header.num_entries <= 0 ||
+      !(header.angle_step > 0 && header.angle_step <= CV_PI) || !(header.distance_step > 0))
+  {
+    CV_Error(Error::StsParseError, "Invalid or incompatible model file: " + fileName);
+  }
+
+  // every section must be aligned, follow the previous one and hold its array; the sizes are
+  // compared with the distances between the offsets so that nothing can wrap around
+  const int numPPF = header.num_ref_points * header.num_ref_points;
+  const uint64 sampledSize = (uint64)header.sampled_rows * header.sampled_cols * sizeof(float);
+  const uint64 ppfSize = (uint64)numPPF * PPF_LENGTH * sizeof(float);
+  const uint64 bucketsSize = ((uint64)header.num_buckets + 1) * sizeof(int);
+  const uint64 entriesSize = (uint64)header.num_entries * sizeof(int);
+  const uint64 sections[] = { header.sampled_offset, header.ppf_offset, header.buckets_offset,
+                              header.entries_offset, header.file_size };
+  const uint64 sectionSizes[] = { sampledSize, ppfSize, bucketsSize, entriesSize };
+  bool validLayout = header.sampled_offset >= sizeof(ModelFileHeader);
+  for (int i = 0; validLayout && i < 4; i++)
+  {
+    validLayout = sections[i] % MODEL_ALIGNMENT == 0 && sections[i] <= sections[i + 1] &&
+                  sectionSizes[i] <= sections[i + 1] - sections[i];
+  }
+  if (!validLayout)
+  {
+    CV_Error(Error::StsParseError, "Invalid model file: " + fileName);
+  }
+
+  // the matrices reference the read-only storage, they are never written by match
+  uchar* data = (uchar*)storage->data;
+  Mat ppfMapped(numPPF, (int)PPF_LENGTH, CV_32FC1, data + header.ppf_offset);
+  Mat offsetsMapped(1, header.num_buckets + 1, CV_32S, data + header.buckets_offset);
+  Mat entriesMapped(1, header.num_entries, CV_32S, data + header.entries_offset);
+  checkFlatHashTable(fileName, offsetsMapped, entriesMapped, ppfMapped, numPPF);
+
+  sampled_pc = Mat(header.sampled_rows, header.sampled_cols, CV_32FC1, data + header.sampled_offset);
+  ppf = ppfMapped;
+  bucket_offsets = offsetsMapped;
+  bucket_entries = entriesMapped;
+
+  angle_step = header.angle_step;
+  angle_step_radians = header.angle_step_radians;
+  distance_step = header.distance_step;
+  sampling_step_relative = header.sampling_step_relative;
+  angle_step_relative = header.angle_step_relative;
+  distance_step_relative = header.distance_step_relative;
+  num_ref_points = header.num_ref_points;
+  model_storage = storage;
   trained = true;
+
+  setSearchParams();
 }
 
 
@@ -302,25 +653,48 @@ void PPF3DDetector::clusterPoses(std::vector<Pose3DPtr>& poseList, int numPoses,
   // sort the poses for stability
   std::sort(poseList.begin(), poseList.end(), pose3DPtrCompare);
 
-  for (int i=0; i<numPoses; i++)
+  // Each pose joins the first cluster whose center (first pose) matches it, or starts a new
+  // cluster. The poses are processed in blocks: the comparison of a block of poses against the
+  // existing cluster centers runs in parallel, then the poses of the block that matched none of
+  // them are compared serially against the centers created inside the block. The clusters are
+  // the same as with a fully serial assignment.
+  const int blockSize = 256;
+  std::vector<int> firstMatch(blockSize);
+  for (int blockStart = 0; blockStart < numPoses; blockStart += blockSize)
   {
-    Pose3DPtr pose = poseList[i];
-    bool assigned = false;
+    const int blockEnd = std::min(blockStart + blockSize, numPoses);
+    const int numClustersBefore = (int)poseClusters.size();
 
-    // search all clusters
-    for (size_t j=0; j<poseClusters.size() && !assigned; j++)
+    parallel_for_(Range(blockStart, blockEnd), [&](const Range& range)
     {
-      const Pose3DPtr poseCenter = poseClusters[j]->poseList[0];
-      if (matchPose(*pose, *poseCenter))
+      for (int i = range.start; i < range.end; i++)
       {
-        poseClusters[j]->addPose(pose);
-        assigned = true;
+        int clusterIdx = -1;
+        for (int j = 0; j < numClustersBefore && clusterIdx < 0; j++)
+        {
+          if (matchPose(*poseList[i], *poseClusters[j]->poseList[0]))
+            clusterIdx = j;
+        }
+        firstMatch[i - blockStart] = clusterIdx;
       }
-    }
+    });
 
-    if (!assigned)
+    for (int i = blockStart; i < blockEnd; i++)
     {
-      poseClusters.push_back(PoseCluster3DPtr(new PoseCluster3D(pose)));
+      Pose3DPtr pose = poseList[i];
+      int clusterIdx = firstMatch[i - blockStart];
+
+      // search the clusters created in this block
+      for (size_t j = numClustersBefore; j < poseClusters.size() && clusterIdx < 0; j++)
+      {
+        if (matchPose(*pose, *poseClusters[j]->poseList[0]))
+          clusterIdx = (int)j;
+      }
+
+      if (clusterIdx >= 0)
+        poseClusters[clusterIdx]->addPose(pose);
+      else
+        poseClusters.push_back(PoseCluster3DPtr(new PoseCluster3D(pose)));
     }
   }
 
@@ -333,75 +707,75 @@ void PPF3DDetector::clusterPoses(std::vector<Pose3DPtr>& poseList, int numPoses,
 
   if (use_weighted_avg)
   {
-#if defined _OPENMP
-#pragma omp parallel for
-#endif
     // uses weighting by the number of votes
-    for (int i=0; i<static_cast<int>(poseClusters.size()); i++)
+    parallel_for_(Range(0, static_cast<int>(poseClusters.size())), [&](const Range& range)
     {
-      // We could only average the quaternions. So I will make use of them here
-      Vec4d qAvg = Vec4d::all(0);
-      Vec3d tAvg = Vec3d::all(0);
+      for (int i = range.start; i < range.end; i++)
+      {
+        // We could only average the quaternions. So I will make use of them here
+        Vec4d qAvg = Vec4d::all(0);
+        Vec3d tAvg = Vec3d::all(0);
 
-      // Perform the final averaging
-      PoseCluster3DPtr curCluster = poseClusters[i];
-      std::vector<Pose3DPtr> curPoses = curCluster->poseList;
-      int curSize = (int)curPoses.size();
-      size_t numTotalVotes = 0;
+        // Perform the final averaging
+        PoseCluster3DPtr curCluster = poseClusters[i];
+        std::vector<Pose3DPtr> curPoses = curCluster->poseList;
+        int curSize = (int)curPoses.size();
+        size_t numTotalVotes = 0;
 
-      for (int j=0; j<curSize; j++)
-        numTotalVotes += curPoses[j]->numVotes;
+        for (int j=0; j<curSize; j++)
+          numTotalVotes += curPoses[j]->numVotes;
 
-      double wSum=0;
+        double wSum=0;
 
-      for (int j=0; j<curSize; j++)
-      {
-        const double w = (double)curPoses[j]->numVotes / (double)numTotalVotes;
+        for (int j=0; j<curSize; j++)
+        {
+          const double w = (double)curPoses[j]->numVotes / (double)numTotalVotes;
 
-        qAvg += w * curPoses[j]->q;
-        tAvg += w * curPoses[j]->t;
-        wSum += w;
-      }
+          qAvg += w * curPoses[j]->q;
+          tAvg += w * curPoses[j]->t;
+          wSum += w;
+        }
 
-      tAvg *= 1.0 / wSum;
-      qAvg *= 1.0 / wSum;
+        tAvg *= 1.0 / wSum;
+        qAvg *= 1.0 / wSum;
 
-      curPoses[0]->updatePoseQuat(qAvg, tAvg);
-      curPoses[0]->numVotes=curCluster->numVotes;
+        curPoses[0]->updatePoseQuat(qAvg, tAvg);
+        curPoses[0]->numVotes=curCluster->numVotes;
 
-      finalPoses[i]=curPoses[0]->clone();
-    }
+        finalPoses[i]=curPoses[0]->clone();
+      }
+    });
   }
   else
   {
-#if defined _OPENMP
-#pragma omp parallel for
-#endif
-    for (int i=0; i<static_cast<int>(poseClusters.size()); i++)
+    parallel_for_(Range(0, static_cast<int>(poseClusters.size())), [&](const Range& range)
     {
-      // We could only average the quaternions. So I will make use of them here
-      Vec4d qAvg = Vec4d::all(0);
-      Vec3d tAvg = Vec3d::all(0);
+      for (int i = range.start; i < range.end; i++)
+      {
+        // We could only average the quaternions. So I will make use of them here
+        Vec4d qAvg = Vec4d::all(0);
+        Vec3d tAvg = Vec3d::all(0);
 
-      // Perform the final averaging
-      PoseCluster3DPtr curCluster = poseClusters[i];
-      std::vector<Pose3DPtr> curPoses = curCluster->poseList;
-      const int curSize = (int)curPoses.size();
+        // Perform the final averaging
+        PoseCluster3DPtr curCluster = poseClusters[i];
+        std::vector<Pose3DPtr> curPoses = curCluster->poseList;
+        const int curSize = (int)curPoses.size();
 
-      for (int j=0; j<curSize; j++)
-      {
-        qAvg += curPoses[j]->q;
-        tAvg += curPoses[j]->t;
-      }
+        for (int j=0; j<curSize; j++)
+        {
+          qAvg += curPoses[j]->q;
+          tAvg += curPoses[j]->t;
+        }
 
-      tAvg *= 1.0 / curSize;
-      qAvg *= 1.0 / curSize;
+        tAvg *= 1.0 / curSize;
+        qAvg *= 1.0 / curSize;
 
-      curPoses[0]->updatePoseQuat(qAvg, tAvg);
-      curPoses[0]->numVotes=curCluster->numVotes;
+        curPoses[0]->updatePoseQuat(qAvg, tAvg);
+        curPoses[0]->numVotes=curCluster->numVotes;
 
-      finalPoses[i]=curPoses[0]->clone();
-    }
+        finalPoses[i]=curPoses[0]->clone();
+      }
+    });
   }
 
   poseClusters.clear();
@@ -423,6 +797,9 @@ void PPF3DDetector::match(const Mat& pc, std::vector<Pose3DPtr>& results, const
   int numAngles = (int) (floor (2 * M_PI / angle_step));
   float distanceStep = (float)distance_step;
   uint n = num_ref_points;
+  const int numBuckets = (int)bucket_offsets.total() - 1;
+  const int* bucketOffsets = bucket_offsets.ptr<int>();
+  const int* bucketEntries = bucket_entries.ptr<int>();
   std::vector<Pose3DPtr> poseList;
   int sceneSamplingStep = scene_sample_step;
 
@@ -438,153 +815,146 @@ void PPF3DDetector::match(const Mat& pc, std::vector<Pose3DPtr>& results, const
   float distanceSampleStep = diameter * RelativeSceneDistance;*/
   Mat sampled = samplePCByQuantization(pc, xRange, yRange, zRange, (float)relativeSceneDistance, 0);
 
-  // allocate the accumulator : Moved this to the inside of the loop
-  /*#if !defined (_OPENMP)
-     uint* accumulator = (uint*)calloc(numAngles*n, sizeof(uint));
-  #endif*/
+  // one pose per scene reference point, stored at the index of the reference point so that the
+  // result does not depend on the scheduling of the threads
+  const int numSceneRefPoints = (sampled.rows + sceneSamplingStep - 1) / sceneSamplingStep;
+  poseList.resize(numSceneRefPoints);
 
-  poseList.reserve((sampled.rows/sceneSamplingStep)+4);
-
-#if defined _OPENMP
-#pragma omp parallel for
-#endif
-  for (int i = 0; i < sampled.rows; i += sceneSamplingStep)
+  // the reference points are split in a few stripes per thread, each stripe reusing a single
+  // accumulator sized to the model, which is cleared while it is maximized
+  const double nstripes = std::min((double)numSceneRefPoints, 4.0 * getNumThreads());
+  parallel_for_(Range(0, numSceneRefPoints), [&](const Range& range)
   {
-    uint refIndMax = 0, alphaIndMax = 0;
-    uint maxVotes = 0;
+    std::vector<uint> accumulatorBuffer((size_t)numAngles*n, 0);
+    uint* accumulator = &accumulatorBuffer[0];
 
-    const Vec3f p1(sampled.ptr<float>(i));
-    const Vec3f n1(sampled.ptr<float>(i) + 3);
-    Vec3d tsg = Vec3d::all(0);
-    Matx33d Rsg = Matx33d::all(0), RInv = Matx33d::all(0);
+    for (int refPoint = range.start; refPoint < range.end; refPoint++)
+    {
+      const int i = refPoint * sceneSamplingStep;
+      uint refIndMax = 0, alphaIndMax = 0;
+      uint maxVotes = 0;
 
-    uint* accumulator = (uint*)calloc(numAngles*n, sizeof(uint));
-    computeTransformRT(p1, n1, Rsg, tsg);
+      const Vec3f p1(sampled.ptr<float>(i));
+      const Vec3f n1(sampled.ptr<float>(i) + 3);
+      Vec3d tsg = Vec3d::all(0);
+      Matx33d Rsg = Matx33d::all(0), RInv = Matx33d::all(0);
 
-    // Tolga Birdal's notice:
-    // As a later update, we might want to look into a local neighborhood only
-    // To do this, simply search the local neighborhood by radius look up
-    // and collect the neighbors to compute the relative pose
+      computeTransformRT(p1, n1, Rsg, tsg);
 
-    for (int j = 0; j < sampled.rows; j ++)
-    {
-      if (i!=j)
+      // Tolga Birdal's notice:
+      // As a later update, we might want to look into a local neighborhood only
+      // To do this, simply search the local neighborhood by radius look up
+      // and collect the neighbors to compute the relative pose
+
+      for (int j = 0; j < sampled.rows; j ++)
       {
-        const Vec3f p2(sampled.ptr<float>(j));
-        const Vec3f n2(sampled.ptr<float>(j) + 3);
-        Vec3d p2t;
-        double alpha_scene;
+        if (i!=j)
+        {
+          const Vec3f p2(sampled.ptr<float>(j));
+          const Vec3f n2(sampled.ptr<float>(j) + 3);
+          Vec3d p2t;
+          double alpha_scene;
 
-        Vec4d f = Vec4d::all(0);
-        computePPFFeatures(p1, n1, p2, n2, f);
-        KeyType hashValue = hashPPF(f, angle_step, distanceStep);
+          Vec4d f = Vec4d::all(0);
+          computePPFFeatures(p1, n1, p2, n2, f);
+          KeyType hashValue = hashPPF(f, angle_step, distanceStep);
 
-        p2t = tsg + Rsg * Vec3d(p2);
+          p2t = tsg + Rsg * Vec3d(p2);
 
-        alpha_scene=atan2(-p2t[2], p2t[1]);
+          alpha_scene=atan2(-p2t[2], p2t[1]);
 
-        if ( alpha_scene != alpha_scene)
-        {
-          continue;
-        }
+          if ( alpha_scene != alpha_scene)
+          {
+            continue;
+          }
+
+          if (sin(alpha_scene)*p2t[2]<0.0)
+            alpha_scene=-alpha_scene;
 
-        if (sin(alpha_scene)*p2t[2]<0.0)
           alpha_scene=-alpha_scene;
 
-        alpha_scene=-alpha_scene;
+          const int bucket = (int)(hashValue % (KeyType)numBuckets);
 
-        hashnode_i* node = hashtableGetBucketHashed(hash_table, (hashValue));
+          for (int e = bucketOffsets[bucket]; e < bucketOffsets[bucket + 1]; e++)
+          {
+            int ppfInd = bucketEntries[e];
+            int corrI = ppfInd / (int)n;
+            const float* ppfCorrScene = ppf.ptr<float>(ppfInd);
+            double alpha_model = (double)ppfCorrScene[PPF_LENGTH-1];
+            double alpha = alpha_model - alpha_scene;
 
-        while (node)
-        {
-          THash* tData = (THash*) node->data;
-          int corrI = (int)tData->i;
-          int ppfInd = (int)tData->ppfInd;
-          float* ppfCorrScene = ppf.ptr<float>(ppfInd);
-          double alpha_model = (double)ppfCorrScene[PPF_LENGTH-1];
-          double alpha = alpha_model - alpha_scene;
-
-          /*  Tolga Birdal's note: Map alpha to the indices:
-                  atan2 generates results in (-pi pi]
-                  That's why alpha should be in range [-2pi 2pi]
-                  So the quantization would be :
-                  numAngles * (alpha+2pi)/(4pi)
-                  */
-
-          //printf("%f\n", alpha);
-          int alpha_index = (int)(numAngles*(alpha + 2*M_PI) / (4*M_PI));
-
-          uint accIndex = corrI * numAngles + alpha_index;
-
-          accumulator[accIndex]++;
-          node = node->next;
+            /*  Tolga Birdal's note: Map alpha to the indices:
+                    atan2 generates results in (-pi pi]
+                    That's why alpha should be in range [-2pi 2pi]
+                    So the quantization would be :
+                    numAngles * (alpha+2pi)/(4pi)
+                    */
+
+            //printf("%f\n", alpha);
+            int alpha_index = (int)(numAngles*(alpha + 2*M_PI) / (4*M_PI));
+
+            uint accIndex = corrI * numAngles + alpha_index;
+
+            accumulator[accIndex]++;
+          }
         }
       }
-    }
 
-    // Maximize the accumulator
-    for (uint k = 0; k < n; k++)
-    {
-      for (int j = 0; j < numAngles; j++)
+      // Maximize the accumulator
+      for (uint k = 0; k < n; k++)
       {
-        const uint accInd = k*numAngles + j;
-        const uint accVal = accumulator[ accInd ];
-        if (accVal > maxVotes)
+        for (int j = 0; j < numAngles; j++)
         {
-          maxVotes = accVal;
-          refIndMax = k;
-          alphaIndMax = j;
+          const uint accInd = k*numAngles + j;
+          const uint accVal = accumulator[ accInd ];
+          if (accVal > maxVotes)
+          {
+            maxVotes = accVal;
+            refIndMax = k;
+            alphaIndMax = j;
+          }
+
+          accumulator[accInd ] = 0;
         }
-
-#if !defined (_OPENMP)
-        accumulator[accInd ] = 0;
-#endif
       }
-    }
 
-    // invert Tsg : Luckily rotation is orthogonal: Inverse = Transpose.
-    // We are not required to invert.
-    Vec3d tInv, tmg;
-    Matx33d Rmg;
-    RInv = Rsg.t();
-    tInv = -RInv * tsg;
+      // invert Tsg : Luckily rotation is orthogonal: Inverse = Transpose.
+      // We are not required to invert.
+      Vec3d tInv, tmg;
+      Matx33d Rmg;
+      RInv = Rsg.t();
+      tInv = -RInv * tsg;
 
-    Matx44d TsgInv;
-    rtToPose(RInv, tInv, TsgInv);
+      Matx44d TsgInv;
+      rtToPose(RInv, tInv, TsgInv);
 
-    // TODO : Compute pose
-    const Vec3f pMax(sampled_pc.ptr<float>(refIndMax));
-    const Vec3f nMax(sampled_pc.ptr<float>(refIndMax) + 3);
+      // TODO : Compute pose
+      const Vec3f pMax(sampled_pc.ptr<float>(refIndMax));
+      const Vec3f nMax(sampled_pc.ptr<float>(refIndMax) + 3);
 
-    computeTransformRT(pMax, nMax, Rmg, tmg);
+      computeTransformRT(pMax, nMax, Rmg, tmg);
 
-    Matx44d Tmg;
-    rtToPose(Rmg, tmg, Tmg);
+      Matx44d Tmg;
+      rtToPose(Rmg, tmg, Tmg);
 
-    // convert alpha_index to alpha
-    int alpha_index = alphaIndMax;
-    double alpha = (alpha_index*(4*M_PI))/numAngles-2*M_PI;
+      // convert alpha_index to alpha
+      int alpha_index = alphaIndMax;
+      double alpha = (alpha_index*(4*M_PI))/numAngles-2*M_PI;
 
-    // Equation 2:
-    Matx44d Talpha;
-    Matx33d R;
-    Vec3d t = Vec3d::all(0);
-    getUnitXRotation(alpha, R);
-    rtToPose(R, t, Talpha);
+      // Equation 2:
+      Matx44d Talpha;
+      Matx33d R;
+      Vec3d t = Vec3d::all(0);
+      getUnitXRotation(alpha, R);
+      rtToPose(R, t, Talpha);
 
-    Matx44d rawPose = TsgInv * (Talpha * Tmg);
+      Matx44d rawPose = TsgInv * (Talpha * Tmg);
 
-    Pose3DPtr pose(new Pose3D(alpha, refIndMax, maxVotes));
-    pose->updatePose(rawPose);
-    #if defined (_OPENMP)
-    #pragma omp critical
-    #endif
-    {
-      poseList.push_back(pose);
+      Pose3DPtr pose(new Pose3D(alpha, refIndMax, maxVotes));
+      pose->updatePose(rawPose);
+      poseList[refPoint] = pose;
     }
-
-    free(accumulator);
-  }
+  }, nstripes);
 
   // TODO : Make the parameters relative if not arguments.
   //double MinMatchScore = 0.5;
@@ -0,0 +1,122 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "test_precomp.hpp"
+#include <fstream>
+#include <iterator>
+
+namespace opencv_test { namespace {
+
+// points of an ellipsoid with their normals, as a Nx6 point cloud
+static Mat makeEllipsoid(int numPoints)
+{
+    const Vec3f axes(1.f, 0.6f, 0.4f);
+    RNG rng(0);
+    Mat pc(numPoints, 6, CV_32FC1);
+    for (int i = 0; i < numPoints; i++)
+    {
+        const float theta = rng.uniform(0.f, (float)CV_PI);
+        const float phi = rng.uniform(0.f, (float)(2 * CV_PI));
+        const Vec3f p(axes[0] * sin(theta) * cos(phi), axes[1] * sin(theta) * sin(phi), axes[2] * cos(theta));
+        Vec3f n(p[0] / (axes[0] * axes[0]), p[1] / (axes[1] * axes[1]), p[2] / (axes[2] * axes[2]));
+        n /= norm(n);
+        float* row = pc.ptr<float>(i);
+        for (int k = 0; k < 3; k++)
+        {
+            row[k] = p[k];
+            row[k + 3] = n[k];
+        }
+    }
+    return pc;
+}
+
+static void readFile(const String& fileName, std::vector<char>& content)
+{
+    std::ifstream f(fileName.c_str(), std::ios::binary);
+    ASSERT_TRUE(f.is_open());
+    content.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const String& fileName, const char* data, size_t size)
+{
+    std::ofstream f(fileName.c_str(), std::ios::binary);
+    ASSERT_TRUE(f.is_open());
+    f.write(data, (std::streamsize)size);
+}
+
+TEST(Surface_Matching_PPF3DDetector, save_load_roundtrip)
+{
+    Mat pc = makeEllipsoid(2000);
+
+    PPF3DDetector trained(0.05, 0.05);
+    trained.trainModel(pc);
+    trained.setSearchParams(0.05, 5.0 / 180.0 * CV_PI);
+
+    const String fileName = cv::tempfile(".ppf");
+    trained.saveModel(fileName);
+
+    // the file does not depend on the uninitialized memory of the model
+    PPF3DDetector retrained(0.05, 0.05);
+    retrained.trainModel(pc);
+    const String otherFileName = cv::tempfile(".ppf");
+    retrained.saveModel(otherFileName);
+    std::vector<char> content, otherContent;
+    readFile(fileName, content);
+    readFile(otherFileName, otherContent);
+    EXPECT_TRUE(content == otherContent);
+    remove(otherFileName.c_str());
+
+    std::vector<Pose3DPtr> expected;
+    trained.match(pc, expected, 1.0 / 5.0, 0.05);
+    ASSERT_FALSE(expected.empty());
+
+    {
+        PPF3DDetector loaded;
+        loaded.loadModel(fileName);
+        loaded.setSearchParams(0.05, 5.0 / 180.0 * CV_PI);
+
+        std::vector<Pose3DPtr> results;
+        loaded.match(pc, results, 1.0 / 5.0, 0.05);
+        ASSERT_EQ(expected.size(), results.size());
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            EXPECT_EQ(expected[i]->numVotes, results[i]->numVotes);
+            EXPECT_EQ(expected[i]->modelIndex, results[i]->modelIndex);
+            EXPECT_EQ(0, cvtest::norm(Mat(expected[i]->pose), Mat(results[i]->pose), NORM_INF));
+        }
+    }
+
+    remove(fileName.c_str());
+}
+
+TEST(Surface_Matching_PPF3DDetector, load_truncated_model)
+{
+    PPF3DDetector trained(0.05, 0.05);
+    trained.trainModel(makeEllipsoid(2000));
+
+    const String fileName = cv::tempfile(".ppf");
+    trained.saveModel(fileName);
+    std::vector<char> content;
+    readFile(fileName, content);
+    ASSERT_FALSE(content.empty());
+
+    // a model missing the end of its hash table, then a model whose entries are out of range
+    writeFile(fileName, &content[0], content.size() / 2);
+    PPF3DDetector loaded;
+    EXPECT_THROW(loaded.loadModel(fileName), cv::Exception);
+
+    std::vector<char> corrupt(content);
+    const size_t entriesEnd = corrupt.size() - corrupt.size() % sizeof(int);
+    for (size_t i = entriesEnd - 16 * sizeof(int); i < entriesEnd; i++)
+        corrupt[i] = (char)0x7f;
+    writeFile(fileName, &corrupt[0], corrupt.size());
+    EXPECT_THROW(loaded.loadModel(fileName), cv::Exception);
+
+    writeFile(fileName, &content[0], content.size());
+    EXPECT_NO_THROW(loaded.loadModel(fileName));
+
+    remove(fileName.c_str());
+}
+
+}} // namespace
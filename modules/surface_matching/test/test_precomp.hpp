@@ -0,0 +1,14 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+#ifndef __OPENCV_TEST_SURFACE_MATCHING_PRECOMP_HPP__
+#define __OPENCV_TEST_SURFACE_MATCHING_PRECOMP_HPP__
+
+#include "opencv2/ts.hpp"
+#include "opencv2/surface_matching.hpp"
+
+namespace opencv_test {
+using namespace cv::ppf_match_3d;
+}
+
+#endif
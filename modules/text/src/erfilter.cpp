@@ -71,27 +71,6 @@ using namespace cv::ml;
 using namespace std;
 using namespace cv::ml;
 
-// Deletes a tree of ERStat regions starting at root. Used only
-// internally to this implementation.
-static void deleteERStatTree(ERStat* root) {
-    queue<ERStat*> to_delete;
-    to_delete.push(root);
-    while (!to_delete.empty()) {
-        ERStat* n = to_delete.front();
-        to_delete.pop();
-        ERStat* c = n->child;
-        if (c != NULL) {
-            to_delete.push(c);
-            ERStat* sibling = c->next;
-            while (sibling != NULL) {
-                to_delete.push(sibling);
-                sibling = sibling->next;
-            }
-        }
-        delete n;
-    }
-}
-
 ERStat::ERStat(int init_level, int init_pixel, int init_x, int init_y) : pixel(init_pixel),
                level(init_level), area(0), perimeter(0), euler(0), probability(1.0),
                parent(0), child(0), next(0), prev(0), local_maxima(0),
@@ -111,6 +90,63 @@ ERStat::ERStat(int init_level, int init_pixel, int init_x, int init_y) : pixel(i
 // derivative classes
 
 
+// Arena for the ERStat nodes of the component tree. Nodes are allocated from blocks which are kept
+// between runs, the rejected nodes are recycled, and the whole tree is released at once when the
+// extraction ends. Used only internally to this implementation.
+class ERStatPool
+{
+public:
+    ERStatPool() : block(0) {}
+    // copies start with an empty arena of their own
+    ERStatPool(const ERStatPool&) : block(0) {}
+    ERStatPool& operator=(const ERStatPool&) { return *this; }
+
+    ERStat* allocate(int level = 256, int pixel = 0, int x = 0, int y = 0)
+    {
+        if (!released.empty())
+        {
+            ERStat* stat = released.back();
+            released.pop_back();
+            *stat = ERStat(level, pixel, x, y);
+            return stat;
+        }
+        // the blocks never grow past their capacity, so the nodes never move
+        if (block < blocks.size() && blocks[block].size() == blocks[block].capacity())
+            block++;
+        if (block == blocks.size())
+        {
+            blocks.push_back(vector<ERStat>());
+            blocks.back().reserve(BLOCK_SIZE);
+        }
+        blocks[block].push_back(ERStat(level, pixel, x, y));
+        return &blocks[block].back();
+    }
+
+    void release(ERStat* stat)
+    {
+        stat->crossings.release();
+        released.push_back(stat);
+    }
+
+    // release all the nodes, keeping the memory for the next run
+    void clear()
+    {
+        for (size_t b = 0; b < blocks.size(); b++)
+            blocks[b].clear();
+        released.clear();
+        block = 0;
+    }
+
+private:
+    enum { BLOCK_SIZE = 4096 };
+    vector< vector<ERStat> > blocks;
+    size_t block;
+    vector<ERStat*> released;
+};
+
+static bool isThreadSafeCallback(const Ptr<ERFilter::Callback>& cb);
+
+
 // the classes implementing the interface for the 1st and 2nd stages of Neumann and Matas algorithm
 class CV_EXPORTS ERFilterNM : public ERFilter
 {
@@ -151,11 +187,17 @@ public:
     void setNonMaxSuppression(bool nonMaxSuppression) CV_OVERRIDE;
     int  getNumRejected() const CV_OVERRIDE;
 
+    // a copy that can run concurrently with this filter, or empty if the classifier can not be
+    // shared between threads
+    Ptr<ERFilterNM> cloneForThread() const;
+
 private:
     // pointer to the input/output regions vector
     vector<ERStat> *regions;
-    // image mask used for feature calculations
-    Mat region_mask;
+    // size of the image mask used for feature calculations (image size plus a 1 pixel border)
+    Size region_mask_size;
+    // storage of the component tree nodes
+    ERStatPool er_pool;
 
     // extract the component tree and store all the ER regions
     void er_tree_extract( InputArray image );
@@ -167,8 +209,10 @@ private:
     void er_merge( ERStat *parent, ERStat *child );
     // copy extracted regions into the output vector
     ERStat* er_save( ERStat *er, ERStat *parent, ERStat *prev );
+    // calculate the 2nd stage features and the probabilities of a list of regions
+    void er_tree_features( InputArray image, vector<ERStat> &stats );
     // recursively walk the tree and filter (remove) regions using the callback classifier
-    ERStat* er_tree_filter( InputArray image, ERStat *stat, ERStat *parent, ERStat *prev );
+    ERStat* er_tree_filter( ERStat *stat, ERStat *parent, ERStat *prev );
     // recursively walk the tree selecting only regions with local maxima probability
     ERStat* er_tree_nonmax_suppression( ERStat *er, ERStat *parent, ERStat *prev );
 };
@@ -201,6 +245,8 @@ public:
 
     // The classifier must return probability measure for the region.
     double eval(const ERStat& stat) CV_OVERRIDE;
+    // Set the probability of each region in a single call to the classifier.
+    void evalBatch(const vector<ERStat*>& stats);
 
 private:
     Ptr<Boost> boost;
@@ -234,7 +280,7 @@ void ERFilterNM::run( InputArray image, vector<ERStat>& _regions )
     CV_Assert( image.getMat().type() == CV_8UC1 );
 
     regions = &_regions;
-    region_mask = Mat::zeros(image.getMat().rows+2, image.getMat().cols+2, CV_8UC1);
+    region_mask_size = Size(image.getMat().cols+2, image.getMat().rows+2);
 
     // if regions vector is empty we must extract the entire component tree
     if ( regions->size() == 0 )
@@ -257,7 +303,8 @@ void ERFilterNM::run( InputArray image, vector<ERStat>& _regions )
         vector<ERStat> aux_regions;
         regions->swap(aux_regions);
         regions->reserve(aux_regions.size());
-        er_tree_filter( image, &aux_regions.front(), NULL, NULL );
+        er_tree_features( image, aux_regions );
+        er_tree_filter( &aux_regions.front(), NULL, NULL );
         aux_regions.clear();
     }
 }
@@ -282,6 +329,7 @@ void ERFilterNM::er_tree_extract( InputArray image )
 
     // the component stack
     vector<ERStat*> er_stack;
+    er_pool.clear();
 
     // the quads for Euler's number calculation
     // quads[2][2] and quads[2][3] are never used.
@@ -305,7 +353,7 @@ void ERFilterNM::er_tree_extract( InputArray image )
     vector<int> boundary_edges[256];
 
     // add a dummy-component before start
-    er_stack.push_back(new ERStat);
+    er_stack.push_back(er_pool.allocate());
 
     // we'll look initially for all pixels with grey-level lower than a grey-level higher than any allowed in the image
     int threshold_level = (255/thresholdDelta)+1;
@@ -325,7 +373,7 @@ void ERFilterNM::er_tree_extract( InputArray image )
 
         // push a component with current level in the component stack
         if (push_new_component)
-            er_stack.push_back(new ERStat(current_level, current_pixel, x, y));
+            er_stack.push_back(er_pool.allocate(current_level, current_pixel, x, y));
         push_new_component = false;
 
         // explore the (remaining) edges to the neighbors to the current pixel
@@ -523,16 +571,8 @@ void ERFilterNM::er_tree_extract( InputArray image )
             er_save(er_stack.back(), NULL, NULL);
 
             // clean memory
-            for (size_t r=0; r<er_stack.size(); r++)
-            {
-                ERStat *stat = er_stack.at(r);
-                if (stat->crossings)
-                {
-                    stat->crossings.release();
-                }
-                deleteERStatTree(stat);
-            }
             er_stack.clear();
+            er_pool.clear();
 
             return;
         }
@@ -563,7 +603,7 @@ void ERFilterNM::er_tree_extract( InputArray image )
 
                 if (new_level < er_stack.back()->level)
                 {
-                    er_stack.push_back(new ERStat(new_level, current_pixel, current_pixel%width, current_pixel/width));
+                    er_stack.push_back(er_pool.allocate(new_level, current_pixel, current_pixel%width, current_pixel/width));
                     er_merge(er_stack.back(), er);
                     break;
                 }
@@ -677,8 +717,8 @@ void ERFilterNM::er_merge(ERStat *parent, ERStat *child)
     }
 
     if ( (((classifier)?(child->probability >= minProbability):true)||(nonMaxSuppression)) &&
-         ((child->area >= (minArea*region_mask.rows*region_mask.cols)) &&
-          (child->area <= (maxArea*region_mask.rows*region_mask.cols)) &&
+         ((child->area >= (minArea*region_mask_size.height*region_mask_size.width)) &&
+          (child->area <= (maxArea*region_mask_size.height*region_mask_size.width)) &&
           (child->rect.width > 2) && (child->rect.height > 2)) )
     {
 
@@ -710,11 +750,7 @@ void ERFilterNM::er_merge(ERStat *parent, ERStat *child)
         }
 
         // free mem
-        if(child->crossings)
-        {
-            child->crossings.release();
-        }
-        delete(child);
+        er_pool.release(child);
     }
 
 }
@@ -783,16 +819,13 @@ ERStat* ERFilterNM::er_save( ERStat *er, ERStat *parent, ERStat *prev )
     return this_er;
 }
 
-// recursively walk the tree and filter (remove) regions using the callback classifier
-ERStat* ERFilterNM::er_tree_filter ( InputArray image, ERStat * stat, ERStat *parent, ERStat *prev )
+// calculate the 2nd stage features of a region, mask is a scratch buffer
+static void er_2nd_stage_features( const Mat& src, ERStat *stat, Mat& mask )
 {
-    // assert correct image type
-    CV_Assert( image.type() == CV_8UC1 );
-
-    Mat src = image.getMat();
-
     //Fill the region and calculate 2nd stage features
-    Mat region = region_mask(Rect(stat->rect.tl(), stat->rect.br() + Point(2,2)));
+    if ((mask.rows < stat->rect.height+2) || (mask.cols < stat->rect.width+2))
+        mask.create(max(mask.rows, stat->rect.height+2), max(mask.cols, stat->rect.width+2), CV_8UC1);
+    Mat region = mask(Rect(0, 0, stat->rect.width+2, stat->rect.height+2));
     region = Scalar(0);
     int newMaskVal = 255;
     int flags = 4 + (newMaskVal << 8) + FLOODFILL_FIXED_RANGE + FLOODFILL_MASK_ONLY;
@@ -861,17 +894,55 @@ ERStat* ERFilterNM::er_tree_filter ( InputArray image, ERStat * stat, ERStat *pa
     stat->hole_area_ratio = (float)holes_area / stat->area;
     stat->convex_hull_ratio = (float)hull_area / (float)contourArea(contours[0]);
     stat->num_inflexion_points = (float)num_inflexion_points;
+}
 
+// calculate the 2nd stage features and the probabilities of a list of regions
+// the regions are independent, so they are processed in parallel; the classifier is evaluated in
+// the same parallel loop (in a single batch per stripe for the default one) when it can be shared
+// between threads, and serially in the list order otherwise
+void ERFilterNM::er_tree_features( InputArray image, vector<ERStat> &stats )
+{
+    // assert correct image type
+    CV_Assert( image.type() == CV_8UC1 );
+
+    Mat src = image.getMat();
+    const int n = (int)stats.size();
+    const bool shared_classifier = classifier && isThreadSafeCallback(classifier);
+    ERClassifierNM2 *nm2 = dynamic_cast<ERClassifierNM2*>(classifier.get());
+
+    parallel_for_(Range(0, n), [&](const Range& range)
+    {
+        Mat mask;
+        vector<ERStat*> batch;
+        for (int i = range.start; i < range.end; i++)
+        {
+            er_2nd_stage_features(src, &stats[i], mask);
+            if (shared_classifier && (stats[i].parent != NULL))
+                batch.push_back(&stats[i]);
+        }
+        if (nm2)
+            nm2->evalBatch(batch);
+        else
+            for (size_t i = 0; i < batch.size(); i++)
+                batch[i]->probability = classifier->eval(*batch[i]);
+    }, std::max(1, std::min(n/64, 4*getNumThreads())));
 
-    // calculate P(child|character) and filter if possible
-    if (classifier && (stat->parent != NULL))
+    // calculate P(child|character)
+    if (classifier && !shared_classifier)
     {
-        stat->probability = classifier->eval(*stat);
+        for (int i = 0; i < n; i++)
+            if (stats[i].parent != NULL)
+                stats[i].probability = classifier->eval(stats[i]);
     }
+}
 
+// recursively walk the tree and filter (remove) regions using the callback classifier
+ERStat* ERFilterNM::er_tree_filter ( ERStat * stat, ERStat *parent, ERStat *prev )
+{
+    // filter if possible, P(child|character) is calculated by er_tree_features
     if ( ( ((classifier)?(stat->probability >= minProbability):true) &&
-          ((stat->area >= minArea*region_mask.rows*region_mask.cols) &&
-           (stat->area <= maxArea*region_mask.rows*region_mask.cols)) ) ||
+          ((stat->area >= minArea*region_mask_size.height*region_mask_size.width) &&
+           (stat->area <= maxArea*region_mask_size.height*region_mask_size.width)) ) ||
         (stat->parent == NULL) )
     {
 
@@ -892,7 +963,7 @@ ERStat* ERFilterNM::er_tree_filter ( InputArray image, ERStat * stat, ERStat *pa
 
         for (ERStat * child = stat->child; child; child = child->next)
         {
-            old_prev = er_tree_filter(image, child, this_er, old_prev);
+            old_prev = er_tree_filter(child, this_er, old_prev);
         }
 
         return this_er;
@@ -905,7 +976,7 @@ ERStat* ERFilterNM::er_tree_filter ( InputArray image, ERStat * stat, ERStat *pa
 
         for (ERStat * child = stat->child; child; child = child->next)
         {
-            old_prev = er_tree_filter(image, child, parent, old_prev);
+            old_prev = er_tree_filter(child, parent, old_prev);
         }
 
         return old_prev;
@@ -1076,6 +1147,34 @@ double ERClassifierNM2::eval(const ERStat& stat)
     return (double)1-(double)1/(1+exp(-2*votes));
 }
 
+void ERClassifierNM2::evalBatch(const vector<ERStat*>& stats)
+{
+    if (stats.empty())
+        return;
+
+    //Classify
+    Mat samples((int)stats.size(), 7, CV_32F);
+    for (int i = 0; i < samples.rows; i++)
+    {
+        const ERStat& stat = *stats[i];
+        float* sample = samples.ptr<float>(i);
+        sample[0] = (float)(stat.rect.width)/(stat.rect.height); // aspect ratio
+        sample[1] = sqrt((float)(stat.area))/stat.perimeter; // compactness
+        sample[2] = (float)(1-stat.euler); //number of holes
+        sample[3] = stat.med_crossings;
+        sample[4] = stat.hole_area_ratio;
+        sample[5] = stat.convex_hull_ratio;
+        sample[6] = stat.num_inflexion_points;
+    }
+
+    Mat votes;
+    boost->predict( samples, votes, DTrees::PREDICT_SUM | StatModel::RAW_OUTPUT);
+
+    // Logistic Correction returns a probability value (in the range(0,1))
+    for (int i = 0; i < samples.rows; i++)
+        stats[i]->probability = (double)1-(double)1/(1+exp(-2*votes.at<float>(i)));
+}
+
 
 /*!
     Create an Extremal Region Filter for the 1st stage classifier of N&M algorithm
@@ -1204,6 +1303,22 @@ Ptr<ERFilter::Callback> loadDummyClassifier()
     return makePtr<ERDummyClassifier>();
 }
 
+// the default classifiers only read their models, so they can be shared between threads;
+// nothing is assumed about user callbacks
+static bool isThreadSafeCallback(const Ptr<ERFilter::Callback>& cb)
+{
+    return dynamic_cast<ERClassifierNM1*>(cb.get()) != NULL ||
+           dynamic_cast<ERClassifierNM2*>(cb.get()) != NULL ||
+           dynamic_cast<ERDummyClassifier*>(cb.get()) != NULL;
+}
+
+Ptr<ERFilterNM> ERFilterNM::cloneForThread() const
+{
+    if (classifier && !isThreadSafeCallback(classifier))
+        return Ptr<ERFilterNM>();
+    return makePtr<ERFilterNM>(*this);
+}
+
 /* ------------------------------------------------------------------------------------*/
 /* -------------------------------- Compute Channels NM -------------------------------*/
 /* ------------------------------------------------------------------------------------*/
@@ -3599,6 +3714,169 @@ bool sort_couples (Vec3i i,Vec3i j) { return (i[0]<j[0]); }
     \param  do_feedback    Whenever the grouping algorithm uses a feedback loop to recover missing regions in a line.
 */
 
+// struct region_features
+// Compact table (structure of arrays) with the features of the regions of a channel that are used
+// to validate pairs, so the exhaustive pair search does not go through the ERStat objects
+struct region_features
+{
+    vector<Rect>  rect;
+    vector<Point> center;
+    vector<uchar> has_parent;
+    // mean grey level and mean a,b values of the region pixels, only filled for the regions
+    // that appear in some candidate pair
+    vector<int>   grey_mean;
+    vector<float> a_mean;
+    vector<float> b_mean;
+
+    region_features(const vector<ERStat>& stats)
+    {
+        size_t n = stats.size();
+        rect.resize(n);
+        center.resize(n);
+        has_parent.resize(n);
+        grey_mean.resize(n, 0);
+        a_mean.resize(n, 0.f);
+        b_mean.resize(n, 0.f);
+        for (size_t r=0; r<n; r++)
+        {
+            rect[r] = stats[r].rect;
+            center[r] = Point(rect[r].x+rect[r].width/2, rect[r].y+rect[r].height/2);
+            has_parent[r] = (stats[r].parent != NULL);
+        }
+    }
+};
+
+// Geometric part of isValidPair: height ratio, centroid angle and region distance normalized by
+// region width fall within a given interval
+static bool isValidPairGeometry(const region_features& f, int r1, int r2)
+{
+    Rect minarearect = f.rect[r1] | f.rect[r2];
+
+    // Overlapping regions are not valid pair in any case
+    if ( (minarearect == f.rect[r1]) || (minarearect == f.rect[r2]) )
+        return false;
+
+    int i = r1, j = r2;
+    if (!(f.rect[r1].x < f.rect[r2].x))
+        std::swap(i, j);
+    const Rect &rect_i = f.rect[i], &rect_j = f.rect[j];
+
+    if (rect_j.x == rect_i.x)
+        return false;
+
+    float height_ratio = (float)min(rect_i.height,rect_j.height) /
+                                max(rect_i.height,rect_j.height);
+
+    float centroid_angle = (float)atan2((float)(f.center[j].y-f.center[i].y), (float)(f.center[j].x-f.center[i].x));
+
+    int avg_width = (rect_i.width + rect_j.width) / 2;
+    float norm_distance = (float)(rect_j.x-(rect_i.x+rect_i.width))/avg_width;
+
+    if (( height_ratio   < PAIR_MIN_HEIGHT_RATIO) ||
+        ( centroid_angle < PAIR_MIN_CENTROID_ANGLE) ||
+        ( centroid_angle > PAIR_MAX_CENTROID_ANGLE) ||
+        ( norm_distance  < PAIR_MIN_REGION_DIST) ||
+        ( norm_distance  > PAIR_MAX_REGION_DIST))
+        return false;
+
+    // deprecate the root region
+    return f.has_parent[i] && f.has_parent[j];
+}
+
+// Colour part of isValidPair, on the means stored in the table
+static bool isValidPairColor(const region_features& f, int r1, int r2)
+{
+    if (abs(f.grey_mean[r1]-f.grey_mean[r2]) > PAIR_MAX_INTENSITY_DIST)
+      return false;
+
+    if (sqrt(pow(f.a_mean[r1]-f.a_mean[r2],2)+pow(f.b_mean[r1]-f.b_mean[r2],2)) > PAIR_MAX_AB_DIST)
+      return false;
+
+    return true;
+}
+
+// Mean grey level and mean a,b values of the pixels of a region, as computed in isValidPair
+// mask is a scratch buffer
+static void regionColor(const Mat& channel, const Mat& grey, const Mat& lab, const ERStat& er,
+                        Mat& mask, int& grey_mean, float& a_mean, float& b_mean)
+{
+    if ((mask.rows < er.rect.height+2) || (mask.cols < er.rect.width+2))
+        mask.create(max(mask.rows, er.rect.height+2), max(mask.cols, er.rect.width+2), CV_8UC1);
+    Mat region = mask(Rect(0, 0, er.rect.width+2, er.rect.height+2));
+    region = Scalar(0);
+
+    int newMaskVal = 255;
+    int flags = 4 + (newMaskVal << 8) + FLOODFILL_FIXED_RANGE + FLOODFILL_MASK_ONLY;
+
+    floodFill( channel(er.rect),
+               region, Point(er.pixel%grey.cols, er.pixel/grey.cols) - er.rect.tl(),
+               Scalar(255), NULL, Scalar(er.level), Scalar(0), flags);
+    Mat rect_mask = region(Rect(1, 1, er.rect.width, er.rect.height));
+
+    Scalar mean,std;
+    meanStdDev(grey(er.rect),mean,std,rect_mask);
+    grey_mean = (int)mean[0];
+    meanStdDev(lab(er.rect),mean,std,rect_mask);
+    a_mean = (float)mean[1];
+    b_mean = (float)mean[2];
+}
+
+// For every region i, find the regions j > i that make a geometrically valid pair with it
+// A uniform grid indexes the regions by the box that contains the centers of all the regions it
+// can be paired with (the pair distance and angle limits bound it in terms of the region width),
+// so only the regions sharing a grid cell are checked.
+static void findPairCandidates(const region_features& f, Size size, vector< vector<int> >& candidates)
+{
+    const int n = (int)f.rect.size();
+    const double reach = (PAIR_MAX_REGION_DIST + 1) / 2;
+    const double slope = max(abs(tan(PAIR_MIN_CENTROID_ANGLE)), abs(tan(PAIR_MAX_CENTROID_ANGLE)));
+    const int cell = max(16, max(size.width, size.height) / 64);
+    const int grid_cols = max(1, (size.width + cell - 1) / cell);
+    const int grid_rows = max(1, (size.height + cell - 1) / cell);
+
+    vector<Rect> cells(n);
+    vector< vector<int> > grid(grid_cols*grid_rows);
+    for (int r=0; r<n; r++)
+    {
+        if (!f.has_parent[r])
+            continue;
+        double half_width = reach*f.rect[r].width + 1;
+        double half_height = slope*half_width + 1;
+        int x0 = min(max(cvFloor((f.center[r].x - half_width)/cell), 0), grid_cols-1);
+        int x1 = min(max(cvFloor((f.center[r].x + half_width)/cell), 0), grid_cols-1);
+        int y0 = min(max(cvFloor((f.center[r].y - half_height)/cell), 0), grid_rows-1);
+        int y1 = min(max(cvFloor((f.center[r].y + half_height)/cell), 0), grid_rows-1);
+        cells[r] = Rect(x0, y0, x1-x0+1, y1-y0+1);
+        for (int y=y0; y<=y1; y++)
+            for (int x=x0; x<=x1; x++)
+                grid[y*grid_cols+x].push_back(r);
+    }
+
+    candidates.assign(n, vector<int>());
+    parallel_for_(Range(0, n), [&](const Range& range)
+    {
+        for (int i=range.start; i<range.end; i++)
+        {
+            vector<int>& candidates_i = candidates[i];
+            for (int y=cells[i].y; y<cells[i].y+cells[i].height; y++)
+                for (int x=cells[i].x; x<cells[i].x+cells[i].width; x++)
+                {
+                    const vector<int>& regions_xy = grid[y*grid_cols+x];
+                    for (size_t k=0; k<regions_xy.size(); k++)
+                        if (regions_xy[k] > i)
+                            candidates_i.push_back(regions_xy[k]);
+                }
+            sort(candidates_i.begin(), candidates_i.end());
+            candidates_i.erase(unique(candidates_i.begin(), candidates_i.end()), candidates_i.end());
+            size_t valid = 0;
+            for (size_t k=0; k<candidates_i.size(); k++)
+                if (isValidPairGeometry(f, i, candidates_i[k]))
+                    candidates_i[valid++] = candidates_i[k];
+            candidates_i.resize(valid);
+        }
+    }, max(1, min(n/64, 4*getNumThreads())));
+}
+
 void erGroupingNM(InputArray _img, InputArrayOfArrays _src, vector< vector<ERStat> >& regions,
                   vector< vector<Vec2i> >& out_groups, vector<Rect>& out_boxes, bool do_feedback_loop)
 {
@@ -3611,57 +3889,60 @@ void erGroupingNM(InputArray _img, InputArrayOfArrays _src, vector< vector<ERSta
     size_t num_channels = src.size();
 
     Mat img = _img.getMat();
+    Mat grey,lab;
+    cvtColor(img, lab, COLOR_RGB2Lab);
+    cvtColor(img, grey, COLOR_RGB2GRAY);
 
     //process each channel independently
     for(size_t c=0; c<num_channels; c++)
     {
-        //store indices to regions in a single vector
-        vector< Vec2i > all_regions;
-        for(size_t r=0; r<regions[c].size(); r++)
-        {
-            all_regions.push_back(Vec2i((int)c,(int)r));
-        }
+        const int num_regions = (int)regions[c].size();
+        region_features features(regions[c]);
 
-        vector< region_pair > valid_pairs;
-        Mat mask = Mat::zeros(img.rows+2, img.cols+2, CV_8UC1);
-        Mat grey,lab;
-        cvtColor(img, lab, COLOR_RGB2Lab);
-        cvtColor(img, grey, COLOR_RGB2GRAY);
+        // candidate pairs (i,j), i<j, passing the geometric checks
+        vector< vector<int> > candidates;
+        findPairCandidates(features, img.size(), candidates);
 
-        //check every possible pair of regions
-        for (size_t i=0; i<all_regions.size(); i++)
+        // colour of the regions of the candidate pairs
+        vector<uchar> in_candidate_pair(num_regions, 0);
+        for (int i=0; i<num_regions; i++)
+        {
+            for (size_t k=0; k<candidates[i].size(); k++)
+                in_candidate_pair[i] = in_candidate_pair[candidates[i][k]] = 1;
+        }
+        parallel_for_(Range(0, num_regions), [&](const Range& range)
         {
-            vector<int> i_siblings;
-            int first_i_sibling_idx = (int)valid_pairs.size();
-            for (size_t j=i+1; j<all_regions.size(); j++)
+            Mat region_mask;
+            for (int r=range.start; r<range.end; r++)
+                if (in_candidate_pair[r])
+                    regionColor(src[c], grey, lab, regions[c][r], region_mask,
+                                features.grey_mean[r], features.a_mean[r], features.b_mean[r]);
+        }, max(1, min(num_regions/64, 4*getNumThreads())));
+
+        //check every possible pair of regions, the pairs of each region i are independent
+        vector< vector<region_pair> > pairs_of(num_regions);
+        parallel_for_(Range(0, num_regions), [&](const Range& range)
+        {
+            for (int i=range.start; i<range.end; i++)
             {
-                // check height ratio, centroid angle and region distance normalized by region width
-                // fall within a given interval
-                if (isValidPair(grey, lab, mask, src, regions, all_regions[i],all_regions[j]))
+                vector<region_pair>& i_pairs = pairs_of[i];
+                vector<int> i_siblings;
+                for (size_t k=0; k<candidates[i].size(); k++)
                 {
+                    int j = candidates[i][k];
+                    if (!isValidPairColor(features, i, j))
+                        continue;
+
                     bool isCycle = false;
-                    for (size_t k=0; k<i_siblings.size(); k++)
+                    for (size_t s=0; s<i_siblings.size(); s++)
                     {
-                      if (isValidPair(grey, lab, mask, src, regions, all_regions[j],all_regions[i_siblings[k]]))
+                      if (isValidPairGeometry(features, j, i_siblings[s]) && isValidPairColor(features, j, i_siblings[s]))
                       {
                         // choose as sibling the closer and not the first that was "paired" with i
-                        Point i_center = Point( regions[all_regions[i][0]][all_regions[i][1]].rect.x +
-                                                regions[all_regions[i][0]][all_regions[i][1]].rect.width/2,
-                                                regions[all_regions[i][0]][all_regions[i][1]].rect.y +
-                                                regions[all_regions[i][0]][all_regions[i][1]].rect.height/2 );
-                        Point j_center = Point( regions[all_regions[j][0]][all_regions[j][1]].rect.x +
-                                                regions[all_regions[j][0]][all_regions[j][1]].rect.width/2,
-                                                regions[all_regions[j][0]][all_regions[j][1]].rect.y +
-                                                regions[all_regions[j][0]][all_regions[j][1]].rect.height/2 );
-                        Point k_center = Point( regions[all_regions[i_siblings[k]][0]][all_regions[i_siblings[k]][1]].rect.x +
-                                                regions[all_regions[i_siblings[k]][0]][all_regions[i_siblings[k]][1]].rect.width/2,
-                                                regions[all_regions[i_siblings[k]][0]][all_regions[i_siblings[k]][1]].rect.y +
-                                                regions[all_regions[i_siblings[k]][0]][all_regions[i_siblings[k]][1]].rect.height/2 );
-
-                        if ( norm(i_center - j_center) < norm(i_center - k_center) )
+                        if ( norm(features.center[i] - features.center[j]) < norm(features.center[i] - features.center[i_siblings[s]]) )
                         {
-                          valid_pairs[first_i_sibling_idx+k] = region_pair(all_regions[i],all_regions[j]);
-                          i_siblings[k] = (int)j;
+                          i_pairs[s] = region_pair(Vec2i((int)c,i),Vec2i((int)c,j));
+                          i_siblings[s] = j;
                         }
                         isCycle = true;
                         break;
@@ -3669,32 +3950,59 @@ void erGroupingNM(InputArray _img, InputArrayOfArrays _src, vector< vector<ERSta
                     }
                     if (!isCycle)
                     {
-                      valid_pairs.push_back(region_pair(all_regions[i],all_regions[j]));
-                      i_siblings.push_back((int)j);
-                      //cout << "Valid pair (" << all_regions[i][0] << ","  << all_regions[i][1] << ") (" << all_regions[j][0] << ","  << all_regions[j][1] << ")" << endl;
+                      i_pairs.push_back(region_pair(Vec2i((int)c,i),Vec2i((int)c,j)));
+                      i_siblings.push_back(j);
                     }
                 }
             }
-        }
+        }, max(1, min(num_regions/64, 4*getNumThreads())));
+
+        vector< region_pair > valid_pairs;
+        for (int i=0; i<num_regions; i++)
+            valid_pairs.insert(valid_pairs.end(), pairs_of[i].begin(), pairs_of[i].end());
 
         //cout << "GroupingNM : detected " << valid_pairs.size() << " valid pairs" << endl;
 
-        vector< region_triplet > valid_triplets;
+        //check every possible triplet of regions, only pairs with a region in common can make one
+        const int num_pairs = (int)valid_pairs.size();
+        vector< vector<int> > pairs_with_region(num_regions);
+        for (int p=0; p<num_pairs; p++)
+        {
+            pairs_with_region[valid_pairs[p].a[1]].push_back(p);
+            pairs_with_region[valid_pairs[p].b[1]].push_back(p);
+        }
 
-        //check every possible triplet of regions
-        for (size_t i=0; i<valid_pairs.size(); i++)
+        vector< vector<region_triplet> > triplets_of(num_pairs);
+        parallel_for_(Range(0, num_pairs), [&](const Range& range)
         {
-            for (size_t j=i+1; j<valid_pairs.size(); j++)
+            vector<int> pair_candidates;
+            for (int i=range.start; i<range.end; i++)
             {
-                // check collinearity rules
-                region_triplet valid_triplet(Vec2i(0,0),Vec2i(0,0),Vec2i(0,0));
-                if (isValidTriplet(regions, valid_pairs[i],valid_pairs[j], valid_triplet))
+                pair_candidates.clear();
+                const vector<int>& with_a = pairs_with_region[valid_pairs[i].a[1]];
+                const vector<int>& with_b = pairs_with_region[valid_pairs[i].b[1]];
+                for (size_t k=0; k<with_a.size(); k++)
+                    if (with_a[k] > i)
+                        pair_candidates.push_back(with_a[k]);
+                for (size_t k=0; k<with_b.size(); k++)
+                    if (with_b[k] > i)
+                        pair_candidates.push_back(with_b[k]);
+                sort(pair_candidates.begin(), pair_candidates.end());
+                pair_candidates.erase(unique(pair_candidates.begin(), pair_candidates.end()), pair_candidates.end());
+
+                for (size_t k=0; k<pair_candidates.size(); k++)
                 {
-                    valid_triplets.push_back(valid_triplet);
-                    //cout << "Valid triplet (" << valid_triplet.a[1] << "," <<  valid_triplet.b[1] << "," <<  valid_triplet.c[1] << ")" << endl;
+                    // check collinearity rules
+                    region_triplet valid_triplet(Vec2i(0,0),Vec2i(0,0),Vec2i(0,0));
+                    if (isValidTriplet(regions, valid_pairs[i], valid_pairs[pair_candidates[k]], valid_triplet))
+                        triplets_of[i].push_back(valid_triplet);
                 }
             }
-        }
+        }, max(1, min(num_pairs/64, 4*getNumThreads())));
+
+        vector< region_triplet > valid_triplets;
+        for (int i=0; i<num_pairs; i++)
+            valid_triplets.insert(valid_triplets.end(), triplets_of[i].begin(), triplets_of[i].end());
 
         //cout << "GroupingNM : detected " << valid_triplets.size() << " valid triplets" << endl;
 
@@ -3706,19 +4014,46 @@ void erGroupingNM(InputArray _img, InputArrayOfArrays _src, vector< vector<ERSta
             pending_sequences.push_back(region_sequence(valid_triplets[i]));
         }
 
-
+        // Each sequence absorbs, in order, the following ones that are valid with it. A sequence only
+        // grows, so a following sequence that was valid with it stays valid, and after a merge only
+        // the absorbed triplets need to be checked against the rest. The checks against the
+        // remaining sequences are done in parallel.
+        vector<uchar> absorbed(pending_sequences.size(), 0);
         for (size_t i=0; i<pending_sequences.size(); i++)
         {
-            bool expanded = false;
+            if (absorbed[i])
+                continue;
+
+            vector<int> following;
             for (size_t j=i+1; j<pending_sequences.size(); j++)
+                if (!absorbed[j])
+                    following.push_back((int)j);
+            vector<uchar> valid(following.size(), 0);
+
+            bool expanded = false;
+            region_sequence probe = pending_sequences[i];
+            for (size_t first=0; first<following.size(); )
             {
-                if (isValidSequence(pending_sequences[i], pending_sequences[j]))
+                const int num_following = (int)(following.size() - first);
+                parallel_for_(Range((int)first, (int)following.size()), [&](const Range& range)
                 {
-                    expanded = true;
-                    pending_sequences[i].triplets.insert(pending_sequences[i].triplets.begin(), pending_sequences[j].triplets.begin(), pending_sequences[j].triplets.end());
-                    pending_sequences.erase(pending_sequences.begin()+j);
-                    j--;
-                }
+                    for (int k=range.start; k<range.end; k++)
+                        if (!valid[k] && isValidSequence(probe, pending_sequences[following[k]]))
+                            valid[k] = 1;
+                }, max(1, min(num_following/32, 4*getNumThreads())));
+
+                size_t k = first;
+                while (k<following.size() && !valid[k])
+                    k++;
+                if (k == following.size())
+                    break;
+
+                region_sequence &merged = pending_sequences[following[k]];
+                expanded = true;
+                pending_sequences[i].triplets.insert(pending_sequences[i].triplets.begin(), merged.triplets.begin(), merged.triplets.end());
+                absorbed[following[k]] = 1;
+                probe = merged;
+                first = k+1;
             }
             if (expanded)
             {
@@ -3756,6 +4091,7 @@ void erGroupingNM(InputArray _img, InputArrayOfArrays _src, vector< vector<ERSta
 
             //Feedback loop of detected lines to region extraction ... tries to recover mismatches in the region decomposition step by extracting regions in the neighbourhood of a valid sequence and checking if they are consistent with its line estimates
             Ptr<ERFilter> er_filter = createERFilterNM1(loadDummyClassifier(),1,0.005f,0.3f,0.f,false);
+            Mat mask = Mat::zeros(img.rows+2, img.cols+2, CV_8UC1);
             for (int i=0; i<(int)valid_sequences.size(); i++)
             {
                 vector<Point> bbox_points;
@@ -4107,11 +4443,39 @@ void detectRegions(InputArray image, const Ptr<ERFilter>& er_filter1, const Ptr<
 
     vector<vector<ERStat> > regions(channels.size());
 
-    // Apply the default cascade classifier to each independent channel (could be done in parallel)
-    for (int c=0; c<(int)channels.size(); c++)
+    // Apply the default cascade classifier to each independent channel. The channels are processed
+    // in parallel by copies of the filters when possible; the last channel uses the given filters,
+    // which are left in the same state as after a serial run.
+    const int nchannels = (int)channels.size();
+    vector< Ptr<ERFilter> > filters1(nchannels, er_filter1), filters2(nchannels, er_filter2);
+    ERFilterNM *nm1 = dynamic_cast<ERFilterNM*>(er_filter1.get());
+    ERFilterNM *nm2 = dynamic_cast<ERFilterNM*>(er_filter2.get());
+    bool parallel = (nm1 != NULL) && (nm2 != NULL);
+    for (int c=0; parallel && c<nchannels-1; c++)
+    {
+        filters1[c] = nm1->cloneForThread();
+        filters2[c] = nm2->cloneForThread();
+        parallel = !filters1[c].empty() && !filters2[c].empty();
+    }
+
+    if (parallel)
+    {
+        parallel_for_(Range(0, nchannels), [&](const Range& range)
+        {
+            for (int c=range.start; c<range.end; c++)
+            {
+                filters1[c]->run(channels[c], regions[c]);
+                filters2[c]->run(channels[c], regions[c]);
+            }
+        }, nchannels);
+    }
+    else
     {
-        er_filter1->run(channels[c], regions[c]);
-        er_filter2->run(channels[c], regions[c]);
+        for (int c=0; c<nchannels; c++)
+        {
+            er_filter1->run(channels[c], regions[c]);
+            er_filter2->run(channels[c], regions[c]);
+        }
     }
    // Detect character groups
     vector< vector<Vec2i> > nm_region_groups;
@@ -74,6 +74,110 @@ TEST_P(Detection, sample)
     EXPECT_GT(groups_boxes.size(), 3u);
 }
 
+TEST(Text, detectRegions_threads)
+{
+    String nm1_file = findDataFile("trained_classifierNM1.xml");
+    String nm2_file = findDataFile("trained_classifierNM2.xml");
+    Ptr<ERFilter> er_filter1 = createERFilterNM1(loadClassifierNM1(nm1_file),16,0.00015f,0.13f,0.2f,true,0.1f);
+    Ptr<ERFilter> er_filter2 = createERFilterNM2(loadClassifierNM2(nm2_file),0.5);
+    Mat src = cv::imread(findDataFile("text/scenetext01.jpg"));
+    ASSERT_FALSE(src.empty());
+
+    std::vector<Rect> boxes;
+    detectRegions(src, er_filter1, er_filter2, boxes);
+
+    // the channels and the regions are processed in parallel, the result must not depend on it
+    int nThreads = getNumThreads();
+    setNumThreads(1);
+    std::vector<Rect> serialBoxes;
+    detectRegions(src, er_filter1, er_filter2, serialBoxes);
+    setNumThreads(nThreads);
+
+    EXPECT_EQ(serialBoxes, boxes);
+}
+
+TEST(Text, erGrouping_horiz_threads)
+{
+    String nm1_file = findDataFile("trained_classifierNM1.xml");
+    String nm2_file = findDataFile("trained_classifierNM2.xml");
+    Ptr<ERFilter> er_filter1 = createERFilterNM1(loadClassifierNM1(nm1_file),16,0.00015f,0.13f,0.2f,true,0.1f);
+    Ptr<ERFilter> er_filter2 = createERFilterNM2(loadClassifierNM2(nm2_file),0.5);
+    Mat src = cv::imread(findDataFile("text/scenetext01.jpg"));
+    ASSERT_FALSE(src.empty());
+
+    std::vector<Mat> channels;
+    computeNMChannels(src, channels);
+    for (size_t c = channels.size(); c > 0; c--)
+        channels.push_back(255 - channels[c - 1]);
+
+    std::vector<std::vector<ERStat> > regions(channels.size());
+    for (size_t c = 0; c < channels.size(); c++)
+    {
+        er_filter1->run(channels[c], regions[c]);
+        er_filter2->run(channels[c], regions[c]);
+    }
+
+    std::vector<std::vector<ERStat> > serialRegions = regions;
+
+    std::vector< std::vector<Vec2i> > groups;
+    std::vector<Rect> boxes;
+    erGrouping(src, channels, regions, groups, boxes, ERGROUPING_ORIENTATION_HORIZ);
+
+    // the pairs and the triplets are searched in parallel, the groups must not depend on it
+    int nThreads = getNumThreads();
+    setNumThreads(1);
+    std::vector< std::vector<Vec2i> > serialGroups;
+    std::vector<Rect> serialBoxes;
+    erGrouping(src, channels, serialRegions, serialGroups, serialBoxes, ERGROUPING_ORIENTATION_HORIZ);
+    setNumThreads(nThreads);
+
+    EXPECT_EQ(serialGroups, groups);
+    EXPECT_EQ(serialBoxes, boxes);
+}
+
+TEST(Text, erGrouping_horiz_reference)
+{
+    Mat src = cv::imread(findDataFile("text/scenetext01.jpg"));
+    ASSERT_FALSE(src.empty());
+    Mat grey;
+    cvtColor(src, grey, COLOR_BGR2GRAY);
+
+    // regions of the grey channel, and the boxes the exhaustive pair and triplet search groups them in
+    FileStorage fs(findDataFile("text/scenetext01_groups_horiz.xml.gz"), FileStorage::READ);
+    ASSERT_TRUE(fs.isOpened());
+    Mat contourSizes, contourPoints, referenceBoxes;
+    fs["contour_sizes"] >> contourSizes;
+    fs["contour_points"] >> contourPoints;
+    fs["boxes"] >> referenceBoxes;
+    ASSERT_EQ(CV_32S, contourSizes.type());
+    ASSERT_EQ(CV_32S, contourPoints.type());
+    ASSERT_EQ(CV_32S, referenceBoxes.type());
+
+    std::vector<std::vector<Point> > contours(contourSizes.total());
+    for (size_t c = 0, p = 0; c < contours.size(); c++)
+    {
+        for (int k = 0; k < contourSizes.at<int>((int)c); k++, p++)
+            contours[c].push_back(Point(contourPoints.at<int>((int)p, 0), contourPoints.at<int>((int)p, 1)));
+    }
+
+    std::vector<Rect> boxes;
+    erGrouping(src, grey, contours, boxes, ERGROUPING_ORIENTATION_HORIZ);
+
+    int nThreads = getNumThreads();
+    setNumThreads(1);
+    std::vector<Rect> serialBoxes;
+    erGrouping(src, grey, contours, serialBoxes, ERGROUPING_ORIENTATION_HORIZ);
+    setNumThreads(nThreads);
+
+    EXPECT_EQ(serialBoxes, boxes);
+    ASSERT_EQ((size_t)referenceBoxes.rows, boxes.size());
+    for (int i = 0; i < referenceBoxes.rows; i++)
+    {
+        const int* r = referenceBoxes.ptr<int>(i);
+        EXPECT_EQ(Rect(r[0], r[1], r[2], r[3]), boxes[i]) << "box " << i;
+    }
+}
+
 INSTANTIATE_TEST_CASE_P(Text, Detection,
     testing::Combine(
         testing::Values(
@@ -135,16 +135,12 @@ public:
 
     ///
     /// \brief Computes images descriptors.
+    /// Images are resized in parallel.
     /// \param[in] mats Frames containing images of interest.
     /// \param[out] descrs Matrices to store the computed descriptors.
-    //
+    ///
     void compute(const std::vector<cv::Mat> &mats,
-                 CV_OUT std::vector<cv::Mat>& descrs) override  {
-        descrs.resize(mats.size());
-        for (size_t i = 0; i < mats.size(); i++)  {
-            compute(mats[i], descrs[i]);
-        }
-    }
+                 CV_OUT std::vector<cv::Mat>& descrs) override;
 
 private:
     cv::Size descr_size_;
@@ -176,6 +172,19 @@ public:
     virtual std::vector<float> compute(const std::vector<cv::Mat> &descrs1,
                                        const std::vector<cv::Mat> &descrs2) = 0;
 
+    ///
+    /// \brief Computes distances between all pairs of descriptors.
+    /// The default implementation calls compute() for every pair.
+    /// \param[in] descrs1 First set of descriptors.
+    /// \param[in] descrs2 Second set of descriptors.
+    /// \param[out] distances CV_32F matrix of size descrs1.size() x descrs2.size()
+    ///             where element (i, j) is the distance between descrs1[i] and
+    ///             descrs2[j].
+    ///
+    virtual void computeMatrix(const std::vector<cv::Mat> &descrs1,
+                               const std::vector<cv::Mat> &descrs2,
+                               CV_OUT cv::Mat& distances);
+
     virtual ~IDescriptorDistance() {}
 };
 
@@ -209,6 +218,17 @@ public:
         const std::vector<cv::Mat> &descrs1,
         const std::vector<cv::Mat> &descrs2) override;
 
+    ///
+    /// \brief Computes distances between all pairs of descriptors with a
+    /// single matrix product.
+    /// \param[in] descrs1 First set of descriptors.
+    /// \param[in] descrs2 Second set of descriptors.
+    /// \param[out] distances CV_32F matrix of pairwise distances.
+    ///
+    void computeMatrix(const std::vector<cv::Mat> &descrs1,
+                       const std::vector<cv::Mat> &descrs2,
+                       CV_OUT cv::Mat& distances) override;
+
 private:
     cv::Size descriptor_size_;
 };
@@ -250,6 +270,15 @@ public:
     ///
     std::vector<float> compute(const std::vector<cv::Mat> &descrs1,
                                const std::vector<cv::Mat> &descrs2) override;
+    ///
+    /// \brief Computes distances between all pairs of descriptors in parallel.
+    /// \param[in] descrs1 First set of descriptors.
+    /// \param[in] descrs2 Second set of descriptors.
+    /// \param[out] distances CV_32F matrix of pairwise distances.
+    ///
+    void computeMatrix(const std::vector<cv::Mat> &descrs1,
+                       const std::vector<cv::Mat> &descrs2,
+                       CV_OUT cv::Mat& distances) override;
     virtual ~MatchTemplateDistance() {}
 
 private:
@@ -408,6 +437,9 @@ public:
 /// detections. The affinity equals to
 ///       appearance_affinity * motion_affinity * shape_affinity.
 /// Where appearance is 1 - distance(tracklet_fast_dscr, detection_fast_dscr).
+/// Fast descriptors of all detections are computed with a single batch call
+/// (IImageDescriptor::compute), and the appearance distance is only computed
+/// for the pairs whose motion, shape and time affinities are not negligible.
 /// Second step is to solve the assignment problem using Kuhn-Munkres
 /// algorithm. If correspondence between some tracklet and detection is
 /// established with low confidence (affinity) then the strong descriptor is
@@ -0,0 +1,76 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "perf_precomp.hpp"
+
+#include <opencv2/tracking/tracking_by_matching.hpp>
+
+namespace opencv_test { namespace {
+using namespace perf;
+using namespace cv::detail::tracking::tbm;
+
+// Grid of pedestrian-like boxes that jitter slightly from frame to frame.
+static TrackedObjects makeDetections(int count, const Size& frame_size, int frame_idx, RNG& rng)
+{
+    const Size box(24, 48), cell(32, 64);
+    const int cols = frame_size.width / cell.width;
+    TrackedObjects detections;
+    for (int i = 0; i < count; i++)
+    {
+        Point tl((i % cols) * cell.width + rng.uniform(0, 4), (i / cols) * cell.height + rng.uniform(0, 4));
+        detections.emplace_back(Rect(tl, box), 0.9f, frame_idx, -1);
+    }
+    return detections;
+}
+
+typedef TestBaseWithParam<int> TrackingByMatching;
+
+PERF_TEST_P(TrackingByMatching, process, testing::Values(16, 64, 128, 256))
+{
+    const int count = GetParam();
+    const Size frame_size(1920, 1080);
+    CV_Assert(count <= (frame_size.width / 32) * (frame_size.height / 64));
+
+    Mat frame(frame_size, CV_8UC3);
+    RNG rng(12345);
+    rng.fill(frame, RNG::UNIFORM, 0, 256);
+
+    Ptr<ITrackerByMatching> tracker = createTrackerByMatching();
+    tracker->setDescriptorFast(std::make_shared<ResizedImageDescriptor>(Size(16, 32), INTER_LINEAR));
+    tracker->setDistanceFast(std::make_shared<MatchTemplateDistance>());
+
+    int frame_idx = 0;
+    tracker->process(frame, makeDetections(count, frame_size, frame_idx, rng), 40);
+
+    TEST_CYCLE()
+    {
+        frame_idx++;
+        tracker->process(frame, makeDetections(count, frame_size, frame_idx, rng),
+                         static_cast<uint64_t>(frame_idx + 1) * 40);
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+
+PERF_TEST_P(TrackingByMatching, cos_distance_matrix, testing::Values(16, 64, 128, 256))
+{
+    const int count = GetParam();
+    const Size descriptor_size(1, 256);
+    std::vector<Mat> descriptors(count);
+    RNG rng(12345);
+    for (auto& descriptor : descriptors)
+    {
+        descriptor.create(descriptor_size, CV_32F);
+        rng.fill(descriptor, RNG::UNIFORM, -1.f, 1.f);
+    }
+
+    CosDistance distance(descriptor_size);
+    Mat distances;
+
+    TEST_CYCLE() distance.computeMatrix(descriptors, descriptors, distances);
+
+    SANITY_CHECK_NOTHING();
+}
+
+}} // namespace
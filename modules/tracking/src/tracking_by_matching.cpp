@@ -33,6 +33,28 @@ inline namespace tracking {
 
 using namespace tbm;
 
+void ResizedImageDescriptor::compute(const std::vector<cv::Mat> &mats,
+                                     std::vector<cv::Mat>& descrs) {
+    descrs.resize(mats.size());
+    cv::parallel_for_(cv::Range(0, static_cast<int>(mats.size())), [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; i++) {
+            compute(mats[i], descrs[i]);
+        }
+    });
+}
+
+void IDescriptorDistance::computeMatrix(const std::vector<cv::Mat> &descrs1,
+                                        const std::vector<cv::Mat> &descrs2,
+                                        cv::Mat& distances) {
+    distances.create(static_cast<int>(descrs1.size()), static_cast<int>(descrs2.size()), CV_32F);
+    for (int i = 0; i < distances.rows; i++) {
+        float* ptr = distances.ptr<float>(i);
+        for (int j = 0; j < distances.cols; j++) {
+            ptr[j] = compute(descrs1[i], descrs2[j]);
+        }
+    }
+}
+
 CosDistance::CosDistance(const cv::Size &descriptor_size)
     : descriptor_size_(descriptor_size) {
     TBM_CHECK(descriptor_size.area() != 0);
@@ -64,6 +86,58 @@ std::vector<float> CosDistance::compute(const std::vector<cv::Mat> &descrs1,
     return distances;
 }
 
+namespace {
+// Stacks descriptors as rows of a CV_64F matrix and returns their squared norms.
+cv::Mat StackDescriptors(const std::vector<cv::Mat> &descrs,
+                         const cv::Size &descriptor_size,
+                         cv::Mat &sqr_norms) {
+    cv::Mat rows;
+    sqr_norms.create(static_cast<int>(descrs.size()), 1, CV_64F);
+    for (size_t i = 0; i < descrs.size(); i++) {
+        TBM_CHECK(!descrs[i].empty());
+        TBM_CHECK(descrs[i].size() == descriptor_size);
+        if (rows.empty()) {
+            rows.create(static_cast<int>(descrs.size()),
+                        static_cast<int>(descrs[i].total() * descrs[i].channels()), CV_64F);
+        }
+        TBM_CHECK_EQ(descrs[i].total() * descrs[i].channels(), static_cast<size_t>(rows.cols));
+        cv::Mat row = rows.row(static_cast<int>(i));
+        cv::Mat src = descrs[i].isContinuous() ? descrs[i] : descrs[i].clone();
+        src.reshape(1, 1).convertTo(row, CV_64F);
+        sqr_norms.at<double>(static_cast<int>(i)) = row.dot(row);
+    }
+    return rows;
+}
+}  // anonymous namespace
+
+void CosDistance::computeMatrix(const std::vector<cv::Mat> &descrs1,
+                                const std::vector<cv::Mat> &descrs2,
+                                cv::Mat& distances) {
+    if (descrs1.empty() || descrs2.empty()) {
+        distances.create(static_cast<int>(descrs1.size()), static_cast<int>(descrs2.size()), CV_32F);
+        return;
+    }
+
+    cv::Mat xx, yy;
+    cv::Mat x = StackDescriptors(descrs1, descriptor_size_, xx);
+    cv::Mat y = StackDescriptors(descrs2, descriptor_size_, yy);
+    TBM_CHECK_EQ(x.cols, y.cols);
+
+    cv::Mat xy;
+    cv::gemm(x, y, 1.0, cv::noArray(), 0.0, xy, cv::GEMM_2_T);
+
+    distances.create(xy.size(), CV_32F);
+    for (int i = 0; i < xy.rows; i++) {
+        const double* xy_ptr = xy.ptr<double>(i);
+        float* ptr = distances.ptr<float>(i);
+        double xx_i = xx.at<double>(i);
+        for (int j = 0; j < xy.cols; j++) {
+            double norm = sqrt(xx_i * yy.at<double>(j)) + 1e-6;
+            ptr[j] = 0.5f * static_cast<float>(1.0 - xy_ptr[j] / norm);
+        }
+    }
+}
+
 
 float MatchTemplateDistance::compute(const cv::Mat &descr1,
                                      const cv::Mat &descr2) {
@@ -86,6 +160,19 @@ std::vector<float> MatchTemplateDistance::compute(const std::vector<cv::Mat> &de
     return result;
 }
 
+void MatchTemplateDistance::computeMatrix(const std::vector<cv::Mat> &descrs1,
+                                          const std::vector<cv::Mat> &descrs2,
+                                          cv::Mat& distances) {
+    distances.create(static_cast<int>(descrs1.size()), static_cast<int>(descrs2.size()), CV_32F);
+    const int total = distances.rows * distances.cols;
+    cv::parallel_for_(cv::Range(0, total), [&](const cv::Range& range) {
+        for (int k = range.start; k < range.end; k++) {
+            int i = k / distances.cols, j = k % distances.cols;
+            distances.at<float>(i, j) = compute(descrs1[i], descrs2[j]);
+        }
+    });
+}
+
 namespace {
 cv::Point Center(const cv::Rect& rect) {
     return cv::Point((int)(rect.x + rect.width * .5), (int)(rect.y + rect.height * .5));
@@ -427,8 +514,8 @@ private:
     std::vector<std::pair<size_t, size_t>> GetTrackToDetectionIds(
         const std::set<std::tuple<size_t, size_t, float>> &matches);
 
-    float AffinityFast(const cv::Mat &descriptor1, const TrackedObject &obj1,
-                       const cv::Mat &descriptor2, const TrackedObject &obj2);
+    bool AffinityFastGeometry(const TrackedObject &obj1, const TrackedObject &obj2,
+                              float &shape_motion_aff, float &time_aff) const;
 
     float Affinity(const TrackedObject &obj1, const TrackedObject &obj2);
 
@@ -984,29 +1071,60 @@ float TrackerByMatching::TimeAffinity(float weight, const float &trk_time,
 void TrackerByMatching::ComputeFastDesciptors(
     const cv::Mat &frame, const TrackedObjects &detections,
     std::vector<cv::Mat>& desriptors) {
-    desriptors = std::vector<cv::Mat>(detections.size(), cv::Mat());
+    std::vector<cv::Mat> images(detections.size());
     for (size_t i = 0; i < detections.size(); i++) {
-        descriptor_fast_->compute(frame(detections[i].rect).clone(),
-                                  desriptors[i]);
+        images[i] = frame(detections[i].rect).clone();
     }
+    desriptors = std::vector<cv::Mat>(detections.size(), cv::Mat());
+    descriptor_fast_->compute(images, desriptors);
 }
 
 void TrackerByMatching::ComputeDissimilarityMatrix(
     const std::set<size_t> &active_tracks, const TrackedObjects &detections,
     const std::vector<cv::Mat> &descriptors_fast,
     cv::Mat& dissimilarity_matrix) {
-    cv::Mat am(static_cast<int>(active_tracks.size()), static_cast<int>(detections.size()), CV_32F, cv::Scalar(0));
-    int i = 0;
+    std::vector<cv::Mat> track_descriptors;
+    std::vector<TrackedObject> last_dets;
+    track_descriptors.reserve(active_tracks.size());
+    last_dets.reserve(active_tracks.size());
     for (auto id : active_tracks) {
-        auto ptr = am.ptr<float>(i);
-        for (size_t j = 0; j < descriptors_fast.size(); j++) {
-            auto last_det = tracks_.at(id).objects.back();
-            last_det.rect = tracks_.at(id).predicted_rect;
-            ptr[j] = AffinityFast(tracks_.at(id).descriptor_fast, last_det,
-                                  descriptors_fast[j], detections[j]);
+        const Track &track = tracks_.at(id);
+        track_descriptors.push_back(track.descriptor_fast);
+        last_dets.push_back(track.objects.back());
+        last_dets.back().rect = track.predicted_rect;
+    }
+
+    // the shape, motion and time affinities are cheap and rule out most of the pairs, the
+    // appearance distance is only computed for the remaining ones
+    cv::Mat am(static_cast<int>(active_tracks.size()), static_cast<int>(detections.size()), CV_32F, cv::Scalar(0));
+    cv::Mat time_am(am.size(), CV_32F);
+    std::vector<std::vector<int>> row_candidates(am.rows);
+    cv::parallel_for_(cv::Range(0, am.rows), [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; i++) {
+            float* ptr = am.ptr<float>(i);
+            float* time_ptr = time_am.ptr<float>(i);
+            for (int j = 0; j < am.cols; j++) {
+                if (AffinityFastGeometry(last_dets[i], detections[j], ptr[j], time_ptr[j]))
+                    row_candidates[i].push_back(j);
+            }
         }
-        i++;
+    });
+
+    std::vector<cv::Point> candidates;
+    for (int i = 0; i < am.rows; i++) {
+        for (int j : row_candidates[i])
+            candidates.emplace_back(j, i);
     }
+
+    cv::parallel_for_(cv::Range(0, static_cast<int>(candidates.size())), [&](const cv::Range& range) {
+        for (int k = range.start; k < range.end; k++) {
+            const cv::Point &c = candidates[k];
+            float app_aff = static_cast<float>(
+                1.0 - distance_fast_->compute(track_descriptors[c.y], descriptors_fast[c.x]));
+            am.at<float>(c) = am.at<float>(c) * app_aff * time_am.at<float>(c);
+        }
+    });
+
     dissimilarity_matrix = 1.0 - am;
 }
 
@@ -1198,25 +1316,24 @@ void TrackerByMatching::AppendToTrack(const cv::Mat &frame,
     }
 }
 
-float TrackerByMatching::AffinityFast(const cv::Mat &descriptor1,
-                                      const TrackedObject &obj1,
-                                      const cv::Mat &descriptor2,
-                                      const TrackedObject &obj2) {
+bool TrackerByMatching::AffinityFastGeometry(const TrackedObject &obj1,
+                                             const TrackedObject &obj2,
+                                             float &shape_motion_aff,
+                                             float &time_aff) const {
     const float eps = static_cast<float>(1e-6);
     float shp_aff = ShapeAffinity(params_.shape_affinity_w, obj1.rect, obj2.rect);
-    if (shp_aff < eps) return 0.0;
+    if (shp_aff < eps) return false;
 
     float mot_aff =
         MotionAffinity(params_.motion_affinity_w, obj1.rect, obj2.rect);
-    if (mot_aff < eps) return 0.0;
-    float time_aff =
+    if (mot_aff < eps) return false;
+    time_aff =
         TimeAffinity(params_.time_affinity_w, static_cast<float>(obj1.frame_idx), static_cast<float>(obj2.frame_idx));
 
-    if (time_aff < eps) return 0.0;
+    if (time_aff < eps) return false;
 
-    float app_aff = static_cast<float>(1.0 - distance_fast_->compute(descriptor1, descriptor2));
-
-    return shp_aff * mot_aff * app_aff * time_aff;
+    shape_motion_aff = shp_aff * mot_aff;
+    return true;
 }
 
 float TrackerByMatching::Affinity(const TrackedObject &obj1,
@@ -0,0 +1,52 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "test_precomp.hpp"
+
+#include "opencv2/tracking/tracking_by_matching.hpp"
+
+namespace opencv_test { namespace {
+using namespace cv::detail::tracking::tbm;
+
+static std::vector<Mat> makeDescriptors(int count, const Size& size, int type, RNG& rng)
+{
+    std::vector<Mat> descriptors(count);
+    for (auto& descriptor : descriptors)
+    {
+        descriptor.create(size, type);
+        rng.fill(descriptor, RNG::UNIFORM, 0, 256);
+    }
+    return descriptors;
+}
+
+static void checkDistanceMatrix(IDescriptorDistance& distance,
+                                const std::vector<Mat>& descrs1, const std::vector<Mat>& descrs2)
+{
+    Mat distances;
+    distance.computeMatrix(descrs1, descrs2, distances);
+    ASSERT_EQ(CV_32F, distances.type());
+    ASSERT_EQ(Size((int)descrs2.size(), (int)descrs1.size()), distances.size());
+    for (int i = 0; i < distances.rows; i++)
+        for (int j = 0; j < distances.cols; j++)
+            EXPECT_NEAR(distance.compute(descrs1[i], descrs2[j]), distances.at<float>(i, j), 1e-5)
+                << "i=" << i << " j=" << j;
+}
+
+TEST(TrackingByMatching, cos_distance_matrix)
+{
+    RNG rng(12345);
+    const Size size(1, 128);
+    CosDistance distance(size);
+    checkDistanceMatrix(distance, makeDescriptors(7, size, CV_32F, rng), makeDescriptors(5, size, CV_32F, rng));
+}
+
+TEST(TrackingByMatching, match_template_distance_matrix)
+{
+    RNG rng(12345);
+    const Size size(16, 32);
+    MatchTemplateDistance distance;
+    checkDistanceMatrix(distance, makeDescriptors(7, size, CV_8UC3, rng), makeDescriptors(5, size, CV_8UC3, rng));
+}
+
+}} // namespace
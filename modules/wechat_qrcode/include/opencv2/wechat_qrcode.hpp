@@ -51,6 +51,23 @@ public:
     CV_WRAP std::vector<std::string> detectAndDecode(InputArray img,
                                                      OutputArrayOfArrays points = noArray());
 
+    /**
+     * @brief Limits the number of decoding attempts that run concurrently.
+     * Every detected candidate is decoded at several scales, each scale trying every binarizer;
+     * these attempts are distributed over up to max_concurrency threads, and the remaining
+     * attempts of a candidate are skipped as soon as it is decoded. The result does not depend
+     * on this value.
+     *
+     * @param max_concurrency maximum number of worker threads; 1 decodes sequentially,
+     * 0 or a negative value uses cv::getNumThreads() (default).
+     */
+    CV_WRAP void setMaxConcurrency(int max_concurrency);
+
+    /**
+     * @brief Returns the limit set by setMaxConcurrency().
+     */
+    CV_WRAP int getMaxConcurrency() const;
+
 protected:
     class Impl;
     Ptr<Impl> p;
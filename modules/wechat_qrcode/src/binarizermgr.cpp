@@ -7,6 +7,7 @@
 #include "precomp.hpp"
 #include "binarizermgr.hpp"
 #include "imgsource.hpp"
+#include "opencv2/core.hpp"
 
 
 using zxing::Binarizer;
@@ -59,6 +60,13 @@ int BinarizerMgr::GetCurBinarizer() {
     return m_vecRotateBinarizer[m_iNowRotateIndex];
 }
 
+int BinarizerMgr::GetBinarizerCount() const { return (int)m_vecRotateBinarizer.size(); }
+
+void BinarizerMgr::SetRotateIndex(int iRotateIndex) {
+    CV_Assert(iRotateIndex >= 0 && iRotateIndex < GetBinarizerCount());
+    m_iNowRotateIndex = iRotateIndex;
+}
+
 void BinarizerMgr::SetNextOnceBinarizer(int iBinarizerIndex) {
     m_iNextOnceBinarizer = iBinarizerIndex;
 }
@@ -37,6 +37,10 @@ public:
 
     int GetCurBinarizer();
 
+    int GetBinarizerCount() const;
+
+    void SetRotateIndex(int iRotateIndex);
+
     void SetNextOnceBinarizer(int iBinarizerIndex);
 
     void SetBinarizer(vector<BINARIZER> vecRotateBinarizer);
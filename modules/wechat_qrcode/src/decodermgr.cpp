@@ -19,37 +19,41 @@ using zxing::UnicomBlock;
 namespace cv {
 namespace wechat_qrcode {
 int DecoderMgr::decodeImage(cv::Mat src, bool use_nn_detector, string& result) {
+    // Four Binarizers
+    int tryBinarizeTime = getBinarizerCount();
+    for (int tb = 0; tb < tryBinarizeTime; tb++) {
+        if (decodeImage(src, use_nn_detector, tb, result) == 0) return 0;
+    }
+    return -1;
+}
+
+int DecoderMgr::decodeImage(cv::Mat src, bool use_nn_detector, int binarizer_index,
+                            string& result) {
     int width = src.cols;
     int height = src.rows;
     if (width <= 20 || height <= 20)
         return -1;  // image data is not enough for providing reliable results
 
-    std::vector<uint8_t> scaled_img_data(src.data, src.data + width * height);
-    zxing::ArrayRef<uint8_t> scaled_img_zx =
-        zxing::ArrayRef<uint8_t>(new zxing::Array<uint8_t>(scaled_img_data));
+    if (!src.isContinuous()) src = src.clone();
 
     zxing::Ref<zxing::Result> zx_result;
 
     decode_hints_.setUseNNDetector(use_nn_detector);
 
-    Ref<ImgSource> source;
-    qbarUicomBlock_ = new UnicomBlock(width, height);
+    // the connected-component buffers only depend on the image size, so they
+    // are kept between attempts
+    if (qbarUicomBlock_ == NULL || block_width_ != width || block_height_ != height) {
+        qbarUicomBlock_ = new UnicomBlock(width, height);
+        block_width_ = width;
+        block_height_ = height;
+    }
 
-    // Four Binarizers
-    int tryBinarizeTime = 4;
-    for (int tb = 0; tb < tryBinarizeTime; tb++) {
-        if (source == NULL || height * width > source->getMaxSize()) {
-            source = ImgSource::create(scaled_img_zx.data(), width, height);
-        } else {
-            source->reset(scaled_img_zx.data(), width, height);
-        }
-        int ret = TryDecode(source, zx_result);
-        if (!ret) {
-            result = zx_result->getText()->getText();
-            return ret;
-        }
-        // try different binarizers
-        binarizer_mgr_.SwitchBinarizer();
+    Ref<ImgSource> source = ImgSource::create(src.data, width, height);
+    binarizer_mgr_.SetRotateIndex(binarizer_index);
+    int ret = TryDecode(source, zx_result);
+    if (!ret) {
+        result = zx_result->getText()->getText();
+        return ret;
     }
     return -1;
 }
@@ -23,13 +23,20 @@ namespace wechat_qrcode {
 
 class DecoderMgr {
 public:
-    DecoderMgr() { reader_ = new zxing::qrcode::QRCodeReader(); };
+    DecoderMgr() : block_width_(0), block_height_(0) { reader_ = new zxing::qrcode::QRCodeReader(); };
     ~DecoderMgr(){};
 
+    // tries every binarizer in turn and stops at the first one that decodes
     int decodeImage(cv::Mat src, bool use_nn_detector, string& result);
 
+    // single attempt with the binarizer_index-th binarizer
+    int decodeImage(cv::Mat src, bool use_nn_detector, int binarizer_index, string& result);
+
+    int getBinarizerCount() const { return binarizer_mgr_.GetBinarizerCount(); }
+
 private:
     zxing::Ref<zxing::UnicomBlock> qbarUicomBlock_;
+    int block_width_, block_height_;
     zxing::DecodeHints decode_hints_;
 
     zxing::Ref<zxing::qrcode::QRCodeReader> reader_;
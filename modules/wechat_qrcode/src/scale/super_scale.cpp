@@ -45,8 +45,12 @@ int SuperScale::superResoutionScale(const Mat &src, Mat &dst) {
     Mat blob;
     dnn::blobFromImage(src, blob, 1.0 / 255, Size(src.cols, src.rows), {0.0f}, false, false);
 
-    srnet_.setInput(blob);
-    auto prob = srnet_.forward();
+    Mat prob;
+    {
+        AutoLock lock(srnet_mutex_);
+        srnet_.setInput(blob);
+        prob = srnet_.forward();
+    }
 
     dst = Mat(prob.size[2], prob.size[3], CV_8UC1);
 
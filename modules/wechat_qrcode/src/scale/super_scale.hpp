@@ -23,6 +23,7 @@ public:
 
 private:
     dnn::Net srnet_;
+    Mutex srnet_mutex_;  // candidates are scaled from several threads
     bool net_loaded_ = false;
     int superResoutionScale(const cv::Mat &src, cv::Mat &dst);
 };
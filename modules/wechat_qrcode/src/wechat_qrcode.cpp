@@ -13,11 +13,13 @@
 #include "opencv2/core/utils/filesystem.hpp"
 #include "scale/super_scale.hpp"
 #include "zxing/result.hpp"
+#include <atomic>
+#include <climits>
 namespace cv {
 namespace wechat_qrcode {
 class WeChatQRCode::Impl {
 public:
-    Impl() {}
+    Impl() : max_concurrency_(0) {}
     ~Impl() {}
     /**
      * @brief detect QR codes from the given image
@@ -34,6 +36,11 @@ public:
      * all the qrcode can be decoded.
      * @param points succussfully decoded qrcode with bounding box points.
      * @return vector<string>
+     *
+     * The (candidate, scale, binarizer) attempts are distributed over up to
+     * max_concurrency_ workers, each with its own zxing decoder state. A candidate
+     * reports its first successful attempt in sequential order, so the result does
+     * not depend on the number of workers.
      */
     std::vector<std::string> decode(const Mat& img, std::vector<Mat>& candidate_points,
                                     std::vector<Mat>& points);
@@ -43,6 +50,7 @@ public:
     std::shared_ptr<SSDDetector> detector_;
     std::shared_ptr<SuperScale> super_resolution_model_;
     bool use_nn_detector_, use_nn_sr_;
+    int max_concurrency_;
 };
 
 WeChatQRCode::WeChatQRCode(const String& detector_prototxt_path,
@@ -111,35 +119,82 @@ vector<string> WeChatQRCode::detectAndDecode(InputArray img, OutputArrayOfArrays
     return ret;
 };
 
+void WeChatQRCode::setMaxConcurrency(int max_concurrency) {
+    p->max_concurrency_ = max_concurrency;
+}
+
+int WeChatQRCode::getMaxConcurrency() const {
+    return p->max_concurrency_;
+}
+
 vector<string> WeChatQRCode::Impl::decode(const Mat& img, vector<Mat>& candidate_points,
                                           vector<Mat>& points) {
     if (candidate_points.size() == 0) {
         return vector<string>();
     }
-    vector<string> decode_results;
-    for (auto& point : candidate_points) {
-        Mat cropped_img;
-        if (use_nn_detector_) {
-            Align aligner;
-            cropped_img = cropObj(img, point, aligner);
-        } else {
-            cropped_img = img;
+    const int num_candidates = (int)candidate_points.size();
+
+    vector<Mat> cropped_imgs(num_candidates);
+    vector<vector<float> > scale_lists(num_candidates);
+    parallel_for_(Range(0, num_candidates), [&](const Range& range) {
+        for (int i = range.start; i < range.end; i++) {
+            if (use_nn_detector_) {
+                Align aligner;
+                cropped_imgs[i] = cropObj(img, candidate_points[i], aligner);
+            } else {
+                cropped_imgs[i] = img;
+            }
+            // scale_list contains different scale ratios
+            scale_lists[i] = getScaleList(cropped_imgs[i].cols, cropped_imgs[i].rows);
         }
-        // scale_list contains different scale ratios
-        auto scale_list = getScaleList(cropped_img.cols, cropped_img.rows);
-        for (auto cur_scale : scale_list) {
-            Mat scaled_img =
-                super_resolution_model_->processImageScale(cropped_img, cur_scale, use_nn_sr_);
+    });
+
+    // attempts are numbered in sequential order: candidate, then scale. Each attempt tries every
+    // binarizer with its own DecoderMgr, as the zxing reader keeps state between the binarizers
+    vector<int> first_attempt(num_candidates + 1, 0);
+    for (int i = 0; i < num_candidates; i++) {
+        first_attempt[i + 1] = first_attempt[i] + (int)scale_lists[i].size();
+    }
+    const int num_attempts = first_attempt[num_candidates];
+
+    // per candidate, the first (candidate-local) attempt known to succeed
+    vector<std::atomic<int> > decoded_attempt(num_candidates);
+    for (auto& attempt : decoded_attempt) attempt.store(INT_MAX);
+    vector<string> attempt_results(num_attempts);
+    std::atomic<int> next_attempt(0);
+
+    const int max_workers = max_concurrency_ > 0 ? max_concurrency_ : getNumThreads();
+    const int num_workers = std::max(1, std::min(max_workers, num_attempts));
+    parallel_for_(Range(0, num_workers), [&](const Range&) {
+        for (int attempt = next_attempt++; attempt < num_attempts; attempt = next_attempt++) {
+            int candidate = (int)(std::upper_bound(first_attempt.begin(), first_attempt.end(),
+                                                   attempt) - first_attempt.begin()) - 1;
+            int local_attempt = attempt - first_attempt[candidate];
+            // an earlier attempt of this candidate has already succeeded
+            if (decoded_attempt[candidate].load() < local_attempt) continue;
+
+            Mat scaled_img = super_resolution_model_->processImageScale(
+                cropped_imgs[candidate], scale_lists[candidate][local_attempt], use_nn_sr_);
             string result;
             DecoderMgr decodemgr;
             auto ret = decodemgr.decodeImage(scaled_img, use_nn_detector_, result);
-
             if (ret == 0) {
-                decode_results.push_back(result);
-                points.push_back(point);
-                break;
+                attempt_results[attempt] = result;
+                int best = decoded_attempt[candidate].load();
+                while (local_attempt < best &&
+                       !decoded_attempt[candidate].compare_exchange_weak(best, local_attempt)) {
+                }
             }
         }
+    }, num_workers);
+
+    vector<string> decode_results;
+    for (int i = 0; i < num_candidates; i++) {
+        int local_attempt = decoded_attempt[i].load();
+        if (local_attempt != INT_MAX) {
+            decode_results.push_back(attempt_results[first_attempt[i] + local_attempt]);
+            points.push_back(candidate_points[i]);
+        }
     }
 
     return decode_results;
@@ -13,30 +13,34 @@
 
 #include <cstddef>
 #include <algorithm>
+#include <atomic>
 namespace zxing {
 
 /* base class for reference-counted objects */
+/* the count is atomic: static objects (e.g. qrcode versions) are shared by
+   decoders running on different threads */
 class Counted {
 private:
-    unsigned int count_;
+    std::atomic<unsigned int> count_;
 
 public:
     Counted() : count_(0) {}
+    Counted(const Counted&) : count_(0) {}
+    Counted& operator=(const Counted&) { return *this; }
     virtual ~Counted() {}
     Counted* retain() {
-        count_++;
+        count_.fetch_add(1, std::memory_order_relaxed);
         return this;
     }
     void release() {
-        count_--;
-        if (count_ == 0) {
-            count_ = 0xDEADF001;
+        if (count_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            count_.store(0xDEADF001, std::memory_order_relaxed);
             delete this;
         }
     }
 
     /* return the current count for denugging purposes or similar */
-    int count() const { return count_; }
+    int count() const { return count_.load(std::memory_order_relaxed); }
 };
 
 /* counting reference to reference-counted objects */
@@ -283,7 +283,33 @@ TEST_P(Objdetect_QRCode_Multi, regression) {
     }
 }
 
+typedef testing::TestWithParam<std::string> Objdetect_QRCode_Concurrency;
+TEST_P(Objdetect_QRCode_Concurrency, same_as_sequential) {
+    const std::string name_current_image = GetParam();
+    const std::string root = "qrcode/";
+
+    std::string image_path = findDataFile(root + name_current_image);
+    Mat src = imread(image_path, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(src.empty()) << "Can't read image: " << image_path;
+
+    auto detector = wechat_qrcode::WeChatQRCode();
+    EXPECT_EQ(0, detector.getMaxConcurrency());
+    detector.setMaxConcurrency(1);
+    vector<Mat> sequential_points;
+    vector<string> sequential_info = detector.detectAndDecode(src, sequential_points);
+
+    detector.setMaxConcurrency(4);
+    vector<Mat> parallel_points;
+    vector<string> parallel_info = detector.detectAndDecode(src, parallel_points);
+
+    EXPECT_EQ(sequential_info, parallel_info);
+    ASSERT_EQ(sequential_points.size(), parallel_points.size());
+    for (size_t i = 0; i < sequential_points.size(); i++)
+        EXPECT_EQ(0, cvtest::norm(sequential_points[i], parallel_points[i], NORM_INF));
+}
+
 INSTANTIATE_TEST_CASE_P(/**/, Objdetect_QRCode, testing::ValuesIn(qrcode_images_name));
+INSTANTIATE_TEST_CASE_P(/**/, Objdetect_QRCode_Concurrency, testing::ValuesIn(qrcode_images_name));
 INSTANTIATE_TEST_CASE_P(/**/, Objdetect_QRCode_Close, testing::ValuesIn(qrcode_images_close));
 INSTANTIATE_TEST_CASE_P(/**/, Objdetect_QRCode_Monitor, testing::ValuesIn(qrcode_images_monitor));
 INSTANTIATE_TEST_CASE_P(/**/, Objdetect_QRCode_Curved, testing::ValuesIn(qrcode_images_curved));
@@ -0,0 +1,39 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+#include "perf_precomp.hpp"
+
+namespace opencv_test { namespace {
+
+typedef perf::TestBaseWithParam<std::string> freak;
+
+#define FREAK_IMAGES \
+    "cv/detectors_descriptors_evaluation/images_datasets/leuven/img1.png",\
+    "stitching/a3.png"
+
+PERF_TEST_P(freak, extract, testing::Values(FREAK_IMAGES))
+{
+    string filename = getDataPath(GetParam());
+    Mat frame = imread(filename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(frame.empty()) << "Unable to load source image " << filename;
+
+    Mat mask;
+    declare.in(frame).time(90);
+
+    Ptr<ORB> detector = ORB::create(10000);
+    vector<KeyPoint> points;
+    detector->detect(frame, points, mask);
+
+    Ptr<FREAK> descriptor = FREAK::create();
+    vector<KeyPoint> described;
+    Mat descriptors;
+    TEST_CYCLE()
+    {
+        described = points;
+        descriptor->compute(frame, described, descriptors);
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+
+}} // namespace
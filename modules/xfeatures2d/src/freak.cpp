@@ -31,6 +31,7 @@
 //  the use of this software, even if advised of the possibility of such damage.
 
 #include "precomp.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 #include <fstream>
 #include <stdlib.h>
 #include <algorithm>
@@ -91,15 +92,24 @@ protected:
 
     void buildPattern();
 
+    struct PatternPoint;
+
     template <typename imgType, typename iiType>
-    imgType meanIntensity( InputArray image, InputArray integral, const float kp_x, const float kp_y,
-                          const unsigned int scale, const unsigned int rot, const unsigned int point );
+    imgType meanIntensity( const Mat& image, const Mat& integral, const float kp_x, const float kp_y,
+                          const PatternPoint& FreakPoint ) const;
 
     template <typename srcMatType, typename iiMatType>
     void computeDescriptors( InputArray image, std::vector<KeyPoint>& keypoints, OutputArray descriptors );
 
+    /** estimates the orientation of a single keypoint and writes its descriptor to desc
+     * (a zero-initialized output row); safe to call concurrently for different keypoints
+     */
+    template <typename srcMatType, typename iiMatType>
+    void describeKeypoint( const Mat& image, const Mat& integral, KeyPoint& keypoint,
+                           int scaleIdx, uchar* desc ) const;
+
     template <typename srcMatType>
-    void extractDescriptor(srcMatType *pointsValue, void ** ptr);
+    void extractDescriptor( const srcMatType *pointsValue, uchar* desc ) const;
 
     bool orientationNormalized; //true if the orientation is normalized, false otherwise
     bool scaleNormalized; //true if the scale is normalized, false otherwise
@@ -364,9 +374,9 @@ void FREAK_Impl::compute( InputArray _image, std::vector<KeyPoint>& keypoints, O
 }
 
 template <typename srcMatType>
-void FREAK_Impl::extractDescriptor(srcMatType *pointsValue, void ** ptr)
+void FREAK_Impl::extractDescriptor( const srcMatType *pointsValue, uchar* desc ) const
 {
-    std::bitset<FREAK::NB_PAIRS>** ptrScalar = (std::bitset<FREAK::NB_PAIRS>**) ptr;
+    std::bitset<FREAK::NB_PAIRS>* ptrScalar = (std::bitset<FREAK::NB_PAIRS>*) desc;
 
     // extracting descriptor preserving the order of SSE version
     int cnt = 0;
@@ -377,70 +387,38 @@ void FREAK_Impl::extractDescriptor(srcMatType *pointsValue, void ** ptr)
             int nm = n-m;
             for(int kk = nm+15*8; kk >= nm; kk-=8, ++cnt)
             {
-                (*ptrScalar)->set(kk, pointsValue[descriptionPairs[cnt].i] >= pointsValue[descriptionPairs[cnt].j]);
+                ptrScalar->set(kk, pointsValue[descriptionPairs[cnt].i] >= pointsValue[descriptionPairs[cnt].j]);
             }
         }
     }
-    --(*ptrScalar);
 }
 
-#if CV_SSE2
+#if CV_SIMD128
 template <>
-void FREAK_Impl::extractDescriptor(uchar *pointsValue, void ** ptr)
+void FREAK_Impl::extractDescriptor( const uchar *pointsValue, uchar* desc ) const
 {
-    __m128i** ptrSSE = (__m128i**) ptr;
+    uchar CV_DECL_ALIGNED(16) operand1[16];
+    uchar CV_DECL_ALIGNED(16) operand2[16];
 
     // note that comparisons order is modified in each block (but first 128 comparisons remain globally the same-->does not affect the 128,384 bits segmanted matching strategy)
     int cnt = 0;
-    for( int n = FREAK::NB_PAIRS/128; n-- ; )
+    for( int n = 0; n < FREAK::NB_PAIRS/128; ++n, desc += 16 )
     {
-        __m128i result128 = _mm_setzero_si128();
+        v_uint8x16 result128 = v_setzero_u8();
         for( int m = 128/16; m--; cnt += 16 )
         {
-            __m128i operand1 = _mm_set_epi8(pointsValue[descriptionPairs[cnt+0].i],
-                                            pointsValue[descriptionPairs[cnt+1].i],
-                                            pointsValue[descriptionPairs[cnt+2].i],
-                                            pointsValue[descriptionPairs[cnt+3].i],
-                                            pointsValue[descriptionPairs[cnt+4].i],
-                                            pointsValue[descriptionPairs[cnt+5].i],
-                                            pointsValue[descriptionPairs[cnt+6].i],
-                                            pointsValue[descriptionPairs[cnt+7].i],
-                                            pointsValue[descriptionPairs[cnt+8].i],
-                                            pointsValue[descriptionPairs[cnt+9].i],
-                                            pointsValue[descriptionPairs[cnt+10].i],
-                                            pointsValue[descriptionPairs[cnt+11].i],
-                                            pointsValue[descriptionPairs[cnt+12].i],
-                                            pointsValue[descriptionPairs[cnt+13].i],
-                                            pointsValue[descriptionPairs[cnt+14].i],
-                                            pointsValue[descriptionPairs[cnt+15].i]);
-
-            __m128i operand2 = _mm_set_epi8(pointsValue[descriptionPairs[cnt+0].j],
-                                            pointsValue[descriptionPairs[cnt+1].j],
-                                            pointsValue[descriptionPairs[cnt+2].j],
-                                            pointsValue[descriptionPairs[cnt+3].j],
-                                            pointsValue[descriptionPairs[cnt+4].j],
-                                            pointsValue[descriptionPairs[cnt+5].j],
-                                            pointsValue[descriptionPairs[cnt+6].j],
-                                            pointsValue[descriptionPairs[cnt+7].j],
-                                            pointsValue[descriptionPairs[cnt+8].j],
-                                            pointsValue[descriptionPairs[cnt+9].j],
-                                            pointsValue[descriptionPairs[cnt+10].j],
-                                            pointsValue[descriptionPairs[cnt+11].j],
-                                            pointsValue[descriptionPairs[cnt+12].j],
-                                            pointsValue[descriptionPairs[cnt+13].j],
-                                            pointsValue[descriptionPairs[cnt+14].j],
-                                            pointsValue[descriptionPairs[cnt+15].j]);
-
-            __m128i workReg = _mm_min_epu8(operand1, operand2); // emulated "not less than" for 8-bit UNSIGNED integers
-            workReg = _mm_cmpeq_epi8(workReg, operand2);        // emulated "not less than" for 8-bit UNSIGNED integers
-
-            workReg = _mm_and_si128(_mm_set1_epi16(short(0x8080 >> m)), workReg); // merge the last 16 bits with the 128bits std::vector until full
-            result128 = _mm_or_si128(result128, workReg);
+            // gather the 16 pairs, the last pair of the group goes to the first lane
+            for( int l = 0; l < 16; ++l )
+            {
+                operand1[l] = pointsValue[descriptionPairs[cnt+15-l].i];
+                operand2[l] = pointsValue[descriptionPairs[cnt+15-l].j];
+            }
+            v_uint8x16 workReg = v_load_aligned(operand1) >= v_load_aligned(operand2);
+
+            result128 |= workReg & v_setall_u8((uchar)(0x80 >> m)); // merge the last 16 bits with the 128bits std::vector until full
         }
-        (**ptrSSE) = result128;
-        ++(*ptrSSE);
+        v_store(desc, result128);
     }
-    (*ptrSSE) -= 8;
 }
 #endif
 
@@ -451,190 +429,130 @@ void FREAK_Impl::computeDescriptors( InputArray _image, std::vector<KeyPoint>& k
     Mat imgIntegral;
     integral(image, imgIntegral, DataType<iiMatType>::type);
     std::vector<int> kpScaleIdx(keypoints.size()); // used to save pattern scale index corresponding to each keypoints
-    const std::vector<int>::iterator ScaleIdxBegin = kpScaleIdx.begin(); // used in std::vector erase function
-    const std::vector<cv::KeyPoint>::iterator kpBegin = keypoints.begin(); // used in std::vector erase function
     const float sizeCst = static_cast<float>(FREAK::NB_SCALES/(FREAK_LOG2* nOctaves));
-    srcMatType pointsValue[FREAK_NB_POINTS];
-    int thetaIdx = 0;
-    int direction0;
-    int direction1;
+    // equivalent to the formule when the scale is normalized with a constant size of keypoints[k].size=3*SMALLEST_KP_SIZE
+    const int constScaleIdx = std::min( std::max( cvRound(1.0986122886681*sizeCst) ,0), FREAK::NB_SCALES-1 );
 
-    // compute the scale index corresponding to the keypoint size and remove keypoints close to the border
-    if( scaleNormalized )
+    // compute the scale index corresponding to the keypoint size and remove keypoints close to the border,
+    // compacting the survivors in place so that their relative order is preserved
+    size_t nKept = 0;
+    for( size_t k = 0; k < keypoints.size(); ++k )
     {
-        for( size_t k = keypoints.size(); k--; )
+        int scaleIdx = constScaleIdx;
+        if( scaleNormalized )
         {
-            //Is k non-zero? If so, decrement it and continue"
-            kpScaleIdx[k] = std::max( (int)(std::log(keypoints[k].size/FREAK_SMALLEST_KP_SIZE)*sizeCst+0.5) ,0);
-            if( kpScaleIdx[k] >= FREAK::NB_SCALES )
-                kpScaleIdx[k] = FREAK::NB_SCALES-1;
-
-            if( keypoints[k].pt.x <= patternSizes[kpScaleIdx[k]] || //check if the description at this specific position and scale fits inside the image
-                 keypoints[k].pt.y <= patternSizes[kpScaleIdx[k]] ||
-                 keypoints[k].pt.x >= image.cols-patternSizes[kpScaleIdx[k]] ||
-                 keypoints[k].pt.y >= image.rows-patternSizes[kpScaleIdx[k]]
-               )
-            {
-                keypoints.erase(kpBegin+k);
-                kpScaleIdx.erase(ScaleIdxBegin+k);
-            }
+            scaleIdx = std::max( (int)(std::log(keypoints[k].size/FREAK_SMALLEST_KP_SIZE)*sizeCst+0.5) ,0);
+            if( scaleIdx >= FREAK::NB_SCALES )
+                scaleIdx = FREAK::NB_SCALES-1;
         }
+
+        if( keypoints[k].pt.x <= patternSizes[scaleIdx] || //check if the description at this specific position and scale fits inside the image
+            keypoints[k].pt.y <= patternSizes[scaleIdx] ||
+            keypoints[k].pt.x >= image.cols-patternSizes[scaleIdx] ||
+            keypoints[k].pt.y >= image.rows-patternSizes[scaleIdx]
+           )
+            continue;
+
+        if( nKept != k )
+            keypoints[nKept] = keypoints[k];
+        kpScaleIdx[nKept++] = scaleIdx;
+    }
+    keypoints.resize(nKept);
+    kpScaleIdx.resize(nKept);
+
+    // allocate descriptor memory, then estimate orientations and extract descriptors;
+    // every keypoint owns its output row, so keypoints are processed in parallel
+    _descriptors.create((int)keypoints.size(), extAll ? 128 : FREAK::NB_PAIRS/8, CV_8U);
+    _descriptors.setTo(Scalar::all(0));
+    Mat descriptors = _descriptors.getMat();
+
+    const int nKeypoints = (int)keypoints.size();
+    const int nStripes = std::max(1, std::min(nKeypoints / 64, 4 * getNumThreads()));
+    parallel_for_(Range(0, nKeypoints), [&](const Range& range)
+    {
+        for( int k = range.start; k < range.end; ++k )
+            describeKeypoint<srcMatType, iiMatType>(image, imgIntegral, keypoints[k], kpScaleIdx[k],
+                                                    descriptors.ptr<uchar>(k));
+    }, nStripes);
+}
+
+template <typename srcMatType, typename iiMatType>
+void FREAK_Impl::describeKeypoint( const Mat& image, const Mat& imgIntegral, KeyPoint& keypoint,
+                                   int scaleIdx, uchar* desc ) const
+{
+    // pattern points of all orientations at the keypoint scale
+    const PatternPoint* scalePattern = &patternLookup[scaleIdx*FREAK_NB_ORIENTATION*FREAK_NB_POINTS];
+    srcMatType pointsValue[FREAK_NB_POINTS];
+    int thetaIdx = 0;
+
+    // estimate orientation (gradient)
+    if( !orientationNormalized )
+    {
+        thetaIdx = 0; // assign 0° to all keypoints
+        keypoint.angle = 0.0;
     }
     else
     {
-        const int scIdx = std::max( cvRound(1.0986122886681*sizeCst) ,0);
-        for( size_t k = keypoints.size(); k--; )
+        // get the points intensity value in the un-rotated pattern
+        for( int i = FREAK_NB_POINTS; i--; )
+            pointsValue[i] = meanIntensity<srcMatType, iiMatType>(image, imgIntegral, keypoint.pt.x, keypoint.pt.y,
+                                                                  scalePattern[i]);
+        int direction0 = 0;
+        int direction1 = 0;
+        for( int m = 45; m--; )
         {
-            kpScaleIdx[k] = scIdx; // equivalent to the formule when the scale is normalized with a constant size of keypoints[k].size=3*SMALLEST_KP_SIZE
-            if( kpScaleIdx[k] >= FREAK::NB_SCALES )
-            {
-                kpScaleIdx[k] = FREAK::NB_SCALES-1;
-            }
-            if( keypoints[k].pt.x <= patternSizes[kpScaleIdx[k]] ||
-                keypoints[k].pt.y <= patternSizes[kpScaleIdx[k]] ||
-                keypoints[k].pt.x >= image.cols-patternSizes[kpScaleIdx[k]] ||
-                keypoints[k].pt.y >= image.rows-patternSizes[kpScaleIdx[k]]
-               )
-            {
-                keypoints.erase(kpBegin+k);
-                kpScaleIdx.erase(ScaleIdxBegin+k);
-            }
+            //iterate through the orientation pairs
+            const int delta = (pointsValue[ orientationPairs[m].i ]-pointsValue[ orientationPairs[m].j ]);
+            direction0 += delta*(orientationPairs[m].weight_dx)/2048;
+            direction1 += delta*(orientationPairs[m].weight_dy)/2048;
         }
-    }
 
-    // allocate descriptor memory, estimate orientations, extract descriptors
-    if( !extAll )
-    {
-        // extract the best comparisons only
-        _descriptors.create((int)keypoints.size(), FREAK::NB_PAIRS/8, CV_8U);
-        _descriptors.setTo(Scalar::all(0));
-        Mat descriptors = _descriptors.getMat();
+        keypoint.angle = static_cast<float>(atan2((float)direction1,(float)direction0)*(180.0/CV_PI));//estimate orientation
 
-        void *ptr = descriptors.data+(keypoints.size()-1)*descriptors.step[0];
+        thetaIdx = cvRound(FREAK_NB_ORIENTATION*keypoint.angle*(1/360.0));
 
-        for( size_t k = keypoints.size(); k--; ) {
-            // estimate orientation (gradient)
-            if( !orientationNormalized )
-            {
-                thetaIdx = 0; // assign 0° to all keypoints
-                keypoints[k].angle = 0.0;
-            }
-            else
-            {
-                // get the points intensity value in the un-rotated pattern
-                for( int i = FREAK_NB_POINTS; i--; ) {
-                    pointsValue[i] = meanIntensity<srcMatType, iiMatType>(image, imgIntegral,
-                                                                          keypoints[k].pt.x, keypoints[k].pt.y,
-                                                                          kpScaleIdx[k], 0, i);
-                }
-                direction0 = 0;
-                direction1 = 0;
-                for( int m = 45; m--; )
-                {
-                    //iterate through the orientation pairs
-                    const int delta = (pointsValue[ orientationPairs[m].i ]-pointsValue[ orientationPairs[m].j ]);
-                    direction0 += delta*(orientationPairs[m].weight_dx)/2048;
-                    direction1 += delta*(orientationPairs[m].weight_dy)/2048;
-                }
-
-                keypoints[k].angle = static_cast<float>(atan2((float)direction1,(float)direction0)*(180.0/CV_PI));//estimate orientation
-
-                thetaIdx = cvRound(FREAK_NB_ORIENTATION*keypoints[k].angle*(1/360.0));
+        if( thetaIdx < 0 )
+            thetaIdx += FREAK_NB_ORIENTATION;
 
-                if( thetaIdx < 0 )
-                    thetaIdx += FREAK_NB_ORIENTATION;
+        if( thetaIdx >= FREAK_NB_ORIENTATION )
+            thetaIdx -= FREAK_NB_ORIENTATION;
+    }
 
-                if( thetaIdx >= FREAK_NB_ORIENTATION )
-                    thetaIdx -= FREAK_NB_ORIENTATION;
-            }
-            // extract descriptor at the computed orientation
-            for( int i = FREAK_NB_POINTS; i--; ) {
-                pointsValue[i] = meanIntensity<srcMatType, iiMatType>(image, imgIntegral,
-                                                                      keypoints[k].pt.x, keypoints[k].pt.y,
-                                                                      kpScaleIdx[k], thetaIdx, i);
-            }
+    // get the points intensity value in the rotated pattern
+    const PatternPoint* rotatedPattern = scalePattern + thetaIdx*FREAK_NB_POINTS;
+    for( int i = FREAK_NB_POINTS; i--; )
+        pointsValue[i] = meanIntensity<srcMatType, iiMatType>(image, imgIntegral, keypoint.pt.x, keypoint.pt.y,
+                                                              rotatedPattern[i]);
 
-            // Extract descriptor
-            extractDescriptor<srcMatType>(pointsValue, &ptr);
-        }
+    if( !extAll )
+    {
+        // extract the best comparisons only
+        extractDescriptor<srcMatType>(pointsValue, desc);
     }
     else // extract all possible comparisons for selection
     {
-        _descriptors.create((int)keypoints.size(), 128, CV_8U);
-        _descriptors.setTo(Scalar::all(0));
-        Mat descriptors = _descriptors.getMat();
-        std::bitset<1024>* ptr = (std::bitset<1024>*) (descriptors.data+(keypoints.size()-1)*descriptors.step[0]);
-
-        for( size_t k = keypoints.size(); k--; )
+        std::bitset<1024>* ptr = (std::bitset<1024>*) desc;
+        int cnt(0);
+        for( int i = 1; i < FREAK_NB_POINTS; ++i )
         {
-            //estimate orientation (gradient)
-            if( !orientationNormalized )
-            {
-                thetaIdx = 0;//assign 0° to all keypoints
-                keypoints[k].angle = 0.0;
-            }
-            else
+            //(generate all the pairs)
+            for( int j = 0; j < i; ++j )
             {
-                //get the points intensity value in the un-rotated pattern
-                for( int i = FREAK_NB_POINTS;i--; )
-                    pointsValue[i] = meanIntensity<srcMatType, iiMatType>(image, imgIntegral,
-                                                                          keypoints[k].pt.x,keypoints[k].pt.y,
-                                                                          kpScaleIdx[k], 0, i);
-
-                direction0 = 0;
-                direction1 = 0;
-                for( int m = 45; m--; )
-                {
-                    //iterate through the orientation pairs
-                    const int delta = (pointsValue[ orientationPairs[m].i ]-pointsValue[ orientationPairs[m].j ]);
-                    direction0 += delta*(orientationPairs[m].weight_dx)/2048;
-                    direction1 += delta*(orientationPairs[m].weight_dy)/2048;
-                }
-
-                keypoints[k].angle = static_cast<float>(atan2((float)direction1,(float)direction0)*(180.0/CV_PI)); //estimate orientation
-
-                thetaIdx = cvRound(FREAK_NB_ORIENTATION*keypoints[k].angle*(1/360.0));
-
-                if( thetaIdx < 0 )
-                    thetaIdx += FREAK_NB_ORIENTATION;
-
-                if( thetaIdx >= FREAK_NB_ORIENTATION )
-                    thetaIdx -= FREAK_NB_ORIENTATION;
-            }
-            // get the points intensity value in the rotated pattern
-            for( int i = FREAK_NB_POINTS; i--; ) {
-                pointsValue[i] = meanIntensity<srcMatType, iiMatType>(image, imgIntegral,
-                                                                      keypoints[k].pt.x, keypoints[k].pt.y,
-                                                                      kpScaleIdx[k], thetaIdx, i);
-            }
-
-            int cnt(0);
-            for( int i = 1; i < FREAK_NB_POINTS; ++i )
-            {
-                //(generate all the pairs)
-                for( int j = 0; j < i; ++j )
-                {
-                    ptr->set(cnt, pointsValue[i] >= pointsValue[j] );
-                    ++cnt;
-                }
+                ptr->set(cnt, pointsValue[i] >= pointsValue[j] );
+                ++cnt;
             }
-            --ptr;
         }
     }
 }
 
 // simply take average on a square patch, not even gaussian approx
 template <typename imgType, typename iiType>
-imgType FREAK_Impl::meanIntensity( InputArray _image, InputArray _integral,
+imgType FREAK_Impl::meanIntensity( const Mat& image, const Mat& integral,
                               const float kp_x,
                               const float kp_y,
-                              const unsigned int scale,
-                              const unsigned int rot,
-                              const unsigned int point)
+                              const PatternPoint& FreakPoint ) const
 {
-    Mat image = _image.getMat(), integral = _integral.getMat();
     // get point position in image
-    const PatternPoint& FreakPoint = patternLookup[scale*FREAK_NB_ORIENTATION*FREAK_NB_POINTS + rot*FREAK_NB_POINTS + point];
     const float xf = FreakPoint.x+kp_x;
     const float yf = FreakPoint.y+kp_y;
     const int x = int(xf);
@@ -653,10 +571,12 @@ imgType FREAK_Impl::meanIntensity( InputArray _image, InputArray _integral,
         const int r_y_1 = (1024-r_y);
         unsigned int ret_val;
         // linear interpolation:
-        ret_val = r_x_1*r_y_1*int(image.at<imgType>(y  , x  ))
-                + r_x  *r_y_1*int(image.at<imgType>(y  , x+1))
-                + r_x_1*r_y  *int(image.at<imgType>(y+1, x  ))
-                + r_x  *r_y  *int(image.at<imgType>(y+1, x+1));
+        const imgType* row0 = image.ptr<imgType>(y) + x;
+        const imgType* row1 = image.ptr<imgType>(y+1) + x;
+        ret_val = r_x_1*r_y_1*int(row0[0])
+                + r_x  *r_y_1*int(row0[1])
+                + r_x_1*r_y  *int(row1[0])
+                + r_x  *r_y  *int(row1[1]);
         //return the rounded mean
         ret_val += 2 * 1024 * 1024;
         return static_cast<imgType>(ret_val / (4 * 1024 * 1024));
@@ -671,10 +591,12 @@ imgType FREAK_Impl::meanIntensity( InputArray _image, InputArray _integral,
     const int y_bottom = cvRound(yf+radius+1);//integral image is 1px higher
     iiType ret_val;
 
-    ret_val = integral.at<iiType>(y_bottom,x_right);//bottom right corner
-    ret_val -= integral.at<iiType>(y_bottom,x_left);
-    ret_val += integral.at<iiType>(y_top,x_left);
-    ret_val -= integral.at<iiType>(y_top,x_right);
+    const iiType* rowTop = integral.ptr<iiType>(y_top);
+    const iiType* rowBottom = integral.ptr<iiType>(y_bottom);
+    ret_val = rowBottom[x_right];//bottom right corner
+    ret_val -= rowBottom[x_left];
+    ret_val += rowTop[x_left];
+    ret_val -= rowTop[x_right];
     const int area = (x_right - x_left) * (y_bottom - y_top);
     ret_val = (ret_val + area/2) / area;
     //~ std::cout<<integral.step[1]<<std::endl;
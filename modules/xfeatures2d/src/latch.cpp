@@ -44,6 +44,7 @@
 //M*/
 
 #include "precomp.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 #include <algorithm>
 #include <vector>
 
@@ -94,220 +95,41 @@ namespace cv
         void CalcuateSums(int count, const std::vector<int> &points, bool rotationInvariance, const Mat &grayImage, const KeyPoint &pt, int &suma, int &sumc, float cos_theta, float sin_theta, int half_ssd_size);
 
 
-        static void pixelTests1(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
+        // every keypoint owns its output row, so keypoints are processed in parallel
+        template <int bytes>
+        static void pixelTests(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
         {
             Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
+            const int nKeypoints = (int)keypoints.size();
+            const int nStripes = std::max(1, std::min(nKeypoints / 64, 4 * getNumThreads()));
+            parallel_for_(Range(0, nKeypoints), [&](const Range& range)
             {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
-
-                //handling keypoint orientation
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 1; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
-
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
-
-                        count += 6;
-                    }
-                }
-            }
-        }
-
-
-        static void pixelTests2(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
-        {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
-            {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
-
-                //handling keypoint orientation
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 2; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
-
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
-
-                        count += 6;
-                    }
-                }
-            }
-        }
-
-
-        static void pixelTests4(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
-        {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
-            {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
-
-                //handling keypoint orientation
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 4; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
-
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
-
-                        count += 6;
-                    }
-                }
-            }
-        }
-
-
-
-        static void pixelTests8(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
-        {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
-            {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
-
-                //handling keypoint orientation
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 8; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
-
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
-
-                        count += 6;
-                    }
-                }
-            }
-        }
-
-
-        static void pixelTests16(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
-        {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
-            {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
-
-                //handling keypoint orientation
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 16; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
-
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
-
-                        count += 6;
-                    }
-                }
-            }
-        }
-
-
-        static void pixelTests32(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
-        {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
-            {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
-
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 32; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
-
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
-
-                        count += 6;
-                    }
-                }
-            }
-        }
-
-
-        static void pixelTests64(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
-        {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
-            {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
-
-                //handling keypoint orientation
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 64; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
-
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
-
-                        count += 6;
+                for (int i = range.start; i < range.end; ++i)
+                {
+                    uchar* desc = descriptors.ptr(i);
+                    const KeyPoint& pt = keypoints[i];
+                    int count = 0;
+
+                    //handling keypoint orientation
+                    float angle = pt.angle;
+                    angle *= (float)(CV_PI / 180.f);
+                    float cos_theta = cos(angle);
+                    float sin_theta = sin(angle);
+
+                    for (int ix = 0; ix < bytes; ix++){
+                        desc[ix] = 0;
+                        for (int j = 7; j >= 0; j--){
+                            int suma = 0;
+                            int sumc = 0;
+
+                            CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
+                            desc[ix] += (uchar)((suma < sumc) << j);
+
+                            count += 6;
+                        }
                     }
                 }
-            }
+            }, nStripes);
         }
 
         void CalcuateSums(int count, const std::vector<int> &points, bool rotationInvariance, const Mat &grayImage, const KeyPoint &pt, int &suma, int &sumc, float cos_theta, float sin_theta, int half_ssd_size)
@@ -384,22 +206,48 @@ namespace cv
 
 
             int K = half_ssd_size;
+            const int width = 2 * K + 1;
+            const int xa = ax2 - K, xb = bx2 - K, xc = cx2 - K;
+#if CV_SIMD128
+            // the window rows are loaded in whole groups of 8 pixels, which may run past the right
+            // edge of the window (but not past the image row); the lanes outside the window are masked out
+            if (std::max(xa, std::max(xb, xc)) + ((width + 7) & -8) <= grayImage.cols)
+            {
+                const v_int16x8 lanes(0, 1, 2, 3, 4, 5, 6, 7);
+                v_int32x4 vsuma = v_setzero_s32(), vsumc = v_setzero_s32();
+                for (int iy = -K; iy <= K; iy++)
+                {
+                    const uchar * Mi_a = grayImage.ptr<uchar>(ay2 + iy) + xa;
+                    const uchar * Mi_b = grayImage.ptr<uchar>(by2 + iy) + xb;
+                    const uchar * Mi_c = grayImage.ptr<uchar>(cy2 + iy) + xc;
+                    for (int ix = 0; ix < width; ix += 8)
+                    {
+                        v_int16x8 mask = lanes < v_setall_s16((short)(width - ix));
+                        v_int16x8 b = v_reinterpret_as_s16(v_load_expand(Mi_b + ix));
+                        v_int16x8 difa = (v_reinterpret_as_s16(v_load_expand(Mi_a + ix)) - b) & mask;
+                        v_int16x8 difc = (v_reinterpret_as_s16(v_load_expand(Mi_c + ix)) - b) & mask;
+                        vsuma += v_dotprod(difa, difa);
+                        vsumc += v_dotprod(difc, difc);
+                    }
+                }
+                suma += v_reduce_sum(vsuma);
+                sumc += v_reduce_sum(vsumc);
+                return;
+            }
+#endif
             for (int iy = -K; iy <= K; iy++)
             {
-                const uchar * Mi_a = grayImage.ptr<uchar>(ay2 + iy);
-                const uchar * Mi_b = grayImage.ptr<uchar>(by2 + iy);
-                const uchar * Mi_c = grayImage.ptr<uchar>(cy2 + iy);
-
-                for (int ix = -K; ix <= K; ix++)
+                const uchar * Mi_a = grayImage.ptr<uchar>(ay2 + iy) + xa;
+                const uchar * Mi_b = grayImage.ptr<uchar>(by2 + iy) + xb;
+                const uchar * Mi_c = grayImage.ptr<uchar>(cy2 + iy) + xc;
+                for (int ix = 0; ix < width; ix++)
                 {
-                    double difa = Mi_a[ax2 + ix] - Mi_b[bx2 + ix];
-                    suma += (int)((difa)*(difa));
-
-                    double difc = Mi_c[cx2 + ix] - Mi_b[bx2 + ix];
-                    sumc += (int)((difc)*(difc));
+                    int difa = Mi_a[ix] - Mi_b[ix];
+                    suma += difa * difa;
+                    int difc = Mi_c[ix] - Mi_b[ix];
+                    sumc += difc * difc;
                 }
             }
-
         }
 
 
@@ -410,25 +258,25 @@ namespace cv
             switch (bytes)
             {
             case 1:
-                test_fn_ = pixelTests1;
+                test_fn_ = pixelTests<1>;
                 break;
             case 2:
-                test_fn_ = pixelTests2;
+                test_fn_ = pixelTests<2>;
                 break;
             case 4:
-                test_fn_ = pixelTests4;
+                test_fn_ = pixelTests<4>;
                 break;
             case 8:
-                test_fn_ = pixelTests8;
+                test_fn_ = pixelTests<8>;
                 break;
             case 16:
-                test_fn_ = pixelTests16;
+                test_fn_ = pixelTests<16>;
                 break;
             case 32:
-                test_fn_ = pixelTests32;
+                test_fn_ = pixelTests<32>;
                 break;
             case 64:
-                test_fn_ = pixelTests64;
+                test_fn_ = pixelTests<64>;
                 break;
             default:
                 CV_Error(Error::StsBadArg, "descriptorSize must be 1,2, 4, 8, 16, 32, or 64");
@@ -458,25 +306,25 @@ namespace cv
             switch (dSize)
             {
             case 1:
-                test_fn_ = pixelTests1;
+                test_fn_ = pixelTests<1>;
                 break;
             case 2:
-                test_fn_ = pixelTests2;
+                test_fn_ = pixelTests<2>;
                 break;
             case 4:
-                test_fn_ = pixelTests4;
+                test_fn_ = pixelTests<4>;
                 break;
             case 8:
-                test_fn_ = pixelTests8;
+                test_fn_ = pixelTests<8>;
                 break;
             case 16:
-                test_fn_ = pixelTests16;
+                test_fn_ = pixelTests<16>;
                 break;
             case 32:
-                test_fn_ = pixelTests32;
+                test_fn_ = pixelTests<32>;
                 break;
             case 64:
-                test_fn_ = pixelTests64;
+                test_fn_ = pixelTests<64>;
                 break;
             default:
                 CV_Error(Error::StsBadArg, "descriptorSize must be 1,2, 4, 8, 16, 32, or 64");
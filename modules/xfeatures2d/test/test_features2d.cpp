@@ -185,6 +185,40 @@ TEST( Features2d_DescriptorExtractor_LATCH, regression )
     test.safe_run();
 }
 
+static void checkBinaryDescriptorThreads(const Ptr<DescriptorExtractor>& extractor)
+{
+    Mat img = imread(cvtest::findDataFile("features2d/tsukuba.png"), IMREAD_GRAYSCALE);
+    ASSERT_FALSE(img.empty());
+
+    std::vector<KeyPoint> keypoints;
+    ORB::create(5000)->detect(img, keypoints);
+    ASSERT_FALSE(keypoints.empty());
+
+    std::vector<KeyPoint> keypointsSingle = keypoints, keypointsParallel = keypoints;
+    Mat single, parallel;
+    int threads = getNumThreads();
+    setNumThreads(1);
+    extractor->compute(img, keypointsSingle, single);
+    setNumThreads(threads);
+    extractor->compute(img, keypointsParallel, parallel);
+
+    ASSERT_EQ(keypointsSingle.size(), keypointsParallel.size());
+    for (size_t i = 0; i < keypointsSingle.size(); i++)
+        EXPECT_EQ(keypointsSingle[i].angle, keypointsParallel[i].angle) << "keypoint " << i;
+    ASSERT_EQ(single.size(), parallel.size());
+    EXPECT_EQ(0, cvtest::norm(single, parallel, NORM_INF));
+}
+
+TEST( Features2d_DescriptorExtractor_FREAK, threads_identical )
+{
+    checkBinaryDescriptorThreads(FREAK::create());
+}
+
+TEST( Features2d_DescriptorExtractor_LATCH, threads_identical )
+{
+    checkBinaryDescriptorThreads(LATCH::create(32, true, 3, 0));
+}
+
 TEST(Features2d_DescriptorExtractor_BEBLID, regression )
 {
     CV_DescriptorExtractorTest<Hamming> test("descriptor-beblid", 1,
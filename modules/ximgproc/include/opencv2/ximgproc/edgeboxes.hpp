@@ -162,6 +162,18 @@ public:
     */
     CV_WRAP virtual void setKappa(float value) = 0;
 
+    /** @brief Returns proposal boxes for a batch of images.
+
+    The images are processed concurrently; the result for each image is the same as with the single image version.
+
+    @param edge_maps edge images.
+    @param orientation_maps orientation maps, one per edge image.
+    @param boxes proposal boxes of each image.
+    @param scores scores of the proposal boxes of each image.
+    */
+    virtual void getBoundingBoxes(InputArrayOfArrays edge_maps, InputArrayOfArrays orientation_maps,
+                                  std::vector<std::vector<Rect> > &boxes, std::vector<std::vector<float> > &scores) = 0;
+
 };
 
 /** @brief Creates a Edgeboxes
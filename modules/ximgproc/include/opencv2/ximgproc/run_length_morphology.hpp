@@ -113,6 +113,62 @@ CV_EXPORTS void createRLEImage(const std::vector<cv::Point3i>& runs, OutputArray
 CV_EXPORTS void morphologyEx(InputArray rlSrc, OutputArray rlDest, int op, InputArray rlKernel,
     bool bBoundaryOnForErosion = true, Point anchor = Point(0,0));
 
+/**
+* @brief   Labels the connected components of a run-length encoded binary image.
+*
+* The runs of a run-length encoded image are sorted by row and then by column; all functions of this
+* module keep that order and expect it from their inputs. Unlike cv::connectedComponents, no label is
+* reserved for the background: every run gets the 0-based label of its component, and components are
+* numbered in the order of their first run.
+*
+* @param   rlSrc         input image
+* @param   labels        output vector of CV_32S labels, one per run of rlSrc
+* @param   connectivity  8 or 4 for 8-way or 4-way connectivity respectively
+* @return  number of components
+*/
+CV_EXPORTS int connectedComponents(InputArray rlSrc, OutputArray labels, int connectivity = 8);
+
+/**
+* @brief   Labels the connected components of a run-length encoded binary image and computes their statistics.
+*
+* @param   rlSrc         input image
+* @param   labels        output vector of CV_32S labels, one per run of rlSrc (see rl::connectedComponents)
+* @param   stats         statistics for each component as a CV_32S matrix with one row per label, indexed by
+*                        cv::ConnectedComponentsTypes (CC_STAT_LEFT, CC_STAT_TOP, CC_STAT_WIDTH, CC_STAT_HEIGHT, CC_STAT_AREA)
+* @param   centroids     centroid of each component as a CV_64F matrix with one (x, y) row per label
+* @param   connectivity  8 or 4 for 8-way or 4-way connectivity respectively
+* @return  number of components
+*/
+CV_EXPORTS int connectedComponentsWithStats(InputArray rlSrc, OutputArray labels, OutputArray stats,
+    OutputArray centroids, int connectivity = 8);
+
+/**
+* @brief   Computes the intersection of two run-length encoded binary images.
+*
+* @param   rlSrc1      first input image
+* @param   rlSrc2      second input image
+* @param   rlDest      result; its size is the maximum of the sizes of the inputs
+*/
+CV_EXPORTS void bitwise_and(InputArray rlSrc1, InputArray rlSrc2, OutputArray rlDest);
+
+/**
+* @brief   Computes the union of two run-length encoded binary images.
+*
+* @param   rlSrc1      first input image
+* @param   rlSrc2      second input image
+* @param   rlDest      result; its size is the maximum of the sizes of the inputs
+*/
+CV_EXPORTS void bitwise_or(InputArray rlSrc1, InputArray rlSrc2, OutputArray rlDest);
+
+/**
+* @brief   Computes the symmetric difference of two run-length encoded binary images.
+*
+* @param   rlSrc1      first input image
+* @param   rlSrc2      second input image
+* @param   rlDest      result; its size is the maximum of the sizes of the inputs
+*/
+CV_EXPORTS void bitwise_xor(InputArray rlSrc1, InputArray rlSrc2, OutputArray rlDest);
+
 }
 }
 }
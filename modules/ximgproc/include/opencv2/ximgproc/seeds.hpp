@@ -139,6 +139,21 @@ public:
     CV_WRAP virtual void getLabelContourMask(OutputArray image, bool thick_line = false) = 0;
 
     virtual ~SuperpixelSEEDS() {}
+
+    /** @brief Sets whether iterate() starts from the segmentation of its previous call.
+
+    This is meant for videos, where consecutive frames are similar. When enabled, iterate() keeps
+    the labels of the previous frame, skips the block updates and only runs num_iterations pixel
+    updates on the new frame, which is much faster. The first call always starts from the
+    initial grid.
+
+    @param val True to warm-start from the previous segmentation, false to start from the initial
+    grid on every call (default).
+     */
+    CV_WRAP virtual void setUseWarmStart(bool val) = 0;
+
+    /** @copybrief setUseWarmStart @see setUseWarmStart */
+    CV_WRAP virtual bool getUseWarmStart() const = 0;
 };
 
 /** @brief Initializes a SuperpixelSEEDS object.
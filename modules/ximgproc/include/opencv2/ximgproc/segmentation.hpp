@@ -216,7 +216,8 @@ namespace cv {
                             CV_WRAP virtual void clearImages() = 0;
 
                             /** @brief Add a new graph segmentation in the list of graph segementations to process.
-                                @param g The graph segmentation
+                                @param g The graph segmentation. Segmentations created by createGraphSegmentation are run on several images in
+                                parallel; other segmentations are used from one thread at a time.
                             */
                             CV_WRAP virtual void addGraphSegmentation(Ptr<GraphSegmentation> g) = 0;
 
@@ -225,7 +226,8 @@ namespace cv {
                             CV_WRAP virtual void clearGraphSegmentations() = 0;
 
                             /** @brief Add a new strategy in the list of strategy to process.
-                                @param s The strategy
+                                @param s The strategy. Strategies created by the create* functions of this module are duplicated so that
+                                they can be run on several segmentations in parallel; other strategies are used from one thread at a time.
                             */
                             CV_WRAP virtual void addStrategy(Ptr<SelectiveSearchSegmentationStrategy> s) = 0;
 
@@ -234,6 +236,8 @@ namespace cv {
                             CV_WRAP virtual void clearStrategies() = 0;
 
                             /** @brief Based on all images, graph segmentations and stragies, computes all possible rects and return them
+                                The initial segmentations and the hierarchical groupings are computed in parallel. Internal buffers are kept
+                                between calls, so processing successive images with the same object avoids most allocations.
                                 @param rects The list of rects. The first ones are more relevents than the lasts ones.
                             */
                             CV_WRAP virtual void process(CV_OUT std::vector<Rect>& rects) = 0;
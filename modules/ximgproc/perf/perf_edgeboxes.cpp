@@ -0,0 +1,34 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+#include "perf_precomp.hpp"
+
+namespace opencv_test { namespace {
+
+typedef TestBaseWithParam<int> EdgeBoxesPerfTest;
+
+PERF_TEST_P(EdgeBoxesPerfTest, getBoundingBoxes, Values(1, 4))
+{
+    const int nimages = GetParam();
+
+    Mat img = imread(getDataPath("cv/ximgproc/pascal_voc_bird.png"), IMREAD_COLOR);
+    ASSERT_FALSE(img.empty());
+    cvtColor(img, img, COLOR_BGR2RGB);
+    img.convertTo(img, CV_32F, 1.0 / 255.0f);
+
+    Ptr<StructuredEdgeDetection> sed = createStructuredEdgeDetection(getDataPath("cv/ximgproc/model.yml.gz"));
+    Mat edges, orientations;
+    sed->detectEdges(img, edges);
+    sed->computeOrientation(edges, orientations);
+
+    std::vector<Mat> edgeMaps(nimages, edges), orientationMaps(nimages, orientations);
+    Ptr<EdgeBoxes> edgeboxes = createEdgeBoxes();
+    std::vector<std::vector<Rect> > boxes;
+    std::vector<std::vector<float> > scores;
+
+    TEST_CYCLE() edgeboxes->getBoundingBoxes(edgeMaps, orientationMaps, boxes, scores);
+
+    SANITY_CHECK_NOTHING();
+}
+
+}} // namespace
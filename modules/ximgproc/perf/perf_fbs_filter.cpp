@@ -0,0 +1,31 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+#include "perf_precomp.hpp"
+
+namespace opencv_test { namespace {
+
+typedef tuple<Size, int> FBSPerfParams;
+typedef TestBaseWithParam<FBSPerfParams> FastBilateralSolverPerfTest;
+
+PERF_TEST_P(FastBilateralSolverPerfTest, filter,
+    Combine(
+        Values(szVGA, sz1080p),
+        Values(1, 3))
+)
+{
+    Size sz = get<0>(GetParam());
+    int guideCn = get<1>(GetParam());
+
+    Mat guide(sz, CV_MAKE_TYPE(CV_8U, guideCn)), src(sz, CV_32FC1), confidence(sz, CV_32FC1), dst;
+    declare.in(guide, src, confidence, WARMUP_RNG);
+
+    // the guide is shared by every frame: only the solve is measured
+    Ptr<FastBilateralSolverFilter> fbs = createFastBilateralSolverFilter(guide, 8.0, 8.0, 8.0);
+
+    TEST_CYCLE() fbs->filter(src, confidence, dst);
+
+    SANITY_CHECK_NOTHING();
+}
+
+}} // namespace
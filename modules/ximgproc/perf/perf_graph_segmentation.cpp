@@ -0,0 +1,28 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+#include "perf_precomp.hpp"
+
+namespace opencv_test {
+namespace {
+
+typedef TestBaseWithParam<Size> GraphSegmentationPerfTest;
+
+PERF_TEST_P(GraphSegmentationPerfTest, processImage, Values(szVGA, sz720p, sz1080p))
+{
+    Size sz = GetParam();
+
+    Mat src = imread(getDataPath("cv/shared/lena.png"), IMREAD_COLOR);
+    ASSERT_FALSE(src.empty());
+    resize(src, src, sz);
+
+    Ptr<segmentation::GraphSegmentation> gs = segmentation::createGraphSegmentation();
+    Mat dst;
+
+    TEST_CYCLE() gs->processImage(src, dst);
+
+    SANITY_CHECK_NOTHING();
+}
+
+}
+} // namespace
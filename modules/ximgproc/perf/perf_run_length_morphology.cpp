@@ -33,5 +33,25 @@ PERF_TEST_P(RLMorphologyPerfTest, perf, Combine(Values(1,7, 21), Values(sz720p,
     SANITY_CHECK_NOTHING();
 }
 
+typedef TestBaseWithParam<tuple<Size, int> > RLConnectedComponentsPerfTest;
+
+PERF_TEST_P(RLConnectedComponentsPerfTest, perf, Combine(Values(sz720p, sz2160p), Values(4, 8)))
+{
+    Size sz = get<0>(GetParam());
+    int connectivity = get<1>(GetParam());
+
+    Mat src(sz, CV_8U);
+    Mat thresholded, labels, stats, centroids;
+    declare.in(src, WARMUP_RNG);
+    rl::threshold(src, thresholded, 100.0, THRESH_BINARY);
+
+    TEST_CYCLE()
+    {
+        rl::connectedComponentsWithStats(thresholded, labels, stats, centroids, connectivity);
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+
 }
 } // namespace
\ No newline at end of file
@@ -0,0 +1,32 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+#include "perf_precomp.hpp"
+
+namespace opencv_test { namespace {
+
+typedef tuple<Size, bool> SeedsParams;
+typedef TestBaseWithParam<SeedsParams> SuperpixelSEEDSPerfTest;
+
+PERF_TEST_P(SuperpixelSEEDSPerfTest, iterate, Combine(Values(sz720p, sz1080p), Values(false, true)))
+{
+    Size sz = get<0>(GetParam());
+    bool warmStart = get<1>(GetParam());
+
+    Mat src(sz, CV_8UC3);
+    declare.in(src, WARMUP_RNG);
+    GaussianBlur(src, src, Size(15, 15), 0);
+
+    Ptr<SuperpixelSEEDS> seeds = createSuperpixelSEEDS(sz.width, sz.height, 3, 1000, 4);
+    seeds->setUseWarmStart(warmStart);
+    seeds->iterate(src, 4);
+
+    TEST_CYCLE()
+    {
+        seeds->iterate(src, 4);
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+
+}} // namespace
@@ -0,0 +1,36 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+#include "perf_precomp.hpp"
+
+namespace opencv_test {
+namespace {
+
+typedef tuple<Size, bool> SelectiveSearchParams;
+typedef TestBaseWithParam<SelectiveSearchParams> SelectiveSearchPerfTest;
+
+PERF_TEST_P(SelectiveSearchPerfTest, process, Combine(Values(szVGA, sz720p), Values(false, true)))
+{
+    Size sz = get<0>(GetParam());
+    bool quality = get<1>(GetParam());
+
+    Mat src = imread(getDataPath("cv/shared/lena.png"), IMREAD_COLOR);
+    ASSERT_FALSE(src.empty());
+    resize(src, src, sz);
+
+    Ptr<segmentation::SelectiveSearchSegmentation> ss = segmentation::createSelectiveSearchSegmentation();
+    ss->setBaseImage(src);
+    if (quality)
+        ss->switchToSelectiveSearchQuality();
+    else
+        ss->switchToSelectiveSearchFast();
+
+    std::vector<Rect> rects;
+
+    TEST_CYCLE_N(3) ss->process(rects);
+
+    SANITY_CHECK_NOTHING();
+}
+
+}
+} // namespace
@@ -0,0 +1,33 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+#include "perf_precomp.hpp"
+
+namespace opencv_test { namespace {
+
+typedef tuple<Size, int> ThinningPerfParams;
+typedef TestBaseWithParam<ThinningPerfParams> ThinningPerfTest;
+
+PERF_TEST_P(ThinningPerfTest, perf,
+    Combine(
+        Values(szVGA, sz1080p),
+        Values((int)THINNING_ZHANGSUEN, (int)THINNING_GUOHALL))
+)
+{
+    Size sz = get<0>(GetParam());
+    int thinningType = get<1>(GetParam());
+
+    // thick blobs: many iterations, the work is concentrated on their shrinking boundary
+    Mat src(sz, CV_8UC1);
+    RNG rng(0);
+    rng.fill(src, RNG::UNIFORM, 0, 256);
+    GaussianBlur(src, src, Size(0, 0), 8);
+    threshold(src, src, 128, 255, THRESH_BINARY);
+
+    Mat dst;
+    TEST_CYCLE() thinning(src, dst, thinningType);
+
+    SANITY_CHECK_NOTHING();
+}
+
+}} // namespace
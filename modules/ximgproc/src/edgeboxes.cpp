@@ -61,7 +61,73 @@ namespace cv
 namespace ximgproc
 {
 
-class EdgeBoxesImpl : public EdgeBoxes
+// parameters of the algorithm, and values derived from them
+struct EdgeBoxesParams
+{
+    float _alpha;
+    float _beta;
+    float _eta;
+    float _minScore;
+    int _maxBoxes;
+    float _edgeMinMag;
+    float _edgeMergeThr;
+    float _clusterMinMag;
+    float _maxAspectRatio;
+    float _minBoxArea;
+    float _gamma;
+    float _kappa;
+
+    vector<float> _scaleNorm;
+    float _sxStep, _ayStep, _xyStepRatio;
+};
+
+// Proposals of one image. The state of the algorithm lives here, so that
+// several images can be processed concurrently with the same parameters.
+class EdgeBoxesImage : private EdgeBoxesParams
+{
+public:
+    EdgeBoxesImage(const EdgeBoxesParams &params) : EdgeBoxesParams(params), h(0), w(0), _segCnt(0) {}
+
+    // edge and orientation maps are transposed (see EdgeBoxesImpl::getBoundingBoxes)
+    void process(Mat &edgeMap, Mat &orientationMap, Boxes &boxes);
+
+private:
+    // edge segment information (see clusterEdges)
+    int h, w;                         // image dimensions
+    int _segCnt;                      // total segment count
+    Mat _segIds;                      // segment ids (-1/0 means no segment)
+    vector<float> _segMag;            // segment edge magnitude sums
+    vector<Point2i> _segP;            // segment lower-right pixel
+    vector<int> _segAffStart;         // neighbors of segment i are in [_segAffStart[i], _segAffStart[i+1])
+    vector<float> _segAff;            // segment affinities
+    vector<int> _segAffIdx;           // segment neighbors
+
+    // data structures for efficiency (see prepDataStructs)
+    Mat _segIImg, _magIImg;
+    Mat _hIdxImg, _vIdxImg;
+    vector<int> _hIdxStart, _vIdxStart; // first entry of each row (column) in _hIdxs (_vIdxs)
+    vector<int> _hIdxs, _vIdxs;
+
+    // data structures for efficiency (see scoreBox), one set per thread
+    struct ScoreBuffers
+    {
+        vector<float> sWts;
+        vector<int> sDone, sMap, sIds;
+        int sId;
+    };
+
+    // helper routines
+    static bool boxesCompare(const Box &a, const Box &b) { return a.score < b.score; }
+    void clusterEdges(Mat &edgeMap, Mat &orientationMap);
+    void prepDataStructs(Mat &edgeMap);
+    void scoreAllBoxes(Boxes &boxes);
+    void scoreBox(Box &box, ScoreBuffers &buf) const;
+    void refineBox(Box &box, ScoreBuffers &buf) const;
+    float boxesOverlap(Box &a, Box &b);
+    void boxesNms(Boxes &boxes, float thr, float eta, int maxBoxes);
+};
+
+class EdgeBoxesImpl : public EdgeBoxes, private EdgeBoxesParams
 {
 public:
 
@@ -80,6 +146,9 @@ public:
 
     virtual void getBoundingBoxes(InputArray edge_map, InputArray orientation_map, std::vector<Rect> &boxes, OutputArray scores = noArray()) CV_OVERRIDE;
 
+    virtual void getBoundingBoxes(InputArrayOfArrays edge_maps, InputArrayOfArrays orientation_maps,
+                                  std::vector<std::vector<Rect> > &boxes, std::vector<std::vector<float> > &scores) CV_OVERRIDE;
+
     float getAlpha() const CV_OVERRIDE { return _alpha; }
     void setAlpha(float value) CV_OVERRIDE
     {
@@ -129,51 +198,6 @@ public:
 
     //! the destructor
     virtual ~EdgeBoxesImpl() {}
-
-private:
-    float _alpha;
-    float _beta;
-    float _eta;
-    float _minScore;
-    int _maxBoxes;
-    float _edgeMinMag;
-    float _edgeMergeThr;
-    float _clusterMinMag;
-    float _maxAspectRatio;
-    float _minBoxArea;
-    float _gamma;
-    float _kappa;
-
-    // edge segment information (see clusterEdges)
-    int h, w;                         // image dimensions
-    int _segCnt;                      // total segment count
-    Mat _segIds;                      // segment ids (-1/0 means no segment)
-    vector<float> _segMag;            // segment edge magnitude sums
-    vector<Point2i> _segP;            // segment lower-right pixel
-    vector<vector<float> > _segAff;   // segment affinities
-    vector<vector<int> > _segAffIdx;  // segment neighbors
-
-    // data structures for efficiency (see prepDataStructs)
-    Mat _segIImg, _magIImg;
-    Mat _hIdxImg, _vIdxImg;
-    vector<vector<int> > _hIdxs, _vIdxs;
-    vector<float> _scaleNorm;
-    float _sxStep, _ayStep, _xyStepRatio;
-
-    // data structures for efficiency (see scoreBox)
-    Mat _sWts;
-    Mat _sDone, _sMap, _sIds;
-    int _sId;
-
-    // helper routines
-    static bool boxesCompare(const Box &a, const Box &b) { return a.score < b.score; }
-    void clusterEdges(Mat &edgeMap, Mat &orientationMap);
-    void prepDataStructs(Mat &edgeMap);
-    void scoreAllBoxes(Boxes &boxes);
-    void scoreBox(Box &box);
-    void refineBox(Box &box);
-    float boxesOverlap(Box &a, Box &b);
-    void boxesNms(Boxes &boxes, float thr, float eta, int maxBoxes);
 };
 
 
@@ -189,20 +213,20 @@ EdgeBoxesImpl::EdgeBoxesImpl(float alpha,
                              float minBoxArea,
                              float gamma,
                              float kappa)
-    : _alpha(alpha),
-      _beta(beta),
-      _eta(eta),
-      _minScore(minScore),
-      _maxBoxes(maxBoxes),
-      _edgeMinMag(edgeMinMag),
-      _edgeMergeThr(edgeMergeThr),
-      _clusterMinMag(clusterMinMag),
-      _maxAspectRatio(maxAspectRatio),
-      _minBoxArea(minBoxArea),
-      _gamma(gamma),
-      _kappa(kappa)
-
 {
+  _alpha = alpha;
+  _beta = beta;
+  _eta = eta;
+  _minScore = minScore;
+  _maxBoxes = maxBoxes;
+  _edgeMinMag = edgeMinMag;
+  _edgeMergeThr = edgeMergeThr;
+  _clusterMinMag = clusterMinMag;
+  _maxAspectRatio = maxAspectRatio;
+  _minBoxArea = minBoxArea;
+  _gamma = gamma;
+  _kappa = kappa;
+
   // initialize step sizes
   _sxStep = sqrt(1 / _alpha);
   _ayStep = (1 + _alpha) / (2 * _alpha);
@@ -215,7 +239,7 @@ EdgeBoxesImpl::EdgeBoxesImpl(float alpha,
 }
 
 
-void EdgeBoxesImpl::clusterEdges(Mat &edgeMap, Mat &orientationMap)
+void EdgeBoxesImage::clusterEdges(Mat &edgeMap, Mat &orientationMap)
 {
     int x, y, xd, yd, i, j;
 
@@ -426,13 +450,8 @@ void EdgeBoxesImpl::clusterEdges(Mat &edgeMap, Mat &orientationMap)
     }
 
     // compute segment affinities
-    _segAff.resize(_segCnt);
-    _segAffIdx.resize(_segCnt);
-    for (i = 0; i < _segCnt; i++)
-    {
-      _segAff[i].resize(0);
-      _segAffIdx[i].resize(0);
-    }
+    vector<vector<float> > segAff(_segCnt);
+    vector<vector<int> > segAffIdx(_segCnt);
 
     const int rad = 2;
     for (x = rad; x < w - rad; x++)
@@ -451,9 +470,9 @@ void EdgeBoxesImpl::clusterEdges(Mat &edgeMap, Mat &orientationMap)
                     if (s1 <= s0) continue;
                     bool found = false;
 
-                    for (i = 0; i < (int)_segAffIdx[s0].size(); i++)
+                    for (i = 0; i < (int)segAffIdx[s0].size(); i++)
                     {
-                        if (_segAffIdx[s0][i] == s1)
+                        if (segAffIdx[s0][i] == s1)
                         {
                             found = true;
                             break;
@@ -463,15 +482,27 @@ void EdgeBoxesImpl::clusterEdges(Mat &edgeMap, Mat &orientationMap)
                     float o = atan2(meanY[s0] - meanY[s1], meanX[s0] - meanX[s1]) + (float)CV_PI / 2.0f;
                     float a = fabs(cos(meanO[s0] - o) * cos(meanO[s1] - o));
                     a = pow(a, _gamma);
-                    _segAff[s0].push_back(a);
-                    _segAffIdx[s0].push_back(s1);
-                    _segAff[s1].push_back(a);
-                    _segAffIdx[s1].push_back(s0);
+                    segAff[s0].push_back(a);
+                    segAffIdx[s0].push_back(s1);
+                    segAff[s1].push_back(a);
+                    segAffIdx[s1].push_back(s0);
                 }
             }
         }
     }
 
+    // store them contiguously, in the same order
+    _segAffStart.assign(_segCnt + 1, 0);
+    for (i = 0; i < _segCnt; i++)
+        _segAffStart[i + 1] = _segAffStart[i] + (int)segAffIdx[i].size();
+    _segAff.resize(_segAffStart[_segCnt]);
+    _segAffIdx.resize(_segAffStart[_segCnt]);
+    for (i = 0; i < _segCnt; i++)
+    {
+        std::copy(segAff[i].begin(), segAff[i].end(), _segAff.begin() + _segAffStart[i]);
+        std::copy(segAffIdx[i].begin(), segAffIdx[i].end(), _segAffIdx.begin() + _segAffStart[i]);
+    }
+
     // compute _segC and _segR
     _segP.resize(_segCnt);
     for (x = 1; x < w - 1; x++)
@@ -489,7 +520,7 @@ void EdgeBoxesImpl::clusterEdges(Mat &edgeMap, Mat &orientationMap)
 }
 
 
-void EdgeBoxesImpl::prepDataStructs(Mat &edgeMap)
+void EdgeBoxesImage::prepDataStructs(Mat &edgeMap)
 {
     int y, x, i;
 
@@ -526,60 +557,58 @@ void EdgeBoxesImpl::prepDataStructs(Mat &edgeMap)
     int s = 0;
     int s1;
 
-    _hIdxs.resize(h);
+    _hIdxStart.resize(h + 1);
+    _hIdxs.clear();
     _hIdxImg = Mat::zeros(w, h, DataType<int>::type);
     for (y = 0; y < h; y++)
     {
         s = 0;
-        _hIdxs[y].push_back(s);
+        _hIdxStart[y] = (int)_hIdxs.size();
+        _hIdxs.push_back(s);
         for (x = 0; x < w; x++)
         {
             s1 = _segIds.at<int>(x, y);
             if (s1 != s)
             {
                 s = s1;
-                _hIdxs[y].push_back(s);
+                _hIdxs.push_back(s);
             }
-            _hIdxImg.at<int>(x, y) = (int)_hIdxs[y].size() - 1;
+            _hIdxImg.at<int>(x, y) = (int)_hIdxs.size() - 1 - _hIdxStart[y];
         }
     }
+    _hIdxStart[h] = (int)_hIdxs.size();
 
-    _vIdxs.resize(w);
+    _vIdxStart.resize(w + 1);
+    _vIdxs.clear();
     _vIdxImg = Mat::zeros(w, h, DataType<int>::type);
     for (x = 0; x < w; x++)
     {
         s = 0;
-        _vIdxs[x].push_back(s);
+        _vIdxStart[x] = (int)_vIdxs.size();
+        _vIdxs.push_back(s);
         for (y = 0; y < h; y++)
         {
             s1 = _segIds.at<int>(x, y);
             if (s1 != s)
             {
                 s = s1;
-                _vIdxs[x].push_back(s);
+                _vIdxs.push_back(s);
             }
-            _vIdxImg.at<int>(x, y) = (int)_vIdxs[x].size() - 1;
+            _vIdxImg.at<int>(x, y) = (int)_vIdxs.size() - 1 - _vIdxStart[x];
         }
     }
-
-    // initialize scoreBox() data structures
-    int n = _segCnt + 1;
-    _sWts = Mat::zeros(n, 1, DataType<float>::type);
-    _sDone = Mat(n, 1, DataType<int>::type,Scalar(-1));
-    _sMap = Mat::zeros(n, 1, DataType<int>::type);
-    _sIds = Mat::zeros(n, 1, DataType<int>::type);
-    _sId = 0;
+    _vIdxStart[w] = (int)_vIdxs.size();
 }
 
 
-void EdgeBoxesImpl::scoreBox(Box &box)
+void EdgeBoxesImage::scoreBox(Box &box, ScoreBuffers &buf) const
 {
     int i, j, k, q, bh, bw, y0, x0, y1, x1, y0m, y1m, x0m, x1m;
-    float *sWts = (float *)_sWts.data;
-    int *sDone = (int *)_sDone.data;
-    int *sMap = (int *)_sMap.data;
-    int *sIds = (int *)_sIds.data;
-    int sId = _sId++;
+    float *sWts = &buf.sWts[0];
+    int *sDone = &buf.sDone[0];
+    int *sMap = &buf.sMap[0];
+    int *sIds = &buf.sIds[0];
+    int sId = buf.sId++;
 
     // add edge count inside box
     y1 = clamp(box.y + box.h, 0, h - 1);
@@ -616,7 +645,7 @@ void EdgeBoxesImpl::scoreBox(Box &box)
     ce = _hIdxImg.at<int>(x1, y0); // top
     for (i = cs; i <= ce; i++)
     {
-        j = _hIdxs[y0][i];
+        j = _hIdxs[_hIdxStart[y0] + i];
         if (j > 0 && sDone[j] != sId)
         {
             sIds[n] = j;
@@ -630,7 +659,7 @@ void EdgeBoxesImpl::scoreBox(Box &box)
     ce = _hIdxImg.at<int>(x1, y1); // bottom
     for (i = cs; i <= ce; i++)
     {
-        j = _hIdxs[y1][i];
+        j = _hIdxs[_hIdxStart[y1] + i];
         if (j > 0 && sDone[j] != sId)
         {
             sIds[n] = j;
@@ -644,7 +673,7 @@ void EdgeBoxesImpl::scoreBox(Box &box)
     re = _vIdxImg.at<int>(x0, y1); // left
     for (i = rs; i <= re; i++)
     {
-        j = _vIdxs[x0][i];
+        j = _vIdxs[_vIdxStart[x0] + i];
         if (j > 0 && sDone[j] != sId)
         {
             sIds[n] = j;
@@ -658,7 +687,7 @@ void EdgeBoxesImpl::scoreBox(Box &box)
     re = _vIdxImg.at<int>(x1, y1); // right
     for (i = rs; i <= re; i++)
     {
-        j = _vIdxs[x1][i];
+        j = _vIdxs[_vIdxStart[x1] + i];
         if (j > 0 && sDone[j] != sId)
         {
             sIds[n] = j;
@@ -673,10 +702,10 @@ void EdgeBoxesImpl::scoreBox(Box &box)
     {
         float ws = sWts[i];
         j = sIds[i];
-        for (k = 0; k < (int)_segAffIdx[j].size(); k++)
+        for (k = _segAffStart[j]; k < _segAffStart[j + 1]; k++)
         {
-            q = _segAffIdx[j][k];
-            float wq = ws * _segAff[j][k];
+            q = _segAffIdx[k];
+            float wq = ws * _segAff[k];
             if (wq < .05f) continue; // short circuit for efficiency
             if (sDone[q] == sId)
             {
@@ -708,7 +737,7 @@ void EdgeBoxesImpl::scoreBox(Box &box)
 }
 
 
-void EdgeBoxesImpl::refineBox(Box &box)
+void EdgeBoxesImage::refineBox(Box &box, ScoreBuffers &buf) const
 {
     int yStep = (int)(box.h * _xyStepRatio);
     int xStep = (int)(box.w * _xyStepRatio);
@@ -725,59 +754,59 @@ void EdgeBoxesImpl::refineBox(Box &box)
         B = box;
         B.y = box.y - yStep;
         B.h = B.h + yStep;
-        scoreBox(B);
+        scoreBox(B, buf);
 
         if (B.score <= box.score)
         {
             B = box;
             B.y = box.y + yStep;
             B.h = B.h - yStep;
-            scoreBox(B);
+            scoreBox(B, buf);
         }
         if (B.score > box.score) box = B;
         // search over y end
         B = box;
         B.h = B.h + yStep;
-        scoreBox(B);
+        scoreBox(B, buf);
 
         if (B.score <= box.score)
         {
             B = box;
             B.h = B.h - yStep;
-            scoreBox(B);
+            scoreBox(B, buf);
         }
         if (B.score > box.score) box = B;
         // search over x start
         B = box;
         B.x = box.x - xStep;
         B.w = B.w + xStep;
-        scoreBox(B);
+        scoreBox(B, buf);
 
         if (B.score <= box.score)
         {
             B = box;
             B.x = box.x + xStep;
             B.w = B.w - xStep;
-            scoreBox(B);
+            scoreBox(B, buf);
         }
 
         if (B.score > box.score) box = B;
         // search over x end
         B = box;
         B.w = B.w + xStep;
-        scoreBox(B);
+        scoreBox(B, buf);
 
         if (B.score <= box.score)
         {
             B = box;
             B.w = B.w - xStep;
-            scoreBox(B);
+            scoreBox(B, buf);
         }
         if (B.score > box.score) box = B;
     }
 }
 
-void EdgeBoxesImpl::scoreAllBoxes(Boxes &boxes)
+void EdgeBoxesImage::scoreAllBoxes(Boxes &boxes)
 {
     // get list of all boxes roughly distributed in grid
     boxes.resize(0);
@@ -813,21 +842,42 @@ void EdgeBoxesImpl::scoreAllBoxes(Boxes &boxes)
         }
     }
 
-    // score all boxes, refine top candidates
+    // score all boxes, refine top candidates.
+    // Boxes are independent: score them in parallel, each stripe with its own buffers.
     int i, k = 0, m = (int)boxes.size();
+    const int nstripes = std::max(1, std::min((m + 255) / 256, 4 * getNumThreads()));
+    parallel_for_(Range(0, nstripes), [&](const Range &range)
+    {
+        ScoreBuffers buf;
+        int n = _segCnt + 1;
+        buf.sWts.assign(n, 0.f);
+        buf.sDone.assign(n, -1);
+        buf.sMap.assign(n, 0);
+        buf.sIds.assign(n, 0);
+        buf.sId = 0;
+
+        for (int s = range.start; s < range.end; s++)
+        {
+            int i0 = (int)((int64)m * s / nstripes), i1 = (int)((int64)m * (s + 1) / nstripes);
+            for (int bi = i0; bi < i1; bi++)
+            {
+                scoreBox(boxes[bi], buf);
+                if (boxes[bi].score)
+                    refineBox(boxes[bi], buf);
+            }
+        }
+    }, nstripes);
+
     for (i = 0; i < m; i++)
     {
-        scoreBox(boxes[i]);
-        if (!boxes[i].score) continue;
-        k++;
-        refineBox(boxes[i]);
+        if (boxes[i].score) k++;
     }
     sort(boxes.rbegin(), boxes.rend(), boxesCompare);
     boxes.resize(k);
 }
 
 
-float EdgeBoxesImpl::boxesOverlap(Box &a, Box &b)
+float EdgeBoxesImage::boxesOverlap(Box &a, Box &b)
 {
     float areai, areaj, areaij;
     int y0, y1, x0, x1, y1i, x1i, y1j, x1j;
@@ -850,7 +900,7 @@ float EdgeBoxesImpl::boxesOverlap(Box &a, Box &b)
 }
 
 
-void EdgeBoxesImpl::boxesNms(Boxes &boxes, float thr, float eta, int maxBoxes)
+void EdgeBoxesImage::boxesNms(Boxes &boxes, float thr, float eta, int maxBoxes)
 {
     sort(boxes.rbegin(), boxes.rend(), boxesCompare);
     if (thr > .99f) return;
@@ -909,6 +959,19 @@ void EdgeBoxesImpl::boxesNms(Boxes &boxes, float thr, float eta, int maxBoxes)
 }
 
 
+void EdgeBoxesImage::process(Mat &edgeMap, Mat &orientationMap, Boxes &boxes)
+{
+    h = edgeMap.cols;
+    w = edgeMap.rows;
+
+    clusterEdges(edgeMap, orientationMap);
+    prepDataStructs(edgeMap);
+
+    scoreAllBoxes(boxes);
+    boxesNms(boxes, _beta, _eta, _maxBoxes);
+}
+
+
 void EdgeBoxesImpl::getBoundingBoxes(InputArray edge_map, InputArray orientation_map, std::vector<Rect> &boxes, OutputArray scores)
 {
     CV_Assert(edge_map.depth() == CV_32F);
@@ -918,15 +981,8 @@ void EdgeBoxesImpl::getBoundingBoxes(InputArray edge_map, InputArray orientation
     Mat O = orientation_map.getMat().t();
     std::vector<float> _scores;
 
-    h = E.cols;
-    w = E.rows;
-
-    clusterEdges(E, O);
-    prepDataStructs(E);
-
     Boxes b;
-    scoreAllBoxes(b);
-    boxesNms(b, _beta, _eta, _maxBoxes);
+    EdgeBoxesImage(*this).process(E, O, b);
 
     // create output boxes
     int n = (int) b.size();
@@ -954,6 +1010,43 @@ void EdgeBoxesImpl::getBoundingBoxes(InputArray edge_map, InputArray orientation
 }
 
 
+void EdgeBoxesImpl::getBoundingBoxes(InputArrayOfArrays edge_maps, InputArrayOfArrays orientation_maps,
+                                     std::vector<std::vector<Rect> > &boxes, std::vector<std::vector<float> > &scores)
+{
+    std::vector<Mat> E, O;
+    edge_maps.getMatVector(E);
+    orientation_maps.getMatVector(O);
+    CV_Assert(E.size() == O.size());
+
+    const int n = (int)E.size();
+    boxes.resize(n);
+    scores.resize(n);
+
+    // one image per task: boxes of each image are then scored on the calling thread
+    parallel_for_(Range(0, n), [&](const Range &range)
+    {
+        for (int k = range.start; k < range.end; k++)
+        {
+            CV_Assert(E[k].depth() == CV_32F);
+            CV_Assert(O[k].depth() == CV_32F);
+
+            Mat Et = E[k].t();
+            Mat Ot = O[k].t();
+            Boxes b;
+            EdgeBoxesImage(*this).process(Et, Ot, b);
+
+            boxes[k].resize(b.size());
+            scores[k].resize(b.size());
+            for (size_t i = 0; i < b.size(); i++)
+            {
+                boxes[k][i] = Rect((int)b[i].x + 1, (int)b[i].y + 1, (int)b[i].w, (int)b[i].h);
+                scores[k][i] = b[i].score;
+            }
+        }
+    });
+}
+
+
 Ptr<EdgeBoxes> createEdgeBoxes(float alpha,
                               float beta,
                               float eta,
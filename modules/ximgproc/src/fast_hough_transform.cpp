@@ -42,6 +42,7 @@
 //M*/
 
 #include "precomp.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 
 namespace cv { namespace ximgproc {
 
@@ -49,67 +50,150 @@ namespace cv { namespace ximgproc {
     typedef __int32 int32_t;
 #endif
 
-template<typename T, int D, HoughOp Op>
+// Type of intermediate values for FHT_AVE (the same as in cv::addWeighted)
+template<typename T> struct HoughAveType { typedef float type; };
+template<> struct HoughAveType<int> { typedef double type; };
+template<> struct HoughAveType<double> { typedef double type; };
+
+template<typename T>
+inline T houghAverage(T a, T b)
+{
+    typedef typename HoughAveType<T>::type WT;
+    return saturate_cast<T>(WT(a) * WT(0.5) + WT(b) * WT(0.5));
+}
+
+// Processes the head of a row with universal intrinsics and returns the number
+// of processed elements; the rest is processed by HoughOperator
+template<typename T, HoughOp Op>
+inline int houghOperateVec(T *, const T *, const T *, int) { return 0; }
+
+#if CV_SIMD128
+#define SPECIALIZE_HOUGHOP_VEC(T, VT, TOp, body)                              \
+    template<>                                                                \
+    inline int houghOperateVec<T, TOp>(T *pDst, const T *pSrc0,              \
+                                       const T *pSrc1, int len) {            \
+        int i = 0;                                                            \
+        for (; i <= len - VT::nlanes; i += VT::nlanes) {                      \
+            VT a = v_load(pSrc0 + i), b = v_load(pSrc1 + i);                  \
+            v_store(pDst + i, body);                                          \
+        }                                                                     \
+        return i;                                                             \
+    }
+#define SPECIALIZE_HOUGHOP_VEC_ALL(T, VT)                                     \
+    SPECIALIZE_HOUGHOP_VEC(T, VT, FHT_ADD, a + b)                             \
+    SPECIALIZE_HOUGHOP_VEC(T, VT, FHT_MIN, v_min(a, b))                       \
+    SPECIALIZE_HOUGHOP_VEC(T, VT, FHT_MAX, v_max(a, b))
+SPECIALIZE_HOUGHOP_VEC_ALL(uchar, v_uint8x16)
+SPECIALIZE_HOUGHOP_VEC_ALL(schar, v_int8x16)
+SPECIALIZE_HOUGHOP_VEC_ALL(ushort, v_uint16x8)
+SPECIALIZE_HOUGHOP_VEC_ALL(short, v_int16x8)
+SPECIALIZE_HOUGHOP_VEC_ALL(int, v_int32x4)
+SPECIALIZE_HOUGHOP_VEC_ALL(float, v_float32x4)
+SPECIALIZE_HOUGHOP_VEC(float, v_float32x4, FHT_AVE,
+                       a * v_setall_f32(0.5f) + b * v_setall_f32(0.5f))
+#if CV_SIMD128_64F
+SPECIALIZE_HOUGHOP_VEC_ALL(double, v_float64x2)
+SPECIALIZE_HOUGHOP_VEC(double, v_float64x2, FHT_AVE,
+                       a * v_setall_f64(0.5) + b * v_setall_f64(0.5))
+#endif
+#undef SPECIALIZE_HOUGHOP_VEC_ALL
+#undef SPECIALIZE_HOUGHOP_VEC
+#endif
+
+template<typename T, HoughOp Op>
 struct HoughOperator { };
 #define SPECIALIZE_HOUGHOP(TOp, body)                                         \
-    template<typename T, int D>                                               \
-    struct HoughOperator<T, D, TOp> {                                         \
+    template<typename T>                                                      \
+    struct HoughOperator<T, TOp> {                                            \
         static void operate(T *pDst, T *pSrc0, T* pSrc1, int len) {           \
-            Mat dst (Size(1, len), D, pDst);                                  \
-            Mat src0(Size(1, len), D, pSrc0);                                 \
-            Mat src1(Size(1, len), D, pSrc1);                                 \
-            body;                                                             \
+            int i = houghOperateVec<T, TOp>(pDst, pSrc0, pSrc1, len);         \
+            for (; i < len; i++)                                              \
+                pDst[i] = body;                                               \
         }                                                                     \
     };
-SPECIALIZE_HOUGHOP(FHT_ADD, add(src0, src1, dst));
-SPECIALIZE_HOUGHOP(FHT_MIN, min(src0, src1, dst));
-SPECIALIZE_HOUGHOP(FHT_MAX, max(src0, src1, dst));
-SPECIALIZE_HOUGHOP(FHT_AVE, addWeighted(src0, 0.5, src1, 0.5, 0.0, dst));
+SPECIALIZE_HOUGHOP(FHT_ADD, saturate_cast<T>(pSrc0[i] + pSrc1[i]));
+SPECIALIZE_HOUGHOP(FHT_MIN, std::min(pSrc0[i], pSrc1[i]));
+SPECIALIZE_HOUGHOP(FHT_MAX, std::max(pSrc0[i], pSrc1[i]));
+SPECIALIZE_HOUGHOP(FHT_AVE, houghAverage(pSrc0[i], pSrc1[i]));
 #undef SPECIALIZE_HOUGHOP
 
 //----------------------fht----------------------------------------------------
 
-template <typename T, int D, HoughOp OP>
-void fhtCore(Mat     &img0,
-             Mat     &img1,
-             int32_t  y0,
-             int32_t  h,
-             bool     isPositiveShift,
-             int      level,
-             double   aspl)
+// Node of the fht recursion: rows [y0, y0 + h) at the given level
+struct FhtNode
 {
-    if (level <= 0)
-        return;
+    int32_t y0;
+    int32_t h;
+    int     level;
+};
 
+// Collects the nodes of the fht recursion by depth. The nodes of one depth
+// cover disjoint rows, and they only depend on the nodes of the next depth.
+static void collectFhtNodes(std::vector<std::vector<FhtNode> > &depths,
+                            int32_t y0,
+                            int32_t h,
+                            int     level,
+                            size_t  depth)
+{
     CV_Assert(h > 0);
-    if (h == 1)
+    if (depths.size() <= depth)
+        depths.resize(depth + 1);
+    FhtNode node = { y0, h, level };
+    depths[depth].push_back(node);
+    if (level <= 0 || h == 1)
     {
-        if ((aspl != 0.0) && (level == 1))
-        {
-            int w = img0.cols;
-            uchar* pLine0 = img0.data + img0.step * y0;
-            uchar* pLine1 = img1.data + img1.step * y0;
-            int dLine = cvRound(y0 * aspl);
-            dLine = dLine % w;
-            dLine = dLine * (int)(img1.elemSize());
-            int wLine = img0.cols * (int)(img0.elemSize());
-            memcpy(pLine0, pLine1 + wLine - dLine, dLine);
-            memcpy(pLine0 + dLine, pLine1, wLine - dLine);
-        }
-        else
-        {
-            memcpy(img0.data + img0.step * y0,
-                   img1.data + img1.step * y0,
-                   img0.cols * (int)(img0.elemSize()));
-        }
+        CV_Assert(h == 1);
         return;
     }
+
     const int32_t k = h >> 1;
-    fhtCore<T, D, OP>(img1, img0, y0, k,
-                      isPositiveShift, level - 1, aspl);
-    fhtCore<T, D, OP>(img1, img0, y0 + k, h - k,
-                      isPositiveShift, level - 1, aspl);
+    collectFhtNodes(depths, y0, k, level - 1, depth + 1);
+    collectFhtNodes(depths, y0 + k, h - k, level - 1, depth + 1);
+}
+
+// Copies a source row of img1 to img0 (rotated on the last level if aspl != 0);
+// img0 and img1 may be the same image
+static void fhtCopyRow(Mat     &img0,
+                       Mat     &img1,
+                       int32_t  y0,
+                       int      level,
+                       double   aspl)
+{
+    uchar* pLine0 = img0.data + img0.step * y0;
+    uchar* pLine1 = img1.data + img1.step * y0;
+    int wLine = img0.cols * (int)(img0.elemSize());
+    int dLine = 0;
+    if ((aspl != 0.0) && (level == 1))
+    {
+        int w = img0.cols;
+        dLine = cvRound(y0 * aspl);
+        dLine = dLine % w;
+        dLine = dLine * (int)(img1.elemSize());
+    }
+
+    if (pLine0 == pLine1)
+    {
+        std::rotate(pLine0, pLine0 + wLine - dLine, pLine0 + wLine);
+    }
+    else
+    {
+        memcpy(pLine0, pLine1 + wLine - dLine, dLine);
+        memcpy(pLine0 + dLine, pLine1, wLine - dLine);
+    }
+}
 
+// Computes row s of the node (y0, h) in img0 from its two halves in img1
+template <typename T, HoughOp OP>
+void fhtCombineRow(Mat     &img0,
+                   Mat     &img1,
+                   int32_t  y0,
+                   int32_t  h,
+                   int32_t  s,
+                   bool     isPositiveShift,
+                   int      level,
+                   double   aspl)
+{
+    const int32_t k = h >> 1;
     int au = 2 * k - 2;
     int ad = 2 * h - 2 * k - 2;
     int b = h - 1;
@@ -117,93 +201,95 @@ void fhtCore(Mat     &img0,
     int w = img0.cols;
     int wm = (h / w + 1) * w;
 
-    for (int32_t s = 0; s < h; s++)
+    int su = (s * au + b) / d;
+    int sd = (s * ad + b) / d;
+    int rd = isPositiveShift ? sd - s : s - sd;
+    rd = (rd + wm) % w;
+    uchar *pLine0 = img0.data + img0.step * (y0 + s);
+    uchar *pLineU = img1.data + img1.step * (y0 + su);
+    uchar *pLineD = img1.data + img1.step * (y0 + k + sd);
+    int w0 = img0.channels() * rd;
+    int w1 = img0.channels() * (w - rd);
+
+    if ((aspl != 0.0) && (level == 1))
     {
-        int su = (s * au + b) / d;
-        int sd = (s * ad + b) / d;
-        int rd = isPositiveShift ? sd - s : s - sd;
-        rd = (rd + wm) % w;
-        uchar *pLine0 = img0.data + img0.step * (y0 + s);
-        uchar *pLineU = img1.data + img1.step * (y0 + su);
-        uchar *pLineD = img1.data + img1.step * (y0 + k + sd);
-        int w0 = img0.channels() * rd;
-        int w1 = img0.channels() * (w - rd);
-
-        if ((aspl != 0.0) && (level == 1))
+        int dU = cvRound((y0 + su) * aspl);
+        dU = dU % w;
+        dU *= img0.channels();
+        int dD = cvRound((y0 + k + sd) * aspl);
+        dD = dD % w;
+        dD *= img0.channels();
+        int wB = w * img0.channels();
+
+        int dX = dD - dU;
+        if (w0 >= dX)
         {
-            int dU = cvRound((y0 + su) * aspl);
-            dU = dU % w;
-            dU *= img0.channels();
-            int dD = cvRound((y0 + k + sd) * aspl);
-            dD = dD % w;
-            dD *= img0.channels();
-            int wB = w * img0.channels();
-
-            int dX = dD - dU;
-            if (w0 >= dX)
+            if (w0 >= dD)
             {
-                if (w0 >= dD)
-                {
-                    HoughOperator<T, D, OP>::operate((T *)pLine0 + dU,
-                                               (T *)pLineU,
-                                               (T *)pLineD + (w0 - dX),
-                                               w1 + dX);
-                    HoughOperator<T, D, OP>::operate((T *)pLine0 + (w1 + dD),
-                                               (T *)pLineU + (w1 + dX),
-                                               (T *)pLineD,
-                                               w0 - dD);
-                    HoughOperator<T, D, OP>::operate((T *)pLine0,
-                                               (T *)pLineU + (wB - dU),
-                                               (T *)pLineD + (w0 - dD),
-                                               dU);
-                }
-                else
-                {
-                    HoughOperator<T, D, OP>::operate((T *)pLine0 + dU,
-                                               (T *)pLineU,
-                                               (T *)pLineD + (w0 - dX),
-                                               wB - dU);
-                    HoughOperator<T, D, OP>::operate((T *)pLine0,
-                                               (T *)pLineU + (wB - dU),
-                                               (T *)pLineD + (w0 + wB - dD),
-                                               dD - w0);
-                    HoughOperator<T, D, OP>::operate((T *)pLine0 + (dD - w0),
-                                               (T *)pLineU + (w1 + dX),
-                                               (T *)pLineD,
-                                               w0 - dX);
-                }
+                HoughOperator<T, OP>::operate((T *)pLine0 + dU,
+                                              (T *)pLineU,
+                                              (T *)pLineD + (w0 - dX),
+                                              w1 + dX);
+                HoughOperator<T, OP>::operate((T *)pLine0 + (w1 + dD),
+                                              (T *)pLineU + (w1 + dX),
+                                              (T *)pLineD,
+                                              w0 - dD);
+                HoughOperator<T, OP>::operate((T *)pLine0,
+                                              (T *)pLineU + (wB - dU),
+                                              (T *)pLineD + (w0 - dD),
+                                              dU);
             }
             else
             {
-                HoughOperator<T, D, OP>::operate((T *)pLine0 + dU,
-                                           (T *)pLineU,
-                                           (T *)pLineD + (wB - (dX - w0)),
-                                           dX - w0);
-                HoughOperator<T, D, OP>::operate((T *)pLine0 + (dD - w0),
-                                           (T *)pLineU + (dX - w0),
-                                           (T *)pLineD,
-                                           wB - (dX - w0) - dU);
-                HoughOperator<T, D, OP>::operate((T *)pLine0,
-                                           (T *)pLineU + (wB - dU),
-                                           (T *)pLineD + (wB - (dX - w0) - dU),
-                                           dU);
+                HoughOperator<T, OP>::operate((T *)pLine0 + dU,
+                                              (T *)pLineU,
+                                              (T *)pLineD + (w0 - dX),
+                                              wB - dU);
+                HoughOperator<T, OP>::operate((T *)pLine0,
+                                              (T *)pLineU + (wB - dU),
+                                              (T *)pLineD + (w0 + wB - dD),
+                                              dD - w0);
+                HoughOperator<T, OP>::operate((T *)pLine0 + (dD - w0),
+                                              (T *)pLineU + (w1 + dX),
+                                              (T *)pLineD,
+                                              w0 - dX);
             }
         }
         else
         {
-            HoughOperator<T, D, OP>::operate((T *)pLine0,
-                                        (T *)pLineU,
-                                        (T *)pLineD + w0,
-                                        w1);
-            HoughOperator<T, D, OP>::operate((T *)pLine0 + w1,
-                                        (T *)pLineU + w1,
-                                        (T *)pLineD,
-                                        w0);
+            HoughOperator<T, OP>::operate((T *)pLine0 + dU,
+                                          (T *)pLineU,
+                                          (T *)pLineD + (wB - (dX - w0)),
+                                          dX - w0);
+            HoughOperator<T, OP>::operate((T *)pLine0 + (dD - w0),
+                                          (T *)pLineU + (dX - w0),
+                                          (T *)pLineD,
+                                          wB - (dX - w0) - dU);
+            HoughOperator<T, OP>::operate((T *)pLine0,
+                                          (T *)pLineU + (wB - dU),
+                                          (T *)pLineD + (wB - (dX - w0) - dU),
+                                          dU);
         }
     }
+    else
+    {
+        HoughOperator<T, OP>::operate((T *)pLine0,
+                                      (T *)pLineU,
+                                      (T *)pLineD + w0,
+                                      w1);
+        HoughOperator<T, OP>::operate((T *)pLine0 + w1,
+                                      (T *)pLineU + w1,
+                                      (T *)pLineD,
+                                      w0);
+    }
 }
 
-template <typename T, int D, HoughOp Op>
+// Images smaller than this (in elements per depth) are processed in one thread
+static const int64 FHT_MIN_PARALLEL_SIZE = 1 << 16;
+
+// img1 holds the source; the result is put to img0. The recursion is processed
+// depth by depth from the deepest one, the two images are swapped at each depth.
+template <typename T, HoughOp Op>
 void fhtVoT(Mat    &img0,
             Mat    &img1,
             bool    isPositiveShift,
@@ -213,10 +299,47 @@ void fhtVoT(Mat    &img0,
     for (int thres = 1; img0.rows > thres; thres <<= 1)
         level++;
 
-    fhtCore<T, D, Op>(img0, img1, 0, img0.rows, isPositiveShift, level, aspl);
+    std::vector<std::vector<FhtNode> > depths;
+    collectFhtNodes(depths, 0, img0.rows, level, 0);
+
+    std::vector<int> rowOffsets;
+    for (int depth = (int)depths.size() - 1; depth >= 0; depth--)
+    {
+        const std::vector<FhtNode> &nodes = depths[depth];
+        Mat &imgDst = (depth & 1) ? img1 : img0;
+        Mat &imgSrc = (depth & 1) ? img0 : img1;
+
+        rowOffsets.assign(nodes.size() + 1, 0);
+        for (size_t i = 0; i < nodes.size(); i++)
+            rowOffsets[i + 1] = rowOffsets[i] + nodes[i].h;
+        const int nRows = rowOffsets.back();
+        const int64 size = (int64)nRows * img0.cols * img0.channels();
+        const int nStripes = size < FHT_MIN_PARALLEL_SIZE ? 1 :
+                             std::min(nRows, 4 * getNumThreads());
+
+        // rows of the nodes of one depth are independent
+        parallel_for_(Range(0, nRows), [&](const Range &range)
+        {
+            size_t n = std::upper_bound(rowOffsets.begin(), rowOffsets.end(),
+                                        range.start) - rowOffsets.begin() - 1;
+            for (int r = range.start; r < range.end; r++)
+            {
+                while (rowOffsets[n + 1] <= r)
+                    n++;
+                const FhtNode &node = nodes[n];
+                // the rows of a leaf are not touched before it, so they still hold the source
+                if (node.h == 1)
+                    fhtCopyRow(imgDst, img1, node.y0, node.level, aspl);
+                else
+                    fhtCombineRow<T, Op>(imgDst, imgSrc, node.y0, node.h,
+                                         r - rowOffsets[n], isPositiveShift,
+                                         node.level, aspl);
+            }
+        }, nStripes);
+    }
 }
 
-template <typename T, int D>
+template <typename T>
 void fhtVo(Mat    &img0,
            Mat    &img1,
            bool    isPositiveShift,
@@ -226,16 +349,16 @@ void fhtVo(Mat    &img0,
     switch (operation)
     {
     case FHT_ADD:
-        fhtVoT<T, D, FHT_ADD>(img0, img1, isPositiveShift, aspl);
+        fhtVoT<T, FHT_ADD>(img0, img1, isPositiveShift, aspl);
         break;
     case FHT_AVE:
-        fhtVoT<T, D, FHT_AVE>(img0, img1, isPositiveShift, aspl);
+        fhtVoT<T, FHT_AVE>(img0, img1, isPositiveShift, aspl);
         break;
     case FHT_MAX:
-        fhtVoT<T, D, FHT_MAX>(img0, img1, isPositiveShift, aspl);
+        fhtVoT<T, FHT_MAX>(img0, img1, isPositiveShift, aspl);
         break;
     case FHT_MIN:
-        fhtVoT<T, D, FHT_MIN>(img0, img1, isPositiveShift, aspl);
+        fhtVoT<T, FHT_MIN>(img0, img1, isPositiveShift, aspl);
         break;
     default:
         CV_Error_(CV_StsNotImplemented, ("Unknown operation %d", operation));
@@ -253,25 +376,25 @@ static void fhtVo(Mat    &img0,
     switch (depth)
     {
     case CV_8U:
-        fhtVo<uchar, CV_8UC1>(img0, img1, isPositiveShift, operation, aspl);
+        fhtVo<uchar>(img0, img1, isPositiveShift, operation, aspl);
         break;
     case CV_8S:
-        fhtVo<schar, CV_8SC1>(img0, img1, isPositiveShift, operation, aspl);
+        fhtVo<schar>(img0, img1, isPositiveShift, operation, aspl);
         break;
     case CV_16U:
-        fhtVo<ushort, CV_16UC1>(img0, img1, isPositiveShift, operation, aspl);
+        fhtVo<ushort>(img0, img1, isPositiveShift, operation, aspl);
         break;
     case CV_16S:
-        fhtVo<short, CV_16SC1>(img0, img1, isPositiveShift, operation, aspl);
+        fhtVo<short>(img0, img1, isPositiveShift, operation, aspl);
         break;
     case CV_32S:
-        fhtVo<int, CV_32SC1>(img0, img1, isPositiveShift, operation, aspl);
+        fhtVo<int>(img0, img1, isPositiveShift, operation, aspl);
         break;
     case CV_32F:
-        fhtVo<float, CV_32FC1>(img0, img1, isPositiveShift, operation, aspl);
+        fhtVo<float>(img0, img1, isPositiveShift, operation, aspl);
         break;
     case CV_64F:
-        fhtVo<double, CV_64FC1>(img0, img1, isPositiveShift, operation, aspl);
+        fhtVo<double>(img0, img1, isPositiveShift, operation, aspl);
         break;
     default:
         CV_Error_(CV_StsNotImplemented, ("Unknown depth %d", depth));
@@ -279,6 +402,8 @@ static void fhtVo(Mat    &img0,
     }
 }
 
+// src is the original image: it is converted straight into the work buffer,
+// padded with zeros on the right (and transposed for horizontal quadrants)
 static void FHT(Mat       &dst,
                 const Mat &src,
                 int        operation,
@@ -289,19 +414,23 @@ static void FHT(Mat       &dst,
     CV_Assert(dst.cols > 0 && dst.rows > 0);
     CV_Assert(src.channels() == dst.channels());
     if (isVertical)
-        CV_Assert(src.cols == dst.cols && src.rows == dst.rows);
+        CV_Assert(src.rows == dst.rows && src.cols + src.rows == dst.cols);
     else
-        CV_Assert(src.cols == dst.rows && src.rows == dst.cols);
+        CV_Assert(src.cols == dst.rows && src.cols + src.rows == dst.cols);
 
-    int level = 0;
-    for (int thres = 1; dst.rows > thres; thres <<= 1)
-        level++;
-
-    Mat tmp;
-    src.convertTo(tmp, dst.type());
-    if (!isVertical)
-        transpose(tmp, tmp);
-    tmp.copyTo(dst);
+    Mat tmp(dst.size(), dst.type());
+    Mat imgReg(tmp, Rect(0, 0, dst.cols - dst.rows, dst.rows));
+    if (isVertical)
+    {
+        src.convertTo(imgReg, dst.type());
+    }
+    else
+    {
+        Mat srcT;
+        transpose(src, srcT);
+        srcT.convertTo(imgReg, dst.type());
+    }
+    Mat(tmp, Rect(imgReg.cols, 0, dst.rows, dst.rows)).setTo(Scalar::all(0));
 
     fhtVo(dst, tmp,
           isVertical ? isClockwise : !isClockwise,
@@ -391,44 +520,6 @@ static void createDstFhtMat(OutputArray dst,
     dst.create(ht, wd, CV_MAKETYPE(depth, channels));
 }
 
-static void createFHTSrc(Mat       &srcFull,
-                         const Mat &src,
-                         int        angleRange)
-{
-    bool verticalTiling = false;
-    switch (angleRange)
-    {
-    case ARO_315_0:
-    case ARO_0_45:
-    case ARO_CTR_VER:
-    case ARO_315_45:
-        verticalTiling = false;
-        break;
-    case ARO_45_90:
-    case ARO_90_135:
-    case ARO_CTR_HOR:
-    case ARO_45_135:
-        verticalTiling = true;
-        break;
-    default:
-        CV_Error_(CV_StsNotImplemented, ("Unknown angleRange %d", angleRange));
-    }
-
-    int wd = verticalTiling ? src.cols : src.cols + src.rows;
-    int ht = verticalTiling ? src.cols + src.rows : src.rows;
-    srcFull = Mat(ht, wd, src.type());
-
-    Mat imgReg;
-    if (verticalTiling)
-        imgReg = Mat(srcFull, Rect(0, src.rows, src.cols, src.cols));
-    else
-        imgReg = Mat(srcFull, Rect(src.cols, 0, src.rows, src.rows));
-    imgReg = Mat::zeros(imgReg.size(), imgReg.type());
-
-    imgReg = Mat(srcFull, Rect(0, 0, src.cols, src.rows));
-    src.copyTo(imgReg);
-}
-
 static void setFHTDstRegion(Mat       &dstRegion,
                             const Mat &dst,
                             const Mat &src,
@@ -490,25 +581,19 @@ static void setFHTDstRegion(Mat       &dstRegion,
 
 
 static void rotateLineRightCyclic(uchar *pLine,
-                                  uchar *pBuf,
                                   int    len,
                                   int    shift)
 {
   shift = shift % len;
   shift = (shift + len) % len;
-  memcpy(pBuf, pLine, len);
-  memcpy(pLine + shift, pBuf, len - shift);
-  if (shift > 0)
-    memcpy(pLine, pBuf + len - shift, shift);
+  std::rotate(pLine, pLine + len - shift, pLine + len);
 }
 
+// src is the original image
 static void skewQuadrant(Mat         &quad,
                          const Mat   &src,
-                         uchar       *pBuf,
                          int          quadrant)
 {
-    CV_Assert(pBuf);
-
     const int wd = src.cols;
     const int ht = src.rows;
 
@@ -541,10 +626,23 @@ static void skewQuadrant(Mat         &quad,
     {
         uchar *pLine = quad.ptr(y);
         int shift = static_cast<int>(start + step * y) * pixlen;
-        rotateLineRightCyclic(pLine, pBuf, len, shift);
+        rotateLineRightCyclic(pLine, len, shift);
     }
 }
 
+static void calculateFHTQuadrantFull(Mat       &dst,
+                                     const Mat &src,
+                                     int        operation,
+                                     int        quadrant,
+                                     int        makeSkew)
+{
+    calculateFHTQuadrant(dst, src, operation, quadrant);
+    if (quadrant == ARO_315_0 || quadrant == ARO_45_90 || quadrant == ARO_CTR_VER)
+        flip(dst, dst, 0);
+    if (HDO_DESKEW == makeSkew)
+        skewQuadrant(dst, src, quadrant);
+}
+
 void FastHoughTransform(InputArray  src,
                         OutputArray dst,
                         int         dstMatDepth,
@@ -553,119 +651,72 @@ void FastHoughTransform(InputArray  src,
                         int         makeSkew)
 {
     Mat srcMat = src.getMat();
-    if (!srcMat.isContinuous())
-        srcMat = srcMat.clone();
     CV_Assert(srcMat.cols > 0 && srcMat.rows > 0);
 
     createDstFhtMat(dst, src, dstMatDepth, angleRange);
     Mat dstMat = dst.getMat();
 
-    Mat imgRegDst;
-    const int len = dstMat.cols * static_cast<int>(dstMat.elemSize());
-    CV_Assert(len > 0);
-    std::vector<uchar> buf_(len);
-    uchar *buf(&buf_[0]);
-
-    if (angleRange == ARO_315_135)
-    {
-        {
-            Mat imgSrc;
-            createFHTSrc(imgSrc, srcMat, ARO_315_45);
-
-            setFHTDstRegion(imgRegDst, dstMat, srcMat, ARO_315_0, angleRange);
-            calculateFHTQuadrant(imgRegDst, imgSrc, operation, ARO_315_0);
-            flip(imgRegDst, imgRegDst, 0);
-            if (HDO_DESKEW == makeSkew)
-                skewQuadrant(imgRegDst, imgSrc, buf, ARO_315_0);
-
-            setFHTDstRegion(imgRegDst, dstMat, srcMat, ARO_0_45, angleRange);
-            calculateFHTQuadrant(imgRegDst, imgSrc, operation, ARO_0_45);
-            if (HDO_DESKEW == makeSkew)
-                skewQuadrant(imgRegDst, imgSrc, buf, ARO_0_45);
-        }
-        {
-            Mat imgSrc;
-            createFHTSrc(imgSrc, srcMat, ARO_45_135);
-
-            setFHTDstRegion(imgRegDst, dstMat, srcMat, ARO_45_90, angleRange);
-            calculateFHTQuadrant(imgRegDst, imgSrc, operation, ARO_45_90);
-            flip(imgRegDst, imgRegDst, 0);
-            if (HDO_DESKEW == makeSkew)
-                skewQuadrant(imgRegDst, imgSrc, buf, ARO_45_90);
-
-            setFHTDstRegion(imgRegDst, dstMat, srcMat, ARO_90_135, angleRange);
-            calculateFHTQuadrant(imgRegDst, imgSrc, operation, ARO_90_135);
-            if (HDO_DESKEW == makeSkew)
-                skewQuadrant(imgRegDst, imgSrc, buf, ARO_90_135);
-        }
-        return;
-    }
-
-    Mat imgSrc;
-    createFHTSrc(imgSrc, srcMat, angleRange);
-
+    int quadrants[4];
+    int nQuadrants = 0;
     switch (angleRange)
     {
     case ARO_315_0:
-        calculateFHTQuadrant(dstMat, imgSrc, operation, angleRange);
-        flip(dstMat, dstMat, 0);
-        if (HDO_DESKEW == makeSkew)
-            skewQuadrant(dstMat, imgSrc, buf, angleRange);
-        return;
     case ARO_0_45:
-        calculateFHTQuadrant(dstMat, imgSrc, operation, angleRange);
-        if (HDO_DESKEW == makeSkew)
-            skewQuadrant(dstMat, imgSrc, buf, angleRange);
-        return;
     case ARO_45_90:
-        calculateFHTQuadrant(dstMat, imgSrc, operation, angleRange);
-        flip(dstMat, dstMat, 0);
-        if (HDO_DESKEW == makeSkew)
-            skewQuadrant(dstMat, imgSrc, buf, angleRange);
-        return;
     case ARO_90_135:
-        calculateFHTQuadrant(dstMat, imgSrc, operation, angleRange);
-        if (HDO_DESKEW == makeSkew)
-            skewQuadrant(dstMat, imgSrc, buf, angleRange);
-        return;
-    case ARO_315_45:
-        setFHTDstRegion(imgRegDst, dstMat, srcMat, ARO_315_0, angleRange);
-        calculateFHTQuadrant(imgRegDst, imgSrc, operation, ARO_315_0);
-        flip(imgRegDst, imgRegDst, 0);
-        if (HDO_DESKEW == makeSkew)
-            skewQuadrant(imgRegDst, imgSrc, buf, ARO_315_0);
-
-        setFHTDstRegion(imgRegDst, dstMat, srcMat, ARO_0_45, angleRange);
-        calculateFHTQuadrant(imgRegDst, imgSrc, operation, ARO_0_45);
-        if (HDO_DESKEW == makeSkew)
-            skewQuadrant(imgRegDst, imgSrc, buf, ARO_0_45);
-        return;
-    case ARO_45_135:
-        setFHTDstRegion(imgRegDst, dstMat, srcMat, ARO_45_90, angleRange);
-        calculateFHTQuadrant(imgRegDst, imgSrc, operation, ARO_45_90);
-        flip(imgRegDst, imgRegDst, 0);
-        if (HDO_DESKEW == makeSkew)
-            skewQuadrant(imgRegDst, imgSrc, buf, ARO_45_90);
-
-        setFHTDstRegion(imgRegDst, dstMat, srcMat, ARO_90_135, angleRange);
-        calculateFHTQuadrant(imgRegDst, imgSrc, operation, ARO_90_135);
-        if (HDO_DESKEW == makeSkew)
-            skewQuadrant(imgRegDst, imgSrc, buf, ARO_90_135);
-        return;
     case ARO_CTR_VER:
-        calculateFHTQuadrant(dstMat, imgSrc, operation, angleRange);
-        flip(dstMat, dstMat, 0);
-        if (HDO_DESKEW == makeSkew)
-            skewQuadrant(dstMat, imgSrc, buf, angleRange);
-        return;
     case ARO_CTR_HOR:
-        calculateFHTQuadrant(dstMat, imgSrc, operation, angleRange);
-        if (HDO_DESKEW == makeSkew)
-            skewQuadrant(dstMat, imgSrc, buf, angleRange);
-        return;
+        quadrants[nQuadrants++] = angleRange;
+        break;
+    case ARO_315_45:
+        quadrants[nQuadrants++] = ARO_315_0;
+        quadrants[nQuadrants++] = ARO_0_45;
+        break;
+    case ARO_45_135:
+        quadrants[nQuadrants++] = ARO_45_90;
+        quadrants[nQuadrants++] = ARO_90_135;
+        break;
+    case ARO_315_135:
+        quadrants[nQuadrants++] = ARO_315_0;
+        quadrants[nQuadrants++] = ARO_0_45;
+        quadrants[nQuadrants++] = ARO_45_90;
+        quadrants[nQuadrants++] = ARO_90_135;
+        break;
     default:
         CV_Error_(CV_StsNotImplemented, ("Unknown angleRange %d", angleRange));
     }
+
+    // Neighbouring quadrants share one row of dst (the angle where they meet),
+    // which belongs to the later one. Even quadrants are computed in place and
+    // odd ones in separate buffers, so that all of them can run in parallel.
+    const bool isParallel = nQuadrants > 1 && srcMat.rows > 1 && srcMat.cols > 1;
+    std::vector<Mat> regions(nQuadrants), results(nQuadrants);
+    for (int i = 0; i < nQuadrants; i++)
+    {
+        if (nQuadrants > 1)
+            setFHTDstRegion(regions[i], dstMat, srcMat, quadrants[i], angleRange);
+        else
+            regions[i] = dstMat;
+        if (isParallel && (i & 1))
+            results[i].create(regions[i].size(), regions[i].type());
+        else
+            results[i] = regions[i];
+    }
+
+    parallel_for_(Range(0, nQuadrants), [&](const Range &range)
+    {
+        for (int i = range.start; i < range.end; i++)
+            calculateFHTQuadrantFull(results[i], srcMat, operation,
+                                     quadrants[i], makeSkew);
+    }, isParallel ? nQuadrants : 1);
+
+    for (int i = 1; i < nQuadrants; i += 2)
+    {
+        if (results[i].data == regions[i].data)
+            continue;
+        const int ht = regions[i].rows - (i + 1 < nQuadrants ? 1 : 0);
+        results[i].rowRange(0, ht).copyTo(regions[i].rowRange(0, ht));
+    }
 }
 
 //-----------------------------------------------------------------------------
@@ -37,39 +37,66 @@
 #include "precomp.hpp"
 
 #include <cmath>
+#include <cfloat>
 #include <vector>
-#include <memory>
-#include <stdlib.h>
-#include <iostream>
-#include <iterator>
 #include <algorithm>
 
+namespace cv
+{
+namespace ximgproc
+{
 
-#ifdef HAVE_EIGEN
-#  if defined __GNUC__ && defined __APPLE__
-#    pragma GCC diagnostic ignored "-Wshadow"
-#  endif
-#  include <Eigen/Dense>
-#  include <Eigen/SparseCore>
-#  include <Eigen/SparseCholesky>
-#  include <Eigen/IterativeLinearSolvers>
-#  include <Eigen/Sparse>
-
+    // Open addressing table from the hash of grid coordinates to a vertex id
+    class GridHashTable
+    {
+    public:
+        void create(int capacity)
+        {
+            int size = 16;
+            while (size < capacity * 2)
+                size *= 2;
+            mask = size - 1;
+            keys.assign(size, 0);
+            ids.assign(size, -1);
+        }
 
+        // Return the id of the key, or -1
+        int find(long long key) const
+        {
+            for (int i = slot(key);; i = (i + 1) & mask)
+            {
+                if (ids[i] < 0 || keys[i] == key)
+                    return ids[i];
+            }
+        }
 
+        // Return the id of the key, inserting it with the given id if it is new
+        int insert(long long key, int id)
+        {
+            for (int i = slot(key);; i = (i + 1) & mask)
+            {
+                if (ids[i] < 0)
+                {
+                    keys[i] = key;
+                    ids[i] = id;
+                    return id;
+                }
+                if (keys[i] == key)
+                    return ids[i];
+            }
+        }
 
-#if __cplusplus <= 199711L
-    #include <map>
-    typedef std::map<long long /* hash */, int /* vert id */>  mapId;
-#else
-    #include <unordered_map>
-    typedef std::unordered_map<long long /* hash */, int /* vert id */>  mapId;
-#endif
+    private:
+        int slot(long long key) const
+        {
+            unsigned long long h = (unsigned long long)key * 0x9E3779B97F4A7C15ULL;
+            return (int)(h >> 32) & mask;
+        }
 
-namespace cv
-{
-namespace ximgproc
-{
+        int mask;
+        std::vector<long long> keys;
+        std::vector<int> ids;
+    };
 
     class FastBilateralSolverFilterImpl : public FastBilateralSolverFilter
     {
@@ -108,6 +135,8 @@ namespace ximgproc
                 split(src,src_channels);
 
             Mat conf = confidence.getMat();
+            if (!conf.isContinuous())
+                conf = conf.clone();
 
             for(int i=0;i<src.channels();i++)
             {
@@ -133,20 +162,9 @@ namespace ximgproc
         void solve(cv::Mat& src, cv::Mat& confidence, cv::Mat& dst);
         void init(cv::Mat& reference, double sigma_spatial, double sigma_luma, double sigma_chroma, double lambda, int num_iter, double max_tol);
 
-        void Splat(Eigen::VectorXf& input, Eigen::VectorXf& dst);
-        void Blur(Eigen::VectorXf& input, Eigen::VectorXf& dst);
-        void Slice(Eigen::VectorXf& input, Eigen::VectorXf& dst);
-
-        void diagonal(Eigen::VectorXf& v,Eigen::SparseMatrix<float>& mat)
-        {
-            mat = Eigen::SparseMatrix<float>(v.size(),v.size());
-            for (int i = 0; i < int(v.size()); i++)
-            {
-                mat.insert(i,i) = v(i);
-            }
-        }
-
-
+        void Splat(const std::vector<float>& input, std::vector<float>& dst);
+        void Blur(const std::vector<float>& input, std::vector<float>& dst);
+        void Slice(const std::vector<float>& input, std::vector<float>& dst);
 
     private:
 
@@ -155,14 +173,17 @@ namespace ximgproc
         int dim;
         int cols;
         int rows;
+
+        // vertex of each pixel
         std::vector<int> splat_idx;
-        std::vector<std::pair<int, int> > blur_idx;
-        Eigen::VectorXf m;
-        Eigen::VectorXf n;
-        Eigen::SparseMatrix<float, Eigen::ColMajor> blurs;
-        Eigen::SparseMatrix<float, Eigen::ColMajor> S;
-        Eigen::SparseMatrix<float, Eigen::ColMajor> Dn;
-        Eigen::SparseMatrix<float, Eigen::ColMajor> Dm;
+        // pixels of vertex v are splat_pixels[splat_offsets[v]..splat_offsets[v+1]), in raster order
+        std::vector<int> splat_offsets;
+        std::vector<int> splat_pixels;
+        // 2*dim grid neighbours of each vertex, -1 when the neighbour does not exist
+        std::vector<int> blur_idx;
+        // bistochastization of the blur: A = lam*(diag(m) - diag(n)*blur*diag(n)) + diag(splat(w))
+        std::vector<float> m;
+        std::vector<float> n;
 
         struct grid_params
         {
@@ -197,7 +218,34 @@ namespace ximgproc
 
     };
 
+    // Weight of a vertex in its own blur
+    static const float FBS_BLUR_CENTER = 10.0f;
 
+    static int getVertexStripes(int count)
+    {
+        return std::max(1, std::min((count + 4095) / 4096, 4 * getNumThreads()));
+    }
+
+    // Sums of per-element terms over [0, count). The partial sums of fixed blocks
+    // are added in order, so the result does not depend on the number of threads.
+    template<int NSUMS, typename Body>
+    static void blockReduce(int count, const Body& body, double* sums)
+    {
+        const int block = 4096;
+        const int nblocks = std::max(1, (count + block - 1) / block);
+        std::vector<double> partial((size_t)nblocks * NSUMS, 0.);
+
+        parallel_for_(Range(0, nblocks), [&](const Range& range) {
+            for (int b = range.start; b < range.end; b++)
+                body(b * block, std::min(count, (b + 1) * block), &partial[(size_t)b * NSUMS]);
+        });
+
+        for (int k = 0; k < NSUMS; k++)
+            sums[k] = 0.;
+        for (int b = 0; b < nblocks; b++)
+            for (int k = 0; k < NSUMS; k++)
+                sums[k] += partial[(size_t)b * NSUMS + k];
+    }
 
     void FastBilateralSolverFilterImpl::init(cv::Mat& reference, double sigma_spatial, double sigma_luma, double sigma_chroma, double lambda, int num_iter, double max_tol)
     {
@@ -206,255 +254,158 @@ namespace ximgproc
         bs_param.cg_maxiter = num_iter;
         bs_param.cg_tol = max_tol;
 
+        cv::Mat reference_yuv;
         if(reference.channels()==1)
         {
             dim = 3;
-            cols = reference.cols;
-            rows = reference.rows;
-            npixels = cols*rows;
-            long long hash_vec[3];
-            for (int i = 0; i < 3; ++i)
-            hash_vec[i] = static_cast<long long>(std::pow(255, i));
-
-            mapId hashed_coords;
-#if __cplusplus <= 199711L
-#else
-            hashed_coords.reserve(cols*rows);
-#endif
-
-            const unsigned char* pref = (const unsigned char*)reference.data;
-            int vert_idx = 0;
-            int pix_idx = 0;
-
-            // construct Splat(Slice) matrices
-            splat_idx.resize(npixels);
-            for (int y = 0; y < rows; ++y)
-            {
-                for (int x = 0; x < cols; ++x)
-                {
-                    long long coord[3];
-                    coord[0] = int(x / sigma_spatial);
-                    coord[1] = int(y / sigma_spatial);
-                    coord[2] = int(pref[0] / sigma_luma);
-
-                    // convert the coordinate to a hash value
-                    long long hash_coord = 0;
-                    for (int i = 0; i < 3; ++i)
-                        hash_coord += coord[i] * hash_vec[i];
-
-                    // pixels whom are alike will have the same hash value.
-                    // We only want to keep a unique list of hash values, therefore make sure we only insert
-                    // unique hash values.
-                    mapId::iterator it = hashed_coords.find(hash_coord);
-                    if (it == hashed_coords.end())
-                    {
-                        hashed_coords.insert(std::pair<long long, int>(hash_coord, vert_idx));
-                        splat_idx[pix_idx] = vert_idx;
-                        ++vert_idx;
-                    }
-                    else
-                    {
-                        splat_idx[pix_idx] = it->second;
-                    }
-
-                    pref += 1; // skip 1 bytes (y)
-                    ++pix_idx;
-                }
-            }
-            nvertices = static_cast<int>(hashed_coords.size());
-
-            // construct Blur matrices
-            Eigen::VectorXf ones_nvertices = Eigen::VectorXf::Ones(nvertices);
-            diagonal(ones_nvertices,blurs);
-            blurs *= 10;
-            for(int offset = -1; offset <= 1;++offset)
-            {
-                if(offset == 0) continue;
-                for (int i = 0; i < dim; ++i)
-                {
-                    Eigen::SparseMatrix<float, Eigen::ColMajor> blur_temp(hashed_coords.size(), hashed_coords.size());
-                    blur_temp.reserve(Eigen::VectorXi::Constant(nvertices,6));
-                    long long offset_hash_coord = offset * hash_vec[i];
-                    for (mapId::iterator it = hashed_coords.begin(); it != hashed_coords.end(); ++it)
-                    {
-                        long long neighb_coord = it->first + offset_hash_coord;
-                        mapId::iterator it_neighb = hashed_coords.find(neighb_coord);
-                        if (it_neighb != hashed_coords.end())
-                        {
-                            blur_temp.insert(it->second,it_neighb->second) = 1.0f;
-                            blur_idx.push_back(std::pair<int,int>(it->second, it_neighb->second));
-                        }
-                    }
-                    blurs += blur_temp;
-                }
-            }
-            blurs.finalize();
-
-            //bistochastize
-            int maxiter = 10;
-            n = ones_nvertices;
-            m = Eigen::VectorXf::Zero(nvertices);
-            for (int i = 0; i < int(splat_idx.size()); i++)
-            {
-                m(splat_idx[i]) += 1.0f;
-            }
-
-            Eigen::VectorXf bluredn(nvertices);
-
-            for (int i = 0; i < maxiter; i++)
-            {
-                Blur(n,bluredn);
-                n = ((n.array()*m.array()).array()/bluredn.array()).array().sqrt();
-            }
-            Blur(n,bluredn);
-
-            m = n.array() * (bluredn).array();
-            diagonal(m,Dm);
-            diagonal(n,Dn);
-
+            reference_yuv = reference;
         }
         else
         {
             dim = 5;
-            cv::Mat reference_yuv;
             cv::cvtColor(reference, reference_yuv, COLOR_BGR2YCrCb);
+        }
 
-            cols = reference_yuv.cols;
-            rows = reference_yuv.rows;
-            npixels = cols*rows;
-            long long hash_vec[5];
-            for (int i = 0; i < 5; ++i)
+        cols = reference_yuv.cols;
+        rows = reference_yuv.rows;
+        npixels = cols*rows;
+        long long hash_vec[5];
+        for (int i = 0; i < dim; ++i)
             hash_vec[i] = static_cast<long long>(std::pow(255, i));
 
-            mapId hashed_coords;
-#if __cplusplus <= 199711L
-#else
-            hashed_coords.reserve(cols*rows);
-#endif
-
-            const unsigned char* pref = (const unsigned char*)reference_yuv.data;
-            int vert_idx = 0;
-            int pix_idx = 0;
-
-            // construct Splat(Slice) matrices
-            splat_idx.resize(npixels);
-            for (int y = 0; y < rows; ++y)
+        // hash the grid coordinates of every pixel
+        std::vector<long long> pixel_hash(npixels);
+        const int cn = reference_yuv.channels();
+        parallel_for_(Range(0, rows), [&](const Range& range) {
+            for (int y = range.start; y < range.end; ++y)
             {
-                for (int x = 0; x < cols; ++x)
+                const unsigned char* pref = reference_yuv.ptr<unsigned char>(y);
+                for (int x = 0; x < cols; ++x, pref += cn)
                 {
                     long long coord[5];
                     coord[0] = int(x / sigma_spatial);
                     coord[1] = int(y / sigma_spatial);
                     coord[2] = int(pref[0] / sigma_luma);
-                    coord[3] = int(pref[1] / sigma_chroma);
-                    coord[4] = int(pref[2] / sigma_chroma);
+                    if (dim == 5)
+                    {
+                        coord[3] = int(pref[1] / sigma_chroma);
+                        coord[4] = int(pref[2] / sigma_chroma);
+                    }
 
                     // convert the coordinate to a hash value
                     long long hash_coord = 0;
-                    for (int i = 0; i < 5; ++i)
+                    for (int i = 0; i < dim; ++i)
                         hash_coord += coord[i] * hash_vec[i];
-
-                    // pixels whom are alike will have the same hash value.
-                    // We only want to keep a unique list of hash values, therefore make sure we only insert
-                    // unique hash values.
-                    mapId::iterator it = hashed_coords.find(hash_coord);
-                    if (it == hashed_coords.end())
-                    {
-                        hashed_coords.insert(std::pair<long long, int>(hash_coord, vert_idx));
-                        splat_idx[pix_idx] = vert_idx;
-                        ++vert_idx;
-                    }
-                    else
-                    {
-                        splat_idx[pix_idx] = it->second;
-                    }
-
-                    pref += 3; // skip 3 bytes (y u v)
-                    ++pix_idx;
+                    pixel_hash[(size_t)y * cols + x] = hash_coord;
                 }
             }
-            nvertices = static_cast<int>(hashed_coords.size());
+        });
+
+        // pixels whom are alike will have the same hash value: they share a vertex.
+        // Vertices are numbered in order of first appearance.
+        GridHashTable hashed_coords;
+        hashed_coords.create(npixels);
+        std::vector<long long> vertex_hash;
+        splat_idx.resize(npixels);
+        for (int i = 0; i < npixels; ++i)
+        {
+            int vert_idx = hashed_coords.insert(pixel_hash[i], (int)vertex_hash.size());
+            if (vert_idx == (int)vertex_hash.size())
+                vertex_hash.push_back(pixel_hash[i]);
+            splat_idx[i] = vert_idx;
+        }
+        nvertices = (int)vertex_hash.size();
+
+        // group the pixels by vertex
+        splat_offsets.assign(nvertices + 1, 0);
+        for (int i = 0; i < npixels; ++i)
+            splat_offsets[splat_idx[i] + 1]++;
+        for (int v = 0; v < nvertices; ++v)
+            splat_offsets[v + 1] += splat_offsets[v];
+        splat_pixels.resize(npixels);
+        {
+            std::vector<int> pos(splat_offsets.begin(), splat_offsets.end() - 1);
+            for (int i = 0; i < npixels; ++i)
+                splat_pixels[pos[splat_idx[i]]++] = i;
+        }
 
-            // construct Blur matrices
-            Eigen::VectorXf ones_nvertices = Eigen::VectorXf::Ones(nvertices);
-            diagonal(ones_nvertices,blurs);
-            blurs *= 10;
-            for(int offset = -1; offset <= 1;++offset)
+        // construct Blur: neighbours along each dimension of the grid
+        const int nneighbours = 2 * dim;
+        blur_idx.resize((size_t)nvertices * nneighbours);
+        parallel_for_(Range(0, nvertices), [&](const Range& range) {
+            for (int v = range.start; v < range.end; ++v)
             {
-                if(offset == 0) continue;
+                int* neighbours = &blur_idx[(size_t)v * nneighbours];
                 for (int i = 0; i < dim; ++i)
                 {
-                    Eigen::SparseMatrix<float, Eigen::ColMajor> blur_temp(hashed_coords.size(), hashed_coords.size());
-                    blur_temp.reserve(Eigen::VectorXi::Constant(nvertices,6));
-                    long long offset_hash_coord = offset * hash_vec[i];
-                    for (mapId::iterator it = hashed_coords.begin(); it != hashed_coords.end(); ++it)
-                    {
-                        long long neighb_coord = it->first + offset_hash_coord;
-                        mapId::iterator it_neighb = hashed_coords.find(neighb_coord);
-                        if (it_neighb != hashed_coords.end())
-                        {
-                            blur_temp.insert(it->second,it_neighb->second) = 1.0f;
-                            blur_idx.push_back(std::pair<int,int>(it->second, it_neighb->second));
-                        }
-                    }
-                    blurs += blur_temp;
+                    neighbours[2 * i] = hashed_coords.find(vertex_hash[v] - hash_vec[i]);
+                    neighbours[2 * i + 1] = hashed_coords.find(vertex_hash[v] + hash_vec[i]);
                 }
             }
-            blurs.finalize();
-
+        });
 
-            //bistochastize
-            int maxiter = 10;
-            n = ones_nvertices;
-            m = Eigen::VectorXf::Zero(nvertices);
-            for (int i = 0; i < int(splat_idx.size()); i++)
-            {
-                m(splat_idx[i]) += 1.0f;
-            }
+        //bistochastize
+        int maxiter = 10;
+        n.assign(nvertices, 1.0f);
+        m.resize(nvertices);
+        for (int v = 0; v < nvertices; v++)
+            m[v] = (float)(splat_offsets[v + 1] - splat_offsets[v]);
 
-            Eigen::VectorXf bluredn(nvertices);
+        std::vector<float> bluredn(nvertices);
 
-            for (int i = 0; i < maxiter; i++)
-            {
-                Blur(n,bluredn);
-                n = ((n.array()*m.array()).array()/bluredn.array()).array().sqrt();
-            }
+        for (int i = 0; i < maxiter; i++)
+        {
             Blur(n,bluredn);
-
-            m = n.array() * (bluredn).array();
-            diagonal(m,Dm);
-            diagonal(n,Dn);
+            for (int v = 0; v < nvertices; v++)
+                n[v] = std::sqrt(n[v] * m[v] / bluredn[v]);
         }
+        Blur(n,bluredn);
+
+        for (int v = 0; v < nvertices; v++)
+            m[v] = n[v] * bluredn[v];
     }
 
-    void FastBilateralSolverFilterImpl::Splat(Eigen::VectorXf& input, Eigen::VectorXf& output)
+    void FastBilateralSolverFilterImpl::Splat(const std::vector<float>& input, std::vector<float>& output)
     {
-        output.setZero();
-        for (int i = 0; i < int(splat_idx.size()); i++)
-        {
-            output(splat_idx[i]) += input(i);
-        }
-
+        output.resize(nvertices);
+        parallel_for_(Range(0, nvertices), [&](const Range& range) {
+            for (int v = range.start; v < range.end; v++)
+            {
+                float sum = 0.f;
+                for (int k = splat_offsets[v]; k < splat_offsets[v + 1]; k++)
+                    sum += input[splat_pixels[k]];
+                output[v] = sum;
+            }
+        }, getVertexStripes(nvertices));
     }
 
-    void FastBilateralSolverFilterImpl::Blur(Eigen::VectorXf& input, Eigen::VectorXf& output)
+    void FastBilateralSolverFilterImpl::Blur(const std::vector<float>& input, std::vector<float>& output)
     {
-        output.setZero();
-        output = input * 10;
-        for (int i = 0; i < int(blur_idx.size()); i++)
-        {
-            output(blur_idx[i].first) += input(blur_idx[i].second);
-        }
+        const int nneighbours = 2 * dim;
+        output.resize(nvertices);
+        parallel_for_(Range(0, nvertices), [&](const Range& range) {
+            for (int v = range.start; v < range.end; v++)
+            {
+                const int* neighbours = &blur_idx[(size_t)v * nneighbours];
+                float sum = input[v] * FBS_BLUR_CENTER;
+                for (int k = 0; k < nneighbours; k++)
+                {
+                    if (neighbours[k] >= 0)
+                        sum += input[neighbours[k]];
+                }
+                output[v] = sum;
+            }
+        }, getVertexStripes(nvertices));
     }
 
 
-    void FastBilateralSolverFilterImpl::Slice(Eigen::VectorXf& input, Eigen::VectorXf& output)
+    void FastBilateralSolverFilterImpl::Slice(const std::vector<float>& input, std::vector<float>& output)
     {
-        output.setZero();
-        for (int i = 0; i < int(splat_idx.size()); i++)
-        {
-            output(i) = input(splat_idx[i]);
-        }
+        output.resize(npixels);
+        parallel_for_(Range(0, npixels), [&](const Range& range) {
+            for (int i = range.start; i < range.end; i++)
+                output[i] = input[splat_idx[i]];
+        }, getVertexStripes(npixels));
     }
 
 
@@ -462,144 +413,149 @@ namespace ximgproc
                cv::Mat& confidence,
                cv::Mat& output)
     {
-
-        Eigen::SparseMatrix<float, Eigen::ColMajor> M(nvertices,nvertices);
-        Eigen::SparseMatrix<float, Eigen::ColMajor> A_data(nvertices,nvertices);
-        Eigen::SparseMatrix<float, Eigen::ColMajor> A(nvertices,nvertices);
-        Eigen::VectorXf b(nvertices);
-        Eigen::VectorXf y(nvertices);
-        Eigen::VectorXf y0(nvertices);
-        Eigen::VectorXf y1(nvertices);
-        Eigen::VectorXf w_splat(nvertices);
-
-        Eigen::VectorXf x(npixels);
-        Eigen::VectorXf w(npixels);
-
-        if(target.depth() == CV_16S)
-        {
-            const int16_t *pft = reinterpret_cast<const int16_t*>(target.data);
-            for (int i = 0; i < npixels; i++)
-            {
-                x(i) = (cv::saturate_cast<float>(pft[i])+32768.0f)/65535.0f;
-            }
-        }
-        else if(target.depth() == CV_16U)
-        {
-            const uint16_t *pft = reinterpret_cast<const uint16_t*>(target.data);
-            for (int i = 0; i < npixels; i++)
+        std::vector<float> x(npixels);
+        std::vector<float> w(npixels);
+        std::vector<float> xw(npixels);
+        const int depth = target.depth();
+        const int conf_depth = confidence.depth();
+
+        parallel_for_(Range(0, npixels), [&](const Range& range) {
+            for (int i = range.start; i < range.end; i++)
             {
-                x(i) = cv::saturate_cast<float>(pft[i])/65535.0f;
+                if(depth == CV_16S)
+                    x[i] = (cv::saturate_cast<float>(target.ptr<int16_t>()[i])+32768.0f)/65535.0f;
+                else if(depth == CV_16U)
+                    x[i] = cv::saturate_cast<float>(target.ptr<uint16_t>()[i])/65535.0f;
+                else if(depth == CV_8U)
+                    x[i] = cv::saturate_cast<float>(target.ptr<uchar>()[i])/255.0f;
+                else
+                    x[i] = target.ptr<float>()[i];
+
+                if(conf_depth == CV_8U)
+                    w[i] = cv::saturate_cast<float>(confidence.ptr<uchar>()[i])/255.0f;
+                else
+                    w[i] = confidence.ptr<float>()[i];
+
+                xw[i] = x[i] * w[i];
             }
-        }
-        else if(target.depth() == CV_8U)
-        {
-            const uchar *pft = reinterpret_cast<const uchar*>(target.data);
-            for (int i = 0; i < npixels; i++)
-            {
-                x(i) = cv::saturate_cast<float>(pft[i])/255.0f;
-            }
-        }
-        else if(target.depth() == CV_32F)
-        {
-            const float *pft = reinterpret_cast<const float*>(target.data);
-            for (int i = 0; i < npixels; i++)
-            {
-                x(i) = pft[i];
-            }
-        }
-
-        if(confidence.depth() == CV_8U)
-        {
-            const uchar *pfc = reinterpret_cast<const uchar*>(confidence.data);
-            for (int i = 0; i < npixels; i++)
-            {
-                w(i) = cv::saturate_cast<float>(pfc[i])/255.0f;
-            }
-        }
-        else if(confidence.depth() == CV_32F)
-        {
-            const float *pfc = reinterpret_cast<const float*>(confidence.data);
-            for (int i = 0; i < npixels; i++)
-            {
-                w(i) = pfc[i];
-            }
-        }
+        }, getVertexStripes(npixels));
 
         //construct A
+        const float lam = bs_param.lam;
+        std::vector<float> w_splat, b, y;
         Splat(w,w_splat);
 
-        diagonal(w_splat,A_data);
-        A = bs_param.lam * (Dm - Dn * (blurs*Dn)) + A_data ;
-
-        //construct b
-        b.setZero();
-        for (int i = 0; i < int(splat_idx.size()); i++)
+        std::vector<float> A_diag(nvertices), inv_diag(nvertices), lam_n(nvertices);
+        for (int v = 0; v < nvertices; v++)
         {
-            b(splat_idx[i]) += x(i) * w(i);
+            A_diag[v] = lam * (m[v] - FBS_BLUR_CENTER * n[v] * n[v]) + w_splat[v];
+            inv_diag[v] = A_diag[v] != 0.f ? 1.f / A_diag[v] : 1.f;
+            lam_n[v] = lam * n[v];
         }
 
-        //construct guess for y
-        y0.setZero();
-        for (int i = 0; i < int(splat_idx.size()); i++)
-        {
-            y0(splat_idx[i]) += x(i);
-        }
-        y1.setZero();
-        for (int i = 0; i < int(splat_idx.size()); i++)
-        {
-            y1(splat_idx[i]) += 1.0f;
-        }
-        for (int i = 0; i < nvertices; i++)
-        {
-            y0(i) = y0(i)/y1(i);
-        }
+        const int nneighbours = 2 * dim;
+        // dst = A*src, and the dot product src.dst
+        auto multiplyA = [&](const std::vector<float>& src, std::vector<float>& dst) -> double {
+            double dot;
+            blockReduce<1>(nvertices, [&](int begin, int end, double* sum) {
+                for (int v = begin; v < end; v++)
+                {
+                    const int* neighbours = &blur_idx[(size_t)v * nneighbours];
+                    float blurred = 0.f;
+                    for (int k = 0; k < nneighbours; k++)
+                    {
+                        const int u = neighbours[k];
+                        if (u >= 0)
+                            blurred += n[u] * src[u];
+                    }
+                    dst[v] = A_diag[v] * src[v] - lam_n[v] * blurred;
+                    sum[0] += (double)src[v] * dst[v];
+                }
+            }, &dot);
+            return dot;
+        };
 
+        //construct b
+        Splat(xw,b);
 
-        // solve Ay = b
-        Eigen::ConjugateGradient<Eigen::SparseMatrix<float>, Eigen::Lower|Eigen::Upper> cg;
-        cg.compute(A);
-        cg.setMaxIterations(bs_param.cg_maxiter);
-        cg.setTolerance(bs_param.cg_tol);
-        // y = cg.solve(b);
-        y = cg.solveWithGuess(b,y0);
-        std::cout << "#iterations:     " << cg.iterations() << std::endl;
-        std::cout << "estimated error: " << cg.error()      << std::endl;
+        //construct guess for y: the mean of the target over each vertex
+        Splat(x,y);
+        for (int v = 0; v < nvertices; v++)
+            y[v] /= (float)(splat_offsets[v + 1] - splat_offsets[v]);
 
-        //slice
-        if(target.depth() == CV_16S)
-        {
-            int16_t *pftar = (int16_t*) output.data;
-            for (int i = 0; i < int(splat_idx.size()); i++)
-            {
-                pftar[i] = cv::saturate_cast<short>(y(splat_idx[i]) * 65535.0f - 32768.0f);
-            }
-        }
-        else if(target.depth() == CV_16U)
-        {
-            uint16_t *pftar = (uint16_t*) output.data;
-            for (int i = 0; i < int(splat_idx.size()); i++)
+        // solve Ay = b with a Jacobi-preconditioned conjugate gradient
+        std::vector<float> r(nvertices), z(nvertices), p(nvertices), Ap(nvertices);
+        double sums[2];
+
+        multiplyA(y, Ap);
+        blockReduce<2>(nvertices, [&](int begin, int end, double* sum) {
+            for (int v = begin; v < end; v++)
             {
-                pftar[i] = cv::saturate_cast<ushort>(y(splat_idx[i]) * 65535.0f);
+                r[v] = b[v] - Ap[v];
+                p[v] = inv_diag[v] * r[v];
+                sum[0] += (double)b[v] * b[v];
+                sum[1] += (double)r[v] * r[v];
             }
-        }
-        else if (target.depth() == CV_8U)
+        }, sums);
+
+        const double rhs_norm2 = sums[0];
+        const double threshold = std::max((double)bs_param.cg_tol * bs_param.cg_tol * rhs_norm2, (double)FLT_MIN);
+        double residual_norm2 = sums[1];
+
+        if (rhs_norm2 == 0)
+            std::fill(y.begin(), y.end(), 0.f);
+        else if (residual_norm2 >= threshold)
         {
-            uchar *pftar = (uchar*) output.data;
-            for (int i = 0; i < int(splat_idx.size()); i++)
+            blockReduce<1>(nvertices, [&](int begin, int end, double* sum) {
+                for (int v = begin; v < end; v++)
+                    sum[0] += (double)r[v] * p[v];
+            }, sums);
+            double abs_new = sums[0];
+
+            for (int it = 0; it < bs_param.cg_maxiter; it++)
             {
-                pftar[i] = cv::saturate_cast<uchar>(y(splat_idx[i]) * 255.0f);
+                const float alpha = (float)(abs_new / multiplyA(p, Ap));
+
+                blockReduce<2>(nvertices, [&](int begin, int end, double* sum) {
+                    for (int v = begin; v < end; v++)
+                    {
+                        y[v] += alpha * p[v];
+                        r[v] -= alpha * Ap[v];
+                        z[v] = inv_diag[v] * r[v];
+                        sum[0] += (double)r[v] * r[v];
+                        sum[1] += (double)r[v] * z[v];
+                    }
+                }, sums);
+
+                residual_norm2 = sums[0];
+                if (residual_norm2 < threshold)
+                    break;
+
+                const float beta = (float)(sums[1] / abs_new);
+                abs_new = sums[1];
+
+                parallel_for_(Range(0, nvertices), [&](const Range& range) {
+                    for (int v = range.start; v < range.end; v++)
+                        p[v] = z[v] + beta * p[v];
+                }, getVertexStripes(nvertices));
             }
         }
-        else
-        {
-            float *pftar = (float*)(output.data);
-            for (int i = 0; i < int(splat_idx.size()); i++)
+
+        //slice
+        parallel_for_(Range(0, npixels), [&](const Range& range) {
+            for (int i = range.start; i < range.end; i++)
             {
-                pftar[i] = y(splat_idx[i]);
+                const float val = y[splat_idx[i]];
+                if(depth == CV_16S)
+                    output.ptr<int16_t>()[i] = cv::saturate_cast<short>(val * 65535.0f - 32768.0f);
+                else if(depth == CV_16U)
+                    output.ptr<uint16_t>()[i] = cv::saturate_cast<ushort>(val * 65535.0f);
+                else if (depth == CV_8U)
+                    output.ptr<uchar>()[i] = cv::saturate_cast<uchar>(val * 255.0f);
+                else
+                    output.ptr<float>()[i] = val;
             }
-        }
-
-
+        }, getVertexStripes(npixels));
     }
 
 
@@ -619,27 +575,3 @@ void fastBilateralSolverFilter(InputArray guide, InputArray src, InputArray conf
 }
 
 }
-
-#else
-
-namespace cv
-{
-namespace ximgproc
-{
-
-Ptr<FastBilateralSolverFilter> createFastBilateralSolverFilter(InputArray, double, double, double, double, int, double)
-{
-    CV_Error(Error::StsNotImplemented, "createFastBilateralSolverFilter : needs to be compiled with EIGEN");
-}
-
-void fastBilateralSolverFilter(InputArray, InputArray, InputArray, OutputArray, double, double, double, double, int, double)
-{
-    CV_Error(Error::StsNotImplemented, "fastBilateralSolverFilter : needs to be compiled with EIGEN");
-}
-
-
-}
-
-}
-
-#endif // HAVE_EIGEN
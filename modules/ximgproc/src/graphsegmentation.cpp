@@ -42,6 +42,7 @@ the use of this software, even if advised of the possibility of such damage.
 #include "opencv2/ximgproc/segmentation.hpp"
 
 #include <iostream>
+#include <mutex>
 
 namespace cv {
     namespace ximgproc {
@@ -61,40 +62,30 @@ namespace cv {
                     }
             };
 
-            // A point in the sets of points
-            class PointSetElement {
-                public:
-                    int p;
-                    int size;
-
-                    PointSetElement() { }
-
-                    PointSetElement(int p_) {
-                        p = p_;
-                        size = 1;
-                    }
-            };
-
-            // An object to manage set of points, who can be fusionned
+            // An object to manage set of points, who can be fusionned.
+            // The storage is owned by the caller, so it can be reused between images.
             class PointSet {
                 public:
-                    PointSet(int nb_elements_);
-                    ~PointSet();
+                    PointSet(std::vector<int>& parent_, std::vector<int>& sizes_, int nb_elements);
 
-                    int nb_elements;
+                    // Map the points in [begin, end) to themselves
+                    void reset(int begin, int end);
 
                     // Return the main point of the point's set
                     int getBasePoint(int p);
 
+                    // Same, without updating the mapping. Safe to call concurrently once merging is done
+                    int getBasePointConst(int p) const;
+
                     // Join two sets of points, based on their main point
                     void joinPoints(int p_a, int p_b);
 
                     // Return the set size of a set (based on the main point)
-                    int size(unsigned int p) { return mapping[p].size; }
+                    int size(int p) const { return sizes[p]; }
 
                 private:
-                    PointSetElement* mapping;
-
+                    int* parent;
+                    int* sizes;
             };
 
             class GraphSegmentationImpl : public GraphSegmentation {
@@ -141,22 +132,113 @@ namespace cv {
                     int min_size;
                     String name_;
 
+                    // Working memory of one processImage call
+                    struct Buffers {
+                        Mat img_filtered;
+                        std::vector<Edge> edges;
+                        std::vector<Edge> edges_tmp;
+                        std::vector<int> parent;
+                        std::vector<int> sizes;
+                        std::vector<float> thresholds;
+                        std::vector<int> counts;
+                        std::vector<int> starts;
+                        std::vector<int> mapped_id;
+                    };
+
+                    // Kept between calls to avoid reallocating for every frame. A call running
+                    // while another one holds them uses its own temporary buffers
+                    Buffers buffers;
+                    Mutex buffers_mutex;
+
                     // Pre-filter the image
                     void filter(const Mat &img, Mat &img_filtered);
 
                     // Build the graph between each pixels
-                    void buildGraph(Edge **edges, int &nb_edges, const Mat &img_filtered);
+                    void buildGraph(std::vector<Edge> &edges, const Mat &img_filtered);
+
+                    // Sort the edges by weight, then segment the graph
+                    const Edge* segmentGraph(Buffers &buf, int rows, int cols, PointSet &es);
 
-                    // Segment the graph
-                    void segmentGraph(Edge * edges, const int &nb_edges, const Mat & img_filtered, PointSet **es);
+                    // Apply the merge criterion on a list of sorted edges
+                    void segmentEdges(const Edge *edges, int begin, int end, PointSet &es, float *thresholds);
 
                     // Remove areas too small
-                    void filterSmallAreas(Edge *edges, const int &nb_edges, PointSet *es);
+                    void filterSmallAreas(const Edge *edges, int nb_edges, PointSet &es);
 
                     // Map the segemented graph to a Mat with uniques, sequentials ids
-                    void finalMapping(PointSet *es, Mat &output);
+                    void finalMapping(const PointSet &es, std::vector<int> &mapped_id, Mat &output);
             };
 
+            // Key of a weight for the radix sort. Weights are never negative, so the
+            // ordering of their IEEE 754 representation is the ordering of the values
+            static inline unsigned weightKey(float w) {
+                Cv32suf v;
+                v.f = w;
+                return v.u;
+            }
+
+            // Stable counting pass, in parallel: scatter src into dst by bucket, keeping the
+            // order of the edges inside a bucket. starts receives the first position of each
+            // bucket. Return false without touching dst when every edge is in the same bucket.
+            template<typename BucketFn>
+            static bool scatterEdges(const Edge *src, Edge *dst, int nb_edges, int nb_buckets, const BucketFn &bucket,
+                                     std::vector<int> &counts, std::vector<int> &starts) {
+
+                const int nstripes = std::max(1, std::min((nb_edges + 65535) / 65536, 4 * getNumThreads()));
+
+                counts.assign((size_t)nstripes * nb_buckets, 0);
+
+                parallel_for_(Range(0, nstripes), [&](const Range &range) {
+                    for (int s = range.start; s < range.end; s++) {
+                        int* c = &counts[(size_t)s * nb_buckets];
+                        const int begin = (int)((int64)nb_edges * s / nstripes);
+                        const int end = (int)((int64)nb_edges * (s + 1) / nstripes);
+
+                        for (int i = begin; i < end; i++)
+                            c[bucket(src[i])]++;
+                    }
+                }, nstripes);
+
+                starts.assign(nb_buckets + 1, 0);
+
+                bool single_bucket = false;
+
+                for (int b = 0; b < nb_buckets; b++) {
+                    int total = 0;
+                    for (int s = 0; s < nstripes; s++)
+                        total += counts[(size_t)s * nb_buckets + b];
+
+                    starts[b + 1] = starts[b] + total;
+                    single_bucket = single_bucket || total == nb_edges;
+                }
+
+                if (single_bucket)
+                    return false;
+
+                // Turn the counts into the write position of each stripe
+                for (int b = 0; b < nb_buckets; b++) {
+                    int position = starts[b];
+                    for (int s = 0; s < nstripes; s++) {
+                        int c = counts[(size_t)s * nb_buckets + b];
+                        counts[(size_t)s * nb_buckets + b] = position;
+                        position += c;
+                    }
+                }
+
+                parallel_for_(Range(0, nstripes), [&](const Range &range) {
+                    for (int s = range.start; s < range.end; s++) {
+                        int* position = &counts[(size_t)s * nb_buckets];
+                        const int begin = (int)((int64)nb_edges * s / nstripes);
+                        const int end = (int)((int64)nb_edges * (s + 1) / nstripes);
+
+                        for (int i = begin; i < end; i++)
+                            dst[position[bucket(src[i])]++] = src[i];
+                    }
+                }, nstripes);
+
+                return true;
+            }
+
             void GraphSegmentationImpl::filter(const Mat &img, Mat &img_filtered) {
 
                 Mat img_converted;
@@ -168,120 +250,143 @@ namespace cv {
                 GaussianBlur(img_converted, img_filtered, Size(0, 0), sigma, sigma);
             }
 
-            void GraphSegmentationImpl::buildGraph(Edge **edges, int &nb_edges, const Mat &img_filtered) {
-
-                *edges = new Edge[img_filtered.rows * img_filtered.cols * 4];
+            void GraphSegmentationImpl::buildGraph(std::vector<Edge> &edges, const Mat &img_filtered) {
 
-                nb_edges = 0;
+                const int rows = img_filtered.rows;
+                const int cols = img_filtered.cols;
+                const int nb_channels = img_filtered.channels();
 
-                int nb_channels = img_filtered.channels();
+                // Each pixel is linked to its right and bottom neighbours, which covers every
+                // pair of 4-connected pixels once. Row i starts at i * (2 * cols - 1): first
+                // its cols - 1 horizontal edges, then its cols vertical ones.
+                edges.resize((size_t)rows * (cols - 1) + (size_t)(rows - 1) * cols);
 
-                for (int i = 0; i < (int)img_filtered.rows; i++) {
-                    const float* p = img_filtered.ptr<float>(i);
+                Edge* e = edges.data();
 
-                    for (int j = 0; j < (int)img_filtered.cols; j++) {
+                parallel_for_(Range(0, rows), [&](const Range &range) {
+                    for (int i = range.start; i < range.end; i++) {
+                        const float* p = img_filtered.ptr<float>(i);
+                        const float* p_down = img_filtered.ptr<float>(std::min(i + 1, rows - 1));
+                        Edge* e_right = e + (size_t)i * (2 * cols - 1);
+                        Edge* e_down = e_right + (cols - 1);
 
-                        //Take the right, left, top and down pixel
-                        for (int delta = -1; delta <= 1; delta += 2) {
-                            for (int delta_j = 0, delta_i = 1; delta_j <= 1; delta_j++ || delta_i--) {
+                        for (int j = 0; j < cols; j++) {
+                            const float* p1 = p + j * nb_channels;
 
-                                int i2 = i + delta * delta_i;
-                                int j2 = j + delta * delta_j;
+                            if (j + 1 < cols) {
+                                const float* p2 = p1 + nb_channels;
+                                float tmp_total = 0;
 
-                                if (i2 >= 0 && i2 < img_filtered.rows && j2 >= 0 && j2 < img_filtered.cols) {
-                                    const float* p2 = img_filtered.ptr<float>(i2);
-
-                                    float tmp_total = 0;
-
-                                    for ( int channel = 0; channel < nb_channels; channel++) {
-                                        tmp_total += pow(p[j * nb_channels + channel] - p2[j2 * nb_channels + channel], 2);
-                                    }
+                                for (int channel = 0; channel < nb_channels; channel++) {
+                                    double d = p1[channel] - p2[channel];
+                                    tmp_total += d * d;
+                                }
 
-                                    float diff = 0;
-                                    diff = sqrt(tmp_total);
+                                e_right[j].weight = sqrt(tmp_total);
+                                e_right[j].from = i * cols + j;
+                                e_right[j].to = i * cols + j + 1;
+                            }
 
-                                    (*edges)[nb_edges].weight = diff;
-                                    (*edges)[nb_edges].from = i * img_filtered.cols +  j;
-                                    (*edges)[nb_edges].to = i2 * img_filtered.cols + j2;
+                            if (i + 1 < rows) {
+                                const float* p2 = p_down + j * nb_channels;
+                                float tmp_total = 0;
 
-                                    nb_edges++;
+                                for (int channel = 0; channel < nb_channels; channel++) {
+                                    double d = p1[channel] - p2[channel];
+                                    tmp_total += d * d;
                                 }
+
+                                e_down[j].weight = sqrt(tmp_total);
+                                e_down[j].from = i * cols + j;
+                                e_down[j].to = (i + 1) * cols + j;
                             }
                         }
                     }
-                }
+                });
             }
 
-            void GraphSegmentationImpl::segmentGraph(Edge *edges, const int &nb_edges, const Mat &img_filtered, PointSet **es) {
-
-                int total_points = ( int)(img_filtered.rows * img_filtered.cols);
+            void GraphSegmentationImpl::segmentEdges(const Edge *edges, int begin, int end, PointSet &es, float *thresholds) {
 
-                // Sort edges
-                std::sort(edges, edges + nb_edges);
+                for (int i = begin; i < end; i++) {
 
-                // Create a set with all point (by default mapped to themselves)
-                *es = new PointSet(img_filtered.cols * img_filtered.rows);
+                    int p_a = es.getBasePoint(edges[i].from);
+                    int p_b = es.getBasePoint(edges[i].to);
 
-                // Thresholds
-                float* thresholds = new float[total_points];
+                    if (p_a != p_b) {
+                        if (edges[i].weight <= thresholds[p_a] && edges[i].weight <= thresholds[p_b]) {
+                            es.joinPoints(p_a, p_b);
+                            p_a = es.getBasePoint(p_a);
+                            thresholds[p_a] = edges[i].weight + k / es.size(p_a);
+                        }
+                    }
+                }
+            }
 
-                for (int i = 0; i < total_points; i++)
-                    thresholds[i] = k;
+            const Edge* GraphSegmentationImpl::segmentGraph(Buffers &buf, int rows, int cols, PointSet &es) {
 
-                for ( int i = 0; i < nb_edges; i++) {
+                const int nb_edges = (int)buf.edges.size();
 
-                    int p_a = (*es)->getBasePoint(edges[i].from);
-                    int p_b = (*es)->getBasePoint(edges[i].to);
+                buf.edges_tmp.resize(buf.edges.size());
+                buf.thresholds.resize((size_t)rows * cols);
 
-                    if (p_a != p_b) {
-                        if (edges[i].weight <= thresholds[p_a] && edges[i].weight <= thresholds[p_b]) {
-                            (*es)->joinPoints(p_a, p_b);
-                            p_a = (*es)->getBasePoint(p_a);
-                            thresholds[p_a] = edges[i].weight + k / (*es)->size(p_a);
+                Edge* sorted = buf.edges.data();
+                Edge* spare = buf.edges_tmp.data();
 
-                            edges[i].weight = 0;
-                        }
-                    }
+                // Sort edges: LSD radix sort on the weights, one byte per pass
+                for (int shift = 0; shift < 32; shift += 8) {
+                    if (scatterEdges(sorted, spare, nb_edges, 256,
+                                     [shift](const Edge &e) { return (int)((weightKey(e.weight) >> shift) & 255); },
+                                     buf.counts, buf.starts))
+                        std::swap(sorted, spare);
                 }
 
-                delete [] thresholds;
-            }
+                // Create a set with all point (by default mapped to themselves)
+                es.reset(0, rows * cols);
 
-            void GraphSegmentationImpl::filterSmallAreas(Edge *edges, const int &nb_edges, PointSet *es) {
+                // Thresholds
+                float* thresholds = buf.thresholds.data();
+                std::fill(thresholds, thresholds + (size_t)rows * cols, k);
 
-                for ( int i = 0; i < nb_edges; i++) {
+                // The merge criterion depends on the order of all the edges by weight, it stays serial
+                segmentEdges(sorted, 0, nb_edges, es, thresholds);
 
-                    if (edges[i].weight > 0) {
+                return sorted;
+            }
 
-                        int p_a = es->getBasePoint(edges[i].from);
-                        int p_b = es->getBasePoint(edges[i].to);
+            void GraphSegmentationImpl::filterSmallAreas(const Edge *edges, int nb_edges, PointSet &es) {
 
-                        if (p_a != p_b && (es->size(p_a) < min_size || es->size(p_b) < min_size)) {
-                            es->joinPoints(p_a, p_b);
+                // Edges already merged by segmentGraph join a set with itself and are skipped
+                for ( int i = 0; i < nb_edges; i++) {
 
-                        }
+                    int p_a = es.getBasePoint(edges[i].from);
+                    int p_b = es.getBasePoint(edges[i].to);
+
+                    if (p_a != p_b && (es.size(p_a) < min_size || es.size(p_b) < min_size)) {
+                        es.joinPoints(p_a, p_b);
                     }
                 }
 
             }
 
-            void GraphSegmentationImpl::finalMapping(PointSet *es, Mat &output) {
+            void GraphSegmentationImpl::finalMapping(const PointSet &es, std::vector<int> &mapped_id, Mat &output) {
 
-                int maximum_size = ( int)(output.rows * output.cols);
+                const int rows = output.rows;
+                const int cols = output.cols;
 
-                int last_id = 0;
-                int * mapped_id = new int[maximum_size];
+                // Look for the main point of each pixel
+                parallel_for_(Range(0, rows), [&](const Range &range) {
+                    for (int i = range.start; i < range.end; i++) {
+                        int* p = output.ptr<int>(i);
 
-                for ( int i = 0; i < maximum_size; i++)
-                    mapped_id[i] = -1;
+                        for (int j = 0; j < cols; j++)
+                            p[j] = es.getBasePointConst(i * cols + j);
+                    }
+                });
 
-                int rows = output.rows;
-                int cols = output.cols;
+                // Then number the sets in order of appearance
+                mapped_id.assign((size_t)rows * cols, -1);
 
-                if (output.isContinuous()) {
-                    cols *= rows;
-                    rows = 1;
-                }
+                int last_id = 0;
 
                 for (int i = 0; i < rows; i++) {
 
@@ -289,7 +394,7 @@ namespace cv {
 
                     for (int j = 0; j < cols; j++) {
 
-                        int point = es->getBasePoint(i * cols + j);
+                        int point = p[j];
 
                         if (mapped_id[point] == -1) {
                             mapped_id[point] = last_id;
@@ -299,8 +404,6 @@ namespace cv {
                         p[j] = mapped_id[point];
                     }
                 }
-
-                delete [] mapped_id;
             }
 
             void GraphSegmentationImpl::processImage(InputArray src, OutputArray dst) {
@@ -311,30 +414,33 @@ namespace cv {
                 Mat output = dst.getMat();
                 output.setTo(0);
 
+                if (img.empty())
+                    return;
+
+                std::unique_lock<Mutex> lock(buffers_mutex, std::try_to_lock);
+                Buffers local_buffers;
+                Buffers &buf = lock.owns_lock() ? buffers : local_buffers;
+
                 // Filter graph
-                Mat img_filtered;
-                filter(img, img_filtered);
+                filter(img, buf.img_filtered);
 
                 // Build graph
-                Edge *edges;
-                int nb_edges;
-
-                buildGraph(&edges, nb_edges, img_filtered);
+                buildGraph(buf.edges, buf.img_filtered);
 
                 // Segment graph
-                PointSet *es;
+                PointSet es(buf.parent, buf.sizes, img.rows * img.cols);
 
-                segmentGraph(edges, nb_edges, img_filtered, &es);
+                const Edge* sorted_edges = segmentGraph(buf, img.rows, img.cols, es);
 
                 // Remove small areas
-                filterSmallAreas(edges, nb_edges, es);
+                filterSmallAreas(sorted_edges, (int)buf.edges.size(), es);
 
                 // Map to final output
-                finalMapping(es, output);
-
-                delete [] edges;
-                delete es;
+                finalMapping(es, buf.mapped_id, output);
+            }
 
+            bool isThreadSafeGraphSegmentation(const Ptr<GraphSegmentation>& gs) {
+                return dynamic_cast<const GraphSegmentationImpl*>(gs.get()) != NULL;
             }
 
             Ptr<GraphSegmentation> createGraphSegmentation(double sigma, float k, int min_size) {
@@ -348,44 +454,48 @@ namespace cv {
                 return graphseg;
             }
 
-            PointSet::PointSet(int nb_elements_) {
-                nb_elements = nb_elements_;
+            PointSet::PointSet(std::vector<int>& parent_, std::vector<int>& sizes_, int nb_elements) {
+                parent_.resize(nb_elements);
+                sizes_.resize(nb_elements);
 
-                mapping = new PointSetElement[nb_elements];
+                parent = parent_.data();
+                sizes = sizes_.data();
+            }
 
-                for ( int i = 0; i < nb_elements; i++) {
-                    mapping[i] = PointSetElement(i);
+            void PointSet::reset(int begin, int end) {
+                for (int i = begin; i < end; i++) {
+                    parent[i] = i;
+                    sizes[i] = 1;
                 }
             }
 
-            PointSet::~PointSet() {
-                delete [] mapping;
-            }
+            int PointSet::getBasePoint(int p) {
 
-            int PointSet::getBasePoint( int p) {
+                // Path halving: every visited point is redirected to its grandparent
+                while (p != parent[p]) {
+                    parent[p] = parent[parent[p]];
+                    p = parent[p];
+                }
 
-                 int base_p = p;
+                return p;
+            }
 
-                while (base_p != mapping[base_p].p) {
-                    base_p = mapping[base_p].p;
-                }
+            int PointSet::getBasePointConst(int p) const {
 
-                // Save mapping for faster acces later
-                mapping[p].p = base_p;
+                while (p != parent[p])
+                    p = parent[p];
 
-                return base_p;
+                return p;
             }
 
             void PointSet::joinPoints(int p_a, int p_b) {
 
                 // Always target smaller set, to avoid redirection in getBasePoint
-                if (mapping[p_a].size < mapping[p_b].size)
-                    swap(p_a, p_b);
-
-                mapping[p_b].p = p_a;
-                mapping[p_a].size += mapping[p_b].size;
+                if (sizes[p_a] < sizes[p_b])
+                    std::swap(p_a, p_b);
 
-                nb_elements--;
+                parent[p_b] = p_a;
+                sizes[p_a] += sizes[p_b];
             }
 
         }
@@ -51,4 +51,15 @@
 #include <algorithm>
 #include <map>
 
+namespace cv {
+namespace ximgproc {
+namespace segmentation {
+
+// True for the graph segmentations created by createGraphSegmentation, whose processImage() may be called concurrently
+bool isThreadSafeGraphSegmentation(const Ptr<GraphSegmentation>& gs);
+
+}
+}
+}
+
 #endif
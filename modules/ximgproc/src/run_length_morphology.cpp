@@ -54,6 +54,27 @@ struct rlType
 
 typedef std::vector<rlType> rlVec;
 
+// Runs are kept sorted by row, then by column (see rlType::operator <). Every function
+// producing runs preserves this order, so inputs never have to be sorted again.
+
+// Number of bands for processing nRows rows in parallel
+static int getRowStripes(int nRows)
+{
+    return std::max(1, std::min(nRows / 16, 4 * getNumThreads()));
+}
+
+// Concatenates the runs produced by consecutive bands of rows
+static void concatenateStripes(std::vector<rlVec>& stripes, rlVec& res)
+{
+    size_t nTotal = 0;
+    for (size_t i = 0; i < stripes.size(); ++i)
+        nTotal += stripes[i].size();
+    res.clear();
+    res.reserve(nTotal);
+    for (size_t i = 0; i < stripes.size(); ++i)
+        res.insert(res.end(), stripes[i].begin(), stripes[i].end());
+}
+
 template <class T>
 void _thresholdLine(T* pData, int nWidth, int nRow, T threshold, int type, rlVec& res)
 {
@@ -83,45 +104,59 @@ void _thresholdLine(T* pData, int nWidth, int nRow, T threshold, int type, rlVec
   }
 }
 
+template <class T>
+static void _thresholdRows(cv::Mat& img, int nRowBegin, int nRowEnd, T threshold, int type, rlVec& res)
+{
+  for (int i = nRowBegin; i < nRowEnd; ++i)
+    _thresholdLine<T>((T*) img.ptr(i), img.cols, i, threshold, type, res);
+}
+
 static void _threshold(cv::Mat& img, rlVec& res, double threshold, int type)
 {
   res.clear();
-  switch (img.depth())
+  int depth = img.depth();
+  if (depth != CV_8U && depth != CV_8S && depth != CV_16U && depth != CV_16S &&
+      depth != CV_32S && depth != CV_32F && depth != CV_64F)
+    CV_Error( CV_StsUnsupportedFormat, "unsupported image type" );
+
+  // rows are independent: threshold bands of rows in parallel
+  int nStripes = getRowStripes(img.rows);
+  std::vector<rlVec> stripes(nStripes);
+  parallel_for_(Range(0, nStripes), [&](const Range& range)
   {
-  case CV_8U:
-    for (int i = 0; i < img.rows; ++i)
-      _thresholdLine<uchar>(img.ptr(i), img.cols, i, (uchar) threshold, type, res);
-    break;
-  case CV_8S:
-    for (int i = 0; i < img.rows; ++i)
-      _thresholdLine<schar>((schar*) img.ptr(i), img.cols, i, (schar) threshold, type, res);
-    break;
-  case CV_16U:
-      for (int i = 0; i < img.rows; ++i)
+    for (int s = range.start; s < range.end; ++s)
+    {
+      int nRowBegin = (int)((int64)img.rows * s / nStripes);
+      int nRowEnd = (int)((int64)img.rows * (s + 1) / nStripes);
+      rlVec& cur = stripes[s];
+      switch (depth)
       {
-          _thresholdLine<unsigned short>((unsigned short*)img.ptr(i), img.cols, i,
-              (unsigned short)threshold, type, res);
+      case CV_8U:
+        _thresholdRows<uchar>(img, nRowBegin, nRowEnd, (uchar) threshold, type, cur);
+        break;
+      case CV_8S:
+        _thresholdRows<schar>(img, nRowBegin, nRowEnd, (schar) threshold, type, cur);
+        break;
+      case CV_16U:
+        _thresholdRows<unsigned short>(img, nRowBegin, nRowEnd, (unsigned short) threshold, type, cur);
+        break;
+      case CV_16S:
+        _thresholdRows<short>(img, nRowBegin, nRowEnd, (short) threshold, type, cur);
+        break;
+      case CV_32S:
+        _thresholdRows<int>(img, nRowBegin, nRowEnd, (int) threshold, type, cur);
+        break;
+      case CV_32F:
+        _thresholdRows<float>(img, nRowBegin, nRowEnd, (float) threshold, type, cur);
+        break;
+      default:
+        _thresholdRows<double>(img, nRowBegin, nRowEnd, threshold, type, cur);
+        break;
       }
-    break;
-  case CV_16S:
-    for (int i = 0; i < img.rows; ++i)
-      _thresholdLine<short>((short*) img.ptr(i), img.cols, i, (short) threshold, type, res);
-    break;
-  case CV_32S:
-    for (int i = 0; i < img.rows; ++i)
-      _thresholdLine<int>((int*) img.ptr(i), img.cols, i, (int) threshold, type, res);
-    break;
-  case CV_32F:
-    for (int i = 0; i < img.rows; ++i)
-      _thresholdLine<float>((float*) img.ptr(i), img.cols, i, (float) threshold, type, res);
-    break;
-  case CV_64F:
-    for (int i = 0; i < img.rows; ++i)
-      _thresholdLine<double>((double*) img.ptr(i), img.cols, i, threshold, type, res);
-    break;
-  default:
-    CV_Error( CV_StsUnsupportedFormat, "unsupported image type" );
-  }
+    }
+  }, nStripes);
+
+  concatenateStripes(stripes, res);
 }
 
 
@@ -237,56 +272,21 @@ CV_EXPORTS Mat getStructuringElement(int shape, Size ksize)
   return rlDest;
 }
 
-static void erode_rle (rlVec& regIn, rlVec& regOut, rlVec& se)
+// Erosion of the result rows [nRowBegin, nRowEnd): they only depend on the chords of regIn
+// in the rows covered by the structuring element
+static void erode_rle_rows(const rlVec& regIn, const rlVec& se, const std::vector<int>& pIdxChord1,
+    const std::vector<int>& pIdxNextRow, int nMinRow, int nRowBegin, int nRowEnd, rlVec& regOut)
 {
-  using namespace std;
-
-    regOut.clear();
-
-    if (regIn.size() == 0)
-        return;
-
-    int nMinRow = regIn[0].r;
-    int nMaxRow = regIn.back().r;
-
-    int nRows = nMaxRow - nMinRow + 1;
-
-
-    const int EMPTY = -1;
-
-    // setup a table which holds the index of the first chord for each row
-    vector<int> pIdxChord1(nRows);
-    vector<int> pIdxNextRow(nRows);
-
-    int i,j;
-
-    for (i=1;i<nRows;i++)
-    {
-        pIdxChord1[i] = EMPTY;
-        pIdxNextRow[i] = EMPTY;
-    }
-
-    pIdxChord1[0] = 0;
-    pIdxNextRow[nRows-1] = (int) regIn.size();
-
-    for (i=1; i < (int) regIn.size();i++)
-        if (regIn[i].r != regIn[i-1].r)
-        {
-            pIdxChord1[regIn[i].r - nMinRow] = i;
-            pIdxNextRow[regIn[i-1].r - nMinRow] = i;
-        }
+    using namespace std;
 
     int nMinRowSE = se[0].r;
-    int nMaxRowSE = se.back().r;
-
-    int nRowsSE = nMaxRowSE - nMinRowSE + 1;
-
-    assert(nRowsSE == (int) se.size());
+    int nRowsSE = (int) se.size();
 
     vector<int> pCurIdxRow(nRowsSE);
+    int i, j;
 
     // loop through all possible rows
-    for (i=nMinRow - nMinRowSE; i<= nMaxRow - nMaxRowSE; i++)
+    for (i = nRowBegin; i < nRowEnd; i++)
     {
         // check whether all relevant rows are available
         bool bNextRow = false;
@@ -361,7 +361,75 @@ static void erode_rle (rlVec& regIn, rlVec& regOut, rlVec& se)
         }
         } // end while (!bNextRow
     } // end for
+}
 
+static void erode_rle (rlVec& regIn, rlVec& regOut, rlVec& se)
+{
+  using namespace std;
+
+    regOut.clear();
+
+    if (regIn.size() == 0)
+        return;
+
+    int nMinRow = regIn[0].r;
+    int nMaxRow = regIn.back().r;
+
+    int nRows = nMaxRow - nMinRow + 1;
+
+
+    const int EMPTY = -1;
+
+    // setup a table which holds the index of the first chord for each row
+    vector<int> pIdxChord1(nRows);
+    vector<int> pIdxNextRow(nRows);
+
+    int i;
+
+    for (i=1;i<nRows;i++)
+    {
+        pIdxChord1[i] = EMPTY;
+        pIdxNextRow[i] = EMPTY;
+    }
+
+    pIdxChord1[0] = 0;
+    pIdxNextRow[nRows-1] = (int) regIn.size();
+
+    for (i=1; i < (int) regIn.size();i++)
+        if (regIn[i].r != regIn[i-1].r)
+        {
+            pIdxChord1[regIn[i].r - nMinRow] = i;
+            pIdxNextRow[regIn[i-1].r - nMinRow] = i;
+        }
+
+    int nMinRowSE = se[0].r;
+    int nMaxRowSE = se.back().r;
+
+    int nRowsSE = nMaxRowSE - nMinRowSE + 1;
+
+    assert(nRowsSE == (int) se.size());
+    CV_UNUSED(nRowsSE);
+
+    // result rows are independent: erode bands of rows in parallel
+    const int nFirstRow = nMinRow - nMinRowSE;
+    const int nLastRow = nMaxRow - nMaxRowSE;
+    if (nLastRow < nFirstRow)
+        return;
+
+    const int nStripes = getRowStripes(nLastRow - nFirstRow + 1);
+    vector<rlVec> stripes(nStripes);
+
+    parallel_for_(Range(0, nStripes), [&](const Range& range)
+    {
+        for (int s = range.start; s < range.end; s++)
+        {
+            int nRowBegin = nFirstRow + (int)((int64)(nLastRow - nFirstRow + 1) * s / nStripes);
+            int nRowEnd = nFirstRow + (int)((int64)(nLastRow - nFirstRow + 1) * (s + 1) / nStripes);
+            erode_rle_rows(regIn, se, pIdxChord1, pIdxNextRow, nMinRow, nRowBegin, nRowEnd, stripes[s]);
+        }
+    }, nStripes);
+
+    concatenateStripes(stripes, regOut);
 }
 
 static void convertInputArrayToRuns(InputArray& theArray, rlVec& runs, Size& theSize)
@@ -412,11 +480,10 @@ static void mergeNeighbouringChords(rlVec& rlIn, rlVec& rlOut)
 
 static void union_regions(rlVec& reg1, rlVec& reg2, rlVec& regUnion)
 {
-    rlVec lAllChords(reg1);
-
-    lAllChords.insert(lAllChords.end(), reg2.begin(), reg2.end());
+    // both inputs are sorted: merging them keeps the order, no need to sort again
+    rlVec lAllChords(reg1.size() + reg2.size());
+    std::merge(reg1.begin(), reg1.end(), reg2.begin(), reg2.end(), lAllChords.begin());
 
-    sortChords(lAllChords);
     mergeNeighbouringChords(lAllChords, regUnion);
 }
 
@@ -807,6 +874,189 @@ CV_EXPORTS void morphologyEx(InputArray rlSrc, OutputArray rlDest, int op, Input
     }
 }
 
+
+// Find the root of a run in the union-find forest of connectedComponents
+static int findRoot(std::vector<int>& parent, int i)
+{
+    while (parent[i] != i)
+    {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+static void joinRuns(std::vector<int>& parent, int a, int b)
+{
+    a = findRoot(parent, a);
+    b = findRoot(parent, b);
+    // the smaller index becomes the root, so labels follow the order of the runs
+    if (a < b)
+        parent[b] = a;
+    else if (b < a)
+        parent[a] = b;
+}
+
+static int labelRuns(rlVec& runs, int connectivity, std::vector<int>& labels)
+{
+    CV_Assert(connectivity == 4 || connectivity == 8);
+    const int nRuns = (int) runs.size();
+    // with 8-connectivity, runs touching diagonally are connected as well
+    const int nReach = (connectivity == 8) ? 1 : 0;
+
+    std::vector<int> parent(nRuns);
+    for (int i = 0; i < nRuns; ++i)
+        parent[i] = i;
+
+    // runs of the previous row are [nPrevBegin, nPrevEnd), runs of the current row start at nCurBegin
+    int nPrevBegin = 0, nPrevEnd = 0, nCurBegin = 0;
+    for (int i = 0; i < nRuns; ++i)
+    {
+        if (i > 0 && runs[i].r != runs[i - 1].r)
+        {
+            if (runs[i].r == runs[i - 1].r + 1)
+            {
+                nPrevBegin = nCurBegin;
+                nPrevEnd = i;
+            }
+            else
+                nPrevBegin = nPrevEnd = i;
+            nCurBegin = i;
+        }
+        else if (i > nCurBegin && runs[i].cb <= runs[i - 1].ce + 1)
+            joinRuns(parent, i, i - 1); // touching runs of the same row
+
+        // both rows are sorted: skip the runs of the previous row ending before this one
+        while (nPrevBegin < nPrevEnd && runs[nPrevBegin].ce + nReach < runs[i].cb)
+            ++nPrevBegin;
+        for (int k = nPrevBegin; k < nPrevEnd && runs[k].cb - nReach <= runs[i].ce; ++k)
+            joinRuns(parent, i, k);
+    }
+
+    labels.resize(nRuns);
+    int nLabels = 0;
+    for (int i = 0; i < nRuns; ++i)
+    {
+        int root = findRoot(parent, i);
+        labels[i] = (root == i) ? nLabels++ : labels[root];
+    }
+    return nLabels;
+}
+
+CV_EXPORTS int connectedComponents(InputArray rlSrc, OutputArray labels, int connectivity)
+{
+    CV_INSTRUMENT_REGION();
+
+    rlVec runs;
+    Size size;
+    convertInputArrayToRuns(rlSrc, runs, size);
+
+    std::vector<int> runLabels;
+    int nLabels = labelRuns(runs, connectivity, runLabels);
+    if (labels.needed())
+        Mat(runLabels).copyTo(labels);
+    return nLabels;
+}
+
+CV_EXPORTS int connectedComponentsWithStats(InputArray rlSrc, OutputArray labels, OutputArray stats,
+    OutputArray centroids, int connectivity)
+{
+    CV_INSTRUMENT_REGION();
+
+    rlVec runs;
+    Size size;
+    convertInputArrayToRuns(rlSrc, runs, size);
+
+    std::vector<int> runLabels;
+    int nLabels = labelRuns(runs, connectivity, runLabels);
+
+    Mat statsMat(nLabels, CC_STAT_MAX, CV_32S), centroidsMat = Mat::zeros(nLabels, 2, CV_64F);
+    for (int l = 0; l < nLabels; ++l)
+    {
+        int* st = statsMat.ptr<int>(l);
+        st[CC_STAT_LEFT] = st[CC_STAT_TOP] = std::numeric_limits<int>::max();
+        st[CC_STAT_WIDTH] = st[CC_STAT_HEIGHT] = std::numeric_limits<int>::min(); // right and bottom for now
+        st[CC_STAT_AREA] = 0;
+    }
+
+    for (size_t i = 0; i < runs.size(); ++i)
+    {
+        const rlType& run = runs[i];
+        int* st = statsMat.ptr<int>(runLabels[i]);
+        double* c = centroidsMat.ptr<double>(runLabels[i]);
+        int nLength = run.ce - run.cb + 1;
+        st[CC_STAT_LEFT] = std::min(st[CC_STAT_LEFT], run.cb);
+        st[CC_STAT_TOP] = std::min(st[CC_STAT_TOP], run.r);
+        st[CC_STAT_WIDTH] = std::max(st[CC_STAT_WIDTH], run.ce);
+        st[CC_STAT_HEIGHT] = std::max(st[CC_STAT_HEIGHT], run.r);
+        st[CC_STAT_AREA] += nLength;
+        c[0] += 0.5 * ((double) run.cb + run.ce) * nLength;
+        c[1] += (double) run.r * nLength;
+    }
+
+    for (int l = 0; l < nLabels; ++l)
+    {
+        int* st = statsMat.ptr<int>(l);
+        double* c = centroidsMat.ptr<double>(l);
+        st[CC_STAT_WIDTH] -= st[CC_STAT_LEFT] - 1;
+        st[CC_STAT_HEIGHT] -= st[CC_STAT_TOP] - 1;
+        c[0] /= st[CC_STAT_AREA];
+        c[1] /= st[CC_STAT_AREA];
+    }
+
+    if (labels.needed())
+        Mat(runLabels).copyTo(labels);
+    if (stats.needed())
+        statsMat.copyTo(stats);
+    if (centroids.needed())
+        centroidsMat.copyTo(centroids);
+    return nLabels;
+}
+
+CV_EXPORTS void bitwise_and(InputArray rlSrc1, InputArray rlSrc2, OutputArray rlDest)
+{
+    rlVec runs1, runs2, runsDestination;
+    Size size1, size2;
+    convertInputArrayToRuns(rlSrc1, runs1, size1);
+    convertInputArrayToRuns(rlSrc2, runs2, size2);
+
+    rlVec merged1, merged2;
+    mergeNeighbouringChords(runs1, merged1);
+    mergeNeighbouringChords(runs2, merged2);
+
+    intersect(merged1, merged2, runsDestination);
+    convertToOutputArray(runsDestination, Size(std::max(size1.width, size2.width), std::max(size1.height, size2.height)), rlDest);
+}
+
+CV_EXPORTS void bitwise_or(InputArray rlSrc1, InputArray rlSrc2, OutputArray rlDest)
+{
+    rlVec runs1, runs2, runsDestination;
+    Size size1, size2;
+    convertInputArrayToRuns(rlSrc1, runs1, size1);
+    convertInputArrayToRuns(rlSrc2, runs2, size2);
+
+    union_regions(runs1, runs2, runsDestination);
+    convertToOutputArray(runsDestination, Size(std::max(size1.width, size2.width), std::max(size1.height, size2.height)), rlDest);
+}
+
+CV_EXPORTS void bitwise_xor(InputArray rlSrc1, InputArray rlSrc2, OutputArray rlDest)
+{
+    rlVec runs1, runs2, runsOnly1, runsOnly2, runsDestination;
+    Size size1, size2;
+    convertInputArrayToRuns(rlSrc1, runs1, size1);
+    convertInputArrayToRuns(rlSrc2, runs2, size2);
+
+    // merge touching chords first: subtract_rle expects separated chords in the subtracted region
+    rlVec merged1, merged2;
+    mergeNeighbouringChords(runs1, merged1);
+    mergeNeighbouringChords(runs2, merged2);
+
+    subtract_rle(merged1, merged2, runsOnly1);
+    subtract_rle(merged2, merged1, runsOnly2);
+    union_regions(runsOnly1, runsOnly2, runsDestination);
+    convertToOutputArray(runsDestination, Size(std::max(size1.width, size2.width), std::max(size1.height, size2.height)), rlDest);
+}
+
 }
 } //end of cv::ximgproc
 } //end of cv
@@ -61,6 +61,10 @@ using namespace std;
 
 #define MINIMUM_NR_SUBLABELS 1
 
+// tile sizes (in pixels / in blocks) of the parallel pixel and block updates
+#define SEEDS_PIXEL_TILE 64
+#define SEEDS_BLOCK_TILE 8
+
 
 // the type of the histogram and the T array
 typedef float HISTN;
@@ -83,45 +87,88 @@ public:
 
     virtual void iterate(InputArray img, int num_iterations = 4) CV_OVERRIDE;
 
+    virtual void setUseWarmStart(bool val) CV_OVERRIDE { use_warm_start = val; }
+    virtual bool getUseWarmStart() const CV_OVERRIDE { return use_warm_start; }
+
 
     virtual void getLabels(OutputArray labels_out) CV_OVERRIDE;
     virtual void getLabelContourMask(OutputArray image, bool thick_line = false) CV_OVERRIDE;
 
 private:
+    /* a pixel (level < 0) or a block moved from label_old to label_new on the top level */
+    struct SeedsChange
+    {
+        int level;
+        int index; // image_idx or sublabel
+        int label_old;
+        int label_new;
+    };
+
+    /* changes of the top level made by the tile being processed, on top of the shared
+     * state (see forEachTile) */
+    struct TopLevelDelta
+    {
+        Mat histogram; // [label * histogram_size_aligned + j]
+        vector<HISTN> T;
+        vector<int> nr_partitions;
+        vector<uchar> touched;
+        vector<int> touched_labels;
+        Mat histogramA, histogramB; // top level histograms with the changes (intersectConf)
+        vector<SeedsChange>* changes;
+    };
+
     /* initialization */
     void initialize(int num_superpixels, int num_levels);
     void initImage(InputArray img);
+    void initDeltas();
     void assignLabels();
     void computeHistograms(int until_level = -1);
+    void computeToplevelHistograms();
     template<typename _Tp>
     inline void initImageBins(const Mat& img, int max_value);
 
 
+    /* parallel processing */
+    template<typename Body>
+    void forEachTile(int size_w, int size_h, int tile_size, const Body& body);
+    inline void touch(TopLevelDelta& delta, int label);
+    inline int nrPartitions(const TopLevelDelta& delta, int label) const;
+    const HISTN* toplevelHistogram(TopLevelDelta& delta, int label, Mat& buf);
+    void resetDelta(TopLevelDelta& delta);
+    void applyChanges(const vector<SeedsChange>& changes);
+
     /* pixel operations */
     inline void update(int label_new, int image_idx, int label_old);
+    inline void update(TopLevelDelta& delta, int label_new, int image_idx, int label_old);
     //image_idx = y*width+x
     inline void addPixel(int level, int label, int image_idx);
     inline void deletePixel(int level, int label, int image_idx);
-    inline bool probability(int image_idx, int label1, int label2, int prior1, int prior2);
+    inline bool probability(TopLevelDelta& delta, int image_idx, int label1, int label2,
+            int prior1, int prior2);
     inline int threebyfour(int x, int y, int label);
     inline int fourbythree(int x, int y, int label);
 
     inline void updateLabels();
     // main loop for pixel updating
     void updatePixels();
+    void updatePixelsHorizontal(TopLevelDelta& delta, const Rect& tile);
+    void updatePixelsVertical(TopLevelDelta& delta, const Rect& tile);
 
 
     /* block operations */
     void addBlock(int level, int label, int sublevel, int sublabel);
     inline void addBlockToplevel(int label, int sublevel, int sublabel);
     void deleteBlockToplevel(int label, int sublevel, int sublabel);
+    void moveBlock(TopLevelDelta& delta, int sublevel, int sublabel, int label_old, int label_new);
 
-    // intersection on label1A and intersection_delete on label1B
+    // intersection on label1A and intersection_delete on label1B (on the top level)
     // returns intA - intB
-    float intersectConf(int level1, int label1A, int label1B, int level2, int label2);
+    float intersectConf(TopLevelDelta& delta, int label1A, int label1B, int level2, int label2);
 
     //main loop for block updates
     void updateBlocks(int level, float req_confidence = 0.0f);
+    void updateBlocksHorizontal(TopLevelDelta& delta, int level, float req_confidence, const Rect& tile);
+    void updateBlocksVertical(TopLevelDelta& delta, int level, float req_confidence, const Rect& tile);
 
     /* go to next block level */
     int goDownOneLevel();
@@ -154,6 +201,9 @@ private:
     bool seeds_double_step;
     int seeds_prior;
 
+    bool use_warm_start;
+    bool has_labels; // labels hold the result of a previous call
+
     // keep one labeling for each level
     vector<int> nr_wh; // [2*level]/[2*level+1] number of labels in x-direction/y-direction
 
@@ -182,6 +232,10 @@ private:
     vector<Mat> T_mat;
     vector<Mat> parent_mat;
     vector<Mat> parent_pre_init_mat;
+
+    /* one delta for each chunk of tiles processed in parallel */
+    vector<TopLevelDelta> deltas;
+    vector<vector<SeedsChange> > tile_changes; //[tile] changes of the tiles of one color
 };
 
 CV_EXPORTS Ptr<SuperpixelSEEDS> createSuperpixelSEEDS(int image_width, int image_height,
@@ -201,6 +255,8 @@ SuperpixelSEEDSImpl::SuperpixelSEEDSImpl(int image_width, int image_height, int
     nr_channels = image_channels;
     seeds_double_step = double_step;
     seeds_prior = std::min(prior, 5);
+    use_warm_start = false;
+    has_labels = false;
 
     histogram_size = nr_bins;
     for (int i = 1; i < nr_channels; ++i)
@@ -219,17 +275,32 @@ SuperpixelSEEDSImpl::~SuperpixelSEEDSImpl()
 void SuperpixelSEEDSImpl::iterate(InputArray img, int num_iterations)
 {
     initImage(img);
+    initDeltas();
+    forwardbackward = true;
 
-    // block updates
-    while (seeds_current_level >= 0)
+    if( use_warm_start && has_labels )
+    {
+        // continue from the labels of the previous frame
+        computeToplevelHistograms();
+    }
+    else
     {
-        if( seeds_double_step )
-            updateBlocks(seeds_current_level, REQ_CONF);
+        seeds_current_level = seeds_nr_levels - 2;
+        assignLabels();
+        computeHistograms();
 
-        updateBlocks(seeds_current_level);
-        seeds_current_level = goDownOneLevel();
+        // block updates
+        while (seeds_current_level >= 0)
+        {
+            if( seeds_double_step )
+                updateBlocks(seeds_current_level, REQ_CONF);
+
+            updateBlocks(seeds_current_level);
+            seeds_current_level = goDownOneLevel();
+        }
+        updateLabels();
+        has_labels = true;
     }
-    updateLabels();
 
     for (int i = 0; i < num_iterations; ++i)
         updatePixels();
@@ -401,10 +472,6 @@ void SuperpixelSEEDSImpl::initImage(InputArray img)
       CV_Error( Error::StsInternal, "Invalid InputArray." );
 
     int depth = src.depth();
-    seeds_current_level = seeds_nr_levels - 2;
-    forwardbackward = true;
-
-    assignLabels();
 
     CV_Assert(src.size().width == width && src.size().height == height);
     CV_Assert(depth == CV_8U || depth == CV_16U || depth == CV_32F);
@@ -423,8 +490,29 @@ void SuperpixelSEEDSImpl::initImage(InputArray img)
         initImageBins<float>(src, 1);
         break;
     }
+}
+
+void SuperpixelSEEDSImpl::initDeltas()
+{
+    int nr_chunks = std::max(getNumThreads(), 1);
+    int nr_labels = nrLabels(seeds_top_level);
+    if( (int)deltas.size() == nr_chunks )
+        return;
 
-    computeHistograms();
+    deltas.resize(nr_chunks);
+    for (int i = 0; i < nr_chunks; ++i)
+    {
+        TopLevelDelta& delta = deltas[i];
+        if( !delta.histogram.empty() )
+            continue;
+        delta.histogram = Mat::zeros(1, nr_labels * histogram_size_aligned, CV_32FC1);
+        delta.T.assign(nr_labels, 0);
+        delta.nr_partitions.assign(nr_labels, 0);
+        delta.touched.assign(nr_labels, 0);
+        delta.histogramA.create(1, histogram_size_aligned, CV_32FC1);
+        delta.histogramB.create(1, histogram_size_aligned, CV_32FC1);
+        delta.changes = NULL;
+    }
 }
 
 // adds labeling to all the blocks at all levels and sets the correct parents
@@ -471,18 +559,161 @@ void SuperpixelSEEDSImpl::computeHistograms(int until_level)
     }
 }
 
+void SuperpixelSEEDSImpl::computeToplevelHistograms()
+{
+    memset(histogram[seeds_top_level], 0,
+            sizeof(HISTN) * histogram_size_aligned * nrLabels(seeds_top_level));
+    memset(T[seeds_top_level], 0, sizeof(HISTN) * nrLabels(seeds_top_level));
+
+    for (int i = 0; i < width * height; ++i)
+        addPixel(seeds_top_level, labels[i], i);
+}
+
+/* Block and pixel updates are done in tiles colored like a 2x2 checkerboard. The tiles of
+ * one color are a whole tile apart, so they never touch each others' labels and are processed
+ * in parallel. Each tile sees the top level as it was at the start of its color plus its own
+ * changes; the changes of all tiles are applied when the color is done. The result does not
+ * depend on the number of threads. */
+template<typename Body>
+void SuperpixelSEEDSImpl::forEachTile(int size_w, int size_h, int tile_size, const Body& body)
+{
+    const int tiles_w = (size_w + tile_size - 1) / tile_size;
+    const int tiles_h = (size_h + tile_size - 1) / tile_size;
+
+    for (int color = 0; color < 4; ++color)
+    {
+        const int color_x = color & 1;
+        const int color_y = color >> 1;
+        const int nr_tiles_w = (tiles_w - color_x + 1) / 2;
+        const int nr_tiles_h = (tiles_h - color_y + 1) / 2;
+        const int nr_tiles = nr_tiles_w * nr_tiles_h;
+        if( nr_tiles <= 0 )
+            continue;
+
+        if( (int)tile_changes.size() < nr_tiles )
+            tile_changes.resize(nr_tiles);
+        const int nr_chunks = std::min(nr_tiles, (int)deltas.size());
+
+        parallel_for_(Range(0, nr_chunks), [&](const Range& range)
+        {
+            for (int c = range.start; c < range.end; ++c)
+            {
+                TopLevelDelta& delta = deltas[c];
+                const int tile_begin = nr_tiles * c / nr_chunks;
+                const int tile_end = nr_tiles * (c + 1) / nr_chunks;
+                for (int t = tile_begin; t < tile_end; ++t)
+                {
+                    const int tx = 2 * (t % nr_tiles_w) + color_x;
+                    const int ty = 2 * (t / nr_tiles_w) + color_y;
+                    const Rect tile(tx * tile_size, ty * tile_size,
+                            std::min(tile_size, size_w - tx * tile_size),
+                            std::min(tile_size, size_h - ty * tile_size));
+                    tile_changes[t].clear();
+                    delta.changes = &tile_changes[t];
+                    body(delta, tile);
+                    resetDelta(delta);
+                }
+            }
+        }, nr_chunks);
+
+        for (int t = 0; t < nr_tiles; ++t)
+            applyChanges(tile_changes[t]);
+    }
+}
+
+void SuperpixelSEEDSImpl::touch(TopLevelDelta& delta, int label)
+{
+    if( !delta.touched[label] )
+    {
+        delta.touched[label] = 1;
+        delta.touched_labels.push_back(label);
+    }
+}
+
+int SuperpixelSEEDSImpl::nrPartitions(const TopLevelDelta& delta, int label) const
+{
+    return (int)nr_partitions[label] + delta.nr_partitions[label];
+}
+
+// returns the top level histogram of label, including the changes of the current tile
+const HISTN* SuperpixelSEEDSImpl::toplevelHistogram(TopLevelDelta& delta, int label, Mat& buf)
+{
+    const HISTN* h_label = &histogram[seeds_top_level][label * histogram_size_aligned];
+    if( !delta.touched[label] )
+        return h_label;
+
+    const HISTN* h_delta = delta.histogram.ptr<HISTN>() + label * histogram_size_aligned;
+    HISTN* h_res = buf.ptr<HISTN>();
+    for (int n = 0; n < histogram_size; n++)
+        h_res[n] = h_label[n] + h_delta[n];
+    return h_res;
+}
+
+void SuperpixelSEEDSImpl::resetDelta(TopLevelDelta& delta)
+{
+    HISTN* h_delta = delta.histogram.ptr<HISTN>();
+    for (size_t i = 0; i < delta.touched_labels.size(); ++i)
+    {
+        int label = delta.touched_labels[i];
+        memset(h_delta + label * histogram_size_aligned, 0, sizeof(HISTN) * histogram_size);
+        delta.T[label] = 0;
+        delta.nr_partitions[label] = 0;
+        delta.touched[label] = 0;
+    }
+    delta.touched_labels.clear();
+    delta.changes = NULL;
+}
+
+void SuperpixelSEEDSImpl::applyChanges(const vector<SeedsChange>& changes)
+{
+    // the histograms hold pixel counts: the changes can be applied in any order
+    for (size_t i = 0; i < changes.size(); ++i)
+    {
+        const SeedsChange& c = changes[i];
+        if( c.level < 0 )
+        {
+            deletePixel(seeds_top_level, c.label_old, c.index);
+            addPixel(seeds_top_level, c.label_new, c.index);
+        }
+        else
+        {
+            deleteBlockToplevel(c.label_old, c.level, c.index);
+            addBlockToplevel(c.label_new, c.level, c.index);
+        }
+    }
+}
+
 void SuperpixelSEEDSImpl::updateBlocks(int level, float req_confidence)
+{
+    // horizontal bidirectional block updating
+    forEachTile(nr_wh[2 * level], nr_wh[2 * level + 1], SEEDS_BLOCK_TILE,
+            [&](TopLevelDelta& delta, const Rect& tile)
+            {
+                updateBlocksHorizontal(delta, level, req_confidence, tile);
+            });
+
+    // vertical bidirectional
+    forEachTile(nr_wh[2 * level], nr_wh[2 * level + 1], SEEDS_BLOCK_TILE,
+            [&](TopLevelDelta& delta, const Rect& tile)
+            {
+                updateBlocksVertical(delta, level, req_confidence, tile);
+            });
+}
+
+void SuperpixelSEEDSImpl::updateBlocksHorizontal(TopLevelDelta& delta, int level,
+        float req_confidence, const Rect& tile)
 {
     int labelA;
     int labelB;
     int sublabel;
     bool done;
     int step = nr_wh[2 * level];
+    const int y_end = std::min(tile.y + tile.height, nr_wh[2 * level + 1] - 1);
+    const int x_end = std::min(tile.x + tile.width, nr_wh[2 * level] - 2);
 
-    // horizontal bidirectional block updating
-    for (int y = 1; y < nr_wh[2 * level + 1] - 1; y++)
+    for (int y = std::max(tile.y, 1); y < y_end; y++)
     {
-        for (int x = 1; x < nr_wh[2 * level] - 2; x++)
+        for (int x = std::max(tile.x, 1); x < x_end; x++)
         {
             // choose a label at the current level
             sublabel = y * step + x;
@@ -503,20 +734,19 @@ void SuperpixelSEEDSImpl::updateBlocks(int level, float req_confidence)
             int a32 = parent[level][(y + 1) * step + (x)];
             done = false;
 
-            if( nr_partitions[labelA] == 2 || (nr_partitions[labelA] > 2 // 3 or more partitions
+            if( nrPartitions(delta, labelA) == 2 || (nrPartitions(delta, labelA) > 2 // 3 or more partitions
                     && checkSplit_hf(a11, a12, a21, a22, a31, a32)) )
             {
                 // run algorithm as usual
-                float conf = intersectConf(seeds_top_level, labelB, labelA, level, sublabel);
+                float conf = intersectConf(delta, labelB, labelA, level, sublabel);
                 if( conf > req_confidence )
                 {
-                    deleteBlockToplevel(labelA, level, sublabel);
-                    addBlockToplevel(labelB, level, sublabel);
+                    moveBlock(delta, level, sublabel, labelA, labelB);
                     done = true;
                 }
             }
 
-            if( !done && (nr_partitions[labelB] > MINIMUM_NR_SUBLABELS) )
+            if( !done && (nrPartitions(delta, labelB) > MINIMUM_NR_SUBLABELS) )
             {
                 // try opposite direction
                 sublabel = y * step + x + 1;
@@ -526,26 +756,36 @@ void SuperpixelSEEDSImpl::updateBlocks(int level, float req_confidence)
                 int a24 = parent[level][(y) * step + (x + 2)];
                 int a33 = parent[level][(y + 1) * step + (x + 1)];
                 int a34 = parent[level][(y + 1) * step + (x + 2)];
-                if( nr_partitions[labelB] <= 2 // == 2
-                        || (nr_partitions[labelB] > 2 && checkSplit_hb(a13, a14, a23, a24, a33, a34)) )
+                if( nrPartitions(delta, labelB) <= 2 // == 2
+                        || (nrPartitions(delta, labelB) > 2 && checkSplit_hb(a13, a14, a23, a24, a33, a34)) )
                 {
                     // run algorithm as usual
-                    float conf = intersectConf(seeds_top_level, labelA, labelB, level, sublabel);
+                    float conf = intersectConf(delta, labelA, labelB, level, sublabel);
                     if( conf > req_confidence )
                     {
-                        deleteBlockToplevel(labelB, level, sublabel);
-                        addBlockToplevel(labelA, level, sublabel);
+                        moveBlock(delta, level, sublabel, labelB, labelA);
                         x++;
                     }
                 }
             }
         }
     }
+}
 
-    // vertical bidirectional
-    for (int x = 1; x < nr_wh[2 * level] - 1; x++)
+void SuperpixelSEEDSImpl::updateBlocksVertical(TopLevelDelta& delta, int level,
+        float req_confidence, const Rect& tile)
+{
+    int labelA;
+    int labelB;
+    int sublabel;
+    bool done;
+    int step = nr_wh[2 * level];
+    const int x_end = std::min(tile.x + tile.width, nr_wh[2 * level] - 1);
+    const int y_end = std::min(tile.y + tile.height, nr_wh[2 * level + 1] - 2);
+
+    for (int x = std::max(tile.x, 1); x < x_end; x++)
     {
-        for (int y = 1; y < nr_wh[2 * level + 1] - 2; y++)
+        for (int y = std::max(tile.y, 1); y < y_end; y++)
         {
             // choose a label at the current level
             sublabel = y * step + x;
@@ -565,20 +805,19 @@ void SuperpixelSEEDSImpl::updateBlocks(int level, float req_confidence)
             int a23 = parent[level][(y) * step + (x + 1)];
 
             done = false;
-            if( nr_partitions[labelA] == 2 || (nr_partitions[labelA] > 2 // 3 or more partitions
+            if( nrPartitions(delta, labelA) == 2 || (nrPartitions(delta, labelA) > 2 // 3 or more partitions
                     && checkSplit_vf(a11, a12, a13, a21, a22, a23)) )
             {
                 // run algorithm as usual
-                float conf = intersectConf(seeds_top_level, labelB, labelA, level, sublabel);
+                float conf = intersectConf(delta, labelB, labelA, level, sublabel);
                 if( conf > req_confidence )
                 {
-                    deleteBlockToplevel(labelA, level, sublabel);
-                    addBlockToplevel(labelB, level, sublabel);
+                    moveBlock(delta, level, sublabel, labelA, labelB);
                     done = true;
                 }
             }
 
-            if( !done && (nr_partitions[labelB] > MINIMUM_NR_SUBLABELS) )
+            if( !done && (nrPartitions(delta, labelB) > MINIMUM_NR_SUBLABELS) )
             {
                 // try opposite direction
                 sublabel = (y + 1) * step + x;
@@ -588,15 +827,14 @@ void SuperpixelSEEDSImpl::updateBlocks(int level, float req_confidence)
                 int a41 = parent[level][(y + 2) * step + (x - 1)];
                 int a42 = parent[level][(y + 2) * step + (x)];
                 int a43 = parent[level][(y + 2) * step + (x + 1)];
-                if( nr_partitions[labelB] <= 2 // == 2
-                        || (nr_partitions[labelB] > 2 && checkSplit_vb(a31, a32, a33, a41, a42, a43)) )
+                if( nrPartitions(delta, labelB) <= 2 // == 2
+                        || (nrPartitions(delta, labelB) > 2 && checkSplit_vb(a31, a32, a33, a41, a42, a43)) )
                 {
                     // run algorithm as usual
-                    float conf = intersectConf(seeds_top_level, labelA, labelB, level, sublabel);
+                    float conf = intersectConf(delta, labelA, labelB, level, sublabel);
                     if( conf > req_confidence )
                     {
-                        deleteBlockToplevel(labelB, level, sublabel);
-                        addBlockToplevel(labelA, level, sublabel);
+                        moveBlock(delta, level, sublabel, labelB, labelA);
                         y++;
                     }
                 }
@@ -636,15 +874,58 @@ int SuperpixelSEEDSImpl::goDownOneLevel()
 }
 
 void SuperpixelSEEDSImpl::updatePixels()
+{
+    forEachTile(width, height, SEEDS_PIXEL_TILE,
+            [&](TopLevelDelta& delta, const Rect& tile)
+            {
+                updatePixelsHorizontal(delta, tile);
+            });
+    forEachTile(width, height, SEEDS_PIXEL_TILE,
+            [&](TopLevelDelta& delta, const Rect& tile)
+            {
+                updatePixelsVertical(delta, tile);
+            });
+    forwardbackward = !forwardbackward;
+
+    // update border pixels
+    int labelA;
+    int labelB;
+    for (int x = 0; x < width; x++)
+    {
+        labelA = labels[x];
+        labelB = labels[width + x];
+        if( labelA != labelB )
+            update(labelB, x, labelA);
+        labelA = labels[(height - 1) * width + x];
+        labelB = labels[(height - 2) * width + x];
+        if( labelA != labelB )
+            update(labelB, (height - 1) * width + x, labelA);
+    }
+    for (int y = 0; y < height; y++)
+    {
+        labelA = labels[y * width];
+        labelB = labels[y * width + 1];
+        if( labelA != labelB )
+            update(labelB, y * width, labelA);
+        labelA = labels[y * width + width - 1];
+        labelB = labels[y * width + width - 2];
+        if( labelA != labelB )
+            update(labelB, y * width + width - 1, labelA);
+    }
+}
+
+void SuperpixelSEEDSImpl::updatePixelsHorizontal(TopLevelDelta& delta, const Rect& tile)
 {
     int labelA;
     int labelB;
     int priorA = 0;
     int priorB = 0;
+    const int y_end = std::min(tile.y + tile.height, height - 1);
+    const int x_end = std::min(tile.x + tile.width, width - 2);
 
-    for (int y = 1; y < height - 1; y++)
+    for (int y = std::max(tile.y, 1); y < y_end; y++)
     {
-        for (int x = 1; x < width - 2; x++)
+        for (int x = std::max(tile.x, 1); x < x_end; x++)
         {
 
             labelA = labels[(y) * width + (x)];
@@ -670,9 +951,9 @@ void SuperpixelSEEDSImpl::updatePixels()
                             priorB = threebyfour(x, y, labelB);
                         }
 
-                        if( probability(y * width + x, labelA, labelB, priorA, priorB) )
+                        if( probability(delta, y * width + x, labelA, labelB, priorA, priorB) )
                         {
-                            update(labelB, y * width + x, labelA);
+                            update(delta, labelB, y * width + x, labelA);
                         }
                         else
                         {
@@ -683,9 +964,9 @@ void SuperpixelSEEDSImpl::updatePixels()
                             int a34 = labels[(y + 1) * width + (x + 2)];
                             if( checkSplit_hb(a13, a14, a23, a24, a33, a34) )
                             {
-                                if( probability(y * width + x + 1, labelB, labelA, priorB, priorA) )
+                                if( probability(delta, y * width + x + 1, labelB, labelA, priorB, priorA) )
                                 {
-                                    update(labelA, y * width + x + 1, labelB);
+                                    update(delta, labelA, y * width + x + 1, labelB);
                                     x++;
                                 }
                             }
@@ -708,9 +989,9 @@ void SuperpixelSEEDSImpl::updatePixels()
                             priorB = threebyfour(x, y, labelB);
                         }
 
-                        if( probability(y * width + x + 1, labelB, labelA, priorB, priorA) )
+                        if( probability(delta, y * width + x + 1, labelB, labelA, priorB, priorA) )
                         {
-                            update(labelA, y * width + x + 1, labelB);
+                            update(delta, labelA, y * width + x + 1, labelB);
                             x++;
                         }
                         else
@@ -722,9 +1003,9 @@ void SuperpixelSEEDSImpl::updatePixels()
                             int a32 = labels[(y + 1) * width + (x)];
                             if( checkSplit_hf(a11, a12, a21, a22, a31, a32) )
                             {
-                                if( probability(y * width + x, labelA, labelB, priorA, priorB) )
+                                if( probability(delta, y * width + x, labelA, labelB, priorA, priorB) )
                                 {
-                                    update(labelB, y * width + x, labelA);
+                                    update(delta, labelB, y * width + x, labelA);
                                 }
                             }
                         }
@@ -733,10 +1014,20 @@ void SuperpixelSEEDSImpl::updatePixels()
             } // labelA != labelB
         } // for x
     } // for y
+}
+
+void SuperpixelSEEDSImpl::updatePixelsVertical(TopLevelDelta& delta, const Rect& tile)
+{
+    int labelA;
+    int labelB;
+    int priorA = 0;
+    int priorB = 0;
+    const int x_end = std::min(tile.x + tile.width, width - 1);
+    const int y_end = std::min(tile.y + tile.height, height - 2);
 
-    for (int x = 1; x < width - 1; x++)
+    for (int x = std::max(tile.x, 1); x < x_end; x++)
     {
-        for (int y = 1; y < height - 2; y++)
+        for (int y = std::max(tile.y, 1); y < y_end; y++)
         {
 
             labelA = labels[(y) * width + (x)];
@@ -762,9 +1053,9 @@ void SuperpixelSEEDSImpl::updatePixels()
                             priorB = fourbythree(x, y, labelB);
                         }
 
-                        if( probability(y * width + x, labelA, labelB, priorA, priorB) )
+                        if( probability(delta, y * width + x, labelA, labelB, priorA, priorB) )
                         {
-                            update(labelB, y * width + x, labelA);
+                            update(delta, labelB, y * width + x, labelA);
                         }
                         else
                         {
@@ -775,9 +1066,9 @@ void SuperpixelSEEDSImpl::updatePixels()
                             int a43 = labels[(y + 2) * width + (x + 1)];
                             if( checkSplit_vb(a31, a32, a33, a41, a42, a43) )
                             {
-                                if( probability((y + 1) * width + x, labelB, labelA, priorB, priorA) )
+                                if( probability(delta, (y + 1) * width + x, labelB, labelA, priorB, priorA) )
                                 {
-                                    update(labelA, (y + 1) * width + x, labelB);
+                                    update(delta, labelA, (y + 1) * width + x, labelB);
                                     y++;
                                 }
                             }
@@ -800,9 +1091,9 @@ void SuperpixelSEEDSImpl::updatePixels()
                             priorB = fourbythree(x, y, labelB);
                         }
 
-                        if( probability((y + 1) * width + x, labelB, labelA, priorB, priorA) )
+                        if( probability(delta, (y + 1) * width + x, labelB, labelA, priorB, priorA) )
                         {
-                            update(labelA, (y + 1) * width + x, labelB);
+                            update(delta, labelA, (y + 1) * width + x, labelB);
                             y++;
                         }
                         else
@@ -814,9 +1105,9 @@ void SuperpixelSEEDSImpl::updatePixels()
                             int a23 = labels[(y) * width + (x + 1)];
                             if( checkSplit_vf(a11, a12, a13, a21, a22, a23) )
                             {
-                                if( probability(y * width + x, labelA, labelB, priorA, priorB) )
+                                if( probability(delta, y * width + x, labelA, labelB, priorA, priorB) )
                                 {
-                                    update(labelB, y * width + x, labelA);
+                                    update(delta, labelB, y * width + x, labelA);
                                 }
                             }
                         }
@@ -825,31 +1116,6 @@ void SuperpixelSEEDSImpl::updatePixels()
             } // labelA != labelB
         } // for y
     } // for x
-    forwardbackward = !forwardbackward;
-
-    // update border pixels
-    for (int x = 0; x < width; x++)
-    {
-        labelA = labels[x];
-        labelB = labels[width + x];
-        if( labelA != labelB )
-            update(labelB, x, labelA);
-        labelA = labels[(height - 1) * width + x];
-        labelB = labels[(height - 2) * width + x];
-        if( labelA != labelB )
-            update(labelB, (height - 1) * width + x, labelA);
-    }
-    for (int y = 0; y < height; y++)
-    {
-        labelA = labels[y * width];
-        labelB = labels[y * width + 1];
-        if( labelA != labelB )
-            update(labelB, y * width, labelA);
-        labelA = labels[y * width + width - 1];
-        labelB = labels[y * width + width - 2];
-        if( labelA != labelB )
-            update(labelB, y * width + width - 1, labelA);
-    }
 }
 
 void SuperpixelSEEDSImpl::update(int label_new, int image_idx, int label_old)
@@ -860,6 +1126,22 @@ void SuperpixelSEEDSImpl::update(int label_new, int image_idx, int label_old)
     labels[image_idx] = label_new;
 }
 
+void SuperpixelSEEDSImpl::update(TopLevelDelta& delta, int label_new, int image_idx, int label_old)
+{
+    //change the label of a single pixel, the histograms are changed in the delta
+    HISTN* h_delta = delta.histogram.ptr<HISTN>();
+    touch(delta, label_old);
+    touch(delta, label_new);
+    h_delta[label_old * histogram_size_aligned + image_bins[image_idx]]--;
+    h_delta[label_new * histogram_size_aligned + image_bins[image_idx]]++;
+    delta.T[label_old]--;
+    delta.T[label_new]++;
+    labels[image_idx] = label_new;
+
+    SeedsChange change = { -1, image_idx, label_old, label_new };
+    delta.changes->push_back(change);
+}
+
 void SuperpixelSEEDSImpl::addPixel(int level, int label, int image_idx)
 {
     histogram[level][label * histogram_size_aligned + image_bins[image_idx]]++;
@@ -935,20 +1217,48 @@ void SuperpixelSEEDSImpl::deleteBlockToplevel(int label, int sublevel, int subla
     nr_partitions[label]--;
 }
 
+void SuperpixelSEEDSImpl::moveBlock(TopLevelDelta& delta, int sublevel, int sublabel,
+        int label_old, int label_new)
+{
+    //move a block to another label, the histograms are changed in the delta
+    parent[sublevel][sublabel] = label_new;
+
+    HISTN* h_old = delta.histogram.ptr<HISTN>() + label_old * histogram_size_aligned;
+    HISTN* h_new = delta.histogram.ptr<HISTN>() + label_new * histogram_size_aligned;
+    const HISTN* h_sublabel = &histogram[sublevel][sublabel * histogram_size_aligned];
+    touch(delta, label_old);
+    touch(delta, label_new);
+    for (int n = 0; n < histogram_size; n++)
+    {
+        h_old[n] -= h_sublabel[n];
+        h_new[n] += h_sublabel[n];
+    }
+    delta.T[label_old] -= T[sublevel][sublabel];
+    delta.T[label_new] += T[sublevel][sublabel];
+    delta.nr_partitions[label_old]--;
+    delta.nr_partitions[label_new]++;
+
+    SeedsChange change = { sublevel, sublabel, label_old, label_new };
+    delta.changes->push_back(change);
+}
+
 void SuperpixelSEEDSImpl::updateLabels()
 {
     for (int i = 0; i < width * height; ++i)
         labels[i] = parent[0][labels_bottom[i]];
 }
 
-bool SuperpixelSEEDSImpl::probability(int image_idx, int label1, int label2,
+bool SuperpixelSEEDSImpl::probability(TopLevelDelta& delta, int image_idx, int label1, int label2,
         int prior1, int prior2)
 {
     unsigned int color = image_bins[image_idx];
-    float P_label1 = histogram[seeds_top_level][label1 * histogram_size_aligned + color]
-                                                * T[seeds_top_level][label2];
-    float P_label2 = histogram[seeds_top_level][label2 * histogram_size_aligned + color]
-                                                * T[seeds_top_level][label1];
+    const HISTN* h_delta = delta.histogram.ptr<HISTN>();
+    const float T1 = T[seeds_top_level][label1] + delta.T[label1];
+    const float T2 = T[seeds_top_level][label2] + delta.T[label2];
+    float P_label1 = (histogram[seeds_top_level][label1 * histogram_size_aligned + color]
+            + h_delta[label1 * histogram_size_aligned + color]) * T2;
+    float P_label2 = (histogram[seeds_top_level][label2 * histogram_size_aligned + color]
+            + h_delta[label2 * histogram_size_aligned + color]) * T1;
 
     if( seeds_prior )
     {
@@ -967,8 +1277,8 @@ bool SuperpixelSEEDSImpl::probability(int image_idx, int label1, int label2,
             /* fallthrough */
         case 2:
             p *= p;
-            P_label1 *= T[seeds_top_level][label2];
-            P_label2 *= T[seeds_top_level][label1];
+            P_label1 *= T2;
+            P_label2 *= T1;
             /* fallthrough */
         case 1:
             P_label1 *= p;
@@ -1086,16 +1396,16 @@ int SuperpixelSEEDSImpl::fourbythree(int x, int y, int label)
 #endif
 }
 
-float SuperpixelSEEDSImpl::intersectConf(int level1, int label1A, int label1B,
+float SuperpixelSEEDSImpl::intersectConf(TopLevelDelta& delta, int label1A, int label1B,
         int level2, int label2)
 {
     float sumA = 0, sumB = 0;
-    float* h1A = &histogram[level1][label1A * histogram_size_aligned];
-    float* h1B = &histogram[level1][label1B * histogram_size_aligned];
-    float* h2 = &histogram[level2][label2 * histogram_size_aligned];
-    const float count1A = T[level1][label1A];
+    const float* h1A = toplevelHistogram(delta, label1A, delta.histogramA);
+    const float* h1B = toplevelHistogram(delta, label1B, delta.histogramB);
+    const float* h2 = &histogram[level2][label2 * histogram_size_aligned];
+    const float count1A = T[seeds_top_level][label1A] + delta.T[label1A];
     const float count2 = T[level2][label2];
-    const float count1B = T[level1][label1B] - count2;
+    const float count1B = T[seeds_top_level][label1B] + delta.T[label1B] - count2;
 
     /* this calculates several things:
      * - normalized intersection of a histogram. which is equal to:
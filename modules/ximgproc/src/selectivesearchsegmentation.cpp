@@ -42,6 +42,7 @@ the use of this software, even if advised of the possibility of such damage.
 #include "opencv2/ximgproc/segmentation.hpp"
 
 #include <iostream>
+#include <climits>
 
 namespace cv {
     namespace ximgproc {
@@ -98,24 +99,20 @@ namespace cv {
                 }
             };
 
-            // Represent a neighboor
-            class Neighbour {
+            // Implemented by the strategies of this file
+            class SelectiveSearchSegmentationStrategyCloneable {
                 public:
-                    int from;
-                    int to;
-                    float similarity;
-                    friend std::ostream& operator<<(std::ostream& os, const Neighbour& n);
+                    virtual ~SelectiveSearchSegmentationStrategyCloneable() {}
 
-                    bool operator <(const Neighbour& n) const {
-                        return similarity < n.similarity;
-                    }
+                    // Return a new strategy with the same parameters, or an empty Ptr if it can't be duplicated
+                    virtual Ptr<SelectiveSearchSegmentationStrategy> cloneStrategy() const = 0;
             };
 
             /****************************************
              * Stragegy / Color
              ***************************************/
 
-            class SelectiveSearchSegmentationStrategyColorImpl CV_FINAL : public SelectiveSearchSegmentationStrategyColor {
+            class SelectiveSearchSegmentationStrategyColorImpl CV_FINAL : public SelectiveSearchSegmentationStrategyColor, public SelectiveSearchSegmentationStrategyCloneable {
                 public:
                     SelectiveSearchSegmentationStrategyColorImpl() {
                         name_ = "SelectiveSearchSegmentationStrategyColor";
@@ -126,6 +123,10 @@ namespace cv {
                     virtual float get(int r1, int r2) CV_OVERRIDE;
                     virtual void merge(int r1, int r2) CV_OVERRIDE;
 
+                    virtual Ptr<SelectiveSearchSegmentationStrategy> cloneStrategy() const CV_OVERRIDE {
+                        return makePtr<SelectiveSearchSegmentationStrategyColorImpl>();
+                    }
+
                 private:
                     String name_;
 
@@ -244,7 +245,7 @@ namespace cv {
              * Stragegy / Multiple
              ***************************************/
 
-            class SelectiveSearchSegmentationStrategyMultipleImpl CV_FINAL : public SelectiveSearchSegmentationStrategyMultiple {
+            class SelectiveSearchSegmentationStrategyMultipleImpl CV_FINAL : public SelectiveSearchSegmentationStrategyMultiple, public SelectiveSearchSegmentationStrategyCloneable {
                 public:
                     SelectiveSearchSegmentationStrategyMultipleImpl() {
                         name_ = "SelectiveSearchSegmentationStrategyMultiple";
@@ -258,6 +259,8 @@ namespace cv {
                     virtual void addStrategy(Ptr<SelectiveSearchSegmentationStrategy> g, float weight) CV_OVERRIDE;
                     virtual void clearStrategies() CV_OVERRIDE;
 
+                    virtual Ptr<SelectiveSearchSegmentationStrategy> cloneStrategy() const CV_OVERRIDE;
+
                 private:
                     String name_;
                     std::vector<Ptr<SelectiveSearchSegmentationStrategy> > strategies;
@@ -277,6 +280,22 @@ namespace cv {
                 weights_total = 0;
             }
 
+            Ptr<SelectiveSearchSegmentationStrategy> SelectiveSearchSegmentationStrategyMultipleImpl::cloneStrategy() const {
+                Ptr<SelectiveSearchSegmentationStrategyMultipleImpl> m = makePtr<SelectiveSearchSegmentationStrategyMultipleImpl>();
+
+                for (unsigned int i = 0; i < strategies.size(); i++) {
+                    const SelectiveSearchSegmentationStrategyCloneable* c = dynamic_cast<const SelectiveSearchSegmentationStrategyCloneable*>(strategies[i].get());
+                    Ptr<SelectiveSearchSegmentationStrategy> s = c ? c->cloneStrategy() : Ptr<SelectiveSearchSegmentationStrategy>();
+
+                    if (!s) {
+                        return Ptr<SelectiveSearchSegmentationStrategy>();
+                    }
+                    m->addStrategy(s, weights[i]);
+                }
+
+                return m;
+            }
+
             void SelectiveSearchSegmentationStrategyMultipleImpl::setImage(InputArray img_, InputArray regions_, InputArray sizes_, int image_id) {
                 for (unsigned int i = 0; i < strategies.size(); i++) {
                     strategies[i]->setImage(img_, regions_, sizes_, image_id);
@@ -348,7 +367,7 @@ namespace cv {
              * Stragegy / Size
              ***************************************/
 
-            class SelectiveSearchSegmentationStrategySizeImpl CV_FINAL : public SelectiveSearchSegmentationStrategySize {
+            class SelectiveSearchSegmentationStrategySizeImpl CV_FINAL : public SelectiveSearchSegmentationStrategySize, public SelectiveSearchSegmentationStrategyCloneable {
                 public:
                     SelectiveSearchSegmentationStrategySizeImpl() {
                         name_ = "SelectiveSearchSegmentationStrategySize";
@@ -358,6 +377,10 @@ namespace cv {
                     virtual float get(int r1, int r2) CV_OVERRIDE;
                     virtual void merge(int r1, int r2) CV_OVERRIDE;
 
+                    virtual Ptr<SelectiveSearchSegmentationStrategy> cloneStrategy() const CV_OVERRIDE {
+                        return makePtr<SelectiveSearchSegmentationStrategySizeImpl>();
+                    }
+
                 private:
                     String name_;
 
@@ -395,7 +418,7 @@ namespace cv {
              * Stragegy / Fill
              ***************************************/
 
-            class SelectiveSearchSegmentationStrategyFillImpl CV_FINAL : public SelectiveSearchSegmentationStrategyFill {
+            class SelectiveSearchSegmentationStrategyFillImpl CV_FINAL : public SelectiveSearchSegmentationStrategyFill, public SelectiveSearchSegmentationStrategyCloneable {
                 public:
                     SelectiveSearchSegmentationStrategyFillImpl() {
                         name_ = "SelectiveSearchSegmentationStrategyFill";
@@ -405,6 +428,10 @@ namespace cv {
                     virtual float get(int r1, int r2) CV_OVERRIDE;
                     virtual void merge(int r1, int r2) CV_OVERRIDE;
 
+                    virtual Ptr<SelectiveSearchSegmentationStrategy> cloneStrategy() const CV_OVERRIDE {
+                        return makePtr<SelectiveSearchSegmentationStrategyFillImpl>();
+                    }
+
                 private:
                     String name_;
 
@@ -473,7 +500,7 @@ namespace cv {
              * Stragegy / Texture
              ***************************************/
 
-            class SelectiveSearchSegmentationStrategyTextureImpl CV_FINAL : public SelectiveSearchSegmentationStrategyTexture {
+            class SelectiveSearchSegmentationStrategyTextureImpl CV_FINAL : public SelectiveSearchSegmentationStrategyTexture, public SelectiveSearchSegmentationStrategyCloneable {
                 public:
                     SelectiveSearchSegmentationStrategyTextureImpl() {
                         name_ = "SelectiveSearchSegmentationStrategyTexture";
@@ -484,6 +511,10 @@ namespace cv {
                     virtual float get(int r1, int r2) CV_OVERRIDE;
                     virtual void merge(int r1, int r2) CV_OVERRIDE;
 
+                    virtual Ptr<SelectiveSearchSegmentationStrategy> cloneStrategy() const CV_OVERRIDE {
+                        return makePtr<SelectiveSearchSegmentationStrategyTextureImpl>();
+                    }
+
                 private:
                     String name_;
 
@@ -688,6 +719,166 @@ namespace cv {
 
             // Core
 
+            // Initial segmentation of one (image, graph segmentation) pair
+            struct InitialSegmentation {
+                Mat img_regions;
+                Mat_<int> sizes;
+                int nb_segs;
+                std::vector<Rect> bounding_rects;
+                std::vector<uint64> neighbours; // Pairs of adjacent regions, (smallest id << 32) | largest id, sorted
+            };
+
+            // Buffers of the hierarchical grouping, reused between groupings
+            class GroupingWorkspace {
+                public:
+                    struct Edge {
+                        int from;
+                        int to;
+                        float similarity;
+                    };
+
+                    Mat sizes;
+
+                    std::vector<Edge> edges;
+
+                    // Incidence lists: half edge 2 * e belongs to edges[e].from, 2 * e + 1 to edges[e].to
+                    std::vector<int> head;
+                    std::vector<int> next_half;
+                    std::vector<int> prev_half;
+
+                    // Indexed max-heap of edge ids (highest similarity first, then oldest edge)
+                    std::vector<int> heap;
+                    std::vector<int> heap_pos;
+
+                    std::vector<int> mark;
+                    std::vector<int> local_neighbours;
+
+                    void reset(int max_regions) {
+                        edges.clear();
+                        next_half.clear();
+                        prev_half.clear();
+                        heap.clear();
+                        heap_pos.clear();
+                        head.assign(max_regions, -1);
+                        mark.assign(max_regions, -1);
+                    }
+
+                    int owner(int h) const { return (h & 1) ? edges[h >> 1].to : edges[h >> 1].from; }
+
+                    int addEdge(int from, int to, float similarity) {
+                        int e = (int)edges.size();
+                        Edge edge = {from, to, similarity};
+                        edges.push_back(edge);
+                        next_half.resize(2 * e + 2);
+                        prev_half.resize(2 * e + 2);
+                        heap_pos.push_back(-1);
+                        link(2 * e, from);
+                        link(2 * e + 1, to);
+                        return e;
+                    }
+
+                    void link(int h, int node) {
+                        next_half[h] = head[node];
+                        prev_half[h] = -1;
+                        if (head[node] >= 0) {
+                            prev_half[head[node]] = h;
+                        }
+                        head[node] = h;
+                    }
+
+                    void unlink(int h) {
+                        if (prev_half[h] >= 0) {
+                            next_half[prev_half[h]] = next_half[h];
+                        } else {
+                            head[owner(h)] = next_half[h];
+                        }
+                        if (next_half[h] >= 0) {
+                            prev_half[next_half[h]] = prev_half[h];
+                        }
+                    }
+
+                    bool before(int e1, int e2) const {
+                        return edges[e1].similarity > edges[e2].similarity || (edges[e1].similarity == edges[e2].similarity && e1 < e2);
+                    }
+
+                    void heapSet(int pos, int e) {
+                        heap[pos] = e;
+                        heap_pos[e] = pos;
+                    }
+
+                    void siftUp(int pos) {
+                        int e = heap[pos];
+                        while (pos > 0) {
+                            int parent = (pos - 1) / 2;
+                            if (!before(e, heap[parent])) {
+                                break;
+                            }
+                            heapSet(pos, heap[parent]);
+                            pos = parent;
+                        }
+                        heapSet(pos, e);
+                    }
+
+                    void siftDown(int pos) {
+                        int e = heap[pos];
+                        int n = (int)heap.size();
+                        for (;;) {
+                            int child = 2 * pos + 1;
+                            if (child >= n) {
+                                break;
+                            }
+                            if (child + 1 < n && before(heap[child + 1], heap[child])) {
+                                child++;
+                            }
+                            if (!before(heap[child], e)) {
+                                break;
+                            }
+                            heapSet(pos, heap[child]);
+                            pos = child;
+                        }
+                        heapSet(pos, e);
+                    }
+
+                    void heapify() {
+                        heap.resize(edges.size());
+                        for (int e = 0; e < (int)edges.size(); e++) {
+                            heapSet(e, e);
+                        }
+                        for (int pos = (int)heap.size() / 2 - 1; pos >= 0; pos--) {
+                            siftDown(pos);
+                        }
+                    }
+
+                    void heapPush(int e) {
+                        heap.push_back(e);
+                        siftUp((int)heap.size() - 1);
+                    }
+
+                    int heapPop() {
+                        int top = heap[0];
+                        heapRemove(top);
+                        return top;
+                    }
+
+                    void heapRemove(int e) {
+                        int pos = heap_pos[e];
+                        int last = heap.back();
+                        heap.pop_back();
+                        heap_pos[e] = -1;
+                        if (last != e) {
+                            heapSet(pos, last);
+                            siftUp(pos);
+                            siftDown(heap_pos[last]);
+                        }
+                    }
+            };
+
+            // Strategies of this file can be duplicated, so that the hierarchical groupings sharing one of them can run concurrently
+            static Ptr<SelectiveSearchSegmentationStrategy> duplicateStrategy(const Ptr<SelectiveSearchSegmentationStrategy>& s) {
+                const SelectiveSearchSegmentationStrategyCloneable* c = dynamic_cast<const SelectiveSearchSegmentationStrategyCloneable*>(s.get());
+                return c ? c->cloneStrategy() : Ptr<SelectiveSearchSegmentationStrategy>();
+            }
+
             class SelectiveSearchSegmentationImpl CV_FINAL : public SelectiveSearchSegmentation {
                 public:
                     SelectiveSearchSegmentationImpl() {
@@ -731,7 +922,17 @@ namespace cv {
                     std::vector<Ptr<GraphSegmentation> > segmentations;
                     std::vector<Ptr<SelectiveSearchSegmentationStrategy> > strategies;
 
-                    void hierarchicalGrouping(const Mat& img, Ptr<SelectiveSearchSegmentationStrategy>& s, const Mat& img_regions, const Mat_<char>& is_neighbour, const Mat_<int>& sizes, int& nb_segs, const std::vector<Rect>& bounding_rects, std::vector<Region>& regions, int region_id);
+                    // State kept between process() calls, so that buffers are reused
+                    std::vector<InitialSegmentation> initial_segmentations;
+                    std::vector<std::vector<Region> > grouped_regions;
+                    std::vector<Ptr<GroupingWorkspace> > workspaces;
+                    Mutex workspaces_mutex;
+
+                    Ptr<GroupingWorkspace> acquireWorkspace();
+                    void releaseWorkspace(const Ptr<GroupingWorkspace>& ws);
+
+                    void computeInitialSegmentation(const Mat& img, const Ptr<GraphSegmentation>& gs, InitialSegmentation& seg);
+                    void hierarchicalGrouping(const Mat& img, SelectiveSearchSegmentationStrategy& s, const InitialSegmentation& seg, int image_id, GroupingWorkspace& ws, std::vector<Region>& regions);
             };
 
             void SelectiveSearchSegmentationImpl::setBaseImage(InputArray img) {
@@ -884,76 +1085,104 @@ namespace cv {
                 addStrategy(size3);
             }
 
-            void SelectiveSearchSegmentationImpl::process(std::vector<Rect>& rects) {
-
-                std::vector<Region> all_regions;
-
-                int image_id = 0;
-
-                for(std::vector<Mat>::iterator image = images.begin(); image != images.end(); ++image) {
-                    for(std::vector<Ptr<GraphSegmentation> >::iterator gs = segmentations.begin(); gs != segmentations.end(); ++gs) {
+            Ptr<GroupingWorkspace> SelectiveSearchSegmentationImpl::acquireWorkspace() {
+                AutoLock lock(workspaces_mutex);
+                if (workspaces.empty()) {
+                    return makePtr<GroupingWorkspace>();
+                }
+                Ptr<GroupingWorkspace> ws = workspaces.back();
+                workspaces.pop_back();
+                return ws;
+            }
 
-                        Mat img_regions;
-                        Mat_<char> is_neighbour;
-                        Mat_<int> sizes;
+            void SelectiveSearchSegmentationImpl::releaseWorkspace(const Ptr<GroupingWorkspace>& ws) {
+                AutoLock lock(workspaces_mutex);
+                workspaces.push_back(ws);
+            }
 
-                        // Compute initial segmentation
-                        (*gs)->processImage(*image, img_regions);
+            void SelectiveSearchSegmentationImpl::process(std::vector<Rect>& rects) {
 
-                        // Get number of regions
-                        double min, max;
-                        minMaxLoc(img_regions, &min, &max);
-                        int nb_segs = (int)max + 1;
+                const int nb_images = (int)images.size();
+                const int nb_gs = (int)segmentations.size();
+                const int nb_strategies = (int)strategies.size();
+                const int nb_initial = nb_images * nb_gs; // Also the image_id given to strategies
 
-                        // Compute bouding rects and neighbours
-                        std::vector<Rect> bounding_rects;
-                        bounding_rects.resize(nb_segs);
+                initial_segmentations.resize(nb_initial);
 
-                        std::vector<std::vector<cv::Point> > points;
+                // Compute initial segmentations. Only the built-in graph segmentations are run in parallel,
+                // the others are called from this thread, in the same order as before
+                std::vector<int> parallel_initial;
 
-                        points.resize(nb_segs);
+                for (int t = 0; t < nb_initial; t++) {
+                    if (isThreadSafeGraphSegmentation(segmentations[t % nb_gs])) {
+                        parallel_initial.push_back(t);
+                    } else {
+                        computeInitialSegmentation(images[t / nb_gs], segmentations[t % nb_gs], initial_segmentations[t]);
+                    }
+                }
 
-                        is_neighbour = Mat::zeros(nb_segs, nb_segs, CV_8UC1);
-                        sizes = Mat::zeros(nb_segs, 1, CV_32SC1);
+                parallel_for_(Range(0, (int)parallel_initial.size()), [&](const Range& range) {
+                    for (int i = range.start; i < range.end; i++) {
+                        const int t = parallel_initial[i];
+                        computeInitialSegmentation(images[t / nb_gs], segmentations[t % nb_gs], initial_segmentations[t]);
+                    }
+                });
 
-                        const int* previous_p = NULL;
+                // Hierarchical groupings. A strategy that can't be duplicated is used by one task, for all segmentations in order.
+                struct GroupingTask {
+                    int initial; // -1: all initial segmentations
+                    int strategy;
+                };
 
-                        for (int i = 0; i < (int)img_regions.rows; i++) {
-                            const int* p = img_regions.ptr<int>(i);
+                std::vector<GroupingTask> tasks;
 
-                            for (int j = 0; j < (int)img_regions.cols; j++) {
+                for (int st = 0; st < nb_strategies; st++) {
+                    if (duplicateStrategy(strategies[st])) {
+                        for (int t = 0; t < nb_initial; t++) {
+                            GroupingTask task = {t, st};
+                            tasks.push_back(task);
+                        }
+                    } else {
+                        GroupingTask task = {-1, st};
+                        tasks.push_back(task);
+                    }
+                }
 
-                                points[p[j]].push_back(cv::Point(j, i));
-                                sizes.at<int>(p[j], 0) = sizes.at<int>(p[j], 0) + 1;
+                grouped_regions.resize(nb_initial * nb_strategies);
 
-                                if (i > 0 && j > 0) {
+                parallel_for_(Range(0, (int)tasks.size()), [&](const Range& range) {
+                    Ptr<GroupingWorkspace> ws = acquireWorkspace();
 
-                                    is_neighbour.at<char>(p[j], p[j - 1]) = 1;
-                                    is_neighbour.at<char>(p[j], previous_p[j]) = 1;
-                                    is_neighbour.at<char>(p[j], previous_p[j - 1]) = 1;
+                    for (int i = range.start; i < range.end; i++) {
+                        const GroupingTask& task = tasks[i];
 
-                                    is_neighbour.at<char>(p[j - 1], p[j]) = 1;
-                                    is_neighbour.at<char>(previous_p[j], p[j]) = 1;
-                                    is_neighbour.at<char>(previous_p[j - 1], p[j]) = 1;
-                                }
+                        if (task.initial >= 0) {
+                            Ptr<SelectiveSearchSegmentationStrategy> s = duplicateStrategy(strategies[task.strategy]);
+                            hierarchicalGrouping(images[task.initial / nb_gs], *s, initial_segmentations[task.initial], task.initial, *ws, grouped_regions[task.initial * nb_strategies + task.strategy]);
+                        } else {
+                            for (int t = 0; t < nb_initial; t++) {
+                                hierarchicalGrouping(images[t / nb_gs], *strategies[task.strategy], initial_segmentations[t], t, *ws, grouped_regions[t * nb_strategies + task.strategy]);
                             }
-                            previous_p = p;
                         }
+                    }
 
-                        for(int seg = 0; seg < nb_segs; seg++) {
-                            bounding_rects[seg] = cv::boundingRect(points[seg]);
-                        }
+                    releaseWorkspace(ws);
+                });
 
-                        for(std::vector<Ptr<SelectiveSearchSegmentationStrategy> >::iterator strategy = strategies.begin(); strategy != strategies.end(); ++strategy) {
-                            std::vector<Region> regions;
-                            hierarchicalGrouping(*image, *strategy, img_regions, is_neighbour, sizes, nb_segs, bounding_rects, regions, image_id);
+                // Compute regions' rank, in the same order as a sequential run
+                std::vector<Region> all_regions;
 
-                            for(std::vector<Region>::iterator region = regions.begin(); region != regions.end(); ++region) {
-                                all_regions.push_back(*region);
-                            }
-                        }
+                size_t nb_regions = 0;
+                for (size_t i = 0; i < grouped_regions.size(); i++) {
+                    nb_regions += grouped_regions[i].size();
+                }
+                all_regions.reserve(nb_regions);
 
-                        image_id++;
+                for (size_t i = 0; i < grouped_regions.size(); i++) {
+                    for(std::vector<Region>::iterator region = grouped_regions[i].begin(); region != grouped_regions[i].end(); ++region) {
+                        // Note: this is inverted from the paper, but we keep the lover region first so it's works
+                        (*region).rank = ((double) rand() / (RAND_MAX)) * ((*region).level);
+                        all_regions.push_back(*region);
                     }
                 }
 
@@ -973,16 +1202,86 @@ namespace cv {
 
             }
 
-            void SelectiveSearchSegmentationImpl::hierarchicalGrouping(const Mat& img, Ptr<SelectiveSearchSegmentationStrategy>& s, const Mat& img_regions, const Mat_<char>& is_neighbour, const Mat_<int>& sizes_, int& nb_segs, const std::vector<Rect>& bounding_rects, std::vector<Region>& regions, int image_id) {
+            void SelectiveSearchSegmentationImpl::computeInitialSegmentation(const Mat& img, const Ptr<GraphSegmentation>& gs, InitialSegmentation& seg) {
+
+                // Compute initial segmentation
+                gs->processImage(img, seg.img_regions);
+
+                const Mat& img_regions = seg.img_regions;
+
+                // Get number of regions
+                double min, max;
+                minMaxLoc(img_regions, &min, &max);
+                int nb_segs = (int)max + 1;
+                seg.nb_segs = nb_segs;
+
+                // Compute sizes, bouding rects and neighbours
+                seg.sizes.create(nb_segs, 1);
+                seg.sizes.setTo(0);
+
+                std::vector<int> bounds(nb_segs * 4);
+                for (int r = 0; r < nb_segs; r++) {
+                    bounds[r * 4] = bounds[r * 4 + 1] = INT_MAX;
+                    bounds[r * 4 + 2] = bounds[r * 4 + 3] = -1;
+                }
+
+                int* sizes = seg.sizes[0];
+                seg.neighbours.clear();
+
+                const int* previous_p = NULL;
+
+                for (int i = 0; i < (int)img_regions.rows; i++) {
+                    const int* p = img_regions.ptr<int>(i);
+
+                    for (int j = 0; j < (int)img_regions.cols; j++) {
+                        int r = p[j];
+                        int* b = &bounds[r * 4];
 
-                Mat sizes = sizes_.clone();
+                        sizes[r]++;
+                        b[0] = std::min(b[0], j);
+                        b[1] = std::min(b[1], i);
+                        b[2] = std::max(b[2], j);
+                        b[3] = std::max(b[3], i);
+
+                        if (i > 0 && j > 0) {
+                            const int others[3] = {p[j - 1], previous_p[j], previous_p[j - 1]};
+
+                            for (int o = 0; o < 3; o++) {
+                                if (others[o] != r) {
+                                    uint64 r1 = (uint64)std::min(r, others[o]), r2 = (uint64)std::max(r, others[o]);
+                                    seg.neighbours.push_back((r1 << 32) | r2);
+                                }
+                            }
+                        }
+                    }
+                    previous_p = p;
+                }
+
+                std::sort(seg.neighbours.begin(), seg.neighbours.end());
+                seg.neighbours.erase(std::unique(seg.neighbours.begin(), seg.neighbours.end()), seg.neighbours.end());
+
+                seg.bounding_rects.resize(nb_segs);
+
+                for (int r = 0; r < nb_segs; r++) {
+                    const int* b = &bounds[r * 4];
+                    seg.bounding_rects[r] = b[2] < 0 ? Rect() : Rect(b[0], b[1], b[2] - b[0] + 1, b[3] - b[1] + 1);
+                }
+            }
+
+            void SelectiveSearchSegmentationImpl::hierarchicalGrouping(const Mat& img, SelectiveSearchSegmentationStrategy& s, const InitialSegmentation& seg, int image_id, GroupingWorkspace& ws, std::vector<Region>& regions) {
+
+                const int nb_segs = seg.nb_segs;
+
+                seg.sizes.copyTo(ws.sizes);
+                Mat_<int> sizes = ws.sizes;
 
-                std::vector<Neighbour> similarities;
                 regions.clear();
+                regions.reserve(std::max(2 * nb_segs - 1, 0));
+                ws.reset(std::max(2 * nb_segs - 1, 0));
 
                 /////////////////////////////////////////
 
-                s->setImage(img, img_regions, sizes, image_id);
+                s.setImage(img, seg.img_regions, ws.sizes, image_id);
 
                 // Compute initial similarities
                 for (int i = 0; i < nb_segs; i++) {
@@ -991,35 +1290,27 @@ namespace cv {
                     r.id = i;
                     r.level = 1;
                     r.merged_to = -1;
-                    r.bounding_box = bounding_rects[i];
+                    r.bounding_box = seg.bounding_rects[i];
 
                     regions.push_back(r);
-
-                    for (int j = i + 1; j < nb_segs; j++) {
-                        if (is_neighbour.at<char>(i, j)) {
-                            Neighbour n;
-                            n.from = i;
-                            n.to = j;
-                            n.similarity = s->get(i, j);
-
-                            similarities.push_back(n);
-                        }
-                    }
                 }
 
-                while(similarities.size() > 0) {
+                for (size_t i = 0; i < seg.neighbours.size(); i++) {
+                    int from = (int)(seg.neighbours[i] >> 32);
+                    int to = (int)(seg.neighbours[i] & 0xffffffff);
+                    ws.addEdge(from, to, s.get(from, to));
+                }
 
-                    std::sort(similarities.begin(), similarities.end());
+                ws.heapify();
 
-                    // for(std::vector<Neighbour>::iterator similarity = similarities.begin(); similarity != similarities.end(); ++similarity) {
-                    //     std::cout << *similarity << std::endl;
-                    // }
+                while (!ws.heap.empty()) {
 
-                    Neighbour p = similarities.back();
-                    similarities.pop_back();
+                    int e = ws.heapPop();
+                    int from = ws.edges[e].from;
+                    int to = ws.edges[e].to;
 
-                    Region region_from = regions[p.from];
-                    Region region_to = regions[p.to];
+                    const Region& region_from = regions[from];
+                    const Region& region_to = regions[to];
 
                     Region new_r;
                     new_r.id = std::min(region_from.id, region_to.id); // Should be the smalest, working ID
@@ -1027,65 +1318,48 @@ namespace cv {
                     new_r.merged_to = -1;
                     new_r.bounding_box = region_from.bounding_box | region_to.bounding_box;
 
+                    int id_from = region_from.id, id_to = region_to.id;
+
                     regions.push_back(new_r);
 
-                    regions[p.from].merged_to = (int)regions.size() - 1;
-                    regions[p.to].merged_to = (int)regions.size() - 1;
+                    int new_region = (int)regions.size() - 1;
+                    regions[from].merged_to = new_region;
+                    regions[to].merged_to = new_region;
 
                     // Merge
-                    s->merge(region_from.id, region_to.id);
+                    s.merge(id_from, id_to);
 
                     // Update size
-                    sizes.at<int>(region_from.id, 0) += sizes.at<int>(region_to.id, 0);
-                    sizes.at<int>(region_to.id, 0) = sizes.at<int>(region_from.id, 0);
+                    sizes(id_from, 0) += sizes(id_to, 0);
+                    sizes(id_to, 0) = sizes(id_from, 0);
 
-                    std::vector<int> local_neighbours;
+                    // Drop the edges of the merged regions, their other ends become neighbours of the new region
+                    ws.local_neighbours.clear();
 
-                    for(std::vector<Neighbour>::iterator similarity = similarities.begin(); similarity != similarities.end();) {
-                        if ((*similarity).from == p.from || (*similarity).to == p.from || (*similarity).from == p.to || (*similarity).to == p.to) {
-                            int from = 0;
+                    const int merged[2] = {from, to};
 
-                            if ((*similarity).from == p.from || (*similarity).from == p.to) {
-                                from = (*similarity).to;
-                            } else {
-                                from = (*similarity).from;
-                            }
+                    for (int m = 0; m < 2; m++) {
+                        for (int h = ws.head[merged[m]]; h >= 0; h = ws.next_half[h]) {
+                            int other = ws.owner(h ^ 1);
 
-                            bool already_neighboor = false;
-
-                            for(std::vector<int>::iterator local_neighbour = local_neighbours.begin(); local_neighbour != local_neighbours.end(); local_neighbour++) {
-                                if (*local_neighbour == from) {
-                                    already_neighboor = true;
-                                }
+                            if ((h >> 1) != e) {
+                                ws.heapRemove(h >> 1);
+                                ws.unlink(h ^ 1);
                             }
 
-                            if (!already_neighboor) {
-                                local_neighbours.push_back(from);
+                            if (other != from && other != to && ws.mark[other] != new_region) {
+                                ws.mark[other] = new_region;
+                                ws.local_neighbours.push_back(other);
                             }
-
-                            similarity = similarities.erase(similarity);
-                        } else {
-                            similarity++;
                         }
+                        ws.head[merged[m]] = -1;
                     }
 
-                    for(std::vector<int>::iterator local_neighbour = local_neighbours.begin(); local_neighbour != local_neighbours.end(); local_neighbour++) {
-
-                        Neighbour n;
-                        n.from = (int)regions.size() - 1;
-                        n.to = *local_neighbour;
-                        n.similarity = s->get(regions[n.from].id, regions[n.to].id);
-
-                        similarities.push_back(n);
+                    for (size_t n = 0; n < ws.local_neighbours.size(); n++) {
+                        int other = ws.local_neighbours[n];
+                        ws.heapPush(ws.addEdge(new_region, other, s.get(regions[new_region].id, regions[other].id)));
                     }
                 }
-
-                // Compute regions' rank
-                for(std::vector<Region>::iterator region = regions.begin(); region != regions.end(); ++region) {
-                    // Note: this is inverted from the paper, but we keep the lover region first so it's works
-                    (*region).rank = ((double) rand() / (RAND_MAX)) * ((*region).level);
-                }
-
             }
 
             Ptr<SelectiveSearchSegmentation> createSelectiveSearchSegmentation() {
@@ -1093,11 +1367,6 @@ namespace cv {
                 return s;
             }
 
-            std::ostream& operator<<(std::ostream& os, const Neighbour& n) {
-                os << "Neighbour[" << n.from << "->" << n.to << "," << n.similarity << "]";
-                return os;
-            }
-
             std::ostream& operator<<(std::ostream& os, const Region& r) {
                 os << "Region[WID" << r.id << ", L" << r.level << ", merged to " << r.merged_to << ", R:" << r.rank << ", " << r.bounding_box << "]";
                 return os;
@@ -5,24 +5,21 @@ using namespace std;
 namespace cv {
 namespace ximgproc {
 
-// Applies a thinning iteration to a binary image
-static void thinningIteration(Mat img, int iter, int thinningType){
-    Mat marker = Mat::zeros(img.size(), CV_8UC1);
+// Deletion decisions of both sub-iterations of both algorithms, for every
+// 8-neighbourhood. The index packs p2 (bit 0), p3, ..., p9 (bit 7).
+struct ThinningLUT
+{
+    uchar table[2][2][256];
 
-    if(thinningType == THINNING_ZHANGSUEN){
-        for (int i = 1; i < img.rows-1; i++)
+    ThinningLUT()
+    {
+        for (int code = 0; code < 256; code++)
         {
-            for (int j = 1; j < img.cols-1; j++)
-            {
-                uchar p2 = img.at<uchar>(i-1, j);
-                uchar p3 = img.at<uchar>(i-1, j+1);
-                uchar p4 = img.at<uchar>(i, j+1);
-                uchar p5 = img.at<uchar>(i+1, j+1);
-                uchar p6 = img.at<uchar>(i+1, j);
-                uchar p7 = img.at<uchar>(i+1, j-1);
-                uchar p8 = img.at<uchar>(i, j-1);
-                uchar p9 = img.at<uchar>(i-1, j-1);
+            uchar p2 = code & 1, p3 = (code >> 1) & 1, p4 = (code >> 2) & 1, p5 = (code >> 3) & 1;
+            uchar p6 = (code >> 4) & 1, p7 = (code >> 5) & 1, p8 = (code >> 6) & 1, p9 = (code >> 7) & 1;
 
+            for (int iter = 0; iter < 2; iter++)
+            {
                 int A  = (p2 == 0 && p3 == 1) + (p3 == 0 && p4 == 1) +
                          (p4 == 0 && p5 == 1) + (p5 == 0 && p6 == 1) +
                          (p6 == 0 && p7 == 1) + (p7 == 0 && p8 == 1) +
@@ -31,24 +28,7 @@ static void thinningIteration(Mat img, int iter, int thinningType){
                 int m1 = iter == 0 ? (p2 * p4 * p6) : (p2 * p4 * p8);
                 int m2 = iter == 0 ? (p4 * p6 * p8) : (p2 * p6 * p8);
 
-                if (A == 1 && (B >= 2 && B <= 6) && m1 == 0 && m2 == 0)
-                    marker.at<uchar>(i,j) = 1;
-            }
-        }
-    }
-    if(thinningType == THINNING_GUOHALL){
-        for (int i = 1; i < img.rows-1; i++)
-        {
-            for (int j = 1; j < img.cols-1; j++)
-            {
-                uchar p2 = img.at<uchar>(i-1, j);
-                uchar p3 = img.at<uchar>(i-1, j+1);
-                uchar p4 = img.at<uchar>(i, j+1);
-                uchar p5 = img.at<uchar>(i+1, j+1);
-                uchar p6 = img.at<uchar>(i+1, j);
-                uchar p7 = img.at<uchar>(i+1, j-1);
-                uchar p8 = img.at<uchar>(i, j-1);
-                uchar p9 = img.at<uchar>(i-1, j-1);
+                table[THINNING_ZHANGSUEN][iter][code] = (A == 1 && (B >= 2 && B <= 6) && m1 == 0 && m2 == 0);
 
                 int C  = ((!p2) & (p3 | p4)) + ((!p4) & (p5 | p6)) +
                          ((!p6) & (p7 | p8)) + ((!p8) & (p9 | p2));
@@ -57,13 +37,154 @@ static void thinningIteration(Mat img, int iter, int thinningType){
                 int N  = N1 < N2 ? N1 : N2;
                 int m  = iter == 0 ? ((p6 | p7 | (!p9)) & p8) : ((p2 | p3 | (!p5)) & p4);
 
-                if ((C == 1) && ((N >= 2) && ((N <= 3)) & (m == 0)))
-                    marker.at<uchar>(i,j) = 1;
+                table[THINNING_GUOHALL][iter][code] = ((C == 1) && ((N >= 2) && ((N <= 3)) & (m == 0)));
             }
         }
     }
+};
 
-    img &= ~marker;
+static const ThinningLUT& getThinningLUT()
+{
+    static ThinningLUT lut;
+    return lut;
+}
+
+// Neighbourhood code of a pixel of a 0/1 image, in the order of ThinningLUT
+static inline int neighbourhoodCode(const uchar* p, size_t step)
+{
+    return  p[-(ptrdiff_t)step]           | (p[-(ptrdiff_t)step + 1] << 1) |
+           (p[1] << 2)                    | (p[step + 1] << 3) |
+           (p[step] << 4)                 | (p[step - 1] << 5) |
+           (p[-1] << 6)                   | (p[-(ptrdiff_t)step - 1] << 7);
+}
+
+// Applies the thinning iterations to a binary (0/1) image.
+// The first sub-iterations scan the whole image by bands of rows. After that,
+// a pixel is only evaluated again for a sub-iteration when one of its
+// neighbours has been deleted since its last evaluation for that sub-iteration:
+// its decision could not have changed otherwise.
+static void thinningIterations(Mat& img, int thinningType)
+{
+    const int rows = img.rows, cols = img.cols;
+    if (rows < 3 || cols < 3)
+        return;
+
+    CV_Assert(img.isContinuous());
+    const size_t step = img.step;
+    uchar* data = img.ptr();
+    const uchar (*table)[256] = getThinningLUT().table[thinningType];
+
+    // Pixels to evaluate again for each sub-iteration, and their flags (bit = sub-iteration)
+    std::vector<int> worklist[2];
+    Mat queued = Mat::zeros(img.size(), CV_8UC1);
+    uchar* flags = queued.ptr();
+    bool dense[2] = { true, true };
+
+    const int nthreads = std::max(1, getNumThreads());
+    std::vector<std::vector<int> > deletions;
+    std::vector<int> candidates;
+
+    bool changed;
+    do {
+        changed = false;
+
+        for (int iter = 0; iter < 2; iter++)
+        {
+            const uchar* lut = table[iter];
+            int nstripes;
+
+            if (dense[iter])
+            {
+                nstripes = std::max(1, std::min(rows - 2, 4 * nthreads));
+                deletions.resize(nstripes);
+
+                parallel_for_(Range(0, nstripes), [&](const Range& range) {
+                    for (int s = range.start; s < range.end; s++)
+                    {
+                        std::vector<int>& deleted = deletions[s];
+                        deleted.clear();
+                        const int i0 = 1 + (int)((int64)(rows - 2) * s / nstripes);
+                        const int i1 = 1 + (int)((int64)(rows - 2) * (s + 1) / nstripes);
+
+                        for (int i = i0; i < i1; i++)
+                        {
+                            const uchar* p = data + i * step;
+                            for (int j = 1; j < cols - 1; j++)
+                            {
+                                if (p[j] && lut[neighbourhoodCode(p + j, step)])
+                                    deleted.push_back((int)(i * step) + j);
+                            }
+                        }
+                    }
+                }, nstripes);
+
+                dense[iter] = false;
+            }
+            else
+            {
+                candidates.swap(worklist[iter]);
+                worklist[iter].clear();
+                const int count = (int)candidates.size();
+                nstripes = std::max(1, std::min((count + 4095) / 4096, 4 * nthreads));
+                deletions.resize(nstripes);
+
+                parallel_for_(Range(0, nstripes), [&](const Range& range) {
+                    for (int s = range.start; s < range.end; s++)
+                    {
+                        std::vector<int>& deleted = deletions[s];
+                        deleted.clear();
+                        const int k0 = (int)((int64)count * s / nstripes);
+                        const int k1 = (int)((int64)count * (s + 1) / nstripes);
+
+                        for (int k = k0; k < k1; k++)
+                        {
+                            const int ofs = candidates[k];
+                            flags[ofs] &= ~(1 << iter);
+                            if (data[ofs] && lut[neighbourhoodCode(data + ofs, step)])
+                                deleted.push_back(ofs);
+                        }
+                    }
+                }, nstripes);
+            }
+
+            // All decisions are taken on the same image: delete afterwards
+            for (int s = 0; s < nstripes; s++)
+            {
+                const std::vector<int>& deleted = deletions[s];
+                for (size_t k = 0; k < deleted.size(); k++)
+                    data[deleted[k]] = 0;
+                changed = changed || !deleted.empty();
+            }
+
+            // Queue the remaining neighbours of the deleted pixels
+            for (int s = 0; s < nstripes; s++)
+            {
+                const std::vector<int>& deleted = deletions[s];
+                for (size_t k = 0; k < deleted.size(); k++)
+                {
+                    const int i = deleted[k] / (int)step, j = deleted[k] % (int)step;
+                    for (int ni = std::max(i - 1, 1); ni <= std::min(i + 1, rows - 2); ni++)
+                    {
+                        for (int nj = std::max(j - 1, 1); nj <= std::min(j + 1, cols - 2); nj++)
+                        {
+                            const int ofs = (int)(ni * step) + nj;
+                            if (!data[ofs])
+                                continue;
+                            for (int q = 0; q < 2; q++)
+                            {
+                                if (!dense[q] && !(flags[ofs] & (1 << q)))
+                                {
+                                    flags[ofs] |= (uchar)(1 << q);
+                                    worklist[q].push_back(ofs);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    while (changed);
 }
 
 // Apply the thinning procedure to a given image
@@ -73,16 +194,8 @@ void thinning(InputArray input, OutputArray output, int thinningType){
     // Enforce the range of the input image to be in between 0 - 255
     processed /= 255;
 
-    Mat prev = Mat::zeros(processed.size(), CV_8UC1);
-    Mat diff;
-
-    do {
-        thinningIteration(processed, 0, thinningType);
-        thinningIteration(processed, 1, thinningType);
-        absdiff(processed, prev, diff);
-        processed.copyTo(prev);
-    }
-    while (countNonZero(diff) > 0);
+    if (thinningType == THINNING_ZHANGSUEN || thinningType == THINNING_GUOHALL)
+        thinningIterations(processed, thinningType);
 
     processed *= 255;
 
@@ -164,59 +164,13 @@ void from32STo32F(Mat &img, Mat &outImg, float *mapping)
 }
 
 
-/***************************************************************
- * Function: float2D
- * Description: allocate a 2D float array with dimension "dim1 x dim2"
- ***************************************************************/
-float** float2D(int dim1, int dim2)
-{
-    float **ret = new float*[dim1];
-    ret[0] = new float[dim1*dim2];
-    for(int i=1;i<dim1;i++)ret[i] = ret[i-1]+dim2;
-
-    return ret;
-}
-
-/***************************************************************
- * Function: float2D_release
- * Description: deallocate the 2D array created by float2D()
- ***************************************************************/
-void float2D_release(float **p)
-{
-    delete []p[0];
-    delete []p;
-}
-
-/***************************************************************
- * Function: int2D
- * Description: allocate a 2D integer array with dimension "dim1 x dim2"
- ***************************************************************/
-int** int2D(int dim1, int dim2)
-{
-    int **ret = new int*[dim1];
-    ret[0] = new int[dim1*dim2];
-    for(int i=1;i<dim1;i++)ret[i] = ret[i-1]+dim2;
-
-    return ret;
-}
-
-/***************************************************************
- * Function: int2D_release
- * Description: deallocate the 2D array created by int2D()
- ***************************************************************/
-void int2D_release(int **p)
-{
-    delete []p[0];
-    delete []p;
-}
-
 /***************************************************************
  * Function: updateBCB
  * Description: maintain the necklace table of BCB
  ***************************************************************/
 inline void updateBCB(int &num,int *f,int *b,int i,int v)
 {
-    static int p1,p2;
+    int p1,p2;
 
     if(i)
     {
@@ -246,7 +200,7 @@ inline void updateBCB(int &num,int *f,int *b,int i,int v)
  *                If F is 3-channel, perform k-means clustering
  *                If F is 1-channel, only perform type-casting
  ***************************************************************/
-void featureIndexing(Mat &F, float **&wMap, int &nF, float sigmaI, int weightType){
+void featureIndexing(Mat &F, Mat &wMap, int &nF, float sigmaI, int weightType){
     // Configuration and Declaration
     Mat FNew;
     int cols = F.cols, rows = F.rows;
@@ -262,7 +216,7 @@ void featureIndexing(Mat &F, float **&wMap, int &nF, float sigmaI, int weightTyp
         F.convertTo(FNew, CV_32S);
 
         // Compute weight map (weight between each pair of feature index)
-        wMap = float2D(nF,nF);
+        wMap.create(nF,nF,CV_32F);
         float nSigmaI = sigmaI;
         float divider = (1.0f/(2*nSigmaI*nSigmaI));
 
@@ -284,7 +238,7 @@ void featureIndexing(Mat &F, float **&wMap, int &nF, float sigmaI, int weightTyp
                     default: val = exp(-(diff*diff)*divider);
                 }
 
-                wMap[i][j] = wMap[j][i] = val;
+                wMap.at<float>(i,j) = wMap.at<float>(j,i) = val;
             }
         }
     }
@@ -294,9 +248,8 @@ void featureIndexing(Mat &F, float **&wMap, int &nF, float sigmaI, int weightTyp
     {
         const int shift = 2; // 256(8-bit)->64(6-bit)
         const int LOW_NUM = 256>>shift;
-        static int hash[LOW_NUM][LOW_NUM][LOW_NUM]={{{0}}};
-
-        memset(hash,0,sizeof(hash));
+        std::vector<int> hashBuf(LOW_NUM*LOW_NUM*LOW_NUM, 0);
+        int (*hash)[LOW_NUM][LOW_NUM] = reinterpret_cast<int (*)[LOW_NUM][LOW_NUM]>(&hashBuf[0]);
 
         // throw pixels into a 2D histogram
         int candCnt = 0;
@@ -362,7 +315,7 @@ void featureIndexing(Mat &F, float **&wMap, int &nF, float sigmaI, int weightTyp
         }
 
         // Compute weight map (weight between each pair of feature index)
-        wMap = float2D(nF,nF);
+        wMap.create(nF,nF,CV_32F);
         float nSigmaI = sigmaI/256.0f*LOW_NUM;
         float divider = (1.0f/(2*nSigmaI*nSigmaI));
 
@@ -399,7 +352,7 @@ void featureIndexing(Mat &F, float **&wMap, int &nF, float sigmaI, int weightTyp
                     default: val = exp(-(diff0*diff0+diff1*diff1+diff2*diff2)*divider);
                 }
 
-                wMap[i][j] = wMap[j][i] = val;
+                wMap.at<float>(i,j) = wMap.at<float>(j,i) = val;
             }
         }
 
@@ -409,244 +362,287 @@ void featureIndexing(Mat &F, float **&wMap, int &nF, float sigmaI, int weightTyp
     F = FNew;
 }
 
-Mat filterCore(Mat &I, Mat &F, float **wMap, int r=20, int nF=256, int nI=256, Mat mask=Mat())
+/***************************************************************
+ * Class: WMFColumnFilter
+ * Description: joint-histogram sweep of a range of columns.
+ *                Every column starts from an empty histogram, so ranges of
+ *                columns are filtered independently, each with its own
+ *                histogram, BCB and necklace tables.
+ ***************************************************************/
+class WMFColumnFilter : public ParallelLoopBody
 {
-    // Check validation
-    assert(I.depth() == CV_32S && I.channels()==1);//input image: 32SC1
-    assert(F.depth() == CV_32S && F.channels()==1);//feature image: 32SC1
+public:
+    WMFColumnFilter(const Mat &I_, const Mat &F_, const Mat &mask_, const Mat &wMap_, int r_, int nF_, int nI_, int nstripes_, Mat &outImg_)
+        : I(I_), F(F_), mask(mask_), wMap(wMap_), r(r_), nF(nF_), nI(nI_), nstripes(nstripes_), outImg(outImg_)
+    {}
 
-    // Configuration and declaration
+    void operator()(const Range &range) const CV_OVERRIDE
+    {
+        int cols = I.cols;
+
+        // Joint-histogram and links of its necklace tables, one row per input value
+        Mat H = Mat::zeros(nI, nF, CV_32S);
+        Mat Hf(nI, nF, CV_32S);//forward link
+        Mat Hb(nI, nF, CV_32S);//backward link
+
+        // BCB and links of its necklace table
+        Mat BCBs(3, nF, CV_32S);
+
+        for(int s = range.start; s < range.end; s++)
+        {
+            int x0 = (int)((int64)cols * s / nstripes);
+            int x1 = (int)((int64)cols * (s + 1) / nstripes);
+
+            for(int x = x0; x < x1; x++)
+                filterColumn(x, H.ptr<int>(), Hf.ptr<int>(), Hb.ptr<int>(), BCBs.ptr<int>(0), BCBs.ptr<int>(1), BCBs.ptr<int>(2));
+        }
+    }
+
+private:
+    void filterColumn(int x, int *H, int *Hf, int *Hb, int *BCB, int *BCBf, int *BCBb) const;
+
+    const Mat &I, &F, &mask, &wMap;
+    int r, nF, nI, nstripes;
+    Mat &outImg;
+};
+
+void WMFColumnFilter::filterColumn(int x, int *H, int *Hf, int *Hb, int *BCB, int *BCBf, int *BCBb) const
+{
     int rows = I.rows, cols = I.cols;
-    Mat outImg = I.clone();
 
-    // Handle Mask
-    if(mask.empty())
+    // Reset BCB and the necklace tables for each column.
+    // The joint-histogram is already empty: it is cleared at the end of the previous column.
+    memset(BCB, 0, sizeof(int)*nF);
+    for(int i=0;i<nI;i++)Hf[i*nF]=Hb[i*nF]=0;
+    BCBf[0]=BCBb[0]=0;
+
+    // Reset cut-point
+    int medianVal = -1;
+
+    // Precompute "x" range and checks boundary
+    int downX = max(0,x-r);
+    int upX = min(cols-1,x+r);
+
+    // Initialize joint-histogram and BCB for the first window
+    int upY = min(rows-1,r);
+    for(int i=0;i<=upY;i++)
     {
-        mask = Mat(I.size(),CV_8U);
-        mask = Scalar(1);
-    }
+        const int *IPtr = I.ptr<int>(i);
+        const int *FPtr = F.ptr<int>(i);
+        const uchar *maskPtr = mask.ptr<uchar>(i);
+
+        for(int j=downX;j<=upX;j++)
+        {
+            if(!maskPtr[j])continue;
 
-    // Allocate memory for joint-histogram and BCB
-    int **H = int2D(nI,nF);
-    int *BCB = new int[nF];
+            int fval = IPtr[j];
+            int *curHist = H + fval*nF;
+            int gval = FPtr[j];
 
-    // Allocate links for necklace table
-    int **Hf = int2D(nI,nF);//forward link
-    int **Hb = int2D(nI,nF);//backward link
-    int *BCBf = new int[nF];//forward link
-    int *BCBb = new int[nF];//backward link
+            // Maintain necklace table of joint-histogram
+            if(!curHist[gval] && gval)
+            {
+                int *curHf = Hf + fval*nF;
+                int *curHb = Hb + fval*nF;
+
+                int p1=0,p2=curHf[0];
+                curHf[p1]=gval;
+                curHf[gval]=p2;
+                curHb[p2]=gval;
+                curHb[gval]=p1;
+            }
 
-    // Column Scanning
-    for(int x=0;x<cols;x++)
+            curHist[gval]++;
+            // Maintain necklace table of BCB
+            updateBCB(BCB[gval],BCBf,BCBb,gval,-1);
+        }
+    }
+
+    for(int y=0;y<rows;y++)
     {
-        // Reset histogram and BCB for each column
-        memset(BCB, 0, sizeof(int)*nF);
-        memset(H[0], 0, sizeof(int)*nF*nI);
-        for(int i=0;i<nI;i++)Hf[i][0]=Hb[i][0]=0;
-        BCBf[0]=BCBb[0]=0;
-
-        // Reset cut-point
-        int medianVal = -1;
-
-        // Precompute "x" range and checks boundary
-        int downX = max(0,x-r);
-        int upX = min(cols-1,x+r);
-
-        // Initialize joint-histogram and BCB for the first window
-        int upY = min(rows-1,r);
-        for(int i=0;i<=upY;i++)
+        // Find weighted median with help of BCB and joint-histogram
+        float balanceWeight = 0;
+        int curIndex = F.ptr<int>(y,x)[0];
+        const float *fPtr = wMap.ptr<float>(curIndex);
+        int &curMedianVal = medianVal;
+
+        // Compute current balance
+        {
+            int i=0;
+            do
+            {
+                balanceWeight += BCB[i]*fPtr[i];
+                i=BCBf[i];
+            }while(i);
+        }
+
+        // Move cut-point to the left
+        if(balanceWeight >= 0)
+        {
+            for(;balanceWeight >= 0 && curMedianVal > 0; curMedianVal--)
+            {
+                float curWeight = 0;
+                int *nextHist = H + curMedianVal*nF;
+                int *nextHf = Hf + curMedianVal*nF;
+
+                // Compute weight change by shift cut-point
+                int i=0;
+                do
+                {
+                    curWeight += (nextHist[i]<<1)*fPtr[i];
+
+                    // Update BCB and maintain the necklace table of BCB
+                    updateBCB(BCB[i],BCBf,BCBb,i,-(nextHist[i]<<1));
+
+                    i=nextHf[i];
+                }while(i);
+
+                balanceWeight -= curWeight;
+            }
+        }
+        // Move cut-point to the right
+        else if(balanceWeight < 0)
+        {
+            for(;balanceWeight < 0 && curMedianVal != nI-1; curMedianVal++)
+            {
+                float curWeight = 0;
+                int *nextHist = H + (curMedianVal+1)*nF;
+                int *nextHf = Hf + (curMedianVal+1)*nF;
+
+                // Compute weight change by shift cut-point
+                int i=0;
+                do
+                {
+                    curWeight += (nextHist[i]<<1)*fPtr[i];
+
+                    // Update BCB and maintain the necklace table of BCB
+                    updateBCB(BCB[i],BCBf,BCBb,i,nextHist[i]<<1);
+
+                    i=nextHf[i];
+                }while(i);
+                balanceWeight += curWeight;
+            }
+        }
+
+        // Weighted median is found and written to the output image
+        if(curMedianVal != -1)
+        {
+            if(balanceWeight < 0)
+                outImg.ptr<int>(y,x)[0] = curMedianVal+1;
+            else
+                outImg.ptr<int>(y,x)[0] = curMedianVal;
+        }
+
+        // Update joint-histogram and BCB when local window is shifted.
+        int fval,gval,*curHist;
+
+        // Add entering pixels into joint-histogram and BCB
+        int rownum = y + r + 1;
+        if(rownum < rows)
         {
-            int *IPtr = I.ptr<int>(i);
-            int *FPtr = F.ptr<int>(i);
-            uchar *maskPtr = mask.ptr<uchar>(i);
+            const int *inputImgPtr = I.ptr<int>(rownum);
+            const int *guideImgPtr = F.ptr<int>(rownum);
+            const uchar *maskPtr = mask.ptr<uchar>(rownum);
 
             for(int j=downX;j<=upX;j++)
             {
                 if(!maskPtr[j])continue;
 
-                int fval = IPtr[j];
-                int *curHist = H[fval];
-                int gval = FPtr[j];
+                fval = inputImgPtr[j];
+                curHist = H + fval*nF;
+                gval = guideImgPtr[j];
 
                 // Maintain necklace table of joint-histogram
                 if(!curHist[gval] && gval)
                 {
-                    int *curHf = Hf[fval];
-                    int *curHb = Hb[fval];
+                    int *curHf = Hf + fval*nF;
+                    int *curHb = Hb + fval*nF;
 
                     int p1=0,p2=curHf[0];
-                    curHf[p1]=gval;
                     curHf[gval]=p2;
-                    curHb[p2]=gval;
                     curHb[gval]=p1;
+                    curHf[p1]=curHb[p2]=gval;
                 }
 
                 curHist[gval]++;
+
                 // Maintain necklace table of BCB
-                updateBCB(BCB[gval],BCBf,BCBb,gval,-1);
+                updateBCB(BCB[gval],BCBf,BCBb,gval,((fval <= medianVal)<<1)-1);
             }
         }
 
-        for(int y=0;y<rows;y++)
-        {
-            // Find weighted median with help of BCB and joint-histogram
-            float balanceWeight = 0;
-            int curIndex = F.ptr<int>(y,x)[0];
-            float *fPtr = wMap[curIndex];
-            int &curMedianVal = medianVal;
 
-            // Compute current balance
-            {
-                int i=0;
-                do
-                {
-                    balanceWeight += BCB[i]*fPtr[i];
-                    i=BCBf[i];
-                }while(i);
-            }
+        // Delete leaving pixels into joint-histogram and BCB
+        rownum = y - r;
+        if(rownum >= 0)
+        {
+            const int *inputImgPtr = I.ptr<int>(rownum);
+            const int *guideImgPtr = F.ptr<int>(rownum);
+            const uchar *maskPtr = mask.ptr<uchar>(rownum);
 
-            // Move cut-point to the left
-            if(balanceWeight >= 0)
+            for(int j=downX;j<=upX;j++)
             {
-                for(;balanceWeight >= 0 && curMedianVal > 0; curMedianVal--)
-                {
-                    float curWeight = 0;
-                    int *nextHist = H[curMedianVal];
-                    int *nextHf = Hf[curMedianVal];
-
-                    // Compute weight change by shift cut-point
-                    int i=0;
-                    do
-                    {
-                        curWeight += (nextHist[i]<<1)*fPtr[i];
+                if(!maskPtr[j])continue;
 
-                        // Update BCB and maintain the necklace table of BCB
-                        updateBCB(BCB[i],BCBf,BCBb,i,-(nextHist[i]<<1));
+                fval = inputImgPtr[j];
+                curHist = H + fval*nF;
+                gval = guideImgPtr[j];
 
-                        i=nextHf[i];
-                    }while(i);
+                curHist[gval]--;
 
-                    balanceWeight -= curWeight;
-                }
-            }
-            // Move cut-point to the right
-            else if(balanceWeight < 0)
-            {
-                for(;balanceWeight < 0 && curMedianVal != nI-1; curMedianVal++)
+                // Maintain necklace table of joint-histogram
+                if(!curHist[gval] && gval)
                 {
-                    float curWeight = 0;
-                    int *nextHist = H[curMedianVal+1];
-                    int *nextHf = Hf[curMedianVal+1];
-
-                    // Compute weight change by shift cut-point
-                    int i=0;
-                    do
-                    {
-                        curWeight += (nextHist[i]<<1)*fPtr[i];
-
-                        // Update BCB and maintain the necklace table of BCB
-                        updateBCB(BCB[i],BCBf,BCBb,i,nextHist[i]<<1);
-
-                        i=nextHf[i];
-                    }while(i);
-                    balanceWeight += curWeight;
+                    int *curHf = Hf + fval*nF;
+                    int *curHb = Hb + fval*nF;
+
+                    int p1=curHb[gval],p2=curHf[gval];
+                    curHf[p1]=p2;
+                    curHb[p2]=p1;
                 }
-            }
 
-            // Weighted median is found and written to the output image
-            if(curMedianVal != -1)
-            {
-                if(balanceWeight < 0)
-                    outImg.ptr<int>(y,x)[0] = curMedianVal+1;
-                else
-                    outImg.ptr<int>(y,x)[0] = curMedianVal;
+                // Maintain necklace table of BCB
+                updateBCB(BCB[gval],BCBf,BCBb,gval,-((fval <= medianVal)<<1)+1);
             }
+        }
+    }
 
-            // Update joint-histogram and BCB when local window is shifted.
-            int fval,gval,*curHist;
-
-            // Add entering pixels into joint-histogram and BCB
-            int rownum = y + r + 1;
-            if(rownum < rows)
-            {
-                    int *inputImgPtr = I.ptr<int>(rownum);
-                    int *guideImgPtr = F.ptr<int>(rownum);
-                    uchar *maskPtr = mask.ptr<uchar>(rownum);
-
-                    for(int j=downX;j<=upX;j++)
-                    {
-                        if(!maskPtr[j])continue;
-
-                        fval = inputImgPtr[j];
-                        curHist = H[fval];
-                        gval = guideImgPtr[j];
-
-                        // Maintain necklace table of joint-histogram
-                        if(!curHist[gval] && gval)
-                        {
-                            int *curHf = Hf[fval];
-                            int *curHb = Hb[fval];
-
-                            int p1=0,p2=curHf[0];
-                            curHf[gval]=p2;
-                            curHb[gval]=p1;
-                            curHf[p1]=curHb[p2]=gval;
-                        }
-
-                        curHist[gval]++;
-
-                        // Maintain necklace table of BCB
-                        updateBCB(BCB[gval],BCBf,BCBb,gval,((fval <= medianVal)<<1)-1);
-                    }
-                }
-
+    // Empty the joint-histogram for the next column: only the cells of the
+    // last window are still set, which is much cheaper than clearing nI x nF cells
+    for(int i=max(0,rows-r);i<rows;i++)
+    {
+        const int *IPtr = I.ptr<int>(i);
+        const int *FPtr = F.ptr<int>(i);
+        const uchar *maskPtr = mask.ptr<uchar>(i);
 
-                // Delete leaving pixels into joint-histogram and BCB
-                rownum = y - r;
-                if(rownum >= 0)
-                {
-                    int *inputImgPtr = I.ptr<int>(rownum);
-                    int *guideImgPtr = F.ptr<int>(rownum);
-                    uchar *maskPtr = mask.ptr<uchar>(rownum);
-
-                    for(int j=downX;j<=upX;j++)
-                    {
-                        if(!maskPtr[j])continue;
-
-                        fval = inputImgPtr[j];
-                        curHist = H[fval];
-                        gval = guideImgPtr[j];
-
-                        curHist[gval]--;
-
-                        // Maintain necklace table of joint-histogram
-                        if(!curHist[gval] && gval)
-                        {
-                            int *curHf = Hf[fval];
-                            int *curHb = Hb[fval];
-
-                            int p1=curHb[gval],p2=curHf[gval];
-                            curHf[p1]=p2;
-                            curHb[p2]=p1;
-                        }
-
-                        // Maintain necklace table of BCB
-                        updateBCB(BCB[gval],BCBf,BCBb,gval,-((fval <= medianVal)<<1)+1);
-                    }
-                }
+        for(int j=downX;j<=upX;j++)
+        {
+            if(maskPtr[j])
+                H[IPtr[j]*nF + FPtr[j]] = 0;
         }
     }
+}
+
+Mat filterCore(Mat &I, Mat &F, const Mat &wMap, int r=20, int nF=256, int nI=256, Mat mask=Mat())
+{
+    // Check validation
+    assert(I.depth() == CV_32S && I.channels()==1);//input image: 32SC1
+    assert(F.depth() == CV_32S && F.channels()==1);//feature image: 32SC1
 
-    // Deallocate the memory
+    // Configuration and declaration
+    Mat outImg = I.clone();
+
+    // Handle Mask
+    if(mask.empty())
     {
-        delete []BCB;
-        delete []BCBf;
-        delete []BCBb;
-        int2D_release(H);
-        int2D_release(Hf);
-        int2D_release(Hb);
+        mask = Mat(I.size(),CV_8U);
+        mask = Scalar(1);
     }
 
+    // Column Scanning, by ranges of columns sharing a joint-histogram
+    int nstripes = max(1, min(I.cols, getNumThreads()));
+    parallel_for_(Range(0, nstripes), WMFColumnFilter(I, F, mask, wMap, r, nF, nI, nstripes, outImg), nstripes);
+
     // end of the function
     return outImg;
 }
@@ -711,7 +707,7 @@ void weightedMedianFilter(InputArray joint, InputArray src, OutputArray dst, int
     //The output "F" is CV_32S type, containing indexes of feature values.
     //"wMap" is a 2D array that defines the distance between each pair of feature indexes.
     // wMap[i][j] is the weight between feature index "i" and "j".
-    float **wMap = NULL;
+    Mat wMap;
     featureIndexing(F, wMap, nF, float(sigma), weightType);
 
     //Filtering - Joint-Histogram Framework
@@ -719,7 +715,6 @@ void weightedMedianFilter(InputArray joint, InputArray src, OutputArray dst, int
     {
         Is[i] = filterCore(Is[i], F, wMap, r, nF, nI, mask.getMat());
     }
-    float2D_release(wMap);
 
     //Postprocess F
     //Convert input image back to the original type.
@@ -45,4 +45,44 @@ TEST(ximgproc_Edgeboxes, regression)
     EXPECT_EQ(expectedProposal.width, boxes[0].width);
 }
 
+TEST(ximgproc_Edgeboxes, batch_same_as_single)
+{
+    cv::String testImagePath = cvtest::TS::ptr()->get_data_path() + "cv/ximgproc/" + "pascal_voc_bird.png";
+    Mat testImg = imread(testImagePath);
+    ASSERT_FALSE(testImg.empty()) << "Could not load input image " << testImagePath;
+    cvtColor(testImg, testImg, COLOR_BGR2RGB);
+    testImg.convertTo(testImg, CV_32F, 1.0 / 255.0f);
+
+    cv::String model_path = cvtest::TS::ptr()->get_data_path() + "cv/ximgproc/" + "model.yml.gz";
+    Ptr<StructuredEdgeDetection> sed = createStructuredEdgeDetection(model_path);
+
+    std::vector<Mat> edges(2), orientations(2);
+    sed->detectEdges(testImg, edges[0]);
+    sed->computeOrientation(edges[0], orientations[0]);
+    Mat flipped;
+    flip(testImg, flipped, 1);
+    sed->detectEdges(flipped, edges[1]);
+    sed->computeOrientation(edges[1], orientations[1]);
+
+    Ptr<EdgeBoxes> edgeboxes = createEdgeBoxes();
+    edgeboxes->setMaxBoxes(50);
+
+    std::vector<std::vector<Rect> > batchBoxes;
+    std::vector<std::vector<float> > batchScores;
+    edgeboxes->getBoundingBoxes(edges, orientations, batchBoxes, batchScores);
+    ASSERT_EQ(2u, batchBoxes.size());
+    ASSERT_EQ(2u, batchScores.size());
+
+    // single calls on the same object, in sequence, give the same proposals
+    for (int k = 0; k < 2; k++)
+    {
+        std::vector<Rect> boxes;
+        std::vector<float> scores;
+        edgeboxes->getBoundingBoxes(edges[k], orientations[k], boxes, scores);
+        ASSERT_FALSE(boxes.empty());
+        EXPECT_EQ(boxes, batchBoxes[k]);
+        EXPECT_EQ(scores, batchScores[k]);
+    }
+}
+
 }} // namespace
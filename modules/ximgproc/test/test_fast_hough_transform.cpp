@@ -459,4 +459,55 @@ INSTANTIATE_TEST_CASE_P(FullSet, FastHoughTransformTest,
 #undef FHT_ALL_DEPTHS
 #undef FHT_ALL_CHANNELS
 
+typedef tuple<int, int> Op_Skew;
+typedef TestWithParam<Op_Skew> FastHoughTransformQuadrantsTest;
+
+TEST_P(FastHoughTransformQuadrantsTest, same_as_single_quadrants)
+{
+    int const op       = get<0>(GetParam());
+    int const makeSkew = get<1>(GetParam());
+
+    Mat src(37, 53, CV_8UC1);
+    randu(src, 0, 256);
+
+    Mat full;
+    FastHoughTransform(src, full, CV_32S, ARO_315_135, op, makeSkew);
+
+    // the quadrants are stacked, each later one overwrites the row shared with the previous one
+    int const quadrants[] = { ARO_315_0, ARO_0_45, ARO_45_90, ARO_90_135 };
+    Mat expected(full.size(), full.type(), Scalar::all(0));
+    int shift = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        Mat quad;
+        FastHoughTransform(src, quad, CV_32S, quadrants[i], op, makeSkew);
+        quad.copyTo(expected.rowRange(shift, shift + quad.rows));
+        shift += quad.rows - 1;
+    }
+    ASSERT_EQ(full.rows, shift + 1);
+    EXPECT_EQ(0, cvtest::norm(expected, full, NORM_INF));
+}
+
+TEST_P(FastHoughTransformQuadrantsTest, threads_identical)
+{
+    int const op       = get<0>(GetParam());
+    int const makeSkew = get<1>(GetParam());
+
+    Mat src(300, 421, CV_32FC1);
+    randu(src, 0, 1);
+
+    int const nThreads = getNumThreads();
+    Mat expected, actual;
+    setNumThreads(1);
+    FastHoughTransform(src, expected, CV_32F, ARO_315_135, op, makeSkew);
+    setNumThreads(nThreads);
+    FastHoughTransform(src, actual, CV_32F, ARO_315_135, op, makeSkew);
+
+    EXPECT_EQ(0, cvtest::norm(expected, actual, NORM_INF));
+}
+
+INSTANTIATE_TEST_CASE_P(FullSet, FastHoughTransformQuadrantsTest,
+                        Combine(Values(FHT_ADD, FHT_MIN, FHT_MAX, FHT_AVE),
+                                Values(HDO_RAW, HDO_DESKEW)));
+
 }} // namespace
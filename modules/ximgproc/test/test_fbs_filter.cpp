@@ -36,8 +36,6 @@
 
 #include "test_precomp.hpp"
 
-#ifdef HAVE_EIGEN
-
 namespace opencv_test { namespace {
 
 using namespace std;
@@ -123,9 +121,29 @@ TEST(FastBilateralSolverTest, ReferenceAccuracy)
 #endif
 }
 
+TEST(FastBilateralSolverTest, reuse_and_threads)
+{
+    RNG rnd(3);
+    Mat guide(240, 320, CV_8UC3), src(guide.size(), CV_32FC1), confidence(guide.size(), CV_32FC1);
+    rnd.fill(guide, RNG::UNIFORM, 0, 255);
+    rnd.fill(src, RNG::UNIFORM, 0, 1);
+    rnd.fill(confidence, RNG::UNIFORM, 0, 1);
+
+    Ptr<FastBilateralSolverFilter> fbs = createFastBilateralSolverFilter(guide, 8.0, 8.0, 8.0);
+    Mat first, second, single;
+    fbs->filter(src, confidence, first);
+    fbs->filter(src, confidence, second);
+
+    int threads = getNumThreads();
+    setNumThreads(1);
+    fastBilateralSolverFilter(guide, src, confidence, single, 8.0, 8.0, 8.0);
+    setNumThreads(threads);
+
+    EXPECT_EQ(0, cvtest::norm(first, second, NORM_INF));
+    EXPECT_EQ(0, cvtest::norm(first, single, NORM_INF));
+}
+
 INSTANTIATE_TEST_CASE_P(FullSet, FastBilateralSolverTest,Combine(Values(szODD, szQVGA), SrcTypes::all(), GuideTypes::all()));
 
 }
 }
-
-#endif //HAVE_EIGEN
@@ -0,0 +1,52 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+#include "test_precomp.hpp"
+
+namespace opencv_test { namespace {
+
+TEST(ximgproc_GraphSegmentation, deterministic)
+{
+    Mat img = imread(cvtest::findDataFile("cv/shared/lena.png"), IMREAD_COLOR);
+    ASSERT_FALSE(img.empty());
+    // large enough for the parallel sort to split the edges
+    resize(img, img, Size(200, 300));
+
+    Ptr<segmentation::GraphSegmentation> gs = segmentation::createGraphSegmentation(0.5, 300.f, 50);
+
+    Mat first, second, single;
+    gs->processImage(img, first);
+    gs->processImage(img, second);
+
+    int threads = getNumThreads();
+    setNumThreads(1);
+    gs->processImage(img, single);
+    setNumThreads(threads);
+
+    ASSERT_EQ(CV_32SC1, first.type());
+    ASSERT_EQ(img.size(), first.size());
+    EXPECT_EQ(0, cvtest::norm(first, second, NORM_INF));
+    EXPECT_EQ(0, cvtest::norm(first, single, NORM_INF));
+
+    // ids are sequential, in order of appearance
+    int next_id = 0;
+    for (int i = 0; i < first.rows; i++)
+        for (int j = 0; j < first.cols; j++)
+        {
+            int id = first.at<int>(i, j);
+            ASSERT_LE(id, next_id);
+            if (id == next_id)
+                next_id++;
+        }
+    EXPECT_GT(next_id, 1);
+}
+
+TEST(ximgproc_GraphSegmentation, uniform_image)
+{
+    Mat img(260, 50, CV_8UC3, Scalar(10, 20, 30));
+    Mat dst;
+    segmentation::createGraphSegmentation()->processImage(img, dst);
+    EXPECT_EQ(0, cvtest::norm(dst, NORM_INF));
+}
+
+}} // namespace
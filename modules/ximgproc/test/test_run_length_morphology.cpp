@@ -245,5 +245,94 @@ TEST_P(RL_Paint, same_result)
 
 INSTANTIATE_TEST_CASE_P(TypicalSET, RL_Paint, Values(CV_8U, CV_16U, CV_16S, CV_32F, CV_64F));
 
+typedef tuple<int> RLCCParams;
+
+class RL_ConnectedComponents : public RLTestBase, public ::testing::TestWithParam<RLCCParams>
+{
+public:
+    RL_ConnectedComponents() { }
+protected:
+    virtual void SetUp() { setUp_impl(); }
+};
+
+TEST_P(RL_ConnectedComponents, same_as_pixel_image)
+{
+    int connectivity = get<0>(GetParam());
+
+    // a denser random image, so that there are components of many shapes
+    Mat theRandom, pixBinary, rlImage;
+    generateRandomImage(theRandom);
+    cv::threshold(theRandom, pixBinary, 160.0, 255.0, THRESH_BINARY);
+    rl::threshold(theRandom, rlImage, 160.0, THRESH_BINARY);
+
+    Mat pixLabels, pixStats, pixCentroids;
+    int nPixLabels = cv::connectedComponentsWithStats(pixBinary, pixLabels, pixStats, pixCentroids, connectivity, CV_32S);
+
+    Mat rlLabels, rlStats, rlCentroids;
+    int nLabels = rl::connectedComponentsWithStats(rlImage, rlLabels, rlStats, rlCentroids, connectivity);
+    ASSERT_EQ(nPixLabels - 1, nLabels);
+    ASSERT_EQ(nLabels, rl::connectedComponents(rlImage, noArray(), connectivity));
+    // the first element of a run-length encoded image holds its size, not a run
+    ASSERT_EQ(rlImage.rows - 1, (int)rlLabels.total());
+
+    // the labels of both versions must describe the same partition of the pixels
+    std::vector<int> toPixLabel(nLabels, -1);
+    for (int i = 1; i < rlImage.rows; ++i)
+    {
+        const Point3i& run = rlImage.at<Point3i>(i);
+        int label = rlLabels.at<int>(i - 1);
+        for (int x = run.x; x <= run.y; ++x)
+        {
+            int pixLabel = pixLabels.at<int>(run.z, x);
+            if (toPixLabel[label] < 0)
+                toPixLabel[label] = pixLabel;
+            ASSERT_EQ(toPixLabel[label], pixLabel);
+        }
+    }
+
+    for (int label = 0; label < nLabels; ++label)
+    {
+        int pixLabel = toPixLabel[label];
+        ASSERT_GT(pixLabel, 0);
+        for (int k = 0; k < CC_STAT_MAX; ++k)
+            EXPECT_EQ(pixStats.at<int>(pixLabel, k), rlStats.at<int>(label, k));
+        EXPECT_NEAR(pixCentroids.at<double>(pixLabel, 0), rlCentroids.at<double>(label, 0), 1e-9);
+        EXPECT_NEAR(pixCentroids.at<double>(pixLabel, 1), rlCentroids.at<double>(label, 1), 1e-9);
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(TypicalSET, RL_ConnectedComponents, Values(4, 8));
+
+class RL_Bitwise : public RLTestBase, public ::testing::Test
+{
+public:
+    RL_Bitwise() { }
+protected:
+    virtual void SetUp() { setUp_impl(); }
+};
+
+TEST_F(RL_Bitwise, same_as_pixel_image)
+{
+    // the checkerboard and a dilated random image overlap in many different ways
+    Mat pixRandom, rlRandom;
+    Mat pixKernel = cv::getStructuringElement(MORPH_RECT, Size(5, 5));
+    cv::dilate(test_image[1], pixRandom, pixKernel);
+    rl::dilate(test_image_rle[1], rlRandom, rl::getStructuringElement(MORPH_RECT, Size(5, 5)));
+    ASSERT_TRUE(areImagesIdentical(pixRandom, rlRandom));
+
+    Mat pixResult, rlResult;
+    cv::bitwise_and(test_image[0], pixRandom, pixResult);
+    rl::bitwise_and(test_image_rle[0], rlRandom, rlResult);
+    EXPECT_TRUE(areImagesIdentical(pixResult, rlResult));
+
+    cv::bitwise_or(test_image[0], pixRandom, pixResult);
+    rl::bitwise_or(test_image_rle[0], rlRandom, rlResult);
+    EXPECT_TRUE(areImagesIdentical(pixResult, rlResult));
+
+    cv::bitwise_xor(test_image[0], pixRandom, pixResult);
+    rl::bitwise_xor(test_image_rle[0], rlRandom, rlResult);
+    EXPECT_TRUE(areImagesIdentical(pixResult, rlResult));
+}
+
 }
 }
\ No newline at end of file
@@ -0,0 +1,70 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+#include "test_precomp.hpp"
+
+namespace opencv_test { namespace {
+
+static Mat makeSeedsImage(int shift)
+{
+    Mat img(240, 320, CV_8UC3);
+    RNG rng(17);
+    img.setTo(Scalar(40, 80, 120));
+    for (int i = 0; i < 30; i++)
+    {
+        Point center(rng.uniform(0, img.cols) + shift, rng.uniform(0, img.rows));
+        circle(img, center, rng.uniform(10, 50),
+               Scalar(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256)), FILLED);
+    }
+    Mat noise(img.size(), CV_8UC3);
+    randu(noise, Scalar::all(0), Scalar::all(16));
+    img += noise;
+    return img;
+}
+
+TEST(ximgproc_SuperpixelSEEDS, threads_identical)
+{
+    Mat img = makeSeedsImage(0);
+    int const nThreads = getNumThreads();
+
+    Ptr<SuperpixelSEEDS> seeds = createSuperpixelSEEDS(img.cols, img.rows, img.channels(), 200, 4);
+    Mat expected, actual;
+    setNumThreads(1);
+    seeds->iterate(img, 4);
+    seeds->getLabels(expected);
+    expected = expected.clone();
+    setNumThreads(nThreads);
+    seeds->iterate(img, 4);
+    seeds->getLabels(actual);
+
+    EXPECT_EQ(0, cvtest::norm(expected, actual, NORM_INF));
+}
+
+TEST(ximgproc_SuperpixelSEEDS, warm_start)
+{
+    Ptr<SuperpixelSEEDS> seeds = createSuperpixelSEEDS(320, 240, 3, 200, 4);
+    EXPECT_FALSE(seeds->getUseWarmStart());
+    seeds->setUseWarmStart(true);
+    EXPECT_TRUE(seeds->getUseWarmStart());
+
+    Mat labels;
+    for (int frame = 0; frame < 3; frame++)
+    {
+        seeds->iterate(makeSeedsImage(2 * frame), 2);
+        seeds->getLabels(labels);
+        ASSERT_EQ(CV_32SC1, labels.type());
+        double minLabel = 0, maxLabel = 0;
+        minMaxLoc(labels, &minLabel, &maxLabel);
+        EXPECT_GE(minLabel, 0);
+        EXPECT_LT(maxLabel, seeds->getNumberOfSuperpixels());
+    }
+
+    // a warm start on the same frame only refines the boundaries
+    Mat img = makeSeedsImage(4);
+    Mat before = labels.clone();
+    seeds->iterate(img, 4);
+    seeds->getLabels(labels);
+    EXPECT_LT(countNonZero(before != labels), (int)labels.total() / 10);
+}
+
+}} // namespace
@@ -0,0 +1,71 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+#include "test_precomp.hpp"
+
+namespace opencv_test { namespace {
+
+TEST(ximgproc_SelectiveSearchSegmentation, repeated_process)
+{
+    Mat img = imread(cvtest::findDataFile("cv/shared/lena.png"), IMREAD_COLOR);
+    ASSERT_FALSE(img.empty());
+    resize(img, img, Size(128, 128));
+
+    Ptr<segmentation::SelectiveSearchSegmentation> ss = segmentation::createSelectiveSearchSegmentation();
+    ss->setBaseImage(img);
+    ss->switchToSelectiveSearchFast();
+
+    std::vector<Rect> first, second;
+    srand(0);
+    ss->process(first);
+    srand(0);
+    ss->process(second);
+
+    ASSERT_FALSE(first.empty());
+    EXPECT_EQ(first, second);
+    // the last merge of every grouping covers the whole image
+    EXPECT_NE(std::find(first.begin(), first.end(), Rect(Point(), img.size())), first.end());
+}
+
+TEST(ximgproc_SelectiveSearchSegmentation, user_strategy)
+{
+    Mat img = imread(cvtest::findDataFile("cv/shared/lena.png"), IMREAD_COLOR);
+    ASSERT_FALSE(img.empty());
+    resize(img, img, Size(96, 96));
+
+    // wrapping a built-in strategy hides it from duplication: the sequential path must give the same rects
+    class Wrapper : public segmentation::SelectiveSearchSegmentationStrategy
+    {
+    public:
+        Wrapper(const Ptr<segmentation::SelectiveSearchSegmentationStrategy>& s) : s_(s) {}
+        void setImage(InputArray img_, InputArray regions, InputArray sizes, int image_id) CV_OVERRIDE { s_->setImage(img_, regions, sizes, image_id); }
+        float get(int r1, int r2) CV_OVERRIDE { return s_->get(r1, r2); }
+        void merge(int r1, int r2) CV_OVERRIDE { s_->merge(r1, r2); }
+    private:
+        Ptr<segmentation::SelectiveSearchSegmentationStrategy> s_;
+    };
+
+    std::vector<Rect> builtin, wrapped;
+    for (int wrap = 0; wrap < 2; wrap++)
+    {
+        Ptr<segmentation::SelectiveSearchSegmentation> ss = segmentation::createSelectiveSearchSegmentation();
+        Mat hsv;
+        cvtColor(img, hsv, COLOR_BGR2HSV);
+        ss->addImage(hsv);
+        ss->addImage(img);
+        ss->addGraphSegmentation(segmentation::createGraphSegmentation(0.8, 150.f));
+        ss->addGraphSegmentation(segmentation::createGraphSegmentation(0.8, 300.f));
+        Ptr<segmentation::SelectiveSearchSegmentationStrategy> s = segmentation::createSelectiveSearchSegmentationStrategyMultiple(
+            segmentation::createSelectiveSearchSegmentationStrategyColor(), segmentation::createSelectiveSearchSegmentationStrategySize());
+        if (wrap)
+            s = makePtr<Wrapper>(s);
+        ss->addStrategy(s);
+
+        srand(0);
+        ss->process(wrap ? wrapped : builtin);
+    }
+    ASSERT_FALSE(builtin.empty());
+    EXPECT_EQ(builtin, wrapped);
+}
+
+}} // namespace
@@ -48,5 +48,67 @@ TEST(ximgproc_Thinning, simple_GUOHALL)
 #endif
 }
 
+// straightforward full-image iterations, as the algorithms are described
+static void referenceThinning(const Mat& src, Mat& dst, int thinningType)
+{
+    Mat img = src / 255, prev;
+    do {
+        img.copyTo(prev);
+        for (int iter = 0; iter < 2; iter++)
+        {
+            Mat marker = Mat::zeros(img.size(), CV_8UC1);
+            for (int i = 1; i < img.rows - 1; i++)
+                for (int j = 1; j < img.cols - 1; j++)
+                {
+                    if (!img.at<uchar>(i, j))
+                        continue;
+                    int p2 = img.at<uchar>(i-1, j), p3 = img.at<uchar>(i-1, j+1), p4 = img.at<uchar>(i, j+1);
+                    int p5 = img.at<uchar>(i+1, j+1), p6 = img.at<uchar>(i+1, j), p7 = img.at<uchar>(i+1, j-1);
+                    int p8 = img.at<uchar>(i, j-1), p9 = img.at<uchar>(i-1, j-1);
+                    bool remove;
+                    if (thinningType == THINNING_ZHANGSUEN)
+                    {
+                        int A = (p2 == 0 && p3 == 1) + (p3 == 0 && p4 == 1) + (p4 == 0 && p5 == 1) + (p5 == 0 && p6 == 1) +
+                                (p6 == 0 && p7 == 1) + (p7 == 0 && p8 == 1) + (p8 == 0 && p9 == 1) + (p9 == 0 && p2 == 1);
+                        int B = p2 + p3 + p4 + p5 + p6 + p7 + p8 + p9;
+                        int m1 = iter == 0 ? (p2 * p4 * p6) : (p2 * p4 * p8);
+                        int m2 = iter == 0 ? (p4 * p6 * p8) : (p2 * p6 * p8);
+                        remove = A == 1 && B >= 2 && B <= 6 && m1 == 0 && m2 == 0;
+                    }
+                    else
+                    {
+                        int C = ((!p2) & (p3 | p4)) + ((!p4) & (p5 | p6)) + ((!p6) & (p7 | p8)) + ((!p8) & (p9 | p2));
+                        int N1 = (p9 | p2) + (p3 | p4) + (p5 | p6) + (p7 | p8);
+                        int N2 = (p2 | p3) + (p4 | p5) + (p6 | p7) + (p8 | p9);
+                        int N = std::min(N1, N2);
+                        int m = iter == 0 ? ((p6 | p7 | (!p9)) & p8) : ((p2 | p3 | (!p5)) & p4);
+                        remove = C == 1 && N >= 2 && N <= 3 && m == 0;
+                    }
+                    if (remove)
+                        marker.at<uchar>(i, j) = 1;
+                }
+            img.setTo(0, marker);
+        }
+    }
+    while (cvtest::norm(img, prev, NORM_INF) > 0);
+    dst = img * 255;
+}
+
+TEST(ximgproc_Thinning, same_as_reference)
+{
+    Mat src(300, 200, CV_8UC1);
+    RNG rng(7);
+    rng.fill(src, RNG::UNIFORM, 0, 256);
+    GaussianBlur(src, src, Size(0, 0), 4);
+    threshold(src, src, 128, 255, THRESH_BINARY);
+
+    for (int type = THINNING_ZHANGSUEN; type <= THINNING_GUOHALL; type++)
+    {
+        Mat ref, dst;
+        referenceThinning(src, ref, type);
+        thinning(src, dst, type);
+        EXPECT_EQ(0, cvtest::norm(ref, dst, NORM_INF)) << "thinningType=" << type;
+    }
+}
 
 }} // namespace
@@ -70,6 +70,33 @@ TEST(WeightedMedianFilterTest, mask_zeros_no_crash)
     EXPECT_EQ(cv::norm(img, filtered, NORM_INF), 0.0);
 }
 
+TEST(WeightedMedianFilterTest, threads_identical)
+{
+    Mat img = imread(getDataDir() + "cv/ximgproc/sources/01.png");
+    ASSERT_FALSE(img.empty());
+    Mat joint, src32f;
+    cvtColor(img, joint, COLOR_BGR2GRAY);
+    img.convertTo(src32f, CV_32F, 1.0/255);
+
+    Mat mask(img.size(), CV_8U);
+    RNG rng(0);
+    rng.fill(mask, RNG::UNIFORM, 0, 4);
+
+    Mat res8u, res32f;
+    weightedMedianFilter(joint, img, res8u, 9, 25, WMF_EXP, mask);
+    weightedMedianFilter(joint, src32f, res32f, 9, 25, WMF_IV1);
+
+    int threads = getNumThreads();
+    setNumThreads(1);
+    Mat ref8u, ref32f;
+    weightedMedianFilter(joint, img, ref8u, 9, 25, WMF_EXP, mask);
+    weightedMedianFilter(joint, src32f, ref32f, 9, 25, WMF_IV1);
+    setNumThreads(threads);
+
+    EXPECT_EQ(0, cvtest::norm(res8u, ref8u, NORM_INF));
+    EXPECT_EQ(0, cvtest::norm(res32f, ref32f, NORM_INF));
+}
+
 INSTANTIATE_TEST_CASE_P(TypicalSET, WeightedMedianFilterTest, Combine(Values(szODD, szQVGA),  Values(WMF_EXP, WMF_IV2, WMF_OFF)));
 
 